@@ -99,4 +99,25 @@ Instance GetInstance(int index)
 {
     StructuredBuffer<Instance> instances = ResourceDescriptorHeap[NonUniformResourceIndex(GSceneInfo.InstancesBufferIndex)];
     return instances[NonUniformResourceIndex(index)];
+}
+
+MeshVertex GetMeshVertex(Instance instance, uint vertexID)
+{
+    PackedMeshVertex packed = BufferLoad<PackedMeshVertex>(instance.BufferIndex, vertexID, instance.VerticesOffset);
+    return VertexPacking::UnpackMeshVertex(packed, instance.PositionOffset, instance.PositionScale);
+}
+
+uint3 GetTriangleIndices(Instance instance, uint primitiveIndex)
+{
+    if (!instance.b16BitIndices)
+        return BufferLoad<uint3>(instance.BufferIndex, primitiveIndex, instance.IndicesOffset);
+
+    // The loads have to be 4 bytes aligned, the 3 indices are in the 2 uints around them
+    uint byteOffset = instance.IndicesOffset + primitiveIndex * 6;
+    uint alignedOffset = byteOffset & ~3u;
+    ByteAddressBuffer buffer = ResourceDescriptorHeap[NonUniformResourceIndex(instance.BufferIndex)];
+    uint2 words = buffer.Load2(alignedOffset);
+    if (alignedOffset == byteOffset)
+        return uint3(words.x & 0xffff, words.x >> 16, words.y & 0xffff);
+    return uint3(words.x >> 16, words.y & 0xffff, words.y >> 16);
 }
\ No newline at end of file
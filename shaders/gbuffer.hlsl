@@ -13,13 +13,14 @@ struct VSOut
 };
 
 uint cInstanceID;
+uint cMeshletOffset; // first meshlet of the LOD being drawn
 
 VSOut MainVS(uint vertexID : SV_VertexID)
 {
     VSOut result = (VSOut)0;
 
     Instance instance = GetInstance(cInstanceID);
-    MeshVertex vertex = BufferLoad<MeshVertex>(instance.BufferIndex, vertexID, instance.VerticesOffset);
+    MeshVertex vertex = GetMeshVertex(instance, vertexID);
 
 	float3 normal = TransformNormal(instance.LocalTransform, vertex.Normal);
 	float3 tangent = normalize(TransformNormal(instance.LocalTransform, vertex.Tangent.xyz));
@@ -43,7 +44,8 @@ void MainMS(uint threadID : SV_DispatchThreadID, uint gtID : SV_GroupThreadID, u
 		    out indices uint3 tris[MESHLET_MAX_TRIANGLES], out vertices VSOut verts[MESHLET_MAX_VERTICES])
 {
     Instance instance = GetInstance(cInstanceID);
-    Meshlet meshlet = BufferLoad<Meshlet>(instance.BufferIndex, groupID, instance.MeshletsOffset);
+    uint meshletIndex = groupID + cMeshletOffset;
+    Meshlet meshlet = BufferLoad<Meshlet>(instance.BufferIndex, meshletIndex, instance.MeshletsOffset);
 
     SetMeshOutputCounts(meshlet.VertexCount, meshlet.TriangleCount);
 
@@ -60,7 +62,7 @@ void MainMS(uint threadID : SV_DispatchThreadID, uint gtID : SV_GroupThreadID, u
 
         uint vertexID = BufferLoad<uint>(instance.BufferIndex, gtID + meshlet.VertexOffset, instance.MeshletsVerticesOffset);
 
-    	MeshVertex vertex = BufferLoad<MeshVertex>(instance.BufferIndex, vertexID, instance.VerticesOffset);
+    	MeshVertex vertex = GetMeshVertex(instance, vertexID);
 
     	float3 normal = normalize(TransformNormal(instance.LocalTransform, vertex.Normal));
     	float3 tangent = normalize(TransformNormal(instance.LocalTransform, vertex.Tangent.xyz));
@@ -75,7 +77,7 @@ void MainMS(uint threadID : SV_DispatchThreadID, uint gtID : SV_GroupThreadID, u
     	result.TBN		= transpose(float3x3(tangent, bitangent, normal));
     	result.UV       = vertex.UV;
     	
-        result.MeshletIndex = groupID;
+        result.MeshletIndex = meshletIndex;
 		verts[gtID] = result;    
     }
 }
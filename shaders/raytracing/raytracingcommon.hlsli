@@ -16,14 +16,14 @@ VertexAttributes GetVertexAttributes(Instance instance, float2 attribBarycentric
 {
     // Given attributes a0, a1 and a2 for the 3 vertices of a triangle, barycentrics.x is the weight for a1 and barycentrics.y is the weight for a2.
     float3 barycentrics = float3(1 - attribBarycentrics.x - attribBarycentrics.y, attribBarycentrics.x, attribBarycentrics.y);
-    uint3  primitive    = BufferLoad<uint3>(instance.BufferIndex, primitiveIndex, instance.IndicesOffset);
+    uint3  primitive    = GetTriangleIndices(instance, primitiveIndex);
 
     MeshVertex vertex[3];
     VertexAttributes vertexAttrib = (VertexAttributes)0;
     for (int i = 0; i < 3; ++i)
     {
         uint vertexID = primitive[i];
-        vertex[i] = BufferLoad<MeshVertex>(instance.BufferIndex, vertexID, instance.VerticesOffset);
+        vertex[i] = GetMeshVertex(instance, vertexID);
 
         vertex[i].Position = mul(instance.LocalTransform, float4(vertex[i].Position, 1.0f)).xyz;
 
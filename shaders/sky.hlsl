@@ -9,8 +9,11 @@ struct SkyboxVertexOutput
     float4 local_position : Position;
 };
 
-SkyboxVertexOutput MainVS(float3 pos : Position)
+SkyboxVertexOutput MainVS(float3 packedPos : Position)
 {
+    // The packed positions are unorms inside of the cube bounds, the cube is centered so this is already the direction
+    float3 pos = packedPos * 2.0f - 1.0f;
+
     float4x4 rot_view = GSceneInfo.View;
     rot_view._m03_m13_m23 = 0.0; // remove translation
     
@@ -17,4 +17,47 @@ namespace limbo::Algo
 
         return hash;
 	}
-}
+
+	// MurmurHash64A - https://github.com/aappleby/smhasher
+	// Meant for hashing big binary blobs (file contents, pixel data), it consumes 8 bytes per iteration
+	inline uint64 Hash64(const void* data, size_t size, uint64 seed = 0)
+	{
+		constexpr uint64 m = 0xc6a4a7935bd1e995ull;
+		constexpr int r = 47;
+
+		uint64 hash = seed ^ (size * m);
+
+		const uint8* bytes = (const uint8*)data;
+		const size_t numBlocks = size / 8;
+		for (size_t i = 0; i < numBlocks; ++i)
+		{
+			uint64 k;
+			memcpy(&k, bytes + i * 8, sizeof(uint64));
+
+			k *= m;
+			k ^= k >> r;
+			k *= m;
+
+			hash ^= k;
+			hash *= m;
+		}
+
+		const uint8* tail = bytes + numBlocks * 8;
+		switch (size & 7)
+		{
+		case 7: hash ^= uint64(tail[6]) << 48; [[fallthrough]];
+		case 6: hash ^= uint64(tail[5]) << 40; [[fallthrough]];
+		case 5: hash ^= uint64(tail[4]) << 32; [[fallthrough]];
+		case 4: hash ^= uint64(tail[3]) << 24; [[fallthrough]];
+		case 3: hash ^= uint64(tail[2]) << 16; [[fallthrough]];
+		case 2: hash ^= uint64(tail[1]) << 8;  [[fallthrough]];
+		case 1: hash ^= uint64(tail[0]);
+			hash *= m;
+		}
+
+		hash ^= hash >> r;
+		hash *= m;
+		hash ^= hash >> r;
+		return hash;
+	}
+}
\ No newline at end of file
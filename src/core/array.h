@@ -2,6 +2,9 @@
 
 namespace limbo
 {
+	template<typename Type, uint32 InlineCapacity>
+	class TSmallVector;
+
 	template<typename T>
 	class Span
 	{
@@ -18,6 +21,11 @@ namespace limbo
 			m_Data(list.data()), m_Size((uint32)list.size())
 		{}
 
+		template<uint32 N>
+		Span(const TSmallVector<std::remove_cv_t<T>, N>& list) :
+			m_Data(list.GetData()), m_Size(list.GetSize())
+		{}
+
 		Span(const T* pValue, uint32 size) :
 			m_Data(pValue), m_Size(size)
 		{}
@@ -62,27 +70,32 @@ namespace limbo
 
 		TStaticArray(const std::initializer_list<std::remove_cv_t<Type>>& list)
 			: m_Capacity(Capacity)
-			, m_Size((uint32)list.size())
+			, m_Size(0)
 		{
-			memcpy(m_Data, list.begin(), sizeof(Type) * list.size());
+			check(list.size() <= Capacity);
+			for (const Type& element : list)
+				m_Data[m_Size++] = element;
 		}
 
 		TStaticArray(const Span<std::remove_cv_t<Type>>& span)
 			: m_Capacity(Capacity)
-			, m_Size(span.GetSize())
+			, m_Size(0)
 		{
-			memcpy(m_Data, span.begin(), sizeof(Type) * span.GetSize());
+			check(span.GetSize() <= Capacity);
+			for (const Type& element : span)
+				m_Data[m_Size++] = element;
 		}
 
-		template<typename OtherType, uint32 OtherCapacity>
-		TStaticArray<Type, Capacity>& operator=(const TStaticArray<std::remove_cv_t<OtherType>, OtherCapacity>& other)
+		template<uint32 OtherCapacity>
+		TStaticArray<Type, Capacity>& operator=(const TStaticArray<Type, OtherCapacity>& other)
 		{
-			static_assert(TIsSame<Type, OtherType>::Value);
-			static_assert(OtherCapacity > Capacity);
+			static_assert(OtherCapacity <= Capacity, "Assigning from an array that may not fit in this one");
 
-			m_Capacity = OtherCapacity;
-			m_Size = other.GetSize();
-			memcpy(m_Data, other.begin(), sizeof(Type) * other.GetSize());
+			// Copy element by element, Type is not guaranteed to be trivially copyable
+			m_Size = 0;
+			for (const Type& element : other)
+				m_Data[m_Size++] = element;
+			return *this;
 		}
 
 		uint32 GetSize() const
@@ -125,4 +138,245 @@ namespace limbo
 		uint32		m_Capacity;
 		uint32		m_Size;
 	};
+
+	/**
+	 * Vector that keeps up to InlineCapacity elements inside the object itself and only spills to the heap when it grows past that.
+	 * Meant for the small lists that get built every frame (render targets, descriptor tables, techniques) to avoid an allocation each time.
+	 */
+	template<typename Type, uint32 InlineCapacity>
+	class TSmallVector
+	{
+		static_assert(InlineCapacity > 0);
+
+	public:
+		TSmallVector() = default;
+
+		TSmallVector(const std::initializer_list<Type>& list)
+		{
+			Reserve((uint32)list.size());
+			for (const Type& element : list)
+				new (m_Data + m_Size++) Type(element);
+		}
+
+		TSmallVector(const TSmallVector& other)
+		{
+			CopyFrom(other);
+		}
+
+		TSmallVector(TSmallVector&& other) noexcept
+		{
+			MoveFrom(std::move(other));
+		}
+
+		~TSmallVector()
+		{
+			Clear();
+			FreeHeap();
+		}
+
+		TSmallVector& operator=(const TSmallVector& other)
+		{
+			if (this != &other)
+			{
+				Clear();
+				CopyFrom(other);
+			}
+			return *this;
+		}
+
+		TSmallVector& operator=(TSmallVector&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Clear();
+				FreeHeap();
+				MoveFrom(std::move(other));
+			}
+			return *this;
+		}
+
+		void Add(const Type& element)
+		{
+			Emplace(element);
+		}
+
+		void Add(Type&& element)
+		{
+			Emplace(std::move(element));
+		}
+
+		template<typename... Args>
+		Type& Emplace(Args&&... args)
+		{
+			if (m_Size < m_Capacity)
+			{
+				Type* element = new (m_Data + m_Size) Type(std::forward<Args>(args)...);
+				m_Size++;
+				return *element;
+			}
+
+			// Construct the new element before relocating, args may reference an element of this vector
+			const uint32 newCapacity = m_Capacity * 2;
+			Type* newData = Allocate(newCapacity);
+			Type* element = new (newData + m_Size) Type(std::forward<Args>(args)...);
+			RelocateElements(newData, m_Data, m_Size);
+			FreeHeap();
+			m_Data = newData;
+			m_Capacity = newCapacity;
+			m_Size++;
+			return *element;
+		}
+
+		void Pop()
+		{
+			check(m_Size > 0);
+			m_Size--;
+			m_Data[m_Size].~Type();
+		}
+
+		// Destroys all the elements but keeps the current allocation
+		void Clear()
+		{
+			if constexpr (!std::is_trivially_destructible_v<Type>)
+			{
+				for (uint32 i = 0; i < m_Size; ++i)
+					m_Data[i].~Type();
+			}
+			m_Size = 0;
+		}
+
+		void Reserve(uint32 capacity)
+		{
+			if (capacity > m_Capacity)
+				Grow(capacity);
+		}
+
+		void Resize(uint32 size)
+		{
+			Reserve(size);
+			for (uint32 i = m_Size; i < size; ++i)
+				new (m_Data + i) Type();
+			for (uint32 i = size; i < m_Size; ++i)
+				m_Data[i].~Type();
+			m_Size = size;
+		}
+
+		uint32 GetSize() const
+		{
+			return m_Size;
+		}
+
+		uint32 GetCapacity() const
+		{
+			return m_Capacity;
+		}
+
+		bool IsEmpty() const
+		{
+			return m_Size == 0;
+		}
+
+		// Returns true while the elements still live in the inline storage
+		bool IsInline() const
+		{
+			return m_Data == GetInlineData();
+		}
+
+		Type* GetData() { return m_Data; }
+		const Type* GetData() const { return m_Data; }
+
+		Type& operator[](uint32 index)
+		{
+			check(index < m_Size);
+			return m_Data[index];
+		}
+
+		const Type& operator[](uint32 index) const
+		{
+			check(index < m_Size);
+			return m_Data[index];
+		}
+
+		Type* begin() { return m_Data; }
+		Type* end() { return m_Data + m_Size; }
+		const Type* begin() const { return m_Data; }
+		const Type* end() const { return m_Data + m_Size; }
+
+	private:
+		Type* GetInlineData() { return reinterpret_cast<Type*>(m_InlineData); }
+		const Type* GetInlineData() const { return reinterpret_cast<const Type*>(m_InlineData); }
+
+		static Type* Allocate(uint32 capacity)
+		{
+			return static_cast<Type*>(::operator new(sizeof(Type) * capacity, std::align_val_t(alignof(Type))));
+		}
+
+		void Grow(uint32 capacity)
+		{
+			Type* newData = Allocate(capacity);
+			RelocateElements(newData, m_Data, m_Size);
+			FreeHeap();
+			m_Data = newData;
+			m_Capacity = capacity;
+		}
+
+		void FreeHeap()
+		{
+			if (!IsInline())
+				::operator delete(m_Data, std::align_val_t(alignof(Type)));
+			m_Data = GetInlineData();
+			m_Capacity = InlineCapacity;
+		}
+
+		// Moves count elements from src into uninitialized memory at dst and destroys the source elements
+		static void RelocateElements(Type* dst, Type* src, uint32 count)
+		{
+			if constexpr (std::is_trivially_copyable_v<Type>)
+			{
+				memcpy(dst, src, sizeof(Type) * count);
+			}
+			else
+			{
+				for (uint32 i = 0; i < count; ++i)
+				{
+					new (dst + i) Type(std::move(src[i]));
+					src[i].~Type();
+				}
+			}
+		}
+
+		void CopyFrom(const TSmallVector& other)
+		{
+			Reserve(other.m_Size);
+			for (uint32 i = 0; i < other.m_Size; ++i)
+				new (m_Data + i) Type(other.m_Data[i]);
+			m_Size = other.m_Size;
+		}
+
+		// Expects this to be empty and pointing at the inline storage
+		void MoveFrom(TSmallVector&& other)
+		{
+			if (other.IsInline())
+			{
+				RelocateElements(m_Data, other.m_Data, other.m_Size);
+				m_Size = other.m_Size;
+			}
+			else
+			{
+				// Steal the heap allocation
+				m_Data = other.m_Data;
+				m_Size = other.m_Size;
+				m_Capacity = other.m_Capacity;
+				other.m_Data = other.GetInlineData();
+				other.m_Capacity = InlineCapacity;
+			}
+			other.m_Size = 0;
+		}
+
+	private:
+		alignas(Type) uint8	m_InlineData[sizeof(Type) * InlineCapacity];
+		Type*				m_Data		= GetInlineData();
+		uint32				m_Size		= 0;
+		uint32				m_Capacity	= InlineCapacity;
+	};
 }
\ No newline at end of file
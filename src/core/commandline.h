@@ -5,6 +5,10 @@
 #define LIMBO_CMD_D3DDEBUG "--d3ddebug"
 #define LIMBO_CMD_GPU_VALIDATION "--gpu-validation"
 #define LIMBO_CMD_NO_CONSOLE "--no-console"
+#define LIMBO_CMD_FAST_TEXTURE_COMPRESSION "--fast-texture-compression"
+#define LIMBO_CMD_NO_TEXTURE_STREAMING "--no-texture-streaming"
+#define LIMBO_CMD_TEXTURE_BUDGET "--texture-budget" // in MB, e.g. --texture-budget=512
+#define LIMBO_CMD_SCENE_REPORT "--scene-report" // writes <scene>.report.json next to every scene that loads
 
 namespace limbo::Core
 {
@@ -2,9 +2,16 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+#if !defined(_WIN32)
+	typedef void* HANDLE;
+#endif
 
 #include "commandline.h"
-#include "windowsplatform.h"
+#if defined(_WIN32)
+	#include "windowsplatform.h"
+#endif
 
 //
 // General Macro
@@ -15,9 +22,16 @@
 	#define LIMBO_DEBUG 0
 #endif
 
-#define FORCENOINLINE __declspec(noinline)
-#define FORCEINLINE   __forceinline
-#define PLATFORM_BREAK() if (IsDebuggerPresent()) __debugbreak()
+#if defined(_WIN32)
+	#define FORCENOINLINE __declspec(noinline)
+	#define FORCEINLINE   __forceinline
+	#define PLATFORM_BREAK() if (IsDebuggerPresent()) __debugbreak()
+#else
+	// Only the headless tools build outside of Windows, an error there just aborts
+	#define FORCENOINLINE __attribute__((noinline))
+	#define FORCEINLINE   inline __attribute__((always_inline))
+	#define PLATFORM_BREAK() ((void)0)
+#endif
 
 //
 // Types
@@ -116,6 +130,7 @@ constexpr inline bool EnumHasAnyFlags(Enum Flags, Enum Contains)
 	{
 		constexpr uint16 bufferSize = 1024;
 		CharType header[bufferSize], body[bufferSize];
+#if defined(_WIN32)
 		SetConsoleTextAttribute(limbo::Core::CommandLine::ConsoleHandle, (uint16)color);
 		if constexpr (TIsSame<CharType, char>::Value)
 		{
@@ -140,16 +155,36 @@ constexpr inline bool EnumHasAnyFlags(Enum Flags, Enum Contains)
 				MessageBoxW(nullptr, body, L"limbo", MB_OK);
 			abort();
 		}
+#else
+		// The log goes to stderr so the tools can keep stdout for their results
+		static_assert(TIsSame<CharType, char>::Value, "Only char logs are supported outside of Windows");
+		snprintf(header, bufferSize, format, args...);
+		snprintf(body, bufferSize, "[Limbo] %s: %s\n", severity, header);
+		fputs(body, stderr);
+
+		if (color == InternalLogColor::Error)
+			abort();
+#endif
 	}
 
+#if defined(_WIN32)
 	#define LB_LOG(msg, ...) Internal_Log("Info", InternalLogColor::Info, msg, __VA_ARGS__)
 	#define LB_WARN(msg, ...) Internal_Log("Warn", InternalLogColor::Warn, msg, __VA_ARGS__)
 	#define LB_ERROR(msg, ...) do { Internal_Log("Error", InternalLogColor::Error, msg, __VA_ARGS__); PLATFORM_BREAK(); } while(0)
-
 #else
+	#define LB_LOG(msg, ...) Internal_Log("Info", InternalLogColor::Info, msg, ##__VA_ARGS__)
+	#define LB_WARN(msg, ...) Internal_Log("Warn", InternalLogColor::Warn, msg, ##__VA_ARGS__)
+	#define LB_ERROR(msg, ...) do { Internal_Log("Error", InternalLogColor::Error, msg, ##__VA_ARGS__); PLATFORM_BREAK(); } while(0)
+#endif
+
+#elif defined(_WIN32)
 	#define LB_LOG(msg, ...) __noop()
 	#define LB_WARN(msg, ...) __noop()
 	#define LB_ERROR(msg, ...) __noop()
+#else
+	#define LB_LOG(msg, ...) ((void)0)
+	#define LB_WARN(msg, ...) ((void)0)
+	#define LB_ERROR(msg, ...) ((void)0)
 #endif
 
 //
@@ -6,14 +6,20 @@
 #include <atomic>
 #include <thread>
 #include <condition_variable>
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
 
 namespace limbo::Core
 {
     uint32                                  SNumThreads = 0;
     RingBuffer<TOnJobSystemExecute, 256>    SJobPool;
+    RingBuffer<TOnJobSystemExecute, 256>    SBackgroundJobPool;
+    // Set while the thread runs a background job
+    thread_local bool                       SInBackgroundJob = false;
     std::condition_variable                 SWakeCondition;
     std::mutex                              SWakeMutex;
-    uint64                                  SCurrentValue = 0;
+    std::atomic<uint64>                     SCurrentValue = 0;
     std::atomic<uint64>                     SCompletedValue;
 
 
@@ -34,8 +40,11 @@ namespace limbo::Core
                 {
                     if (SJobPool.PopFront(job)) // try to grab a job from the jobPool queue
                     {
-                        job.ExecuteIfBound();
-                        SCompletedValue.fetch_add(1);
+                        RunJob(job, false);
+                    }
+                    else if (SBackgroundJobPool.PopFront(job)) // only then the background work
+                    {
+                        RunJob(job, true);
                     }
                     else
                     {
@@ -46,6 +55,7 @@ namespace limbo::Core
                 }
             });
 
+#if defined(_WIN32)
             HANDLE handle = (HANDLE)worker.native_handle();
 
             // Put each thread onto the core specified by the threadID
@@ -56,6 +66,12 @@ namespace limbo::Core
             std::wstring threadName = std::format(L"Worker Thread {}", threadID);
             HRESULT hr = SetThreadDescription(handle, threadName.c_str());
             check(SUCCEEDED(hr));
+#else
+            // The name can only have 15 characters
+            char threadName[16];
+            snprintf(threadName, sizeof(threadName), "Worker %u", threadID);
+            pthread_setname_np(worker.native_handle(), threadName);
+#endif
 
             worker.detach();
         }
@@ -63,15 +79,44 @@ namespace limbo::Core
 
     void JobSystem::Execute(TOnJobSystemExecute jobDelegate)
     {
-        SCurrentValue += 1;
-
-        // Try to push a new job until it is pushed successfully
-        while (!SJobPool.PushBack(jobDelegate)) { WaitUntilFree(); }
+        SCurrentValue.fetch_add(1);
 
-        SWakeCondition.notify_one();
+        // The jobs dispatched by a background job are background jobs too
+        PushJob(jobDelegate, SInBackgroundJob);
     }
 
     void JobSystem::ExecuteMany(uint32 jobCount, uint32 groupSize, TOnJobSystemExecuteMany jobDelegate)
+    {
+        ExecuteManyInternal(nullptr, jobCount, groupSize, jobDelegate);
+    }
+
+    void JobSystem::Execute(JobContext& context, TOnJobSystemExecute jobDelegate)
+    {
+        context.PendingJobs.fetch_add(1);
+        Execute(TOnJobSystemExecute::CreateLambda([&context, jobDelegate]()
+        {
+            jobDelegate.ExecuteIfBound();
+            context.PendingJobs.fetch_sub(1);
+        }));
+    }
+
+    void JobSystem::ExecuteMany(JobContext& context, uint32 jobCount, uint32 groupSize, TOnJobSystemExecuteMany jobDelegate)
+    {
+        ExecuteManyInternal(&context, jobCount, groupSize, jobDelegate);
+    }
+
+    void JobSystem::ExecuteBackground(JobContext& context, TOnJobSystemExecute jobDelegate)
+    {
+        SCurrentValue.fetch_add(1);
+        context.PendingJobs.fetch_add(1);
+        PushJob(TOnJobSystemExecute::CreateLambda([&context, jobDelegate]()
+        {
+            jobDelegate.ExecuteIfBound();
+            context.PendingJobs.fetch_sub(1);
+        }), true);
+    }
+
+    void JobSystem::ExecuteManyInternal(JobContext* context, uint32 jobCount, uint32 groupSize, TOnJobSystemExecuteMany jobDelegate)
     {
         if (jobCount == 0 || groupSize == 0)
             return;
@@ -79,12 +124,14 @@ namespace limbo::Core
         // Calculate the amount of job groups to dispatch (overestimate)
         const uint32 threadsToUse = (jobCount + groupSize - 1) / groupSize;
 
-        SCurrentValue += threadsToUse;
+        SCurrentValue.fetch_add(threadsToUse);
+        if (context)
+            context->PendingJobs.fetch_add(threadsToUse);
 
         for (uint32 groupIndex = 0; groupIndex < threadsToUse; ++groupIndex)
         {
             // For each group, generate one real job
-            TOnJobSystemExecute jobGroup = TOnJobSystemExecute::CreateLambda([jobCount, groupSize, jobDelegate, groupIndex]()
+            TOnJobSystemExecute jobGroup = TOnJobSystemExecute::CreateLambda([jobCount, groupSize, jobDelegate, groupIndex, context]()
         	{
                 // Calculate the current group's offset into the jobs
                 const uint32 groupJobOffset = groupIndex * groupSize;
@@ -99,12 +146,12 @@ namespace limbo::Core
                     args.jobIndex = i;
                     jobDelegate.ExecuteIfBound(args);
                 }
-            });
 
-            // Try to push a new job until it is pushed successfully:
-            while (!SJobPool.PushBack(jobGroup)) { WaitUntilFree(); }
+                if (context)
+                    context->PendingJobs.fetch_sub(1);
+            });
 
-            SWakeCondition.notify_one(); // wake one thread
+            PushJob(jobGroup, SInBackgroundJob);
         }
     }
 
@@ -113,16 +160,66 @@ namespace limbo::Core
         return SCompletedValue.load() < SCurrentValue;
     }
 
+    bool JobSystem::IsBusy(const JobContext& context)
+    {
+        return context.PendingJobs.load() > 0;
+    }
+
     void JobSystem::WaitIdle()
     {
         while (IsBusy()) { WaitUntilFree(); }
     }
 
+    void JobSystem::Wait(const JobContext& context)
+    {
+        // Help with the queued jobs instead of just yielding, this is what makes waiting from inside a job safe
+        while (IsBusy(context)) { if (!ExecuteNextJob()) WaitUntilFree(); }
+    }
+
     uint32 JobSystem::ThreadCount()
     {
         return SNumThreads;
     }
 
+    void JobSystem::PushJob(const TOnJobSystemExecute& job, bool bBackground)
+    {
+        // Try to push the job until it is pushed successfully, run the queued jobs in the meantime
+        // so a job that dispatches more jobs can not block every worker on a full queue
+        RingBuffer<TOnJobSystemExecute, 256>& pool = bBackground ? SBackgroundJobPool : SJobPool;
+        while (!pool.PushBack(job)) { if (!ExecuteNextJob()) WaitUntilFree(); }
+
+        SWakeCondition.notify_one(); // wake one thread
+    }
+
+    void JobSystem::RunJob(const TOnJobSystemExecute& job, bool bBackground)
+    {
+        // A regular job run while waiting inside of a background job still dispatches regular jobs
+        const bool bWasInBackgroundJob = SInBackgroundJob;
+        SInBackgroundJob = bBackground;
+        job.ExecuteIfBound();
+        SInBackgroundJob = bWasInBackgroundJob;
+
+        SCompletedValue.fetch_add(1);
+    }
+
+    bool JobSystem::ExecuteNextJob()
+    {
+        TOnJobSystemExecute job;
+        if (SJobPool.PopFront(job))
+        {
+            RunJob(job, false);
+            return true;
+        }
+
+        // A background job waiting on the jobs it dispatched has to be able to run them, any other thread leaves them to the workers
+        if (SInBackgroundJob && SBackgroundJobPool.PopFront(job))
+        {
+            RunJob(job, true);
+            return true;
+        }
+        return false;
+    }
+
     void JobSystem::WaitUntilFree()
     {
         SWakeCondition.notify_one();
@@ -3,6 +3,7 @@
 #include "core.h"
 
 #include <CppDelegates/Delegates.h>
+#include <atomic>
 
 // Based of Wicked Engine's jobsystem by János Turánszki - https://wickedengine.net/2018/11/24/simple-job-system-using-standard-c/
 namespace limbo::Core
@@ -17,6 +18,12 @@ namespace limbo::Core
 	DECLARE_DELEGATE(TOnJobSystemExecute);
 	DECLARE_DELEGATE(TOnJobSystemExecuteMany, JobDispatchArgs);
 
+	// Tracks a subset of the jobs in flight, so they can be waited on without waiting for every other job
+	struct JobContext
+	{
+		std::atomic<uint32> PendingJobs = 0;
+	};
+
 	struct JobSystem
 	{
         static void Initialize();
@@ -29,13 +36,36 @@ namespace limbo::Core
         //  func        : receives a JobDispatchArgs as parameter
         static void ExecuteMany(uint32 jobCount, uint32 groupSize, TOnJobSystemExecuteMany jobDelegate);
 
+        // Same as above but the jobs are also tracked by the context
+        static void Execute(JobContext& context, TOnJobSystemExecute jobDelegate);
+        static void ExecuteMany(JobContext& context, uint32 jobCount, uint32 groupSize, TOnJobSystemExecuteMany jobDelegate);
+
+        // Long work like a scene load. The workers only pick it up when there is nothing else to do, and a Wait() outside of
+        // a background job never runs it, so the frame does not stall on it. The jobs it dispatches are background jobs too.
+        static void ExecuteBackground(JobContext& context, TOnJobSystemExecute jobDelegate);
+
         static bool IsBusy();
+        static bool IsBusy(const JobContext& context);
 
         static void WaitIdle();
 
+        // Wait only for the jobs tracked by the context. The calling thread runs queued jobs while it waits, so this can be called from a job.
+        // Only a thread that is running a background job helps with the background jobs.
+        static void Wait(const JobContext& context);
+
 		static uint32 ThreadCount();
 
 	private:
+		static void ExecuteManyInternal(JobContext* context, uint32 jobCount, uint32 groupSize, TOnJobSystemExecuteMany jobDelegate);
+
+		// Queues the job in the background pool or in the regular one, runs the queued jobs while the pool is full
+		static void PushJob(const TOnJobSystemExecute& job, bool bBackground);
+		static void RunJob(const TOnJobSystemExecute& job, bool bBackground);
+
+		// Pops a queued job and runs it on the calling thread, returns false if the queue is empty.
+		// The background jobs are only popped when the calling thread is already running one.
+		static bool ExecuteNextJob();
+
 		// Idle the main thread and wait until a worker thread is free
 		static void WaitUntilFree();
 	};
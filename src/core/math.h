@@ -6,6 +6,8 @@
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/ext/quaternion_float.hpp>
+#include <glm/common.hpp>
+#include <cfloat>
 
 typedef glm::vec2 float2;
 typedef glm::vec3 float3;
@@ -38,6 +40,136 @@ namespace limbo::Math
 	inline constexpr float Radians(float degrees) { return degrees * DegreesToRadians; }
 	inline constexpr float Degrees(float radians) { return radians * RadiansToDegrees; }
 
+	// Moves a bounding sphere (xyz center, w radius) to another space, the radius grows with the largest scale of the transform
+	inline float4 TransformBoundingSphere(const float4& sphere, const float4x4& transform)
+	{
+		const float3 center = float3(transform * float4(float3(sphere), 1.0f));
+		const float scale = sqrtf(Max(glm::dot(float3(transform[0]), float3(transform[0])),
+								   Max(glm::dot(float3(transform[1]), float3(transform[1])), glm::dot(float3(transform[2]), float3(transform[2])))));
+		return float4(center, sphere.w * scale);
+	}
+
+	// Diameter in pixels of a sphere seen at a distance, it covers the whole screen when the camera is inside of it
+	inline float ProjectedSphereSize(float distance, float radius, float fovY_radians, float screenHeight)
+	{
+		if (distance <= radius)
+			return screenHeight;
+		return Min(screenHeight, screenHeight * radius / (distance * tanf(fovY_radians * 0.5f)));
+	}
+
+	// Planes of the frustum of a D3D projection (z in [0, w]) in the space the matrix comes from, xyz normal pointing inside and w distance.
+	// Left, right, bottom, top, z = 0 and z = w, the planes that do not exist (like the far one of an infinite projection) let everything through.
+	inline void ExtractFrustumPlanes(const float4x4& viewProjection, float4 outPlanes[6])
+	{
+		const float4 row0 = float4(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+		const float4 row1 = float4(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+		const float4 row2 = float4(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+		const float4 row3 = float4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+		outPlanes[0] = row3 + row0;
+		outPlanes[1] = row3 - row0;
+		outPlanes[2] = row3 + row1;
+		outPlanes[3] = row3 - row1;
+		outPlanes[4] = row2;
+		outPlanes[5] = row3 - row2;
+		for (int i = 0; i < 6; ++i)
+		{
+			const float length = glm::length(float3(outPlanes[i]));
+			outPlanes[i] = length > 1e-6f ? outPlanes[i] / length : float4(0.0f, 0.0f, 0.0f, 1.0f);
+		}
+	}
+
+	// A sphere (xyz center, w radius) that is at least partly inside of all the planes
+	inline bool SphereInFrustum(const float4 planes[6], const float4& sphere)
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			if (glm::dot(float3(planes[i]), float3(sphere)) + planes[i].w < -sphere.w)
+				return false;
+		}
+		return true;
+	}
+
+	// Axis aligned box, a default constructed box is empty and grows with Extend()
+	struct AABB
+	{
+		float3 Min = float3(FLT_MAX);
+		float3 Max = float3(-FLT_MAX);
+
+		void Extend(const float3& point)
+		{
+			Min = glm::min(Min, point);
+			Max = glm::max(Max, point);
+		}
+
+		void Extend(const AABB& other)
+		{
+			Min = glm::min(Min, other.Min);
+			Max = glm::max(Max, other.Max);
+		}
+
+		bool IsEmpty() const { return Min.x > Max.x || Min.y > Max.y || Min.z > Max.z; }
+		float3 GetCenter() const { return (Min + Max) * 0.5f; }
+		float3 GetExtents() const { return (Max - Min) * 0.5f; }
+
+		// Half of the surface area, which is all the SAH needs
+		float GetHalfArea() const
+		{
+			const float3 size = Max - Min;
+			return size.x * size.y + size.y * size.z + size.z * size.x;
+		}
+
+		bool operator==(const AABB& other) const { return Min == other.Min && Max == other.Max; }
+	};
+
+	// Moves a box to another space, the result bounds the transformed box - Arvo, Graphics Gems 1990
+	inline AABB TransformAABB(const AABB& box, const float4x4& transform)
+	{
+		const float3 center = float3(transform * float4(box.GetCenter(), 1.0f));
+		const float3 extents = box.GetExtents();
+		const float3 newExtents = glm::abs(float3(transform[0])) * extents.x + glm::abs(float3(transform[1])) * extents.y + glm::abs(float3(transform[2])) * extents.z;
+		return { center - newExtents, center + newExtents };
+	}
+
+	// A box that is at least partly inside of all the planes, planes from ExtractFrustumPlanes()
+	inline bool AABBInFrustum(const float4 planes[6], const AABB& box)
+	{
+		const float3 center = box.GetCenter();
+		const float3 extents = box.GetExtents();
+		for (int i = 0; i < 6; ++i)
+		{
+			const float3 normal = float3(planes[i]);
+			if (glm::dot(normal, center) + planes[i].w < -glm::dot(glm::abs(normal), extents))
+				return false;
+		}
+		return true;
+	}
+
+	inline bool SphereIntersectsAABB(const float4& sphere, const AABB& box)
+	{
+		const float3 closest = glm::clamp(float3(sphere), box.Min, box.Max);
+		const float3 delta = closest - float3(sphere);
+		return glm::dot(delta, delta) <= sphere.w * sphere.w;
+	}
+
+	struct Ray
+	{
+		float3 Origin;
+		float3 Direction;
+	};
+
+	// Slab test, invDirection is 1 / direction. Outputs the distances where the ray enters and leaves the box, enter is 0 when it starts inside.
+	inline bool RayIntersectsAABB(const float3& origin, const float3& invDirection, const AABB& box, float maxDistance, float& outEnter, float& outExit)
+	{
+		const float3 t0 = (box.Min - origin) * invDirection;
+		const float3 t1 = (box.Max - origin) * invDirection;
+		const float3 tMin = glm::min(t0, t1);
+		const float3 tMax = glm::max(t0, t1);
+		outEnter = Max(Max(tMin.x, tMin.y), Max(tMin.z, 0.0f));
+		outExit = Min(Min(tMax.x, tMax.y), tMax.z);
+		return outEnter <= outExit && outEnter <= maxDistance;
+	}
+
 	// https://nlguillemot.wordpress.com/2016/12/07/reversed-z-in-opengl/
 	inline float4x4 InfReversedProj_RH(float fovY_radians, float aspectRatio, float zNear)
 	{
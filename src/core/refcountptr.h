@@ -188,19 +188,19 @@ namespace limbo
 			return (void**)(ReleaseAndGetAddressOf());
 		}
 
-		FORCEINLINE [[nodiscard]] T** ReleaseAndGetAddressOf()
+		[[nodiscard]] FORCEINLINE T** ReleaseAndGetAddressOf()
 		{
 			if (m_Ptr)
 				m_Ptr->Release();
 			return &m_Ptr;
 		}
 
-		FORCEINLINE [[nodiscard]] T* const* GetAddressOf() const
+		[[nodiscard]] FORCEINLINE T* const* GetAddressOf() const
 		{
 			return &m_Ptr;
 		}
 
-		FORCEINLINE [[nodiscard]] T** GetAddressOf()
+		[[nodiscard]] FORCEINLINE T** GetAddressOf()
 		{
 			return &m_Ptr;
 		}
@@ -0,0 +1,93 @@
+#include "stdafx.h"
+#include "timer.h"
+
+#include <thread>
+
+namespace limbo::Core::Timestamp
+{
+	namespace
+	{
+		struct Calibration
+		{
+			uint64 Frequency = 1;
+			uint64 Overhead = 0;
+		};
+
+		uint64 OSFrequency()
+		{
+#if defined(_WIN32)
+			LARGE_INTEGER frequency;
+			QueryPerformanceFrequency(&frequency);
+			return frequency.QuadPart;
+#else
+			return 1'000'000'000ull; // clock_gettime already returns nanoseconds
+#endif
+		}
+
+		uint64 OSNow()
+		{
+#if defined(_WIN32)
+			LARGE_INTEGER counter;
+			QueryPerformanceCounter(&counter);
+			return counter.QuadPart;
+#else
+			timespec time;
+			clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+			return uint64(time.tv_sec) * 1'000'000'000ull + uint64(time.tv_nsec);
+#endif
+		}
+
+		Calibration RunCalibration()
+		{
+			Calibration result;
+
+#if LIMBO_TIMESTAMP_USE_RDTSC
+			// Measure how many TSC ticks happen during a known OS clock interval
+			const uint64 osFrequency = OSFrequency();
+			const uint64 osStart  = OSNow();
+			const uint64 tscStart = Now();
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			const uint64 osDelta  = OSNow() - osStart;
+			const uint64 tscDelta = Now() - tscStart;
+			result.Frequency = (uint64)((double)tscDelta * (double)osFrequency / (double)osDelta);
+#else
+			result.Frequency = OSFrequency();
+#endif
+
+			// The overhead is the smallest delta between two back to back reads
+			constexpr uint32 numSamples = 1024;
+			uint64 minDelta = ~0ull;
+			for (uint32 i = 0; i < numSamples; ++i)
+			{
+				const uint64 start = Now();
+				const uint64 end   = Now();
+				minDelta = Math::Min(minDelta, end - start);
+			}
+			result.Overhead = minDelta;
+
+			return result;
+		}
+
+		const Calibration& GetCalibration()
+		{
+			static const Calibration calibration = RunCalibration();
+			return calibration;
+		}
+	}
+
+	uint64 Frequency()
+	{
+		return GetCalibration().Frequency;
+	}
+
+	uint64 Overhead()
+	{
+		return GetCalibration().Overhead;
+	}
+
+	void Calibrate()
+	{
+		const Calibration& calibration = GetCalibration();
+		LB_LOG("Timestamp frequency: %llu ticks/s, call overhead: %lldns", calibration.Frequency, ToNanoseconds((int64)calibration.Overhead));
+	}
+}
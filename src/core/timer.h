@@ -1,7 +1,77 @@
 #pragma once
 
+#include "core.h"
+
+// Read the CPU timestamp counter directly instead of going through the OS monotonic clock.
+// Only enable this on machines with an invariant TSC, the frequency is calibrated against the OS clock.
+#ifndef LIMBO_TIMESTAMP_USE_RDTSC
+	#define LIMBO_TIMESTAMP_USE_RDTSC 0
+#endif
+
+#if defined(_WIN32)
+	#include <intrin.h>
+#else
+	#include <time.h>
+	#if LIMBO_TIMESTAMP_USE_RDTSC
+		#include <x86intrin.h>
+	#endif
+#endif
+
 namespace limbo::Core
 {
+	namespace Timestamp
+	{
+		// Raw tick read, this is the cheapest way to get the current time. Convert it with the functions below.
+		FORCEINLINE uint64 Now()
+		{
+#if LIMBO_TIMESTAMP_USE_RDTSC
+			return __rdtsc();
+#elif defined(_WIN32)
+			LARGE_INTEGER counter;
+			QueryPerformanceCounter(&counter);
+			return counter.QuadPart;
+#else
+			timespec time;
+			clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+			return uint64(time.tv_sec) * 1'000'000'000ull + uint64(time.tv_nsec);
+#endif
+		}
+
+		// Ticks per second, calibrated only once
+		uint64 Frequency();
+
+		// Minimum cost, in ticks, of a call to Now(). Useful to remove the timer cost from very small scopes.
+		uint64 Overhead();
+
+		// Calibrates the frequency and overhead, this is done lazily on first use but can be forced on startup
+		void Calibrate();
+
+		FORCEINLINE int64 ToNanoseconds(int64 ticks)
+		{
+			const int64 frequency = (int64)Frequency();
+
+			// Split the conversion in whole seconds plus remainder so long intervals do not overflow 64 bits
+			const int64 seconds   = ticks / frequency;
+			const int64 remainder = ticks % frequency;
+			return seconds * 1'000'000'000ll + (remainder * 1'000'000'000ll) / frequency;
+		}
+
+		FORCEINLINE int64 ToMicroseconds(int64 ticks)
+		{
+			return ToNanoseconds(ticks) / 1'000ll;
+		}
+
+		FORCEINLINE double ToMilliseconds(int64 ticks)
+		{
+			return double(ToNanoseconds(ticks)) * 1e-6;
+		}
+
+		FORCEINLINE double ToSeconds(int64 ticks)
+		{
+			return double(ToNanoseconds(ticks)) * 1e-9;
+		}
+	}
+
 	struct Timer
 	{
 		Timer()
@@ -10,35 +80,41 @@ namespace limbo::Core
 		}
 
 		// Record a reference timestamp
-		inline void Record()
+		FORCEINLINE void Record()
 		{
-			LARGE_INTEGER counter;
-			QueryPerformanceCounter(&counter);
-			m_Timestamp = counter.QuadPart;
+			m_Timestamp = Timestamp::Now();
+		}
 
-			LARGE_INTEGER frequency;
-			QueryPerformanceFrequency(&frequency);
-			m_Frequency = frequency.QuadPart;
+		// Raw ticks since the Timer creation or last call to record()
+		FORCEINLINE uint64 ElapsedTicks() const
+		{
+			return Timestamp::Now() - m_Timestamp;
 		}
 
-		// Elapsed time in seconds since the Timer creation or last call to record()
-		inline float ElapsedSeconds()
+		// Elapsed time in nanoseconds since the Timer creation or last call to record()
+		FORCEINLINE int64 ElapsedNanoseconds() const
 		{
-			LARGE_INTEGER counter;
-			QueryPerformanceCounter(&counter);
+			return Timestamp::ToNanoseconds((int64)ElapsedTicks());
+		}
 
-			return float(counter.QuadPart - m_Timestamp) / m_Frequency;
+		// Elapsed time in seconds since the Timer creation or last call to record()
+		FORCEINLINE float ElapsedSeconds() const
+		{
+			return (float)Timestamp::ToSeconds((int64)ElapsedTicks());
 		}
 
 		// Elapsed time in milliseconds since the Timer creation or last call to record()
-		inline float ElapsedMilliseconds()
+		FORCEINLINE float ElapsedMilliseconds() const
 		{
-			return ElapsedSeconds() * 1000.0f;
+			return (float)Timestamp::ToMilliseconds((int64)ElapsedTicks());
+		}
+
+		uint64 GetTimestamp() const
+		{
+			return m_Timestamp;
 		}
 
 	private:
 		uint64 m_Timestamp;
-
-		inline static uint64 m_Frequency;
 	};
 }
@@ -132,4 +132,132 @@ namespace limbo::Utils
 
 		return false;
 	}
+
+	bool FileReadRange(const char* filename, uint64 offset, uint64 size, void* dst)
+	{
+		std::ifstream file(filename, std::ios::binary);
+		if (!file.is_open())
+			return false;
+
+		file.seekg(offset);
+		file.read((char*)dst, size);
+		return file.good() && (uint64)file.gcount() == size;
+	}
+
+	bool FileWrite(const char* filename, const void* data, uint64 size)
+	{
+		std::string tempFilename = std::string(filename) + ".tmp";
+		{
+			std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+				return false;
+
+			file.write((const char*)data, size);
+			if (!file.good())
+				return false;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempFilename, filename, error);
+		if (error)
+		{
+			std::filesystem::remove(tempFilename, error);
+			return false;
+		}
+		return true;
+	}
+
+	bool IsFileNewer(const char* filename, const char* referenceFilename)
+	{
+		std::error_code error;
+		const std::filesystem::file_time_type time = std::filesystem::last_write_time(filename, error);
+		if (error)
+			return false;
+
+		const std::filesystem::file_time_type referenceTime = std::filesystem::last_write_time(referenceFilename, error);
+		if (error)
+			return false;
+
+		return time >= referenceTime;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	bool MappedFile::Open(const char* filename)
+	{
+		Close();
+
+		m_File = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (m_File == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(m_File, &fileSize) || fileSize.QuadPart == 0)
+		{
+			Close();
+			return false;
+		}
+
+		m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!m_Mapping)
+		{
+			Close();
+			return false;
+		}
+
+		m_Data = (const uint8*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!m_Data)
+		{
+			Close();
+			return false;
+		}
+
+		m_Size = fileSize.QuadPart;
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (m_Data)
+			UnmapViewOfFile(m_Data);
+		if (m_Mapping)
+			CloseHandle(m_Mapping);
+		if (m_File != INVALID_HANDLE_VALUE)
+			CloseHandle(m_File);
+
+		m_Data = nullptr;
+		m_Size = 0;
+		m_Mapping = nullptr;
+		m_File = INVALID_HANDLE_VALUE;
+	}
+
+	bool FileWriteRange(const char* filename, uint64 offset, const void* data, uint64 size)
+	{
+		std::error_code error;
+		const uint64 fileSize = std::filesystem::file_size(filename, error);
+		if (error || offset > fileSize || size > fileSize - offset)
+			return false;
+
+		std::fstream file(filename, std::ios::binary | std::ios::in | std::ios::out);
+		if (!file.is_open())
+			return false;
+
+		file.seekp(offset);
+		file.write((const char*)data, size);
+		return file.good();
+	}
+
+	bool GetFileStamp(const char* filename, uint64& outSize, int64& outWriteTime)
+	{
+		std::error_code error;
+		outSize = std::filesystem::file_size(filename, error);
+		if (error)
+			return false;
+
+		outWriteTime = std::filesystem::last_write_time(filename, error).time_since_epoch().count();
+		return !error;
+	}
 }
@@ -20,6 +20,44 @@ namespace limbo::Utils
 
 	bool FileRead(const char* filename, std::vector<uint8>& filedata);
 
+	// Reads size bytes starting at offset into dst, fails if the file is shorter than that
+	bool FileReadRange(const char* filename, uint64 offset, uint64 size, void* dst);
+
+	// Writes to a temporary file first and then renames it, so a crash never leaves a half written file behind
+	bool FileWrite(const char* filename, const void* data, uint64 size);
+
+	// True if both files exist and filename was written after referenceFilename
+	bool IsFileNewer(const char* filename, const char* referenceFilename);
+
+	// Read-only view of a whole file mapped in memory, the pages are only read from disk when they are touched
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		LB_NON_COPYABLE(MappedFile);
+
+		bool Open(const char* filename);
+		void Close();
+
+		bool IsValid() const { return m_Data != nullptr; }
+		const uint8* GetData() const { return m_Data; }
+		uint64 GetSize() const { return m_Size; }
+
+	private:
+		const uint8*	m_Data = nullptr;
+		uint64			m_Size = 0;
+		HANDLE			m_File = INVALID_HANDLE_VALUE;
+		HANDLE			m_Mapping = nullptr;
+	};
+
+	// Overwrites size bytes starting at offset in place, fails if the file is shorter than that
+	bool FileWriteRange(const char* filename, uint64 offset, const void* data, uint64 size);
+
+	// Size and last write time of a file without reading it, fails if it does not exist
+	bool GetFileStamp(const char* filename, uint64& outSize, int64& outWriteTime);
+
 	inline uint64 ToKB(uint64 bytes)
 	{
 		return bytes * (1 << 10);
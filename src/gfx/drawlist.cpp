@@ -0,0 +1,156 @@
+#include "stdafx.h"
+#include "drawlist.h"
+#include "core/jobsystem.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace limbo::Gfx
+{
+	namespace
+	{
+		// The bits of a float as an unsigned integer with the same order, negative values included
+		uint32 FloatToOrderedBits(float value)
+		{
+			const uint32 bits = std::bit_cast<uint32>(value);
+			return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+		}
+
+		uint32 GetNumJobs(uint32 numKeys)
+		{
+			return Math::Max(Math::DivideAndRoundUp(numKeys, DrawList::KeysPerJob), 1u);
+		}
+	}
+
+	uint64 DrawList::CreateKey(DrawPass pass, uint32 pipeline, uint32 material, float depth, uint32 instance)
+	{
+		check(pipeline < (1u << PipelineBits));
+		check(material < (1u << MaterialBits));
+		check(instance < (1u << InstanceBits));
+
+		// The top bits of the float keep its order, the quantization only merges close depths
+		const uint64 quantizedDepth = FloatToOrderedBits(depth) >> (32 - DepthBits);
+
+		uint64 key = (uint64)pass;
+		key = (key << PipelineBits) | pipeline;
+		key = (key << MaterialBits) | material;
+		key = (key << DepthBits) | quantizedDepth;
+		key = (key << InstanceBits) | instance;
+		return key;
+	}
+
+	void DrawList::Build(Span<uint32> visibleInstances, Span<DrawListInstance> instances, Span<Math::AABB> instanceBounds, const DrawListView& view)
+	{
+		check(instances.GetSize() == instanceBounds.GetSize());
+
+		const uint32 numKeys = visibleInstances.GetSize();
+		m_Keys.resize(numKeys);
+		if (numKeys == 0)
+			return;
+
+		auto createKey = [&](uint32 instance)
+		{
+			const DrawListInstance& drawInstance = instances[instance];
+			const float depth = glm::dot(instanceBounds[instance].GetCenter() - view.Origin, view.Direction);
+			return CreateKey(drawInstance.Pass, view.Pipeline, drawInstance.Material, depth, instance);
+		};
+
+		const uint64 firstKey = createKey(visibleInstances[0]);
+		const uint32 numJobs = GetNumJobs(numKeys);
+		m_DifferentBits.assign(numJobs, 0);
+
+		Core::JobContext context;
+		Core::JobSystem::ExecuteMany(context, numJobs, 1, Core::TOnJobSystemExecuteMany::CreateLambda([&](Core::JobDispatchArgs args)
+		{
+			const uint32 begin = args.jobIndex * KeysPerJob;
+			const uint32 end = Math::Min(begin + KeysPerJob, numKeys);
+
+			uint64 differentBits = 0;
+			for (uint32 i = begin; i < end; ++i)
+			{
+				m_Keys[i] = createKey(visibleInstances[i]);
+				differentBits |= m_Keys[i] ^ firstKey;
+			}
+			m_DifferentBits[args.jobIndex] = differentBits;
+		}));
+		Core::JobSystem::Wait(context);
+
+		uint64 differentBits = 0;
+		for (uint64 bits : m_DifferentBits)
+			differentBits |= bits;
+		RadixSort(differentBits);
+	}
+
+	void DrawList::Sort(Span<uint64> keys)
+	{
+		m_Keys.assign(keys.begin(), keys.end());
+		if (m_Keys.empty())
+			return;
+
+		uint64 differentBits = 0;
+		for (uint64 key : m_Keys)
+			differentBits |= key ^ m_Keys[0];
+		RadixSort(differentBits);
+	}
+
+	Span<uint64> DrawList::GetKeys(DrawPass pass) const
+	{
+		const auto begin = std::partition_point(m_Keys.begin(), m_Keys.end(), [pass](uint64 key) { return GetPass(key) < pass; });
+		const auto end = std::partition_point(begin, m_Keys.end(), [pass](uint64 key) { return GetPass(key) <= pass; });
+		return Span<uint64>(m_Keys.data() + (begin - m_Keys.begin()), (uint32)(end - begin));
+	}
+
+	void DrawList::RadixSort(uint64 differentBits)
+	{
+		// Least significant byte first, each pass keeps the order of the last one. Every job counts its part of the keys,
+		// then writes them where the jobs before it and the smaller bytes end.
+		const uint32 numKeys = (uint32)m_Keys.size();
+		const uint32 numJobs = GetNumJobs(numKeys);
+		m_SortScratch.resize(numKeys);
+		m_Histograms.resize(numJobs * 256);
+
+		Core::JobContext context;
+		for (uint32 shift = 0; shift < 64; shift += 8)
+		{
+			if (((differentBits >> shift) & 0xFF) == 0)
+				continue;
+
+			Core::JobSystem::ExecuteMany(context, numJobs, 1, Core::TOnJobSystemExecuteMany::CreateLambda([&](Core::JobDispatchArgs args)
+			{
+				uint32* histogram = &m_Histograms[args.jobIndex * 256];
+				std::fill_n(histogram, 256, 0);
+
+				const uint32 end = Math::Min((args.jobIndex + 1) * KeysPerJob, numKeys);
+				for (uint32 i = args.jobIndex * KeysPerJob; i < end; ++i)
+					histogram[(m_Keys[i] >> shift) & 0xFF]++;
+			}));
+			Core::JobSystem::Wait(context);
+
+			uint32 offset = 0;
+			for (uint32 bucket = 0; bucket < 256; ++bucket)
+			{
+				for (uint32 job = 0; job < numJobs; ++job)
+				{
+					const uint32 count = m_Histograms[job * 256 + bucket];
+					m_Histograms[job * 256 + bucket] = offset;
+					offset += count;
+				}
+			}
+
+			Core::JobSystem::ExecuteMany(context, numJobs, 1, Core::TOnJobSystemExecuteMany::CreateLambda([&](Core::JobDispatchArgs args)
+			{
+				uint32* offsets = &m_Histograms[args.jobIndex * 256];
+
+				const uint32 end = Math::Min((args.jobIndex + 1) * KeysPerJob, numKeys);
+				for (uint32 i = args.jobIndex * KeysPerJob; i < end; ++i)
+				{
+					const uint64 key = m_Keys[i];
+					m_SortScratch[offsets[(key >> shift) & 0xFF]++] = key;
+				}
+			}));
+			Core::JobSystem::Wait(context);
+
+			m_Keys.swap(m_SortScratch);
+		}
+	}
+}
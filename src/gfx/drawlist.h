@@ -0,0 +1,79 @@
+#pragma once
+
+#include "core/math.h"
+#include "core/array.h"
+
+#include <vector>
+
+namespace limbo::Gfx
+{
+	// Draws of a pass are sorted before the draws of the next one
+	enum class DrawPass : uint8
+	{
+		Opaque = 0,
+		AlphaTested,
+	};
+
+	// What the sort needs to know about an instance, by instance ID
+	struct DrawListInstance
+	{
+		uint32		Material = 0;
+		DrawPass	Pass = DrawPass::Opaque;
+	};
+
+	// Depth of the draws is the distance of their box center along the direction, from the origin
+	struct DrawListView
+	{
+		float3		Origin = float3(0.0f);
+		float3		Direction = float3(0.0f, 0.0f, 1.0f);
+		uint32		Pipeline = 0;
+	};
+
+	/**
+	 * Visible instances of a view sorted by a 64 bit key, from the most significant bits:
+	 * pass (2 bits), pipeline (6 bits), material (16 bits), quantized depth (16 bits) and instance (24 bits).
+	 *
+	 * The opaque draws come before the alpha tested ones and every run of the same pipeline and material is front to back,
+	 * for the early depth test. The keys are made and radix sorted over the job system, the bytes that are the same in
+	 * every key are not sorted.
+	 */
+	class DrawList
+	{
+	public:
+		static constexpr uint32 InstanceBits	= 24;
+		static constexpr uint32 DepthBits		= 16;
+		static constexpr uint32 MaterialBits	= 16;
+		static constexpr uint32 PipelineBits	= 6;
+		static constexpr uint32 PassBits		= 2;
+		static_assert(InstanceBits + DepthBits + MaterialBits + PipelineBits + PassBits == 64);
+
+		static constexpr uint32 KeysPerJob		= 16 * 1024;
+
+	private:
+		std::vector<uint64>		m_Keys;
+		std::vector<uint64>		m_SortScratch;
+		// Per job, the 256 buckets of the byte being sorted and then where the job writes each bucket
+		std::vector<uint32>		m_Histograms;
+		// Per job, the bits its keys have different from the first key
+		std::vector<uint64>		m_DifferentBits;
+
+	public:
+		static uint64 CreateKey(DrawPass pass, uint32 pipeline, uint32 material, float depth, uint32 instance);
+		static uint32 GetInstance(uint64 key) { return (uint32)(key & ((1ull << InstanceBits) - 1)); }
+		static DrawPass GetPass(uint64 key) { return (DrawPass)(key >> (64 - PassBits)); }
+
+		// instances and instanceBounds are indexed by the instance ID, visibleInstances are the instance IDs to draw
+		void Build(Span<uint32> visibleInstances, Span<DrawListInstance> instances, Span<Math::AABB> instanceBounds, const DrawListView& view);
+
+		// Sorts keys made outside of Build()
+		void Sort(Span<uint64> keys);
+
+		Span<uint64> GetKeys() const { return m_Keys; }
+		// The keys of a single pass
+		Span<uint64> GetKeys(DrawPass pass) const;
+		uint32 GetSize() const { return (uint32)m_Keys.size(); }
+
+	private:
+		void RadixSort(uint64 differentBits);
+	};
+}
@@ -32,4 +32,4 @@ namespace limbo::Gfx
 	void Shutdown();
 }
 
-#define SETUP_RENDER_TECHNIQUE(TechniqueClass, List) List.push_back(std::make_unique<TechniqueClass>())
+#define SETUP_RENDER_TECHNIQUE(TechniqueClass, List) List.Add(std::make_unique<TechniqueClass>())
@@ -0,0 +1,318 @@
+#include "stdafx.h"
+#include "gltfaccessors.h"
+
+#include <cgltf/cgltf.h>
+#include <emmintrin.h>
+#include <cfloat>
+
+namespace limbo::Gfx::GLTF
+{
+	namespace
+	{
+		// Normalized integer to float conversion as described in the glTF 2.0 specification
+		template<typename T> constexpr float NormalizationScale();
+		template<> constexpr float NormalizationScale<int8>()	{ return 1.0f / 127.0f; }
+		template<> constexpr float NormalizationScale<uint8>()	{ return 1.0f / 255.0f; }
+		template<> constexpr float NormalizationScale<int16>()	{ return 1.0f / 32767.0f; }
+		template<> constexpr float NormalizationScale<uint16>()	{ return 1.0f / 65535.0f; }
+
+		FORCEINLINE void StoreFloats(__m128i value, float* dst, __m128 scale, __m128 minValue)
+		{
+			__m128 result = _mm_mul_ps(_mm_cvtepi32_ps(value), scale);
+			_mm_storeu_ps(dst, _mm_max_ps(result, minValue));
+		}
+
+		// Signed normalized values can go below -1, they have to be clamped. For the rest the min value does nothing.
+		template<typename T>
+		FORCEINLINE float GetMinValue(bool bNormalized)
+		{
+			return bNormalized && std::is_signed_v<T> ? -1.0f : -FLT_MAX;
+		}
+
+		template<typename T>
+		void ConvertToFloatScalar(const T* src, float* dst, size_t count, bool bNormalized)
+		{
+			const float scale = bNormalized ? NormalizationScale<T>() : 1.0f;
+			const float minValue = GetMinValue<T>(bNormalized);
+			for (size_t i = 0; i < count; ++i)
+				dst[i] = Math::Max(float(src[i]) * scale, minValue);
+		}
+
+		const uint8* GetAccessorData(const cgltf_accessor* accessor)
+		{
+			if (!accessor->buffer_view)
+				return nullptr;
+
+			const uint8* data = cgltf_buffer_view_data(accessor->buffer_view);
+			if (!data)
+				return nullptr;
+			return data + accessor->offset;
+		}
+
+		bool UnpackFloatsFallback(const cgltf_accessor* accessor, uint32 numComponents, float* dst, size_t dstStride)
+		{
+			const size_t srcComponents = cgltf_num_components(accessor->type);
+			const size_t numCopy = Math::Min((size_t)numComponents, srcComponents);
+
+			std::vector<float> unpacked(accessor->count * srcComponents);
+			if (cgltf_accessor_unpack_floats(accessor, unpacked.data(), unpacked.size()) != unpacked.size())
+				return false;
+
+			for (size_t i = 0; i < accessor->count; ++i)
+			{
+				float* out = (float*)((uint8*)dst + i * dstStride);
+				memcpy(out, &unpacked[i * srcComponents], numCopy * sizeof(float));
+			}
+			return true;
+		}
+
+		template<typename T>
+		void UnpackIntegerComponents(const uint8* src, size_t stride, size_t count, size_t srcComponents, size_t numCopy, bool bNormalized, float* dst, size_t dstStride)
+		{
+			// The elements are only contiguous when the stride is a multiple of the component size, vertex attributes are usually padded to 4 bytes.
+			// In that case the whole range can be converted in bulk, padding included, and then scattered into the destination.
+			const size_t componentsPerElement = stride / sizeof(T);
+			if (stride % sizeof(T) == 0 && componentsPerElement <= 4)
+			{
+				constexpr size_t blockSize = 256;
+				float block[blockSize * 4];
+				for (size_t first = 0; first < count; first += blockSize)
+				{
+					const size_t numElements = Math::Min(blockSize, count - first);
+
+					// Do not convert the padding after the last element, it might be past the end of the buffer
+					const size_t numFlatComponents = (numElements - 1) * componentsPerElement + srcComponents;
+					ConvertToFloat((const T*)(src + first * stride), block, numFlatComponents, bNormalized);
+
+					for (size_t i = 0; i < numElements; ++i)
+					{
+						float* out = (float*)((uint8*)dst + (first + i) * dstStride);
+						for (size_t c = 0; c < numCopy; ++c)
+							out[c] = block[i * componentsPerElement + c];
+					}
+				}
+			}
+			else
+			{
+				// Interleaved buffer views, decode element by element
+				float element[4];
+				for (size_t i = 0; i < count; ++i)
+				{
+					ConvertToFloatScalar((const T*)(src + i * stride), element, srcComponents, bNormalized);
+
+					float* out = (float*)((uint8*)dst + i * dstStride);
+					for (size_t c = 0; c < numCopy; ++c)
+						out[c] = element[c];
+				}
+			}
+		}
+	}
+
+	void ConvertToFloat(const int8* src, float* dst, size_t count, bool bNormalized)
+	{
+		const __m128 scale = _mm_set1_ps(bNormalized ? NormalizationScale<int8>() : 1.0f);
+		const __m128 minValue = _mm_set1_ps(GetMinValue<int8>(bNormalized));
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			__m128i value = _mm_loadu_si128((const __m128i*)(src + i));
+
+			// Sign extend by placing the byte in the upper half and shifting it back down
+			__m128i lo16 = _mm_srai_epi16(_mm_unpacklo_epi8(value, value), 8);
+			__m128i hi16 = _mm_srai_epi16(_mm_unpackhi_epi8(value, value), 8);
+
+			StoreFloats(_mm_srai_epi32(_mm_unpacklo_epi16(lo16, lo16), 16), dst + i + 0,  scale, minValue);
+			StoreFloats(_mm_srai_epi32(_mm_unpackhi_epi16(lo16, lo16), 16), dst + i + 4,  scale, minValue);
+			StoreFloats(_mm_srai_epi32(_mm_unpacklo_epi16(hi16, hi16), 16), dst + i + 8,  scale, minValue);
+			StoreFloats(_mm_srai_epi32(_mm_unpackhi_epi16(hi16, hi16), 16), dst + i + 12, scale, minValue);
+		}
+		ConvertToFloatScalar(src + i, dst + i, count - i, bNormalized);
+	}
+
+	void ConvertToFloat(const uint8* src, float* dst, size_t count, bool bNormalized)
+	{
+		const __m128 scale = _mm_set1_ps(bNormalized ? NormalizationScale<uint8>() : 1.0f);
+		const __m128 minValue = _mm_set1_ps(GetMinValue<uint8>(bNormalized));
+		const __m128i zero = _mm_setzero_si128();
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			__m128i value = _mm_loadu_si128((const __m128i*)(src + i));
+			__m128i lo16 = _mm_unpacklo_epi8(value, zero);
+			__m128i hi16 = _mm_unpackhi_epi8(value, zero);
+
+			StoreFloats(_mm_unpacklo_epi16(lo16, zero), dst + i + 0,  scale, minValue);
+			StoreFloats(_mm_unpackhi_epi16(lo16, zero), dst + i + 4,  scale, minValue);
+			StoreFloats(_mm_unpacklo_epi16(hi16, zero), dst + i + 8,  scale, minValue);
+			StoreFloats(_mm_unpackhi_epi16(hi16, zero), dst + i + 12, scale, minValue);
+		}
+		ConvertToFloatScalar(src + i, dst + i, count - i, bNormalized);
+	}
+
+	void ConvertToFloat(const int16* src, float* dst, size_t count, bool bNormalized)
+	{
+		const __m128 scale = _mm_set1_ps(bNormalized ? NormalizationScale<int16>() : 1.0f);
+		const __m128 minValue = _mm_set1_ps(GetMinValue<int16>(bNormalized));
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128i value = _mm_loadu_si128((const __m128i*)(src + i));
+			StoreFloats(_mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16), dst + i + 0, scale, minValue);
+			StoreFloats(_mm_srai_epi32(_mm_unpackhi_epi16(value, value), 16), dst + i + 4, scale, minValue);
+		}
+		ConvertToFloatScalar(src + i, dst + i, count - i, bNormalized);
+	}
+
+	void ConvertToFloat(const uint16* src, float* dst, size_t count, bool bNormalized)
+	{
+		const __m128 scale = _mm_set1_ps(bNormalized ? NormalizationScale<uint16>() : 1.0f);
+		const __m128 minValue = _mm_set1_ps(GetMinValue<uint16>(bNormalized));
+		const __m128i zero = _mm_setzero_si128();
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128i value = _mm_loadu_si128((const __m128i*)(src + i));
+			StoreFloats(_mm_unpacklo_epi16(value, zero), dst + i + 0, scale, minValue);
+			StoreFloats(_mm_unpackhi_epi16(value, zero), dst + i + 4, scale, minValue);
+		}
+		ConvertToFloatScalar(src + i, dst + i, count - i, bNormalized);
+	}
+
+	void ConvertToUint32(const uint16* src, uint32* dst, size_t count)
+	{
+		const __m128i zero = _mm_setzero_si128();
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128i value = _mm_loadu_si128((const __m128i*)(src + i));
+			_mm_storeu_si128((__m128i*)(dst + i + 0), _mm_unpacklo_epi16(value, zero));
+			_mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(value, zero));
+		}
+		for (; i < count; ++i)
+			dst[i] = src[i];
+	}
+
+	void ConvertToUint32(const uint8* src, uint32* dst, size_t count)
+	{
+		const __m128i zero = _mm_setzero_si128();
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			__m128i value = _mm_loadu_si128((const __m128i*)(src + i));
+			__m128i lo16 = _mm_unpacklo_epi8(value, zero);
+			__m128i hi16 = _mm_unpackhi_epi8(value, zero);
+			_mm_storeu_si128((__m128i*)(dst + i + 0),  _mm_unpacklo_epi16(lo16, zero));
+			_mm_storeu_si128((__m128i*)(dst + i + 4),  _mm_unpackhi_epi16(lo16, zero));
+			_mm_storeu_si128((__m128i*)(dst + i + 8),  _mm_unpacklo_epi16(hi16, zero));
+			_mm_storeu_si128((__m128i*)(dst + i + 12), _mm_unpackhi_epi16(hi16, zero));
+		}
+		for (; i < count; ++i)
+			dst[i] = src[i];
+	}
+
+	bool UnpackFloats(const cgltf_accessor* accessor, uint32 numComponents, float* dst, size_t dstStride)
+	{
+		const size_t count = accessor->count;
+		if (count == 0)
+			return true;
+
+		// Sparse accessors and buffers that are not loaded go through cgltf, it handles every case
+		const uint8* src = GetAccessorData(accessor);
+		if (!src || accessor->is_sparse)
+			return UnpackFloatsFallback(accessor, numComponents, dst, dstStride);
+
+		const size_t srcComponents = cgltf_num_components(accessor->type);
+		const size_t numCopy = Math::Min((size_t)numComponents, srcComponents);
+		const size_t stride = accessor->stride;
+
+		switch (accessor->component_type)
+		{
+		case cgltf_component_type_r_32f:
+			{
+				const size_t elementSize = numCopy * sizeof(float);
+				if (stride == elementSize && dstStride == elementSize)
+				{
+					memcpy(dst, src, count * elementSize);
+				}
+				else
+				{
+					for (size_t i = 0; i < count; ++i)
+						memcpy((uint8*)dst + i * dstStride, src + i * stride, elementSize);
+				}
+				return true;
+			}
+		case cgltf_component_type_r_8:
+			UnpackIntegerComponents<int8>(src, stride, count, srcComponents, numCopy, accessor->normalized, dst, dstStride);
+			return true;
+		case cgltf_component_type_r_8u:
+			UnpackIntegerComponents<uint8>(src, stride, count, srcComponents, numCopy, accessor->normalized, dst, dstStride);
+			return true;
+		case cgltf_component_type_r_16:
+			UnpackIntegerComponents<int16>(src, stride, count, srcComponents, numCopy, accessor->normalized, dst, dstStride);
+			return true;
+		case cgltf_component_type_r_16u:
+			UnpackIntegerComponents<uint16>(src, stride, count, srcComponents, numCopy, accessor->normalized, dst, dstStride);
+			return true;
+		default:
+			return UnpackFloatsFallback(accessor, numComponents, dst, dstStride);
+		}
+	}
+
+	bool UnpackIndices(const cgltf_accessor* accessor, uint32* dst)
+	{
+		const size_t count = accessor->count;
+		const uint8* src = GetAccessorData(accessor);
+		if (!src || accessor->is_sparse)
+		{
+			for (size_t i = 0; i < count; ++i)
+				dst[i] = (uint32)cgltf_accessor_read_index(accessor, i);
+			return true;
+		}
+
+		const size_t stride = accessor->stride;
+		switch (accessor->component_type)
+		{
+		case cgltf_component_type_r_32u:
+			if (stride == sizeof(uint32))
+			{
+				memcpy(dst, src, count * sizeof(uint32));
+			}
+			else
+			{
+				for (size_t i = 0; i < count; ++i)
+					memcpy(&dst[i], src + i * stride, sizeof(uint32));
+			}
+			return true;
+		case cgltf_component_type_r_16u:
+			if (stride == sizeof(uint16))
+			{
+				ConvertToUint32((const uint16*)src, dst, count);
+			}
+			else
+			{
+				for (size_t i = 0; i < count; ++i)
+					dst[i] = *(const uint16*)(src + i * stride);
+			}
+			return true;
+		case cgltf_component_type_r_8u:
+			if (stride == sizeof(uint8))
+			{
+				ConvertToUint32(src, dst, count);
+			}
+			else
+			{
+				for (size_t i = 0; i < count; ++i)
+					dst[i] = src[i * stride];
+			}
+			return true;
+		default:
+			return false;
+		}
+	}
+}
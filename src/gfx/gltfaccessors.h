@@ -0,0 +1,25 @@
+#pragma once
+
+#include "core/core.h"
+
+struct cgltf_accessor;
+
+namespace limbo::Gfx::GLTF
+{
+	// Decodes the first numComponents components of every element of the accessor as floats.
+	// Elements are written dstStride bytes apart so the data can go straight into an interleaved vertex stream.
+	// Normalized integer components are converted with the rules from the glTF spec, sparse accessors are supported.
+	// Returns false if the accessor data could not be read.
+	bool UnpackFloats(const cgltf_accessor* accessor, uint32 numComponents, float* dst, size_t dstStride);
+
+	// Decodes every index of the accessor as a 32bit index
+	bool UnpackIndices(const cgltf_accessor* accessor, uint32* dst);
+
+	// Flat conversions of integer components to floats, exposed for testing
+	void ConvertToFloat(const int8* src, float* dst, size_t count, bool bNormalized);
+	void ConvertToFloat(const uint8* src, float* dst, size_t count, bool bNormalized);
+	void ConvertToFloat(const int16* src, float* dst, size_t count, bool bNormalized);
+	void ConvertToFloat(const uint16* src, float* dst, size_t count, bool bNormalized);
+	void ConvertToUint32(const uint16* src, uint32* dst, size_t count);
+	void ConvertToUint32(const uint8* src, uint32* dst, size_t count);
+}
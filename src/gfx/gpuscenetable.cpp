@@ -0,0 +1,116 @@
+#include "stdafx.h"
+#include "gpuscenetable.h"
+#include "rhi/commandcontext.h"
+
+namespace limbo::Gfx
+{
+	GPUSceneBuffer::GPUSceneBuffer(const char* debugName, uint32 stride, uint32 initialCapacity)
+		: m_DebugName(debugName)
+		, m_Stride(stride)
+		, m_Capacity(Math::Max(initialCapacity, 1u))
+	{
+	}
+
+	GPUSceneBuffer::~GPUSceneBuffer()
+	{
+		if (m_Buffer.IsValid())
+			RHI::DestroyBuffer(m_Buffer);
+	}
+
+	void GPUSceneBuffer::MarkDirty(uint32 slot)
+	{
+		if (slot >= m_DirtyFlags.size())
+			m_DirtyFlags.resize(Math::Max((size_t)slot + 1, m_DirtyFlags.size() * 2), false);
+
+		if (m_DirtyFlags[slot])
+			return;
+		m_DirtyFlags[slot] = true;
+		m_DirtySlots.push_back(slot);
+	}
+
+	void GPUSceneBuffer::ClearDirty()
+	{
+		for (uint32 slot : m_DirtySlots)
+			m_DirtyFlags[slot] = false;
+		m_DirtySlots.clear();
+	}
+
+	void GPUSceneBuffer::Upload(RHI::CommandContext* cmd, const void* records, uint32 numSlots)
+	{
+		if (!m_Buffer.IsValid() || numSlots > m_Capacity)
+			Grow(cmd, numSlots);
+
+		m_LastUploadCount = (uint32)m_DirtySlots.size();
+		if (m_DirtySlots.empty())
+			return;
+
+		// Sorted, so the consecutive slots are copied together
+		std::sort(m_DirtySlots.begin(), m_DirtySlots.end());
+
+		RHI::Buffer* buffer = RM_GET(m_Buffer);
+		const uint64 uploadSize = (uint64)m_DirtySlots.size() * m_Stride;
+		if (uploadSize <= MaxTempUploadSize)
+		{
+			cmd->UpdateBufferElements(buffer, records, m_Stride, m_DirtySlots);
+		}
+		else
+		{
+			// The deletion queue keeps the upload buffer alive until the frame is done with it
+			RHI::BufferHandle upload = RHI::CreateBuffer({
+				.DebugName = m_DebugName,
+				.ByteSize = uploadSize,
+				.Flags = RHI::BufferUsage::Upload
+			});
+			RHI::Buffer* uploadBuffer = RM_GET(upload);
+			uploadBuffer->Map();
+
+			uint8* uploadData = (uint8*)uploadBuffer->MappedData;
+			for (uint32 i = 0; i < (uint32)m_DirtySlots.size(); ++i)
+				memcpy(uploadData + (uint64)i * m_Stride, (const uint8*)records + (uint64)m_DirtySlots[i] * m_Stride, m_Stride);
+
+			uint32 runStart = 0;
+			for (uint32 i = 1; i <= (uint32)m_DirtySlots.size(); ++i)
+			{
+				if (i < (uint32)m_DirtySlots.size() && m_DirtySlots[i] == m_DirtySlots[i - 1] + 1)
+					continue;
+
+				cmd->CopyBufferToBuffer(uploadBuffer, buffer, (uint64)(i - runStart) * m_Stride, (uint64)runStart * m_Stride, (uint64)m_DirtySlots[runStart] * m_Stride);
+				runStart = i;
+			}
+			RHI::DestroyBuffer(upload);
+		}
+		cmd->InsertResourceBarrier(buffer, D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE);
+
+		ClearDirty();
+	}
+
+	uint32 GPUSceneBuffer::GetDescriptorIndex() const
+	{
+		return RM_GET(m_Buffer)->CBVHandle.Index;
+	}
+
+	void GPUSceneBuffer::Grow(RHI::CommandContext* cmd, uint32 numSlots)
+	{
+		uint32 capacity = m_Capacity;
+		while (capacity < numSlots)
+			capacity *= 2;
+
+		RHI::BufferHandle buffer = RHI::CreateBuffer({
+			.DebugName = m_DebugName,
+			.NumElements = capacity,
+			.ByteStride = m_Stride,
+			.ByteSize = (uint64)capacity * m_Stride,
+			.Flags = RHI::BufferUsage::Structured | RHI::BufferUsage::ShaderResourceView,
+		});
+
+		// The records already on the GPU stay valid, only the dirty ones are uploaded after this
+		if (m_Buffer.IsValid())
+		{
+			cmd->CopyBufferToBuffer(m_Buffer, buffer, (uint64)m_Capacity * m_Stride);
+			RHI::DestroyBuffer(m_Buffer);
+		}
+
+		m_Buffer = buffer;
+		m_Capacity = capacity;
+	}
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "slotallocator.h"
+#include "rhi/resourcemanager.h"
+
+#include <vector>
+
+namespace limbo::RHI
+{
+	class CommandContext;
+}
+
+namespace limbo::Gfx
+{
+	/**
+	 * Structured buffer behind a GPUSceneTable, it lives as long as the renderer.
+	 *
+	 * The slots written since the last upload are remembered and Upload() copies only those, a run of consecutive slots
+	 * is one copy. When the table outgrows the buffer a buffer twice as big is created and the old contents are copied
+	 * over on the GPU, so growing does not upload the whole table again.
+	 */
+	class GPUSceneBuffer
+	{
+	public:
+		// Bigger uploads get a buffer of their own, the temp ring buffer is small
+		static constexpr uint64 MaxTempUploadSize = 256 * 1024;
+
+	private:
+		const char*			m_DebugName;
+		uint32				m_Stride;
+		uint32				m_Capacity;
+		RHI::BufferHandle	m_Buffer;
+
+		std::vector<uint32>	m_DirtySlots;
+		std::vector<bool>	m_DirtyFlags;
+		uint32				m_LastUploadCount = 0;
+
+	public:
+		GPUSceneBuffer(const char* debugName, uint32 stride, uint32 initialCapacity);
+		~GPUSceneBuffer();
+
+		void MarkDirty(uint32 slot);
+		void ClearDirty();
+
+		// Makes room for numSlots records and copies the dirty ones, records points to the CPU copy of the whole table
+		void Upload(RHI::CommandContext* cmd, const void* records, uint32 numSlots);
+
+		RHI::BufferHandle GetBuffer() const { return m_Buffer; }
+		uint32 GetDescriptorIndex() const;
+		uint32 GetCapacity() const { return m_Capacity; }
+		uint32 GetLastUploadCount() const { return m_LastUploadCount; }
+
+	private:
+		void Grow(RHI::CommandContext* cmd, uint32 numSlots);
+	};
+
+	/**
+	 * Table of records the shaders read by index, like the materials and the instances of the loaded scenes.
+	 * Every scene gets a range of slots, so adding a scene or changing a record only uploads what changed.
+	 */
+	template<typename T>
+	class GPUSceneTable
+	{
+		// CPU copy of the buffer
+		std::vector<T>		m_Records;
+		SlotAllocator		m_Slots;
+		GPUSceneBuffer		m_Buffer;
+
+	public:
+		GPUSceneTable(const char* debugName, uint32 initialCapacity)
+			: m_Buffer(debugName, sizeof(T), initialCapacity)
+		{
+		}
+
+		// Range of slots for count records, they have to be written with Edit() before the next upload
+		uint32 Allocate(uint32 count)
+		{
+			const uint32 first = m_Slots.Allocate(count);
+			if (m_Slots.GetSize() > m_Records.size())
+				m_Records.resize(m_Slots.GetSize());
+			return first;
+		}
+
+		// The records stay in the buffer until the slots are given out again
+		void Free(uint32 first, uint32 count)
+		{
+			m_Slots.Free(first, count);
+		}
+
+		void Clear()
+		{
+			m_Slots.Reset();
+			m_Records.clear();
+			m_Buffer.ClearDirty();
+		}
+
+		const T& Get(uint32 slot) const { return m_Records[slot]; }
+
+		// The slot goes up with the next upload
+		T& Edit(uint32 slot)
+		{
+			m_Buffer.MarkDirty(slot);
+			return m_Records[slot];
+		}
+
+		void Upload(RHI::CommandContext* cmd)
+		{
+			m_Buffer.Upload(cmd, m_Records.data(), m_Slots.GetSize());
+		}
+
+		uint32 GetSize() const { return m_Slots.GetSize(); }
+		uint32 NumAllocated() const { return m_Slots.NumAllocated(); }
+		const GPUSceneBuffer& GetBuffer() const { return m_Buffer; }
+	};
+}
@@ -0,0 +1,62 @@
+#include "stdafx.h"
+#include "indirectcommands.h"
+#include "rhi/resourcemanager.h"
+
+namespace limbo::Gfx
+{
+	static_assert(sizeof(IndirectIndexBufferView) == sizeof(D3D12_INDEX_BUFFER_VIEW));
+	static_assert(sizeof(IndirectDrawIndexedArguments) == sizeof(D3D12_DRAW_INDEXED_ARGUMENTS));
+	static_assert(sizeof(IndirectDispatchMeshArguments) == sizeof(D3D12_DISPATCH_MESH_ARGUMENTS));
+
+	IndirectIndexBufferView CreateIndirectIndexBufferView(const RHI::IndexBufferView& view)
+	{
+		return {
+			.BufferLocation = view.BufferLocation,
+			.SizeInBytes = view.SizeInBytes,
+			.Format = (uint32)RHI::D3DFormat(view.Format)
+		};
+	}
+
+	IndirectCommandBuffer::IndirectCommandBuffer(const char* debugName)
+		: m_DebugName(debugName)
+	{
+	}
+
+	IndirectCommandBuffer::~IndirectCommandBuffer()
+	{
+		if (m_Buffer.IsValid())
+			RHI::DestroyBuffer(m_Buffer);
+	}
+
+	void IndirectCommandBuffer::Reset(uint64 size)
+	{
+		m_Used = 0;
+		if (size <= m_Size)
+			return;
+
+		if (m_Buffer.IsValid())
+			RHI::DestroyBuffer(m_Buffer);
+
+		// Some room so a few more draws do not create it again
+		m_Size = Math::Align(size + size / 4, 64 * 1024ull);
+		m_Buffer = RHI::CreateBuffer({
+			.DebugName = m_DebugName,
+			.ByteSize = m_Size,
+			.Flags = RHI::BufferUsage::Upload
+		});
+		RM_GET(m_Buffer)->Map();
+	}
+
+	void* IndirectCommandBuffer::Allocate(uint64 size, uint64& outOffset)
+	{
+		outOffset = 0;
+		if (size == 0)
+			return nullptr;
+		check(m_Used + size <= m_Size);
+
+		// The command signatures have at most 8 byte members
+		outOffset = m_Used;
+		m_Used = Math::Align(m_Used + size, 8ull);
+		return (uint8*)RM_GET(m_Buffer)->MappedData + outOffset;
+	}
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "drawlist.h"
+#include "core/jobsystem.h"
+#include "rhi/buffer.h"
+
+#include <cstddef>
+
+namespace limbo::Gfx
+{
+	// Same layout as D3D12_INDEX_BUFFER_VIEW
+	struct IndirectIndexBufferView
+	{
+		uint64		BufferLocation = 0;
+		uint32		SizeInBytes = 0;
+		uint32		Format = 0; // DXGI_FORMAT
+	};
+
+	// Same layout as D3D12_DRAW_INDEXED_ARGUMENTS
+	struct IndirectDrawIndexedArguments
+	{
+		uint32		IndexCountPerInstance;
+		uint32		InstanceCount;
+		uint32		StartIndexLocation;
+		int32		BaseVertexLocation;
+		uint32		StartInstanceLocation;
+	};
+
+	// Same layout as D3D12_DISPATCH_MESH_ARGUMENTS
+	struct IndirectDispatchMeshArguments
+	{
+		uint32		ThreadGroupCountX;
+		uint32		ThreadGroupCountY;
+		uint32		ThreadGroupCountZ;
+	};
+
+	// Two root constants, the index buffer and the draw. Padded so the index buffer address of the next command stays aligned.
+	struct IndirectDrawIndexedCommand
+	{
+		uint32							Constants[2];
+		IndirectIndexBufferView			IndexBuffer;
+		IndirectDrawIndexedArguments	Draw;
+		uint32							Padding;
+	};
+	static_assert(sizeof(IndirectDrawIndexedCommand) == 48);
+	static_assert(offsetof(IndirectDrawIndexedCommand, IndexBuffer) == 8);
+	static_assert(offsetof(IndirectDrawIndexedCommand, Draw) == 24);
+
+	// Two root constants and the mesh shader dispatch
+	struct IndirectDispatchMeshCommand
+	{
+		uint32							Constants[2];
+		IndirectDispatchMeshArguments	Dispatch;
+	};
+	static_assert(sizeof(IndirectDispatchMeshCommand) == 20);
+
+	inline IndirectDrawIndexedCommand CreateDrawIndexedCommand(uint32 constant0, uint32 constant1, const IndirectIndexBufferView& indexBuffer, uint32 indexCount)
+	{
+		return {
+			.Constants = { constant0, constant1 },
+			.IndexBuffer = indexBuffer,
+			.Draw = {
+				.IndexCountPerInstance = indexCount,
+				.InstanceCount = 1,
+				.StartIndexLocation = 0,
+				.BaseVertexLocation = 0,
+				.StartInstanceLocation = 0
+			},
+			.Padding = 0
+		};
+	}
+
+	inline IndirectDispatchMeshCommand CreateDispatchMeshCommand(uint32 constant0, uint32 constant1, uint32 threadGroupCount)
+	{
+		return {
+			.Constants = { constant0, constant1 },
+			.Dispatch = { threadGroupCount, 1, 1 }
+		};
+	}
+
+	IndirectIndexBufferView CreateIndirectIndexBufferView(const RHI::IndexBufferView& view);
+
+	inline constexpr uint32 IndirectCommandsPerJob = 1024;
+
+	// Writes the command of every draw key in the order of the keys, split over the job system.
+	// createCommand gets the instance ID of the key and returns its command.
+	template<typename TCommand, typename TCreateCommand>
+	void PackIndirectCommands(Span<uint64> drawKeys, TCommand* outCommands, const TCreateCommand& createCommand)
+	{
+		Core::JobContext context;
+		Core::JobSystem::ExecuteMany(context, drawKeys.GetSize(), IndirectCommandsPerJob, Core::TOnJobSystemExecuteMany::CreateLambda([&](Core::JobDispatchArgs args)
+		{
+			outCommands[args.jobIndex] = createCommand(DrawList::GetInstance(drawKeys[args.jobIndex]));
+		}));
+		Core::JobSystem::Wait(context);
+	}
+
+	/**
+	 * Upload memory the indirect commands are packed into.
+	 * The device waits for the GPU at the end of every frame, so a single buffer is rewritten every frame.
+	 */
+	class IndirectCommandBuffer
+	{
+	private:
+		const char*			m_DebugName;
+		RHI::BufferHandle	m_Buffer;
+		uint64				m_Size = 0;
+		uint64				m_Used = 0;
+
+	public:
+		explicit IndirectCommandBuffer(const char* debugName);
+		~IndirectCommandBuffer();
+
+		// Starts the frame with room for at least size bytes, the buffer only grows here
+		void Reset(uint64 size);
+		// Room for the commands of one ExecuteIndirect(), outOffset is where they start in the buffer
+		void* Allocate(uint64 size, uint64& outOffset);
+
+		RHI::BufferHandle GetBuffer() const { return m_Buffer; }
+	};
+}
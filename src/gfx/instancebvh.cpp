@@ -0,0 +1,466 @@
+#include "stdafx.h"
+#include "instancebvh.h"
+#include "core/jobsystem.h"
+
+#include <numeric>
+
+namespace limbo::Gfx
+{
+	namespace
+	{
+		struct Bin
+		{
+			Math::AABB	Bounds;
+			uint32		Count = 0;
+		};
+
+		// Clears the planes the box is fully inside of, returns false when it is fully outside of one of them
+		bool ClassifyBox(const float4 planes[6], const float3& min, const float3& max, uint32& planeMask)
+		{
+			const float3 center = (min + max) * 0.5f;
+			const float3 extents = (max - min) * 0.5f;
+			for (uint32 i = 0; i < 6; ++i)
+			{
+				if ((planeMask & (1u << i)) == 0)
+					continue;
+
+				const float3 normal = float3(planes[i]);
+				const float distance = glm::dot(normal, center) + planes[i].w;
+				const float radius = glm::dot(glm::abs(normal), extents);
+				if (distance < -radius)
+					return false;
+				if (distance >= radius)
+					planeMask &= ~(1u << i);
+			}
+			return true;
+		}
+
+		bool IntersectRay(const Math::Ray& ray, const float3& invDirection, const float3& min, const float3& max, float maxDistance, float& outDistance)
+		{
+			float exit;
+			return Math::RayIntersectsAABB(ray.Origin, invDirection, { min, max }, maxDistance, outDistance, exit);
+		}
+	}
+
+	void InstanceBVH::Clear()
+	{
+		m_Nodes.clear();
+		m_NodeParents.clear();
+		m_NumNodes = 0;
+		m_SlotInstances.clear();
+		m_SlotBounds.clear();
+		m_InstanceSlots.clear();
+		m_InstanceLeaves.clear();
+	}
+
+	void InstanceBVH::Build(Span<Math::AABB> instanceBounds)
+	{
+		Clear();
+
+		const uint32 numInstances = instanceBounds.GetSize();
+		if (numInstances == 0)
+			return;
+
+		m_BuildBounds = instanceBounds.begin();
+		m_Centroids.resize(numInstances);
+		for (uint32 i = 0; i < numInstances; ++i)
+			m_Centroids[i] = instanceBounds[i].GetCenter();
+
+		m_SlotInstances.resize(numInstances);
+		std::iota(m_SlotInstances.begin(), m_SlotInstances.end(), 0);
+
+		// With one instance per leaf the tree has 2n - 1 nodes, it never needs more
+		m_Nodes.resize(2 * numInstances - 1);
+		m_NodeParents.resize(2 * numInstances - 1);
+		m_NodeParents[0] = ~0u;
+		m_NumNodes = 1;
+
+		Core::JobContext context;
+		Subdivide(0, 0, numInstances, context);
+		Core::JobSystem::Wait(context);
+
+		m_Nodes.resize(m_NumNodes);
+		m_NodeParents.resize(m_NumNodes);
+
+		m_SlotBounds.resize(numInstances);
+		m_InstanceSlots.resize(numInstances);
+		m_InstanceLeaves.resize(numInstances);
+		for (uint32 slot = 0; slot < numInstances; ++slot)
+		{
+			const uint32 instance = m_SlotInstances[slot];
+			m_SlotBounds[slot] = instanceBounds[instance];
+			m_InstanceSlots[instance] = slot;
+		}
+
+		for (uint32 nodeIndex = 0; nodeIndex < NumNodes(); ++nodeIndex)
+		{
+			const Node& node = m_Nodes[nodeIndex];
+			if (!node.IsLeaf())
+				continue;
+
+			for (uint32 slot = node.LeftFirst; slot < node.LeftFirst + node.Count; ++slot)
+				m_InstanceLeaves[m_SlotInstances[slot]] = nodeIndex;
+		}
+
+		std::vector<float3>().swap(m_Centroids);
+		m_BuildBounds = nullptr;
+	}
+
+	void InstanceBVH::Subdivide(uint32 nodeIndex, uint32 first, uint32 count, Core::JobContext& context)
+	{
+		Math::AABB bounds, centroidBounds;
+		for (uint32 slot = first; slot < first + count; ++slot)
+		{
+			const uint32 instance = m_SlotInstances[slot];
+			bounds.Extend(m_BuildBounds[instance]);
+			centroidBounds.Extend(m_Centroids[instance]);
+		}
+
+		Node& node = m_Nodes[nodeIndex];
+		node.Min = bounds.Min;
+		node.Max = bounds.Max;
+		node.LeftFirst = first;
+		node.Count = count;
+		if (count == 1)
+			return;
+
+		// Binned SAH, a split costs the area of each side times the number of instances in it
+		const float3 centroidExtent = centroidBounds.Max - centroidBounds.Min;
+		float bestCost = FLT_MAX;
+		uint32 bestAxis = 0;
+		uint32 bestSplit = 0;
+		for (uint32 axis = 0; axis < 3; ++axis)
+		{
+			if (centroidExtent[axis] <= 0.0f)
+				continue;
+
+			Bin bins[NumBins];
+			const float binScale = NumBins / centroidExtent[axis];
+			for (uint32 slot = first; slot < first + count; ++slot)
+			{
+				const uint32 instance = m_SlotInstances[slot];
+				Bin& bin = bins[Math::Min((uint32)((m_Centroids[instance][axis] - centroidBounds.Min[axis]) * binScale), NumBins - 1)];
+				bin.Bounds.Extend(m_BuildBounds[instance]);
+				bin.Count++;
+			}
+
+			// Sweep from both ends, split i puts bins [0, i] on the left
+			float leftCost[NumBins - 1];
+			Math::AABB leftBounds, rightBounds;
+			uint32 leftCount = 0, rightCount = 0;
+			for (uint32 i = 0; i < NumBins - 1; ++i)
+			{
+				leftBounds.Extend(bins[i].Bounds);
+				leftCount += bins[i].Count;
+				leftCost[i] = leftCount > 0 ? leftCount * leftBounds.GetHalfArea() : -1.0f;
+			}
+			for (uint32 i = NumBins - 1; i > 0; --i)
+			{
+				rightBounds.Extend(bins[i].Bounds);
+				rightCount += bins[i].Count;
+				if (rightCount == 0 || leftCost[i - 1] < 0.0f)
+					continue;
+
+				const float cost = leftCost[i - 1] + rightCount * rightBounds.GetHalfArea();
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = i - 1;
+				}
+			}
+		}
+
+		// Small nodes stay leaves when splitting them does not pay off
+		if (count <= MaxLeafSize && bestCost >= count * bounds.GetHalfArea())
+			return;
+
+		uint32 leftCount = count / 2;
+		if (bestCost < FLT_MAX)
+		{
+			const float binScale = NumBins / centroidExtent[bestAxis];
+			const float axisMin = centroidBounds.Min[bestAxis];
+			uint32* slots = m_SlotInstances.data() + first;
+			uint32* middle = std::partition(slots, slots + count, [&](uint32 instance)
+			{
+				return Math::Min((uint32)((m_Centroids[instance][bestAxis] - axisMin) * binScale), NumBins - 1) <= bestSplit;
+			});
+			leftCount = (uint32)(middle - slots);
+		}
+		else if (count <= MaxLeafSize)
+		{
+			return;
+		}
+		// else every centroid is in the same place, the slots are split in half
+
+		const uint32 left = m_NumNodes.fetch_add(2);
+		node.LeftFirst = left;
+		node.Count = 0;
+		m_NodeParents[left] = nodeIndex;
+		m_NodeParents[left + 1] = nodeIndex;
+
+		if (count >= MinParallelBuildSize)
+		{
+			Core::JobSystem::Execute(context, Core::TOnJobSystemExecute::CreateLambda([this, left, first, leftCount, &context]()
+			{
+				Subdivide(left, first, leftCount, context);
+			}));
+		}
+		else
+		{
+			Subdivide(left, first, leftCount, context);
+		}
+		Subdivide(left + 1, first + leftCount, count - leftCount, context);
+	}
+
+	void InstanceBVH::RefitNode(uint32 nodeIndex)
+	{
+		Node& node = m_Nodes[nodeIndex];
+		Math::AABB bounds;
+		if (node.IsLeaf())
+		{
+			for (uint32 slot = node.LeftFirst; slot < node.LeftFirst + node.Count; ++slot)
+				bounds.Extend(m_SlotBounds[slot]);
+		}
+		else
+		{
+			const Node& left = m_Nodes[node.LeftFirst];
+			const Node& right = m_Nodes[node.LeftFirst + 1];
+			bounds = { glm::min(left.Min, right.Min), glm::max(left.Max, right.Max) };
+		}
+		node.Min = bounds.Min;
+		node.Max = bounds.Max;
+	}
+
+	void InstanceBVH::Refit(Span<uint32> movedInstances, Span<Math::AABB> instanceBounds)
+	{
+		ENSURE_RETURN(instanceBounds.GetSize() != NumInstances());
+
+		for (uint32 instance : movedInstances)
+			m_SlotBounds[m_InstanceSlots[instance]] = instanceBounds[instance];
+
+		// With a lot of instances moving it is cheaper to go over every node once, the children always come after their parent
+		if (movedInstances.GetSize() * 4 >= NumInstances())
+		{
+			for (uint32 nodeIndex = NumNodes(); nodeIndex-- > 0;)
+				RefitNode(nodeIndex);
+			return;
+		}
+
+		// Otherwise walk up from each leaf until a node does not change
+		for (uint32 instance : movedInstances)
+		{
+			uint32 nodeIndex = m_InstanceLeaves[instance];
+			while (nodeIndex != ~0u)
+			{
+				const Node previous = m_Nodes[nodeIndex];
+				RefitNode(nodeIndex);
+
+				const Node& node = m_Nodes[nodeIndex];
+				if (node.Min == previous.Min && node.Max == previous.Max)
+					break;
+
+				nodeIndex = m_NodeParents[nodeIndex];
+			}
+		}
+	}
+
+	void InstanceBVH::AppendSubtree(uint32 nodeIndex, std::vector<uint32>& outInstances) const
+	{
+		TSmallVector<uint32, 64> stack;
+		stack.Add(nodeIndex);
+		while (!stack.IsEmpty())
+		{
+			const Node& node = m_Nodes[stack[stack.GetSize() - 1]];
+			stack.Pop();
+
+			if (node.IsLeaf())
+			{
+				outInstances.insert(outInstances.end(), m_SlotInstances.begin() + node.LeftFirst, m_SlotInstances.begin() + node.LeftFirst + node.Count);
+				continue;
+			}
+
+			stack.Add(node.LeftFirst);
+			stack.Add(node.LeftFirst + 1);
+		}
+	}
+
+	void InstanceBVH::QueryFrustum(const float4 planes[6], std::vector<uint32>& outInstances) const
+	{
+		if (m_Nodes.empty())
+			return;
+
+		// The planes a node is fully inside of are not tested again for anything under it
+		struct Entry
+		{
+			uint32 NodeIndex;
+			uint32 PlaneMask;
+		};
+		TSmallVector<Entry, 64> stack;
+		stack.Add({ 0, 0x3f });
+		while (!stack.IsEmpty())
+		{
+			const Entry entry = stack[stack.GetSize() - 1];
+			stack.Pop();
+
+			const Node& node = m_Nodes[entry.NodeIndex];
+			uint32 planeMask = entry.PlaneMask;
+			if (!ClassifyBox(planes, node.Min, node.Max, planeMask))
+				continue;
+
+			if (planeMask == 0)
+			{
+				AppendSubtree(entry.NodeIndex, outInstances);
+			}
+			else if (node.IsLeaf())
+			{
+				for (uint32 slot = node.LeftFirst; slot < node.LeftFirst + node.Count; ++slot)
+				{
+					uint32 slotMask = planeMask;
+					if (ClassifyBox(planes, m_SlotBounds[slot].Min, m_SlotBounds[slot].Max, slotMask))
+						outInstances.push_back(m_SlotInstances[slot]);
+				}
+			}
+			else
+			{
+				stack.Add({ node.LeftFirst, planeMask });
+				stack.Add({ node.LeftFirst + 1, planeMask });
+			}
+		}
+	}
+
+	void InstanceBVH::QuerySphere(const float4& sphere, std::vector<uint32>& outInstances) const
+	{
+		if (m_Nodes.empty())
+			return;
+
+		TSmallVector<uint32, 64> stack;
+		stack.Add(0);
+		while (!stack.IsEmpty())
+		{
+			const Node& node = m_Nodes[stack[stack.GetSize() - 1]];
+			stack.Pop();
+
+			if (!Math::SphereIntersectsAABB(sphere, { node.Min, node.Max }))
+				continue;
+
+			if (node.IsLeaf())
+			{
+				for (uint32 slot = node.LeftFirst; slot < node.LeftFirst + node.Count; ++slot)
+				{
+					if (Math::SphereIntersectsAABB(sphere, m_SlotBounds[slot]))
+						outInstances.push_back(m_SlotInstances[slot]);
+				}
+				continue;
+			}
+
+			stack.Add(node.LeftFirst);
+			stack.Add(node.LeftFirst + 1);
+		}
+	}
+
+	bool InstanceBVH::Raycast(const Math::Ray& ray, RayHit& outHit, float maxDistance) const
+	{
+		outHit = RayHit();
+		if (m_Nodes.empty())
+			return false;
+
+		const float3 invDirection = 1.0f / ray.Direction;
+		float closest = maxDistance;
+
+		struct Entry
+		{
+			uint32	NodeIndex;
+			float	Distance;
+		};
+		TSmallVector<Entry, 64> stack;
+
+		float rootDistance;
+		if (!IntersectRay(ray, invDirection, m_Nodes[0].Min, m_Nodes[0].Max, closest, rootDistance))
+			return false;
+		stack.Add({ 0, rootDistance });
+
+		while (!stack.IsEmpty())
+		{
+			const Entry entry = stack[stack.GetSize() - 1];
+			stack.Pop();
+			if (entry.Distance > closest)
+				continue;
+
+			const Node& node = m_Nodes[entry.NodeIndex];
+			if (node.IsLeaf())
+			{
+				for (uint32 slot = node.LeftFirst; slot < node.LeftFirst + node.Count; ++slot)
+				{
+					// A box the ray starts inside of, like the walls of a room, is ranked by where the ray leaves it.
+					// Otherwise it would hide everything that is inside of it.
+					float enter, exit;
+					if (!Math::RayIntersectsAABB(ray.Origin, invDirection, m_SlotBounds[slot], closest, enter, exit))
+						continue;
+
+					const float distance = enter > 0.0f ? enter : exit;
+					if (distance <= closest)
+					{
+						closest = distance;
+						outHit.Instance = m_SlotInstances[slot];
+						outHit.Distance = distance;
+					}
+				}
+				continue;
+			}
+
+			// Visit the closest child first so the other one can be skipped
+			float leftDistance, rightDistance;
+			const Node& left = m_Nodes[node.LeftFirst];
+			const Node& right = m_Nodes[node.LeftFirst + 1];
+			const bool bHitLeft = IntersectRay(ray, invDirection, left.Min, left.Max, closest, leftDistance);
+			const bool bHitRight = IntersectRay(ray, invDirection, right.Min, right.Max, closest, rightDistance);
+			if (bHitLeft && bHitRight)
+			{
+				const bool bLeftFirst = leftDistance <= rightDistance;
+				stack.Add(bLeftFirst ? Entry{ node.LeftFirst + 1, rightDistance } : Entry{ node.LeftFirst, leftDistance });
+				stack.Add(bLeftFirst ? Entry{ node.LeftFirst, leftDistance } : Entry{ node.LeftFirst + 1, rightDistance });
+			}
+			else if (bHitLeft)
+			{
+				stack.Add({ node.LeftFirst, leftDistance });
+			}
+			else if (bHitRight)
+			{
+				stack.Add({ node.LeftFirst + 1, rightDistance });
+			}
+		}
+
+		return outHit.Instance != ~0u;
+	}
+
+	Math::AABB InstanceBVH::GetBounds() const
+	{
+		if (m_Nodes.empty())
+			return Math::AABB();
+		return { m_Nodes[0].Min, m_Nodes[0].Max };
+	}
+
+	float InstanceBVH::ComputeCost() const
+	{
+		if (m_Nodes.empty())
+			return 0.0f;
+
+		float cost = 0.0f;
+		for (const Node& node : m_Nodes)
+		{
+			const float area = Math::AABB{ node.Min, node.Max }.GetHalfArea();
+			cost += node.IsLeaf() ? area * node.Count : area;
+		}
+		return cost / Math::Max(GetBounds().GetHalfArea(), FLT_MIN);
+	}
+
+	Math::Ray CreateScreenRay(const float4x4& viewProjection, const float3& eye, const float2& pixel, const uint2& screenSize)
+	{
+		const float2 ndc = float2((pixel.x + 0.5f) / (float)screenSize.x * 2.0f - 1.0f, 1.0f - (pixel.y + 0.5f) / (float)screenSize.y * 2.0f);
+
+		// Any depth inside of the frustum works, the ray starts at the eye
+		const float4 point = glm::inverse(viewProjection) * float4(ndc, 0.5f, 1.0f);
+		return { eye, glm::normalize(float3(point) / point.w - eye) };
+	}
+}
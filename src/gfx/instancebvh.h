@@ -0,0 +1,97 @@
+#pragma once
+
+#include "core/math.h"
+#include "core/array.h"
+
+#include <atomic>
+#include <vector>
+
+namespace limbo::Core
+{
+	struct JobContext;
+}
+
+namespace limbo::Gfx
+{
+	/**
+	 * Bounding volume hierarchy over the world space boxes of the mesh instances, for the queries that run on the CPU.
+	 *
+	 * The build uses a binned SAH, the subtrees that are big enough are built in parallel on the job system.
+	 * The nodes are 32 bytes and both children of a node are stored next to each other, the boxes of the instances
+	 * are stored in leaf order so a leaf reads them from one place.
+	 */
+	class InstanceBVH
+	{
+	public:
+		struct Node
+		{
+			float3	Min;
+			// First child when Count is 0, first instance slot otherwise
+			uint32	LeftFirst;
+			float3	Max;
+			uint32	Count;
+
+			bool IsLeaf() const { return Count > 0; }
+		};
+		static_assert(sizeof(Node) == 32);
+
+		struct RayHit
+		{
+			uint32	Instance = ~0u;
+			float	Distance = FLT_MAX;
+		};
+
+		static constexpr uint32 NumBins = 12;
+		static constexpr uint32 MaxLeafSize = 4;
+		// Subtrees with more instances than this are built in their own job
+		static constexpr uint32 MinParallelBuildSize = 2048;
+
+	private:
+		std::vector<Node>			m_Nodes;
+		std::vector<uint32>			m_NodeParents;
+		std::atomic<uint32>			m_NumNodes = 0;
+
+		// Per slot, the order the leaves reference the instances in
+		std::vector<uint32>			m_SlotInstances;
+		std::vector<Math::AABB>		m_SlotBounds;
+
+		// Per instance
+		std::vector<uint32>			m_InstanceSlots;
+		std::vector<uint32>			m_InstanceLeaves;
+
+		// Only valid during the build
+		std::vector<float3>			m_Centroids;
+		const Math::AABB*			m_BuildBounds = nullptr;
+
+	public:
+		void Build(Span<Math::AABB> instanceBounds);
+		void Clear();
+
+		// Updates the boxes of the instances that moved and the nodes above them, the tree itself is kept.
+		// A refit makes the tree worse the more the instances move, build it again after big changes.
+		void Refit(Span<uint32> movedInstances, Span<Math::AABB> instanceBounds);
+
+		// Appends the instances whose box is at least partly inside of all the planes, planes from Math::ExtractFrustumPlanes()
+		void QueryFrustum(const float4 planes[6], std::vector<uint32>& outInstances) const;
+		// Appends the instances whose box intersects the sphere (xyz center, w radius)
+		void QuerySphere(const float4& sphere, std::vector<uint32>& outInstances) const;
+		// Closest instance box hit by the ray, the direction does not need to be normalized but the distance is in its units
+		bool Raycast(const Math::Ray& ray, RayHit& outHit, float maxDistance = FLT_MAX) const;
+
+		uint32 NumNodes() const { return (uint32)m_Nodes.size(); }
+		uint32 NumInstances() const { return (uint32)m_SlotInstances.size(); }
+		const Node& GetNode(uint32 index) const { return m_Nodes[index]; }
+		Math::AABB GetBounds() const;
+
+		// SAH cost of the tree, relative to the root box, useful to see how much a refit degraded it
+		float ComputeCost() const;
+
+	private:
+		void Subdivide(uint32 nodeIndex, uint32 first, uint32 count, Core::JobContext& context);
+		void RefitNode(uint32 nodeIndex);
+		void AppendSubtree(uint32 nodeIndex, std::vector<uint32>& outInstances) const;
+	};
+
+	// Ray from the eye through a pixel center of the screen, in the space the view projection comes from
+	Math::Ray CreateScreenRay(const float4x4& viewProjection, const float3& eye, const float2& pixel, const uint2& screenSize);
+}
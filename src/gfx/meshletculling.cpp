@@ -0,0 +1,69 @@
+#include "stdafx.h"
+#include "meshletculling.h"
+
+namespace limbo::Gfx
+{
+	namespace
+	{
+		// Whether the bounds of a sphere on screen miss every pixel center, only for spheres that are fully in front of the eye
+		bool IsSmallPrimitive(const float4& sphere, const MeshletCullingView& view)
+		{
+			const float4 clip = view.ViewProjection * float4(float3(sphere), 1.0f);
+			if (clip.w <= sphere.w)
+				return false;
+
+			// The silhouette of the sphere is never bigger than its radius at the depth of its closest point
+			const float2 renderSize = float2(view.RenderSize);
+			const float2 center = (float2(clip.x, -clip.y) / clip.w * 0.5f + 0.5f) * renderSize;
+			const float2 radius = view.ProjectionScale * (sphere.w / (clip.w - sphere.w)) * 0.5f * renderSize;
+
+			// The pixel centers are at k + 0.5
+			const float2 boundsMin = center - radius - 0.5f;
+			const float2 boundsMax = center + radius - 0.5f;
+			return ceilf(boundsMin.x) > floorf(boundsMax.x) || ceilf(boundsMin.y) > floorf(boundsMax.y);
+		}
+	}
+
+	MeshletCullingView CreateMeshletCullingView(const float4x4& view, const float4x4& projection, const float3& eye, uint2 renderSize)
+	{
+		MeshletCullingView result = {
+			.ViewProjection = projection * view,
+			.Eye = eye,
+			.ProjectionScale = float2(projection[0][0], projection[1][1]),
+			.RenderSize = renderSize
+		};
+		Math::ExtractFrustumPlanes(result.ViewProjection, result.FrustumPlanes);
+		return result;
+	}
+
+	MeshletCullResult CullMeshlet(const Meshlet& meshlet, const float4x4& transform, const float3& localEye, bool bMirrored, const MeshletCullingView& view)
+	{
+		const float4 sphere = Math::TransformBoundingSphere(meshlet.BoundingSphere, transform);
+		if (view.bFrustumCulling && !Math::SphereInFrustum(view.FrustumPlanes, sphere))
+			return MeshletCullResult::Frustum;
+
+		// The cone is in local space, the eye goes there instead so any scale keeps the test right
+		if (view.bBackfaceCulling && !bMirrored && MeshletCulling::IsConeBackfacing(meshlet.BoundingSphere, MeshletCulling::UnpackNormalCone(meshlet.NormalCone), localEye))
+			return MeshletCullResult::Backface;
+
+		if (view.bSmallPrimitiveCulling && IsSmallPrimitive(sphere, view))
+			return MeshletCullResult::SmallPrimitive;
+
+		return MeshletCullResult::Visible;
+	}
+
+	void CullMeshlets(const Meshlet* meshlets, uint32 numMeshlets, const float4x4& transform, const MeshletCullingView& view, MeshletCullingStats& stats, std::vector<uint32>* outVisible)
+	{
+		const float3 localEye = float3(glm::inverse(transform) * float4(view.Eye, 1.0f));
+		const bool bMirrored = glm::determinant(float3x3(transform)) < 0.0f;
+
+		stats.NumMeshlets += numMeshlets;
+		for (uint32 i = 0; i < numMeshlets; ++i)
+		{
+			const MeshletCullResult result = CullMeshlet(meshlets[i], transform, localEye, bMirrored, view);
+			stats.NumResults[(uint32)result]++;
+			if (outVisible && result == MeshletCullResult::Visible)
+				outVisible->push_back(i);
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "shaderinterop.h"
+
+namespace limbo::Gfx
+{
+	// Everything a view needs to cull the meshlets, in world space. The mesh shaders have to do the same tests.
+	struct MeshletCullingView
+	{
+		float4		FrustumPlanes[6];
+		float4x4	ViewProjection;
+		float3		Eye;
+		// Projection scale on x and y, for a perspective projection
+		float2		ProjectionScale;
+		uint2		RenderSize;
+
+		bool		bFrustumCulling = true;
+		bool		bBackfaceCulling = true;
+		bool		bSmallPrimitiveCulling = true;
+	};
+
+	MeshletCullingView CreateMeshletCullingView(const float4x4& view, const float4x4& projection, const float3& eye, uint2 renderSize);
+
+	enum class MeshletCullResult : uint8
+	{
+		Visible = 0,
+		Frustum,
+		Backface,
+		SmallPrimitive,
+
+		MAX
+	};
+
+	struct MeshletCullingStats
+	{
+		uint32 NumMeshlets = 0;
+		// Meshlets that got each result
+		uint32 NumResults[(uint32)MeshletCullResult::MAX] = {};
+
+		uint32 NumVisible() const { return NumResults[(uint32)MeshletCullResult::Visible]; }
+		float GetCullRate() const { return NumMeshlets > 0 ? 1.0f - (float)NumVisible() / NumMeshlets : 0.0f; }
+	};
+
+	// Tests are done from the cheapest to the most expensive one and the first one that culls decides the result.
+	// localEye is the eye in the local space of the mesh, bMirrored is set for transforms that flip the triangles.
+	MeshletCullResult CullMeshlet(const Meshlet& meshlet, const float4x4& transform, const float3& localEye, bool bMirrored, const MeshletCullingView& view);
+
+	// Culls the meshlets of a mesh and adds them to the stats. The indices of the visible meshlets go in outVisible when there is one.
+	void CullMeshlets(const Meshlet* meshlets, uint32 numMeshlets, const float4x4& transform, const MeshletCullingView& view, MeshletCullingStats& stats, std::vector<uint32>* outVisible = nullptr);
+}
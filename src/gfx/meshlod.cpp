@@ -0,0 +1,76 @@
+#include "stdafx.h"
+#include "meshlod.h"
+
+#include <meshoptimizer.h>
+
+namespace limbo::Gfx
+{
+	namespace
+	{
+		// Relative to the mesh extents, past this the LOD is too far from the source to be worth keeping
+		constexpr float MaxLODError = 0.1f;
+		// A LOD has to get rid of at least 15% of the indices of the previous one
+		constexpr float MaxLODIndexRatio = 0.85f;
+		constexpr size_t MinLODTriangles = 32;
+	}
+
+	void BuildMeshLODs(const uint32* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t positionStride, std::vector<MeshLODIndices>& outLODs)
+	{
+		outLODs.clear();
+		if (indexCount < MinLODTriangles * 3 * 2 || vertexCount == 0)
+			return;
+
+		const float errorScale = meshopt_simplifyScale(positions, vertexCount, positionStride);
+
+		std::vector<uint32> lodIndices(indexCount);
+		size_t previousCount = indexCount;
+		float previousError = 0.0f;
+		for (uint32 lod = 1; lod < MaxMeshLODs; ++lod)
+		{
+			const size_t targetCount = previousCount / 6 * 3;
+			if (targetCount < MinLODTriangles * 3)
+				break;
+
+			// Every LOD is simplified from LOD 0, so its error is measured against the source mesh and does not add up from LOD to LOD
+			float error = 0.0f;
+			size_t count = meshopt_simplify(lodIndices.data(), indices, indexCount, positions, vertexCount, positionStride, targetCount, MaxLODError, 0, &error);
+
+			// The regular simplification keeps the topology, which does not let meshes made of many small pieces go far.
+			// The sloppy one ignores it and still respects the error.
+			if (count > previousCount * MaxLODIndexRatio)
+				count = meshopt_simplifySloppy(lodIndices.data(), indices, indexCount, positions, vertexCount, positionStride, targetCount, MaxLODError, &error);
+
+			if (count == 0 || count > previousCount * MaxLODIndexRatio)
+				break;
+
+			MeshLODIndices& result = outLODs.emplace_back();
+			result.Indices.assign(lodIndices.begin(), lodIndices.begin() + count);
+			meshopt_optimizeVertexCache(result.Indices.data(), result.Indices.data(), count, vertexCount);
+			result.Error = Math::Max(error * errorScale, previousError);
+
+			previousCount = count;
+			previousError = result.Error;
+		}
+	}
+
+	uint32 SelectMeshLOD(const MeshLOD* lods, uint32 numLODs, const float4& boundingSphere, const float4x4& transform, const MeshLODView& view)
+	{
+		if (numLODs <= 1)
+			return 0;
+
+		// The radius is scaled by the biggest axis scale, the errors get the same scale
+		const float4 sphere = Math::TransformBoundingSphere(boundingSphere, transform);
+		const float scale = boundingSphere.w > 0.0f ? sphere.w / boundingSphere.w : 1.0f;
+		const float distance = Math::Max(glm::length(float3(sphere) - view.Eye) - sphere.w, 0.0f);
+
+		uint32 lod = 0;
+		for (uint32 i = 1; i < numLODs; ++i)
+		{
+			const float pixelError = Math::ProjectedSphereSize(distance, lods[i].Error * scale, view.FovY, view.ScreenHeight);
+			if (pixelError > view.MaxPixelError)
+				break;
+			lod = i;
+		}
+		return lod;
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "core/math.h"
+
+namespace limbo::Gfx
+{
+	// LOD 0 is the imported mesh, every LOD after it has about half the triangles of the previous one
+	constexpr uint32 MaxMeshLODs = 6;
+
+	// Ranges of a LOD, relative to the first index and the first meshlet of the mesh. The LODs share the vertices of LOD 0.
+	struct MeshLOD
+	{
+		uint32	FirstIndex;
+		uint32	IndexCount;
+		uint32	FirstMeshlet;
+		uint32	MeshletCount;
+		// Simplification error in local space units, 0 for LOD 0
+		float	Error;
+	};
+
+	struct MeshLODIndices
+	{
+		std::vector<uint32> Indices;
+		float				Error;
+	};
+
+	// Simplifies a mesh into the LODs after LOD 0, with errors that never decrease from one LOD to the next.
+	// It stops early when the error gets too big for the mesh extents or when the mesh does not get any simpler.
+	void BuildMeshLODs(const uint32* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t positionStride, std::vector<MeshLODIndices>& outLODs);
+
+	// Everything a view needs to pick the LODs
+	struct MeshLODView
+	{
+		float3	Eye;
+		float	FovY; // in radians
+		float	ScreenHeight;
+		// How big the simplification error can get on screen, in pixels
+		float	MaxPixelError = 1.0f;
+	};
+
+	// Picks the coarsest LOD whose error, projected at the closest point of the mesh bounding sphere, stays under the view pixel error.
+	// The bounding sphere and the LOD errors are in local space.
+	uint32 SelectMeshLOD(const MeshLOD* lods, uint32 numLODs, const float4& boundingSphere, const float4x4& transform, const MeshLODView& view);
+}
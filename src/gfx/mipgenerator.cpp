@@ -0,0 +1,370 @@
+#include "stdafx.h"
+#include "mipgenerator.h"
+#include "core/jobsystem.h"
+
+#include <xmmintrin.h>
+#include <cmath>
+
+namespace limbo::Gfx::MipGenerator
+{
+	namespace
+	{
+		// Destination rows filtered by each job
+		constexpr uint32 RowsPerJob = 8;
+		constexpr uint32 LinearToSRGBTableSize = 4096;
+
+		float DecodeSRGB(float value)
+		{
+			return value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+		}
+
+		float EncodeSRGB(float value)
+		{
+			return value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+		}
+
+		// Lookup tables so the conversions do not call powf per texel
+		struct ColorTables
+		{
+			float UnormToFloat[256];
+			float SRGBToLinear[256];
+			uint8 LinearToSRGB[LinearToSRGBTableSize];
+
+			ColorTables()
+			{
+				for (uint32 i = 0; i < 256; ++i)
+				{
+					UnormToFloat[i] = (float)i / 255.0f;
+					SRGBToLinear[i] = DecodeSRGB(UnormToFloat[i]);
+				}
+
+				for (uint32 i = 0; i < LinearToSRGBTableSize; ++i)
+					LinearToSRGB[i] = (uint8)(EncodeSRGB((float)i / (LinearToSRGBTableSize - 1)) * 255.0f + 0.5f);
+			}
+		};
+
+		const ColorTables& GetColorTables()
+		{
+			static const ColorTables tables;
+			return tables;
+		}
+
+		float Sinc(float x)
+		{
+			if (fabsf(x) < 1e-5f)
+				return 1.0f;
+			x *= Math::PI;
+			return sinf(x) / x;
+		}
+
+		// Zeroth order modified Bessel function of the first kind
+		float BesselI0(float x)
+		{
+			float sum = 1.0f;
+			float term = 1.0f;
+			const float halfX = x * 0.5f;
+			for (uint32 k = 1; k < 32 && term > sum * 1e-8f; ++k)
+			{
+				const float factor = halfX / (float)k;
+				term *= factor * factor;
+				sum += term;
+			}
+			return sum;
+		}
+
+		float GetFilterRadius(MipFilter filter)
+		{
+			switch (filter)
+			{
+			case MipFilter::Kaiser:		return 3.0f;
+			case MipFilter::Lanczos:	return 2.0f;
+			case MipFilter::Box:
+			default:
+				return 0.5f;
+			}
+		}
+
+		// t is the distance to the destination texel center, in destination texels
+		float EvaluateFilter(MipFilter filter, float t)
+		{
+			const float radius = GetFilterRadius(filter);
+			switch (filter)
+			{
+			case MipFilter::Kaiser:
+			{
+				constexpr float alpha = 4.0f;
+				if (fabsf(t) >= radius)
+					return 0.0f;
+				const float r = t / radius;
+				return Sinc(t) * BesselI0(alpha * sqrtf(1.0f - r * r)) / BesselI0(alpha);
+			}
+			case MipFilter::Lanczos:
+				if (fabsf(t) >= radius)
+					return 0.0f;
+				return Sinc(t) * Sinc(t / radius);
+			case MipFilter::Box:
+			default:
+				return fabsf(t) <= radius ? 1.0f : 0.0f;
+			}
+		}
+
+		// Weights of a 1D filter, every destination texel reads TapCount source texels starting at First.
+		// First can be outside of the image, the reads are clamped to the edge.
+		struct FilterTaps
+		{
+			std::vector<int32>	First;
+			std::vector<float>	Weights;
+			uint32				TapCount = 0;
+		};
+
+		void BuildFilterTaps(MipFilter filter, uint32 srcSize, uint32 dstSize, FilterTaps& taps)
+		{
+			const float scale = (float)srcSize / (float)dstSize;
+			const float support = GetFilterRadius(filter) * scale;
+
+			taps.TapCount = (uint32)ceilf(support * 2.0f) + 1;
+			taps.First.resize(dstSize);
+			taps.Weights.resize((size_t)dstSize * taps.TapCount);
+
+			for (uint32 dst = 0; dst < dstSize; ++dst)
+			{
+				const float center = ((float)dst + 0.5f) * scale;
+				const int32 first = (int32)floorf(center - support);
+				taps.First[dst] = first;
+
+				float* weights = &taps.Weights[(size_t)dst * taps.TapCount];
+				float sum = 0.0f;
+				for (uint32 k = 0; k < taps.TapCount; ++k)
+				{
+					const float distance = ((float)(first + (int32)k) + 0.5f - center) / scale;
+					weights[k] = EvaluateFilter(filter, distance);
+					sum += weights[k];
+				}
+
+				// Normalize so flat areas stay flat, the negative lobes can make the sum drift away from 1
+				if (fabsf(sum) > 1e-6f)
+				{
+					for (uint32 k = 0; k < taps.TapCount; ++k)
+						weights[k] /= sum;
+				}
+				else
+				{
+					memset(weights, 0, sizeof(float) * taps.TapCount);
+					weights[Math::Min((uint32)Math::Max(0, (int32)center - first), taps.TapCount - 1)] = 1.0f;
+				}
+			}
+		}
+
+		void StoreTexel(__m128 color, const MipSettings& settings, const ColorTables& tables, uint8* dst)
+		{
+			float c[4];
+			_mm_storeu_ps(c, color);
+
+			if (settings.bNormalMap)
+			{
+				float x = c[0] * 2.0f - 1.0f;
+				float y = c[1] * 2.0f - 1.0f;
+				float z = c[2] * 2.0f - 1.0f;
+				const float length = sqrtf(x * x + y * y + z * z);
+				if (length > 1e-6f)
+				{
+					x /= length;
+					y /= length;
+					z /= length;
+				}
+				else
+				{
+					x = 0.0f;
+					y = 0.0f;
+					z = 1.0f;
+				}
+				c[0] = x * 0.5f + 0.5f;
+				c[1] = y * 0.5f + 0.5f;
+				c[2] = z * 0.5f + 0.5f;
+			}
+
+			for (uint32 i = 0; i < 4; ++i)
+				c[i] = Math::Min(Math::Max(c[i], 0.0f), 1.0f);
+
+			for (uint32 i = 0; i < 3; ++i)
+			{
+				if (settings.bSRGB)
+					dst[i] = tables.LinearToSRGB[(uint32)(c[i] * (LinearToSRGBTableSize - 1) + 0.5f)];
+				else
+					dst[i] = (uint8)(c[i] * 255.0f + 0.5f);
+			}
+			dst[3] = (uint8)(c[3] * 255.0f + 0.5f);
+		}
+
+		void GenerateLevel(const uint8* src, uint32 srcWidth, uint32 srcHeight, uint8* dst, uint32 dstWidth, uint32 dstHeight, const MipSettings& settings)
+		{
+			FilterTaps horizontal, vertical;
+			BuildFilterTaps(settings.Filter, srcWidth, dstWidth, horizontal);
+			BuildFilterTaps(settings.Filter, srcHeight, dstHeight, vertical);
+
+			const ColorTables& tables = GetColorTables();
+			const float* colorToLinear = settings.bSRGB ? tables.SRGBToLinear : tables.UnormToFloat;
+
+			// Each job filters a band of destination rows. The source rows the band needs are filtered horizontally into a
+			// small scratch buffer first, so the whole level never has to be kept in floating point.
+			const uint32 numBands = Math::DivideAndRoundUp(dstHeight, RowsPerJob);
+			Core::JobContext context;
+			Core::JobSystem::ExecuteMany(context, numBands, 1, Core::TOnJobSystemExecuteMany::CreateLambda([&](Core::JobDispatchArgs args)
+			{
+				const uint32 firstRow = args.jobIndex * RowsPerJob;
+				const uint32 lastRow = Math::Min(firstRow + RowsPerJob, dstHeight) - 1;
+				const int32 firstSourceRow = vertical.First[firstRow];
+				const uint32 numSourceRows = (uint32)(vertical.First[lastRow] - firstSourceRow) + vertical.TapCount;
+
+				std::vector<__m128> linearRow(srcWidth);
+				std::vector<__m128> rows((size_t)numSourceRows * dstWidth);
+				for (uint32 r = 0; r < numSourceRows; ++r)
+				{
+					const int32 sourceY = Math::Min(Math::Max(firstSourceRow + (int32)r, 0), (int32)srcHeight - 1);
+					const uint8* sourceRow = src + (uint64)sourceY * srcWidth * 4;
+					for (uint32 x = 0; x < srcWidth; ++x)
+					{
+						const uint8* texel = sourceRow + x * 4;
+						linearRow[x] = _mm_set_ps(tables.UnormToFloat[texel[3]], colorToLinear[texel[2]], colorToLinear[texel[1]], colorToLinear[texel[0]]);
+					}
+
+					__m128* filteredRow = &rows[(size_t)r * dstWidth];
+					for (uint32 x = 0; x < dstWidth; ++x)
+					{
+						const float* weights = &horizontal.Weights[(size_t)x * horizontal.TapCount];
+						const int32 first = horizontal.First[x];
+						__m128 sum = _mm_setzero_ps();
+						for (uint32 k = 0; k < horizontal.TapCount; ++k)
+						{
+							const int32 sourceX = Math::Min(Math::Max(first + (int32)k, 0), (int32)srcWidth - 1);
+							sum = _mm_add_ps(sum, _mm_mul_ps(linearRow[sourceX], _mm_set1_ps(weights[k])));
+						}
+						filteredRow[x] = sum;
+					}
+				}
+
+				for (uint32 y = firstRow; y <= lastRow; ++y)
+				{
+					const float* weights = &vertical.Weights[(size_t)y * vertical.TapCount];
+					const __m128* firstFilteredRow = &rows[(size_t)(vertical.First[y] - firstSourceRow) * dstWidth];
+					uint8* dstRow = dst + (uint64)y * dstWidth * 4;
+					for (uint32 x = 0; x < dstWidth; ++x)
+					{
+						__m128 sum = _mm_setzero_ps();
+						for (uint32 k = 0; k < vertical.TapCount; ++k)
+							sum = _mm_add_ps(sum, _mm_mul_ps(firstFilteredRow[(size_t)k * dstWidth + x], _mm_set1_ps(weights[k])));
+						StoreTexel(sum, settings, tables, dstRow + x * 4);
+					}
+				}
+			}));
+			Core::JobSystem::Wait(context);
+		}
+
+		// Scales the alpha of the level so the fraction of texels above the cutoff matches the top level, otherwise
+		// alpha tested geometry gets thinner on every mip as the filtered alpha averages towards the cutoff
+		void ScaleAlphaToCoverage(uint8* rgba, uint32 width, uint32 height, float alphaCutoff, float targetCoverage)
+		{
+			uint32 histogram[256] = {};
+			const uint64 numTexels = (uint64)width * height;
+			for (uint64 i = 0; i < numTexels; ++i)
+				histogram[rgba[i * 4 + 3]]++;
+
+			auto scaleAlpha = [](uint32 alpha, float scale)
+			{
+				return (uint8)Math::Min((float)alpha * scale + 0.5f, 255.0f);
+			};
+
+			auto getCoverage = [&](float scale)
+			{
+				uint64 count = 0;
+				for (uint32 alpha = 0; alpha < 256; ++alpha)
+				{
+					if ((float)scaleAlpha(alpha, scale) >= alphaCutoff * 255.0f)
+						count += histogram[alpha];
+				}
+				return (float)count / (float)numTexels;
+			};
+
+			// The coverage only changes in steps of a histogram bin, so keep the closest scale instead of the last one
+			float minScale = 0.0f;
+			float maxScale = 4.0f;
+			float scale = 1.0f;
+			float bestScale = 1.0f;
+			float bestError = FLT_MAX;
+			for (uint32 iteration = 0; iteration < 16; ++iteration)
+			{
+				const float coverage = getCoverage(scale);
+				const float error = fabsf(coverage - targetCoverage);
+				if (error < bestError)
+				{
+					bestError = error;
+					bestScale = scale;
+				}
+
+				if (coverage < targetCoverage)
+					minScale = scale;
+				else if (coverage > targetCoverage)
+					maxScale = scale;
+				else
+					break;
+				scale = (minScale + maxScale) * 0.5f;
+			}
+
+			for (uint64 i = 0; i < numTexels; ++i)
+				rgba[i * 4 + 3] = scaleAlpha(rgba[i * 4 + 3], bestScale);
+		}
+	}
+
+	uint64 GetMipChainSize(uint32 width, uint32 height, uint16 mipLevels)
+	{
+		uint64 size = 0;
+		for (uint16 mip = 0; mip < mipLevels; ++mip)
+			size += (uint64)Math::Max(1u, width >> mip) * Math::Max(1u, height >> mip) * 4;
+		return size;
+	}
+
+	void GenerateMipChain(const uint8* rgba, uint32 width, uint32 height, uint16 mipLevels, const MipSettings& settings, uint8* dst)
+	{
+		if (mipLevels == 0)
+			return;
+
+		memcpy(dst, rgba, (uint64)width * height * 4);
+
+		const bool bPreserveCoverage = settings.AlphaCutoff >= 0.0f;
+		const float coverage = bPreserveCoverage ? GetAlphaCoverage(rgba, width, height, settings.AlphaCutoff) : 0.0f;
+
+		const uint8* previous = dst;
+		uint32 previousWidth = width;
+		uint32 previousHeight = height;
+		uint8* level = dst + (uint64)width * height * 4;
+		for (uint16 mip = 1; mip < mipLevels; ++mip)
+		{
+			const uint32 levelWidth = Math::Max(1u, width >> mip);
+			const uint32 levelHeight = Math::Max(1u, height >> mip);
+			GenerateLevel(previous, previousWidth, previousHeight, level, levelWidth, levelHeight, settings);
+
+			if (bPreserveCoverage)
+				ScaleAlphaToCoverage(level, levelWidth, levelHeight, settings.AlphaCutoff, coverage);
+
+			previous = level;
+			previousWidth = levelWidth;
+			previousHeight = levelHeight;
+			level += (uint64)levelWidth * levelHeight * 4;
+		}
+	}
+
+	float GetAlphaCoverage(const uint8* rgba, uint32 width, uint32 height, float alphaCutoff)
+	{
+		const uint64 numTexels = (uint64)width * height;
+		if (numTexels == 0)
+			return 0.0f;
+
+		uint64 count = 0;
+		for (uint64 i = 0; i < numTexels; ++i)
+		{
+			if ((float)rgba[i * 4 + 3] >= alphaCutoff * 255.0f)
+				count++;
+		}
+		return (float)count / (float)numTexels;
+	}
+}
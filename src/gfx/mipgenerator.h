@@ -0,0 +1,37 @@
+#pragma once
+
+#include "core/core.h"
+
+namespace limbo::Gfx::MipGenerator
+{
+	enum class MipFilter : uint8
+	{
+		// 2x2 average, the cheapest but also the blurriest
+		Box = 0,
+		// Kaiser windowed sinc, width 3 and alpha 4
+		Kaiser,
+		// Lanczos with 2 lobes
+		Lanczos,
+	};
+
+	struct MipSettings
+	{
+		MipFilter	Filter = MipFilter::Kaiser;
+		// Filter in linear space, the color channels are stored in sRGB
+		bool		bSRGB = false;
+		// The rgb channels are a tangent space normal, every texel is renormalized after filtering
+		bool		bNormalMap = false;
+		// Alpha tested materials keep the same fraction of texels above the cutoff on every level, negative disables it
+		float		AlphaCutoff = -1.0f;
+	};
+
+	// Size of the whole RGBA8 chain tightly packed, this is the layout used by RHI::CreateTexture and by DDS files
+	uint64 GetMipChainSize(uint32 width, uint32 height, uint16 mipLevels);
+
+	// Writes every level of the RGBA8 image into dst, the first level is a copy of the source.
+	// Each level is filtered from the previous one, with its rows split over the job system. It is safe to call this from a job.
+	void GenerateMipChain(const uint8* rgba, uint32 width, uint32 height, uint16 mipLevels, const MipSettings& settings, uint8* dst);
+
+	// Fraction of the texels with an alpha above the cutoff. Exposed for testing.
+	float GetAlphaCoverage(const uint8* rgba, uint32 width, uint32 height, float alphaCutoff);
+}
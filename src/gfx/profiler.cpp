@@ -36,8 +36,9 @@ namespace limbo
 	{
 		std::string Name;
 
-		int64		StartTime;
-		int64		EndTime;
+		// GPU: query timestamps, CPU: raw Core::Timestamp ticks
+		uint64		StartTime;
+		uint64		EndTime;
 
 		static constexpr uint64 FilterSize = 64;
 		double TimeSamples[FilterSize] = { };
@@ -48,6 +49,13 @@ namespace limbo
 	std::vector<ProfileData> GPUProfiles;
 	std::vector<ProfileData> CPUProfiles;
 
+	struct CounterData
+	{
+		std::string Name;
+		uint64		Value;
+	};
+	std::vector<CounterData> CPUCounters;
+
 	//
 	// GPU
 	//
@@ -236,7 +244,7 @@ namespace limbo
 
 		ProfileData& data = CPUProfiles[profileIndex];
 		data.Name			= name;
-		data.StartTime		= (int64)(m_Timer.ElapsedMilliseconds() * 1000);
+		data.StartTime		= Core::Timestamp::Now();
 	}
 
 	void CPUProfiler::EndProfile(const char* name)
@@ -257,7 +265,24 @@ namespace limbo
 		check(profileIndex != -1);
 
 		ProfileData& data = CPUProfiles[profileIndex];
-		data.EndTime = (int64)(m_Timer.ElapsedMilliseconds() * 1000);
+		data.EndTime = Core::Timestamp::Now();
+	}
+
+	void CPUProfiler::SetCounter(const char* name, uint64 value)
+	{
+#if LB_RELEASE // don't run the profiler stuff in release mode
+		return;
+#endif
+
+		for (CounterData& counter : CPUCounters)
+		{
+			if (counter.Name == name)
+			{
+				counter.Value = value;
+				return;
+			}
+		}
+		CPUCounters.push_back({ name, value });
 	}
 
 	void CPUProfiler::EndFrame()
@@ -276,8 +301,11 @@ namespace limbo
 		{
 			ProfileData& profileData = CPUProfiles[profileIndex];
 
+			// Remove the cost of reading the timestamp itself, so tiny scopes are not dominated by the timer
+			const uint64 overhead = Core::Timestamp::Overhead();
 			uint64 delta = profileData.EndTime - profileData.StartTime;
-			double time = double(delta) / 1000.0f;
+			delta = delta > overhead ? delta - overhead : 0;
+			double time = Core::Timestamp::ToMilliseconds((int64)delta);
 
 			profileData.TimeSamples[profileData.CurrentSample] = time;
 			profileData.CurrentSample = (profileData.CurrentSample + 1) % ProfileData::FilterSize;
@@ -314,6 +342,13 @@ namespace limbo
 			for (const OrderedData& data : orderedData)
 				ImGui::Text("%s: %.2fms", data.Name, data.Time);
 
+			if (!CPUCounters.empty())
+			{
+				ImGui::SeparatorText("Counters");
+				for (const CounterData& counter : CPUCounters)
+					ImGui::Text("%s: %llu", counter.Name.c_str(), counter.Value);
+			}
+
 			ImGui::End();
 		}
 	}
@@ -40,7 +40,6 @@ namespace limbo
 	class CPUProfiler
 	{
 	private:
-		Core::Timer m_Timer;
 		double		m_AvgRenderTime = 0;
 
 	public:
@@ -50,6 +49,9 @@ namespace limbo
 		void StartProfile(const char* name);
 		void EndProfile(const char* name);
 
+		// Value shown next to the times until it is set again, for things like the number of culled objects
+		void SetCounter(const char* name, uint64 value);
+
 		double GetRenderTime() const
 		{
 			return m_AvgRenderTime;
@@ -129,6 +131,7 @@ namespace limbo
 #define PROFILE_CPU_SCOPE(Name) limbo::ScopedProfile<CPUProfiler> MACRO_CONCAT(__s__, __COUNTER__)(Name)
 #define PROFILE_CPU_BEGIN(Name) limbo::GCPUProfiler.StartProfile(Name)
 #define PROFILE_CPU_END(Name)   limbo::GCPUProfiler.EndProfile(Name)
+#define PROFILE_COUNTER(Name, Value) limbo::GCPUProfiler.SetCounter(Name, Value)
 
 // Both
 #define PROFILE_SCOPE(CommandContext, Name) PROFILE_CPU_SCOPE(Name); PROFILE_GPU_SCOPE(CommandContext, Name)
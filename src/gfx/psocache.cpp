@@ -3,6 +3,7 @@
 
 #include "shaderinterop.h"
 #include "shaderscache.h"
+#include "indirectcommands.h"
 #include "core/timer.h"
 #include "rhi/device.h"
 #include "rhi/resourcemanager.h"
@@ -11,6 +12,7 @@ namespace limbo::Gfx::PSOCache
 {
 	std::unordered_map<PipelineID, RHI::PSOHandle> s_Pipelines;
 	std::vector<RHI::RootSignatureHandle> s_RootSignatures;
+	std::unordered_map<PipelineID, std::unique_ptr<RHI::CommandSignature>> s_CommandSignatures;
 
 	void CompilePSOs()
 	{
@@ -34,7 +36,7 @@ namespace limbo::Gfx::PSOCache
 		{
 			RHI::RootSignatureHandle& rs = s_RootSignatures.emplace_back();
 			rs = RHI::CreateRootSignature("Deferred Shading RS", RHI::RSSpec().Init()
-										  .AddRootConstants(0, 1)
+										  .AddRootConstants(0, 2)
 										  .AddRootCBV(100));
 
 			constexpr RHI::Format deferredShadingFormats[] = {
@@ -62,6 +64,18 @@ namespace limbo::Gfx::PSOCache
 				auto meshPSO = RHI::PipelineStateSpec(psoInit).SetMeshShader(ShadersCache::Get(ShaderID::MS_GBuffer));
 				s_Pipelines[PipelineID::DeferredShading_Mesh] = RHI::CreatePSO(meshPSO);
 			}
+
+			// Every command sets the instance ID and the first meshlet of its LOD
+			s_CommandSignatures[PipelineID::DeferredShading] = std::make_unique<RHI::CommandSignature>("Deferred Shading CS", RHI::CommandSignatureSpec().Init()
+				.AddConstants(0, 2)
+				.AddIndexBufferView()
+				.AddDrawIndexed()
+				.SetByteStride(sizeof(IndirectDrawIndexedCommand)), rs);
+
+			s_CommandSignatures[PipelineID::DeferredShading_Mesh] = std::make_unique<RHI::CommandSignature>("Deferred Shading Mesh CS", RHI::CommandSignatureSpec().Init()
+				.AddConstants(0, 2)
+				.AddDispatchMesh()
+				.SetByteStride(sizeof(IndirectDispatchMeshCommand)), rs);
 		}
 
 		// Sky
@@ -78,7 +92,7 @@ namespace limbo::Gfx::PSOCache
 				.SetRootSignature(rs)
 				.SetRenderTargetFormats({ RHI::Format::RGBA16_FLOAT }, RHI::Format::UNKNOWN)
 				.SetDepthStencilDesc(RHI::TStaticDepthStencilState<false>::GetRHI())
-				.SetInputLayout({ { "Position", 0, DXGI_FORMAT_R32G32B32_FLOAT } })
+				.SetInputLayout({ { "Position", 0, DXGI_FORMAT_R16G16B16A16_UNORM } })
 				.SetName("Skybox PSO");
 			s_Pipelines[PipelineID::Skybox] = RHI::CreatePSO(psoInit);
 		}
@@ -188,6 +202,13 @@ namespace limbo::Gfx::PSOCache
 				.SetRasterizerDesc(RHI::TStaticRasterizerState<D3D12_FILL_MODE_SOLID, D3D12_CULL_MODE_FRONT, true, 7500, 1.0f, 0.0f, false>::GetRHI())
 				.SetName("Shadow Map PSO");
 			s_Pipelines[PipelineID::ShadowMapping] = RHI::CreatePSO(psoInit);
+
+			// Every command sets the cascade and the instance ID
+			s_CommandSignatures[PipelineID::ShadowMapping] = std::make_unique<RHI::CommandSignature>("Shadow Map CS", RHI::CommandSignatureSpec().Init()
+				.AddConstants(2, 2)
+				.AddIndexBufferView()
+				.AddDrawIndexed()
+				.SetByteStride(sizeof(IndirectDrawIndexedCommand)), rs);
 		}
 
 		// SSAO
@@ -296,6 +317,8 @@ namespace limbo::Gfx::PSOCache
 
 	void DestroyPSOs()
 	{
+		s_CommandSignatures.clear();
+
 		for (uint8 i = 0; i < ENUM_COUNT<PipelineID>(); ++i)
 		{
 			if (!ensure(s_Pipelines.contains((PipelineID)i))) continue;
@@ -314,4 +337,10 @@ namespace limbo::Gfx::PSOCache
 		ENSURE_RETURN(!s_Pipelines.contains(pipelineID), RHI::PSOHandle());
 		return s_Pipelines[pipelineID];
 	}
+
+	const RHI::CommandSignature* GetCommandSignature(PipelineID pipelineID)
+	{
+		ENSURE_RETURN(!s_CommandSignatures.contains(pipelineID), nullptr);
+		return s_CommandSignatures[pipelineID].get();
+	}
 }
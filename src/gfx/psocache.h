@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include "rhi/pipelinestateobject.h"
+#include "rhi/commandsignature.h"
 
 namespace limbo::Gfx
 {
@@ -33,5 +34,7 @@ namespace limbo::Gfx
 		void DestroyPSOs();
 
 		RHI::PSOHandle Get(PipelineID pipelineID);
+		// Only the pipelines that draw with ExecuteIndirect() have one, it matches their root signature
+		const RHI::CommandSignature* GetCommandSignature(PipelineID pipelineID);
 	}
 }
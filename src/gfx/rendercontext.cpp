@@ -4,6 +4,9 @@
 #include "profiler.h"
 #include "psocache.h"
 #include "scene.h"
+#include "sharedtextures.h"
+#include "core/input.h"
+#include "core/commandline.h"
 #include "core/jobsystem.h"
 #include "core/paths.h"
 #include "core/utils.h"
@@ -54,8 +57,68 @@ namespace limbo::Gfx
 		int				SelectedEnvMapIdx = 1;
 	}
 
+	namespace
+	{
+		float BytesToMB(uint64 bytes)
+		{
+			return bytes / (1024.0f * 1024.0f);
+		}
+
+		void DrawSceneReport(const SceneReport& report)
+		{
+			ImGui::Text("%u meshes, %u geometries, %u nodes, %u materials%s", report.NumMeshes, report.NumGeometries, report.NumNodes, report.NumMaterials, report.bFromCache ? ", from cache" : "");
+			ImGui::Text("Geometry: %.2fMB - vertices %.2fMB, indices %.2fMB, meshlets %.2fMB", BytesToMB(report.GetGeometryBytes()), BytesToMB(report.VertexBytes), BytesToMB(report.IndexBytes), BytesToMB(report.MeshletBytes));
+			ImGui::Text("Textures: %u (%u shared) - %.2fMB, %.2fMB resident at load", report.NumTextures, report.NumSharedTextures, BytesToMB(report.GetTextureBytes()), BytesToMB(report.GetResidentTextureBytes()));
+			ImGui::Text("BLAS: %u - %.2fMB", report.NumBLASes, BytesToMB(report.BLASBytes));
+
+			if (!report.TextureFormats.empty() && ImGui::BeginTable("##textureformats", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit))
+			{
+				ImGui::TableSetupColumn("Format");
+				ImGui::TableSetupColumn("Count");
+				ImGui::TableSetupColumn("Total MB");
+				ImGui::TableSetupColumn("Mip 0 MB");
+				ImGui::TableHeadersRow();
+				for (const SceneTextureFormatReport& format : report.TextureFormats)
+				{
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn(); ImGui::Text("%s", format.Format.c_str());
+					ImGui::TableNextColumn(); ImGui::Text("%u", format.NumTextures);
+					ImGui::TableNextColumn(); ImGui::Text("%.2f", BytesToMB(format.TotalBytes));
+					ImGui::TableNextColumn(); ImGui::Text("%.2f", BytesToMB(format.MipBytes.empty() ? 0 : format.MipBytes[0]));
+				}
+				ImGui::EndTable();
+			}
+
+			if (!report.LargestGeometries.empty() && ImGui::BeginTable("##largestgeometries", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit))
+			{
+				ImGui::TableSetupColumn("Geometry");
+				ImGui::TableSetupColumn("Instances");
+				ImGui::TableSetupColumn("Vertices");
+				ImGui::TableSetupColumn("Triangles");
+				ImGui::TableSetupColumn("MB");
+				ImGui::TableHeadersRow();
+				for (const SceneGeometryReport& geometry : report.LargestGeometries)
+				{
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn(); ImGui::Text("%u", geometry.GeometryIndex);
+					ImGui::TableNextColumn(); ImGui::Text("%u", geometry.NumInstances);
+					ImGui::TableNextColumn(); ImGui::Text("%llu", geometry.NumVertices);
+					ImGui::TableNextColumn(); ImGui::Text("%llu", geometry.NumTriangles);
+					ImGui::TableNextColumn(); ImGui::Text("%.2f", BytesToMB(geometry.GetTotalBytes()));
+				}
+				ImGui::EndTable();
+			}
+
+			for (const SceneStageTime& stage : report.Stages)
+				ImGui::Text("%s: %.1fms", stage.Name, stage.Milliseconds);
+			ImGui::Text("Load: %.1fms", report.LoadMilliseconds);
+		}
+	}
+
 	RenderContext::RenderContext(Core::Window* window)
-		: Window(window)
+		: m_MaterialsTable("ScenesMaterials", 256)
+		, m_InstancesTable("SceneInstances", 4096)
+		, Window(window)
 		, Camera(CreateCamera(window, float3(0.0f, 1.0f, 4.0f), float3(0.0f, 0.0f, -1.0f)))
 		, Light({.Position = float3(0.0f, 0.5f, 0.0f), .Color = float3(1, 0.45f, 0) })
 		, Sun({ 0.5f, 12.0f, 2.0f }, 1.0f)
@@ -100,6 +163,7 @@ namespace limbo::Gfx
 
 	RenderContext::~RenderContext()
 	{
+		m_SceneLoads.clear();
 		DestroySceneTextures();
 
 		RHI::DestroyTexture(SceneTextures.EnvironmentCubemap);
@@ -107,14 +171,12 @@ namespace limbo::Gfx
 		RHI::DestroyTexture(SceneTextures.PrefilterMap);
 		RHI::DestroyTexture(SceneTextures.BRDFLUTMap);
 
-		DestroyBuffer(m_ScenesMaterials);
-		DestroyBuffer(m_SceneInstances);
-
+		TextureStreaming.Clear();
 		for (Scene* scene : m_Scenes)
 			DestroyScene(scene);
 	}
 
-	std::vector<RHI::TextureHandle> RenderContext::GetGBufferTextures() const
+	RenderContext::GBufferTextureList RenderContext::GetGBufferTextures() const
 	{
 		return {
 			SceneTextures.GBufferRenderTargetA,
@@ -217,6 +279,18 @@ namespace limbo::Gfx
 		ImGui::SetNextWindowBgAlpha(0.7f);
 		ImGui::Begin("Limbo##debugwindow", nullptr);
 		{
+			if (!m_SceneLoads.empty() && ImGui::CollapsingHeader("Loading Scenes", ImGuiTreeNodeFlags_DefaultOpen))
+			{
+				for (const std::unique_ptr<AsyncSceneLoad>& load : m_SceneLoads)
+				{
+					char filename[MAX_PATH];
+					Paths::GetFilename(load->GetPath(), filename);
+					ImGui::ProgressBar(load->GetProgress(), ImVec2(200.0f, 0.0f), load->GetStageName());
+					ImGui::SameLine();
+					ImGui::Text("%s", filename);
+				}
+			}
+
 			if (ImGui::CollapsingHeader("Rendering", ImGuiTreeNodeFlags_DefaultOpen))
 			{
 				ImGui::PushItemWidth(200.0f);
@@ -293,6 +367,68 @@ namespace limbo::Gfx
 					bResetAccumulationBuffer = true;
 			}
 
+			if (ImGui::CollapsingHeader("Picking"))
+			{
+				if (m_PickedMesh != ~0u)
+				{
+					const Scene* scene = m_Scenes[m_PickedScene];
+					const Math::AABB& bounds = scene->GetMeshBounds(m_PickedMesh);
+					ImGui::Text("Scene: %u, Mesh: %u, Distance: %.2f", m_PickedScene, m_PickedMesh, m_PickedDistance);
+					ImGui::Text("Min: %.1f, %.1f, %.1f", bounds.Min.x, bounds.Min.y, bounds.Min.z);
+					ImGui::Text("Max: %.1f, %.1f, %.1f", bounds.Max.x, bounds.Max.y, bounds.Max.z);
+
+					const uint32 materialIndex = scene->GetMesh(m_PickedMesh).LocalMaterialIndex;
+					Material material = scene->Materials[materialIndex];
+					bool bMaterialChanged = ImGui::ColorEdit4("Base Color", &material.BaseColorFactor[0]);
+					bMaterialChanged |= ImGui::SliderFloat("Roughness", &material.RoughnessFactor, 0.0f, 1.0f);
+					bMaterialChanged |= ImGui::SliderFloat("Metallic", &material.MetallicFactor, 0.0f, 1.0f);
+					bMaterialChanged |= ImGui::ColorEdit3("Emissive", &material.EmissiveFactor[0]);
+					if (bMaterialChanged)
+						SetMaterial(m_PickedScene, materialIndex, material);
+				}
+				else
+				{
+					ImGui::Text("Left click a mesh to pick it");
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Scene Tables"))
+			{
+				ImGui::Text("Materials: %u / %u slots, %u uploaded", m_MaterialsTable.NumAllocated(), m_MaterialsTable.GetBuffer().GetCapacity(), m_MaterialsTable.GetBuffer().GetLastUploadCount());
+				ImGui::Text("Instances: %u / %u slots, %u uploaded", m_InstancesTable.NumAllocated(), m_InstancesTable.GetBuffer().GetCapacity(), m_InstancesTable.GetBuffer().GetLastUploadCount());
+
+				const SharedTexturesStats sharedTextures = SharedTextures::GetStats();
+				ImGui::Text("Textures: %u, referenced %u times by the scenes", sharedTextures.NumTextures, sharedTextures.NumReferences);
+			}
+
+			if (!m_Scenes.empty() && ImGui::CollapsingHeader("Scene Reports"))
+			{
+				for (uint32 i = 0; i < (uint32)m_Scenes.size(); ++i)
+				{
+					Scene* scene = m_Scenes[i];
+					const SceneReport& report = scene->GetReport();
+
+					char filename[MAX_PATH];
+					Paths::GetFilename(report.Name.c_str(), filename);
+					ImGui::PushID(i);
+					if (ImGui::TreeNode("##report", "%s - %.1fMB", filename, BytesToMB(report.GetGeometryBytes() + report.GetTextureBytes() + report.BLASBytes)))
+					{
+						if (ImGui::Button("Write JSON"))
+							scene->WriteReport();
+						DrawSceneReport(report);
+						ImGui::TreePop();
+					}
+					ImGui::PopID();
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Texture Streaming"))
+			{
+				ImGui::PushItemWidth(150.0f);
+				TextureStreaming.RenderUI();
+				ImGui::PopItemWidth();
+			}
+
 			ImGui::End();
 		}
 	}
@@ -305,6 +441,8 @@ namespace limbo::Gfx
 			bUpdateRenderer = false;
 		}
 
+		UpdateSceneLoads();
+
 		RHI::CommandContext* cmd = RHI::CommandContext::GetCommandContext();
 
 		{
@@ -322,10 +460,24 @@ namespace limbo::Gfx
 			cmd->EndEvent();
 		}
 
-		SceneAccelerationStructure.Build(cmd, m_Scenes);
+		UpdateSceneTransforms(cmd);
+		UploadSceneTables(cmd);
+		SceneAccelerationStructure.Build(cmd, m_Scenes, m_MovedMeshes);
+
+		PickMesh();
+
+		TextureStreaming.Update(Camera, RenderSize, m_Scenes);
 
 		UpdateSceneInfo();
 
+		for (auto& i : CurrentRenderTechniques)
+		{
+			if (i->ConditionalRender(*this))
+				i->PreRender(*this);
+		}
+
+		CullViews();
+
 		for (auto& i : CurrentRenderTechniques)
 		{
 			if (i->ConditionalRender(*this))
@@ -341,61 +493,184 @@ namespace limbo::Gfx
 
 	void RenderContext::LoadNewScene(const char* path)
 	{
-		m_Scenes.emplace_back(Scene::Load(path));
-		UploadScenesToGPU();
+		m_SceneLoads.emplace_back(std::make_unique<AsyncSceneLoad>(path));
 	}
 
-	void RenderContext::UploadScenesToGPU()
+	void RenderContext::UpdateSceneLoads()
 	{
-		auto appendArrays = [](auto& outArray, const auto& fromArray)
+		PROFILE_CPU_SCOPE("UpdateSceneLoads");
+
+		bool bAddedScenes = false;
+		for (size_t i = 0; i < m_SceneLoads.size();)
 		{
-			outArray.reserve(outArray.capacity() + fromArray.size());
-			outArray.insert(outArray.end(), fromArray.begin(), fromArray.end());
-		};
+			AsyncSceneLoad& load = *m_SceneLoads[i];
+			if (!load.Update())
+			{
+				++i;
+				continue;
+			}
+
+			if (Scene* scene = load.TakeScene())
+			{
+				m_Scenes.emplace_back(scene);
+				TextureStreaming.AddScene(scene);
+				AddSceneToTables(scene);
+				bAddedScenes = true;
 
-		auto uploadArrayToGPU = [](RHI::BufferHandle& buffer, const auto& arr, const char* debugName)
+				if (Core::CommandLine::HasArg(LIMBO_CMD_SCENE_REPORT))
+					scene->WriteReport();
+			}
+			else
+			{
+				LB_WARN("Failed to load %s", load.GetPath());
+			}
+			m_SceneLoads.erase(m_SceneLoads.begin() + i);
+		}
+
+		// The tables only upload the slots of the new scenes, with the other changes of the frame
+		if (bAddedScenes)
 		{
-			if (buffer.IsValid())
-				DestroyBuffer(buffer);
-
-			buffer = RHI::CreateBuffer({
-				.DebugName = debugName,
-				.NumElements = (uint32)arr.size(),
-				.ByteStride = sizeof(arr[0]),
-				.ByteSize = arr.size() * sizeof(arr[0]),
-				.Flags = RHI::BufferUsage::Structured | RHI::BufferUsage::ShaderResourceView,
-				.InitialData = arr.data(),
-			});
-		};
+			SceneAccelerationStructure.InvalidateInstances();
+			m_ScenesVersion++;
+		}
+	}
+
+	void RenderContext::AddSceneToTables(Scene* scene)
+	{
+		SceneSlots& slots = m_SceneSlots.emplace_back();
+		slots.NumMaterials = (uint32)scene->Materials.size();
+		slots.FirstMaterial = m_MaterialsTable.Allocate(slots.NumMaterials);
+		for (uint32 i = 0; i < slots.NumMaterials; ++i)
+			m_MaterialsTable.Edit(slots.FirstMaterial + i) = scene->Materials[i];
+
+		slots.NumInstances = scene->NumMeshes();
+		slots.FirstInstance = m_InstancesTable.Allocate(slots.NumInstances);
+
+		// The per instance arrays are indexed by instance ID, so they follow the size of the table
+		const uint32 numInstanceSlots = m_InstancesTable.GetSize();
+		m_InstanceMeshes.resize(numInstanceSlots, nullptr);
+		m_InstanceBounds.resize(numInstanceSlots);
+		m_DrawInstances.resize(numInstanceSlots);
+		m_Culling.Resize(numInstanceSlots);
+
+		uint32 instanceID = slots.FirstInstance;
+		scene->IterateMeshesNoConst(TOnDrawMeshNoConst::CreateLambda([&](Mesh& mesh)
+		{
+			mesh.InstanceID = instanceID;
+			Instance& instance = m_InstancesTable.Edit(instanceID);
+			instance.LocalTransform				= mesh.Transform;
+			instance.Material					= slots.FirstMaterial + mesh.LocalMaterialIndex;
+			instance.VerticesOffset				= mesh.VerticesLocation.Offset;
+			instance.IndicesOffset				= mesh.IndicesLocation.Offset;
+			instance.MeshletsOffset				= mesh.MeshletsOffset;
+			instance.MeshletsTrianglesOffset	= mesh.MeshletTrianglesOffset;
+			instance.MeshletsVerticesOffset		= mesh.MeshletVerticesOffset;
+			instance.b16BitIndices				= mesh.IndicesLocation.Format == RHI::Format::R16_UINT;
+			instance.PositionOffset				= mesh.PositionOffset;
+			instance.PositionScale				= mesh.PositionScale;
+			instance.BufferIndex				= scene->GetGeometryBuffer()->CBVHandle.Index;
+			m_InstanceMeshes[instanceID] = &mesh;
+			m_InstanceBounds[instanceID] = mesh.WorldBounds;
+			m_DrawInstances[instanceID] = { .Material = instance.Material, .Pass = mesh.bIsOpaque ? DrawPass::Opaque : DrawPass::AlphaTested };
+			m_Culling.UpdateInstance(instanceID, mesh.WorldBounds);
+			instanceID++;
+		}));
+	}
+
+	void RenderContext::UploadSceneTables(RHI::CommandContext* cmd)
+	{
+		PROFILE_CPU_SCOPE("UploadSceneTables");
+
+		m_MaterialsTable.Upload(cmd);
+		m_InstancesTable.Upload(cmd);
+
+		// A table that grew has a new buffer
+		SceneInfo.MaterialsBufferIndex = m_MaterialsTable.GetBuffer().GetDescriptorIndex();
+		SceneInfo.InstancesBufferIndex = m_InstancesTable.GetBuffer().GetDescriptorIndex();
+	}
+
+	void RenderContext::SetMaterial(uint32 sceneIndex, uint32 localMaterialIndex, const Material& material)
+	{
+		check(localMaterialIndex < m_SceneSlots[sceneIndex].NumMaterials);
+		m_Scenes[sceneIndex]->Materials[localMaterialIndex] = material;
+		m_MaterialsTable.Edit(m_SceneSlots[sceneIndex].FirstMaterial + localMaterialIndex) = material;
+		bResetAccumulationBuffer = true;
+	}
+
+	void RenderContext::UpdateSceneTransforms(RHI::CommandContext* cmd)
+	{
+		PROFILE_CPU_SCOPE("UpdateSceneTransforms");
 
-		std::vector<Material> materials;
-		std::vector<Instance> instances;
-		uint32 instanceID = 0;
+		// The scenes and their meshes are walked in order, so the moved meshes come sorted by instance ID
+		m_MovedMeshes.clear();
+		m_MovedInstanceBounds.clear();
 		for (Scene* scene : m_Scenes)
+			scene->UpdateTransforms(m_MovedMeshes);
+
+		if (m_MovedMeshes.empty())
+			return;
+
+		for (const Mesh* mesh : m_MovedMeshes)
 		{
-			scene->IterateMeshesNoConst(TOnDrawMeshNoConst::CreateLambda([&](Mesh& mesh)
-			{
-				mesh.InstanceID = instanceID;
-				Instance& instance = instances.emplace_back();
-				instance.LocalTransform				= mesh.Transform;
-				instance.Material					= (uint32)materials.size() + mesh.LocalMaterialIndex;
-				instance.VerticesOffset				= mesh.VerticesLocation.Offset;
-				instance.IndicesOffset				= mesh.IndicesLocation.Offset;
-				instance.MeshletsOffset				= mesh.MeshletsOffset;
-				instance.MeshletsTrianglesOffset	= mesh.MeshletTrianglesOffset;
-				instance.MeshletsVerticesOffset		= mesh.MeshletVerticesOffset;
-				instance.BufferIndex				= scene->GetGeometryBuffer()->CBVHandle.Index;
-				instanceID++;
-			}));
-
-			appendArrays(materials, scene->Materials);
+			m_InstancesTable.Edit(mesh->InstanceID).LocalTransform = mesh->Transform;
+			m_MovedInstanceBounds.push_back(m_InstanceBounds[mesh->InstanceID]);
+			m_MovedInstanceBounds.push_back(mesh->WorldBounds);
+			m_InstanceBounds[mesh->InstanceID] = mesh->WorldBounds;
+			m_Culling.UpdateInstance(mesh->InstanceID, mesh->WorldBounds);
+		}
+
+		bResetAccumulationBuffer = true;
+	}
+
+	void RenderContext::PickMesh()
+	{
+		if (ImGui::GetIO().WantCaptureMouse || !Input::IsMouseButtonPressed(Window, Input::MouseButton::Left))
+			return;
+
+		PROFILE_CPU_SCOPE("PickMesh");
+
+		const Math::Ray ray = CreateScreenRay(Camera.ViewProj, Camera.Eye, Input::GetMousePos(Window), RenderSize);
+		m_PickedScene = ~0u;
+		m_PickedMesh = ~0u;
+		float closest = FLT_MAX;
+		for (uint32 i = 0; i < (uint32)m_Scenes.size(); ++i)
+		{
+			InstanceBVH::RayHit hit;
+			if (!m_Scenes[i]->GetBVH().Raycast(ray, hit, closest))
+				continue;
+
+			closest = hit.Distance;
+			m_PickedScene = i;
+			m_PickedMesh = hit.Instance;
+			m_PickedDistance = hit.Distance;
+		}
+	}
+
+	void RenderContext::CullViews()
+	{
+		PROFILE_CPU_SCOPE("CullViews");
+
+		// The GBuffer draws with the infinite reversed projection, so nothing is culled by distance
+		m_Culling.SetView(CV_Camera, Camera.ViewRevProj);
+
+		// The shadow pass does not clip the depth, what is between the light and a cascade is flattened on its near plane
+		for (uint32 cascade = 0; cascade < SHADOWMAP_CASCADES; ++cascade)
+		{
+			if (CanRenderShadows())
+				m_Culling.SetView(CV_ShadowCascade0 + cascade, ShadowMapData.LightViewProj[cascade], false);
+			else
+				m_Culling.DisableView(CV_ShadowCascade0 + cascade);
 		}
 
-		uploadArrayToGPU(m_ScenesMaterials, materials, "ScenesMaterials");
-		uploadArrayToGPU(m_SceneInstances,  instances, "SceneInstances");
+		m_Culling.Cull();
 
-		SceneInfo.MaterialsBufferIndex = RM_GET(m_ScenesMaterials)->CBVHandle.Index;
-		SceneInfo.InstancesBufferIndex = RM_GET(m_SceneInstances)->CBVHandle.Index;
+		for (uint32 view = 0; view < CV_Count; ++view)
+		{
+			const std::string viewName = view == CV_Camera ? "Camera" : std::format("Shadow Cascade {}", view - CV_ShadowCascade0);
+			const CullingViewStats stats = m_Culling.GetStats(view);
+			PROFILE_COUNTER(std::format("{} Visible", viewName).c_str(), stats.NumVisible);
+			PROFILE_COUNTER(std::format("{} Culled", viewName).c_str(), stats.NumCulled);
+		}
 	}
 
 	void RenderContext::UpdateSceneInfo()
@@ -420,7 +695,7 @@ namespace limbo::Gfx
 
 	void RenderContext::UpdateRenderer()
 	{
-		CurrentRenderTechniques.clear();
+		CurrentRenderTechniques.Clear();
 
 		CurrentRenderer = Renderer::Create(CurrentRendererString);
 		CurrentRenderTechniques = CurrentRenderer->SetupRenderTechniques();
@@ -482,9 +757,21 @@ namespace limbo::Gfx
 
 	void RenderContext::ClearScenes()
 	{
+		TextureStreaming.Clear();
 		for (Scene* scene : m_Scenes)
 			DestroyScene(scene);
 		m_Scenes.clear();
+		m_SceneSlots.clear();
+		m_MaterialsTable.Clear();
+		m_InstancesTable.Clear();
+		m_InstanceMeshes.clear();
+		m_InstanceBounds.clear();
+		m_DrawInstances.clear();
+		m_Culling.SetInstances({});
+		m_ScenesVersion++;
+		SceneAccelerationStructure.InvalidateInstances();
+		m_PickedScene = ~0u;
+		m_PickedMesh = ~0u;
 	}
 
 	bool RenderContext::HasScenes() const
@@ -497,6 +784,16 @@ namespace limbo::Gfx
 		return m_Scenes;
 	}
 
+	MeshLODView RenderContext::GetMeshLODView(float maxPixelError) const
+	{
+		return {
+			.Eye = Camera.Eye,
+			.FovY = glm::radians(Camera.FOV),
+			.ScreenHeight = (float)RenderSize.y,
+			.MaxPixelError = maxPixelError
+		};
+	}
+
 	bool RenderContext::CanRenderSSAO() const
 	{
 		return Tweaks::CurrentAOTechnique == (int)Tweaks::AmbientOcclusion::SSAO;
@@ -2,6 +2,10 @@
 
 #include "fpscamera.h"
 #include "shaderinterop.h"
+#include "texturestreamer.h"
+#include "viewculling.h"
+#include "drawlist.h"
+#include "gpuscenetable.h"
 #include "core/window.h"
 #include "renderer/renderer.h"
 #include "rhi/accelerationstructure.h"
@@ -23,6 +27,15 @@ namespace limbo::Gfx
 		inline bool bShowShadowCascades = false;
 	};
 
+	// Views of the culling stage, the visible instances of each one are in RenderContext::GetVisibleInstances()
+	enum CullingViews : uint32
+	{
+		CV_Camera = 0,
+		CV_ShadowCascade0,
+		CV_Count = CV_ShadowCascade0 + SHADOWMAP_CASCADES
+	};
+	static_assert(CV_Count <= ViewCulling::MaxViews);
+
 	struct PointLight
 	{
 		float3 Position;
@@ -36,9 +49,11 @@ namespace limbo::Gfx
 	};
 
 	class Scene;
+	class AsyncSceneLoad;
 	class RenderContext
 	{
 		using EnvironmentMapList = TStaticArray<const char*, 7>;
+		using GBufferTextureList = TSmallVector<RHI::TextureHandle, RHI::gRHIMaxRenderTargets>;
 
 		struct SceneTextures
 		{
@@ -69,10 +84,38 @@ namespace limbo::Gfx
 		};
 
 	private:
-		std::vector<Scene*>				m_Scenes;
+		// Ranges of the scene tables that belong to a scene
+		struct SceneSlots
+		{
+			uint32 FirstMaterial;
+			uint32 NumMaterials;
+			uint32 FirstInstance;
+			uint32 NumInstances;
+		};
 
-		RHI::BufferHandle				m_ScenesMaterials;
-		RHI::BufferHandle				m_SceneInstances;
+		std::vector<Scene*>				m_Scenes;
+		// Indexed like m_Scenes
+		std::vector<SceneSlots>			m_SceneSlots;
+		// Added to m_Scenes once they are ready
+		std::vector<std::unique_ptr<AsyncSceneLoad>> m_SceneLoads;
+
+		// The instance IDs and the material indices the shaders see are slots of these tables
+		GPUSceneTable<Material>			m_MaterialsTable;
+		GPUSceneTable<Instance>			m_InstancesTable;
+		std::vector<const Mesh*>		m_MovedMeshes;
+		// Mesh and world box of each instance ID
+		std::vector<const Mesh*>		m_InstanceMeshes;
+		std::vector<Math::AABB>			m_InstanceBounds;
+		std::vector<DrawListInstance>	m_DrawInstances;
+		ViewCulling						m_Culling;
+		// Box before and box after the move of each instance that moved this frame
+		std::vector<Math::AABB>			m_MovedInstanceBounds;
+		uint32							m_ScenesVersion = 0;
+
+		// Mesh under the cursor from the last left click, tested against the mesh boxes of the scene BVHs
+		uint32							m_PickedScene = ~0u;
+		uint32							m_PickedMesh = ~0u;
+		float							m_PickedDistance = 0.0f;
 
 	public:
 		Core::Window*					Window;
@@ -87,6 +130,7 @@ namespace limbo::Gfx
 		SceneInfo						SceneInfo;
 		ShadowData						ShadowMapData;
 		RHI::AccelerationStructure		SceneAccelerationStructure;
+		TextureStreamer					TextureStreaming;
 
 		bool							bUpdateRenderer = false;
 		bool							bNeedsEnvMapChange = true;
@@ -97,17 +141,35 @@ namespace limbo::Gfx
 		RenderContext(Core::Window* window);
 		~RenderContext();
 
-		std::vector<RHI::TextureHandle> GetGBufferTextures() const;
+		GBufferTextureList GetGBufferTextures() const;
 
 		// Update function with the time passed during that frame as a parameter, in ms
 		void Render(float dt);
 
 		// Scene functions
+		// The scene loads in the background and is added at the start of the frame it is ready in
 		void LoadNewScene(const char* path);
 		void ClearScenes();
 		bool HasScenes() const;
 		const std::vector<Scene*>& GetScenes() const;
 
+		// Uploaded with the next frame, only the one material
+		void SetMaterial(uint32 sceneIndex, uint32 localMaterialIndex, const Material& material);
+
+		// Instance IDs that are inside of the view, in instance order
+		const std::vector<uint32>& GetVisibleInstances(uint32 view) const { return m_Culling.GetVisibleInstances(view); }
+		const Mesh& GetInstanceMesh(uint32 instanceID) const { return *m_InstanceMeshes[instanceID]; }
+		// By instance ID, what the draw lists sort the visible instances with
+		Span<DrawListInstance> GetDrawInstances() const { return m_DrawInstances; }
+		Span<Math::AABB> GetInstanceBounds() const { return m_InstanceBounds; }
+		// Two boxes per instance that moved this frame, where it was and where it is now
+		Span<Math::AABB> GetMovedInstanceBounds() const { return m_MovedInstanceBounds; }
+		// Changes every time a scene is loaded or cleared, for the caches that depend on the scene contents
+		uint32 GetScenesVersion() const { return m_ScenesVersion; }
+
+		// LOD selection from the camera, the passes that can live with coarser geometry use a bigger pixel error
+		MeshLODView GetMeshLODView(float maxPixelError) const;
+
 		bool CanRenderSSAO() const;
 		bool CanRenderRTAO() const;
 		bool CanRenderShadows() const;
@@ -115,7 +177,12 @@ namespace limbo::Gfx
 
 	private:
 		void LoadEnvironmentMap(RHI::CommandContext* cmd, const char* path);
-		void UploadScenesToGPU();
+		void UpdateSceneLoads();
+		void AddSceneToTables(Scene* scene);
+		void UploadSceneTables(RHI::CommandContext* cmd);
+		void UpdateSceneTransforms(RHI::CommandContext* cmd);
+		void PickMesh();
+		void CullViews();
 		void UpdateSceneInfo();
 		void UpdateRenderer();
 		void CreateSceneTextures(uint32 width, uint32 height);
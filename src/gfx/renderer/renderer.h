@@ -4,7 +4,7 @@
 
 namespace limbo::Gfx
 {
-	using RenderTechniquesList = std::vector<std::unique_ptr<RenderTechnique>>;
+	using RenderTechniquesList = TSmallVector<std::unique_ptr<RenderTechnique>, 8>;
 
 	enum RendererRequiredFeatures
 	{
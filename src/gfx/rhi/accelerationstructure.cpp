@@ -16,87 +16,101 @@ namespace limbo::RHI
 			DestroyBuffer(m_InstancesBuffer);
 	}
 
-	void AccelerationStructure::Build(CommandContext* cmd, const std::vector<Gfx::Scene*>& scenes)
+	namespace
+	{
+		void SetInstanceTransform(D3D12_RAYTRACING_INSTANCE_DESC& instance, const Gfx::Mesh& mesh)
+		{
+			memcpy(instance.Transform, &glm::transpose(mesh.Transform * mesh.GetPositionDequantization())[0], sizeof(float3x4));
+		}
+	}
+
+	void AccelerationStructure::Build(CommandContext* cmd, const std::vector<Gfx::Scene*>& scenes, Span<const Gfx::Mesh*> movedMeshes)
 	{
 		if (!RHI::GetGPUInfo().bSupportsRaytracing) return;
 
+		// Nothing moved, the TLAS from the last build is still valid
+		const bool bRebuildInstances = m_bInstancesDirty || !m_InstancesBuffer.IsValid();
+		if (!bRebuildInstances && movedMeshes.GetSize() == 0) return;
+
 		Device* device = Device::Ptr;
 		ID3D12Device5* d3ddevice = device->GetDevice();
 
 		cmd->BeginProfileEvent("Build Acceleration Structure");
 
-		bool bUpdateBLAS = false;
-		std::vector<D3D12_RAYTRACING_INSTANCE_DESC> instances;
-		for (Gfx::Scene* scene : scenes)
+		if (bRebuildInstances)
 		{
-			instances.reserve(instances.capacity() + scene->NumMeshes());
-			scene->IterateMeshesNoConst(Gfx::TOnDrawMeshNoConst::CreateLambda([&](Gfx::Mesh& mesh)
+			m_Instances.clear();
+			for (Gfx::Scene* scene : scenes)
 			{
-				if (!mesh.BLAS.IsValid())
+				m_Instances.reserve(m_Instances.capacity() + scene->NumMeshes());
+				scene->IterateMeshesNoConst(Gfx::TOnDrawMeshNoConst::CreateLambda([&](Gfx::Mesh& mesh)
 				{
-					D3D12_RAYTRACING_GEOMETRY_FLAGS geometryFlags = D3D12_RAYTRACING_GEOMETRY_FLAG_NONE;
-					if (mesh.bIsOpaque)
-						geometryFlags |= D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
-					
-					// Describe the geometry.
-					D3D12_RAYTRACING_GEOMETRY_DESC geometry;
-					geometry.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
-					geometry.Triangles.VertexBuffer.StartAddress = mesh.VerticesLocation.BufferLocation;
-					geometry.Triangles.VertexBuffer.StrideInBytes = mesh.VerticesLocation.StrideInBytes;
-					geometry.Triangles.VertexCount = (uint32)mesh.VertexCount;
-					geometry.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
-					geometry.Triangles.IndexBuffer = mesh.IndicesLocation.BufferLocation;
-					geometry.Triangles.IndexFormat = DXGI_FORMAT_R32_UINT;
-					geometry.Triangles.IndexCount = (uint32)mesh.IndexCount;
-					geometry.Triangles.Transform3x4 = 0;
-					geometry.Flags = geometryFlags;
-
-					// Describe the bottom-level acceleration structure inputs.
-					D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS ASInputs = {};
-					ASInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
-					ASInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-					ASInputs.pGeometryDescs = &geometry;
-					ASInputs.NumDescs = 1;
-					ASInputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
-
-					// Get the memory requirements to build the BLAS.
-					D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO ASBuildInfo = {};
-					d3ddevice->GetRaytracingAccelerationStructurePrebuildInfo(&ASInputs, &ASBuildInfo);
-
-					BufferHandle blasScratch = CreateBuffer({
-						.DebugName = "BLAS Scratch Buffer",
-						.ByteSize = ASBuildInfo.ScratchDataSizeInBytes,
-						.Flags = BufferUsage::AccelerationStructure,
-					});
-					BufferHandle blasResult = CreateBuffer({
-						.DebugName = "BLAS Result Buffer",
-						.ByteSize = ASBuildInfo.ResultDataMaxSizeInBytes,
-						.Flags = BufferUsage::AccelerationStructure | BufferUsage::ShaderResourceView,
-					});
-
-					cmd->BuildRaytracingAccelerationStructure(ASInputs, blasScratch, blasResult);
-					cmd->InsertUAVBarrier(blasResult);
-					DestroyBuffer(blasScratch);
-					mesh.BLAS = blasResult;
-					bUpdateBLAS = true;
-				}
-
-				Buffer* pResult = RM_GET(mesh.BLAS);
-
-				// Describe the top-level acceleration structure instance(s).
-				D3D12_RAYTRACING_INSTANCE_DESC& instance = instances.emplace_back();
-				memcpy(instance.Transform, &glm::transpose(mesh.Transform)[0], sizeof(float3x4));
-				instance.InstanceID = 0;
-				instance.InstanceMask = 0xFF;
-				instance.InstanceContributionToHitGroupIndex = 0;
-				instance.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
-				instance.AccelerationStructure = pResult->Resource->GetGPUVirtualAddress();
-			}));
-		}
+					// The meshes that instance the same geometry only add TLAS instances
+					BufferHandle blas = scene->GetBLAS(mesh.GeometryIndex);
+					if (!blas.IsValid())
+					{
+						D3D12_RAYTRACING_GEOMETRY_FLAGS geometryFlags = D3D12_RAYTRACING_GEOMETRY_FLAG_NONE;
+						if (mesh.bIsOpaque)
+							geometryFlags |= D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
+						
+						// Describe the geometry. The positions are the packed unorms, the instance transform takes them to local space.
+						D3D12_RAYTRACING_GEOMETRY_DESC geometry;
+						geometry.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+						geometry.Triangles.VertexBuffer.StartAddress = mesh.VerticesLocation.BufferLocation;
+						geometry.Triangles.VertexBuffer.StrideInBytes = mesh.VerticesLocation.StrideInBytes;
+						geometry.Triangles.VertexCount = (uint32)mesh.VertexCount;
+						geometry.Triangles.VertexFormat = DXGI_FORMAT_R16G16B16A16_UNORM;
+						geometry.Triangles.IndexBuffer = mesh.IndicesLocation.BufferLocation;
+						geometry.Triangles.IndexFormat = D3DFormat(mesh.IndicesLocation.Format);
+						geometry.Triangles.IndexCount = (uint32)mesh.IndexCount;
+						geometry.Triangles.Transform3x4 = 0;
+						geometry.Flags = geometryFlags;
+
+						// Describe the bottom-level acceleration structure inputs.
+						D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS ASInputs = {};
+						ASInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+						ASInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+						ASInputs.pGeometryDescs = &geometry;
+						ASInputs.NumDescs = 1;
+						ASInputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
+
+						// Get the memory requirements to build the BLAS.
+						D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO ASBuildInfo = {};
+						d3ddevice->GetRaytracingAccelerationStructurePrebuildInfo(&ASInputs, &ASBuildInfo);
+
+						BufferHandle blasScratch = CreateBuffer({
+							.DebugName = "BLAS Scratch Buffer",
+							.ByteSize = ASBuildInfo.ScratchDataSizeInBytes,
+							.Flags = BufferUsage::AccelerationStructure,
+						});
+						BufferHandle blasResult = CreateBuffer({
+							.DebugName = "BLAS Result Buffer",
+							.ByteSize = ASBuildInfo.ResultDataMaxSizeInBytes,
+							.Flags = BufferUsage::AccelerationStructure | BufferUsage::ShaderResourceView,
+						});
+
+						cmd->BuildRaytracingAccelerationStructure(ASInputs, blasScratch, blasResult);
+						cmd->InsertUAVBarrier(blasResult);
+						DestroyBuffer(blasScratch);
+						scene->SetBLAS(mesh.GeometryIndex, blasResult);
+						blas = blasResult;
+					}
+
+					Buffer* pResult = RM_GET(blas);
+
+					// Describe the top-level acceleration structure instance(s), in the same order as the scene instances
+					check(mesh.InstanceID == m_Instances.size());
+					D3D12_RAYTRACING_INSTANCE_DESC& instance = m_Instances.emplace_back();
+					SetInstanceTransform(instance, mesh);
+					instance.InstanceID = 0;
+					instance.InstanceMask = 0xFF;
+					instance.InstanceContributionToHitGroupIndex = 0;
+					instance.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
+					instance.AccelerationStructure = pResult->Resource->GetGPUVirtualAddress();
+				}));
+			}
 
-		if (!m_InstancesBuffer.IsValid() || bUpdateBLAS)
-		{
-			// Delete the _old_ buffers if we are updating the instances
+			// Delete the _old_ buffers, the number of instances might have changed
 			if (m_InstancesBuffer.IsValid())
 			{
 				DestroyBuffer(m_InstancesBuffer);
@@ -104,14 +118,26 @@ namespace limbo::RHI
 				DestroyBuffer(m_ScratchBuffer);
 			}
 
-			// Build BLAS instances buffer
+			// Build BLAS instances buffer, it lives on the GPU as only the instances that move are uploaded after this
 			m_InstancesBuffer = CreateBuffer({
 				.DebugName = "BLAS Instances Buffer",
-				.ByteSize = instances.size() * sizeof(D3D12_RAYTRACING_INSTANCE_DESC),
-				.Flags = BufferUsage::Upload,
-				.InitialData = instances.data()
+				.ByteSize = m_Instances.size() * sizeof(D3D12_RAYTRACING_INSTANCE_DESC),
+				.Flags = BufferUsage::Byte,
+				.InitialData = m_Instances.data()
 			});
+			m_bInstancesDirty = false;
+		}
+		else
+		{
+			m_MovedInstances.clear();
+			for (const Gfx::Mesh* mesh : movedMeshes)
+			{
+				SetInstanceTransform(m_Instances[mesh->InstanceID], *mesh);
+				m_MovedInstances.push_back(mesh->InstanceID);
+			}
+			cmd->UpdateBufferElements(RM_GET(m_InstancesBuffer), m_Instances.data(), sizeof(D3D12_RAYTRACING_INSTANCE_DESC), m_MovedInstances);
 		}
+		cmd->InsertResourceBarrier(m_InstancesBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 
 		// Build TLAS
 		// Describe the bottom-level acceleration structure inputs.
@@ -119,10 +145,10 @@ namespace limbo::RHI
 		TLASInput.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
 		TLASInput.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
 		TLASInput.InstanceDescs = RM_GET(m_InstancesBuffer)->Resource->GetGPUVirtualAddress();
-		TLASInput.NumDescs = (uint32)instances.size();
+		TLASInput.NumDescs = (uint32)m_Instances.size();
 		TLASInput.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
 
-		if (!m_TLAS.IsValid() || bUpdateBLAS)
+		if (bRebuildInstances)
 		{
 			// Get the memory requirements to build the BLAS.
 			D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO ASBuildInfo = {};
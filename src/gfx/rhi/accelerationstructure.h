@@ -5,6 +5,7 @@
 namespace limbo::Gfx
 {
 	class Scene;
+	struct Mesh;
 }
 namespace limbo::RHI
 {
@@ -16,11 +17,21 @@ namespace limbo::RHI
 		BufferHandle	m_TLAS;
 		BufferHandle	m_InstancesBuffer;
 
+		// CPU copy of the instances buffer, indexed by the mesh instance ID
+		std::vector<D3D12_RAYTRACING_INSTANCE_DESC>	m_Instances;
+		std::vector<uint32>							m_MovedInstances;
+		bool										m_bInstancesDirty = true;
+
 	public:
 		AccelerationStructure() = default;
 		~AccelerationStructure();
 
-		void Build(CommandContext* cmd, const std::vector<Gfx::Scene*>& scenes);
+		// Builds the missing BLASes and updates the TLAS, only the instances of the meshes that moved are uploaded again.
+		// The moved meshes have to be sorted by instance ID.
+		void Build(CommandContext* cmd, const std::vector<Gfx::Scene*>& scenes, Span<const Gfx::Mesh*> movedMeshes);
+
+		// The next build gathers every instance again, call it when the scenes change
+		void InvalidateInstances() { m_bInstancesDirty = true; }
 
 		Buffer* GetTLASBuffer() const;
 	};
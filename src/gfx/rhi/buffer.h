@@ -73,5 +73,6 @@ namespace limbo::RHI
 		D3D12_GPU_VIRTUAL_ADDRESS	BufferLocation;
 		uint32						SizeInBytes;
 		uint32						Offset;
+		Format						Format = Format::R32_UINT;
 	};
 }
@@ -3,6 +3,7 @@
 #include "resourcemanager.h"
 #include "accelerationstructure.h"
 #include "commandqueue.h"
+#include "commandsignature.h"
 #include "device.h"
 #include "ringbufferallocator.h"
 #include "core/utils.h"
@@ -105,6 +106,50 @@ namespace limbo::RHI
 		m_CommandList->CopyBufferRegion(dst->Resource.Get(), dstOffset, src->Resource.Get(), srcOffset, numBytes);
 	}
 
+	void CommandContext::UpdateBufferElements(Buffer* dst, const void* srcElements, uint32 stride, Span<uint32> indices)
+	{
+		if (indices.GetSize() == 0)
+			return;
+
+		// The temp allocations have to stay aligned for the constant buffers that come after
+		RingBufferAllocation allocation;
+		RHI::GetTempBufferAllocator()->AllocateTemp(Math::Align((uint64)indices.GetSize() * stride, 256ull), allocation);
+
+		uint8* mappedData = (uint8*)allocation.MappedData;
+		for (uint32 i = 0; i < indices.GetSize(); ++i)
+			memcpy(mappedData + (uint64)i * stride, (const uint8*)srcElements + (uint64)indices[i] * stride, stride);
+
+		uint32 runStart = 0;
+		for (uint32 i = 1; i <= indices.GetSize(); ++i)
+		{
+			if (i < indices.GetSize() && indices[i] == indices[i - 1] + 1)
+				continue;
+
+			CopyBufferToBuffer(allocation.Buffer, dst, (uint64)(i - runStart) * stride, allocation.Offset + (uint64)runStart * stride, (uint64)indices[runStart] * stride);
+			runStart = i;
+		}
+	}
+
+	void CommandContext::CopyTextureMip(Texture* src, uint32 srcMip, Texture* dst, uint32 dstMip)
+	{
+		InsertResourceBarrier(src, D3D12_RESOURCE_STATE_COPY_SOURCE);
+		InsertResourceBarrier(dst, D3D12_RESOURCE_STATE_COPY_DEST);
+		SubmitResourceBarriers();
+
+		D3D12_TEXTURE_COPY_LOCATION srcLocation = {
+			.pResource = src->Resource.Get(),
+			.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
+			.SubresourceIndex = srcMip
+		};
+
+		D3D12_TEXTURE_COPY_LOCATION dstLocation = {
+			.pResource = dst->Resource.Get(),
+			.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
+			.SubresourceIndex = dstMip
+		};
+		m_CommandList->CopyTextureRegion(&dstLocation, 0, 0, 0, &srcLocation, nullptr);
+	}
+
 	void CommandContext::ClearRenderTargets(Span<TextureHandle> renderTargets, float4 color)
 	{
 		for (TextureHandle rt : renderTargets)
@@ -170,7 +215,7 @@ namespace limbo::RHI
 		D3D12_INDEX_BUFFER_VIEW ibView = {
 			.BufferLocation = view.BufferLocation,
 			.SizeInBytes = view.SizeInBytes,
-			.Format = DXGI_FORMAT_R32_UINT
+			.Format = D3DFormat(view.Format)
 		};
 
 		m_CommandList->IASetIndexBuffer(&ibView);
@@ -391,6 +436,14 @@ namespace limbo::RHI
 		m_CommandList->DispatchMesh(groupCountX, groupCountY, groupCountZ);
 	}
 
+	void CommandContext::ExecuteIndirect(const CommandSignature* signature, BufferHandle arguments, uint32 commandCount, uint64 argumentsOffset)
+	{
+		if (commandCount == 0) return;
+
+		SubmitResourceBarriers();
+		m_CommandList->ExecuteIndirect(signature->Get(), commandCount, RM_GET(arguments)->Resource.Get(), argumentsOffset, nullptr, 0);
+	}
+
 	void CommandContext::SubmitResourceBarriers()
 	{
 		if (m_ResourceBarriers.empty()) return;
@@ -46,11 +46,12 @@ namespace limbo::RHI
 	class DescriptorHeap;
 	class RingBufferAllocator;
 	class AccelerationStructure;
+	class CommandSignature;
 	class CommandContext
 	{
 		struct DescriptorTable
 		{
-			std::vector<DescriptorHandle> descriptors;
+			TSmallVector<DescriptorHandle, 8> descriptors;
 		};
 		using DescriptorTablesMap = std::unordered_map<uint32, DescriptorTable>;
 
@@ -86,6 +87,10 @@ namespace limbo::RHI
 		void CopyBufferToTexture(Buffer* src, Texture* dst, uint64 dstOffset = 0);
 		void CopyBufferToBuffer(BufferHandle src, BufferHandle dst, uint64 numBytes, uint64 srcOffset = 0, uint64 dstOffset = 0);
 		void CopyBufferToBuffer(Buffer* src, Buffer* dst, uint64 numBytes, uint64 srcOffset, uint64 dstOffset);
+		// Uploads the elements at the given indices from a CPU copy of the buffer, the indices have to be sorted. Consecutive elements are copied together.
+		void UpdateBufferElements(Buffer* dst, const void* srcElements, uint32 stride, Span<uint32> indices);
+		// Copies a single mip between two textures of the same format, the mips must have the same size
+		void CopyTextureMip(Texture* src, uint32 srcMip, Texture* dst, uint32 dstMip);
 
 		void GenerateMipLevels(TextureHandle texture);
 
@@ -139,6 +144,8 @@ namespace limbo::RHI
 		void Dispatch(uint32 groupCountX, uint32 groupCountY, uint32 groupCountZ);
 		void DispatchRays(const ShaderBindingTable& sbt, uint32 width, uint32 height, uint32 depth = 1);
 		void DispatchMesh(uint32 groupCountX, uint32 groupCountY, uint32 groupCountZ);
+		// The commands are read from an upload buffer, which the GPU can read without any barrier
+		void ExecuteIndirect(const CommandSignature* signature, BufferHandle arguments, uint32 commandCount, uint64 argumentsOffset = 0);
 
 		void BuildRaytracingAccelerationStructure(const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& inputs, BufferHandle scratch, BufferHandle result);
 
@@ -0,0 +1,81 @@
+#include "stdafx.h"
+#include "commandsignature.h"
+#include "device.h"
+#include "resourcemanager.h"
+#include "core/utils.h"
+
+namespace limbo::RHI
+{
+	CommandSignatureSpec& CommandSignatureSpec::Init()
+	{
+		Arguments.clear();
+		ByteStride = 0;
+
+		return *this;
+	}
+
+	CommandSignatureSpec& CommandSignatureSpec::AddConstants(uint32 rootParameter, uint32 num32BitValues, uint32 destOffsetIn32BitValues)
+	{
+		D3D12_INDIRECT_ARGUMENT_DESC& argument = Arguments.emplace_back();
+		argument.Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+		argument.Constant.RootParameterIndex = rootParameter;
+		argument.Constant.DestOffsetIn32BitValues = destOffsetIn32BitValues;
+		argument.Constant.Num32BitValuesToSet = num32BitValues;
+		ByteStride += num32BitValues * sizeof(uint32);
+
+		return *this;
+	}
+
+	CommandSignatureSpec& CommandSignatureSpec::AddIndexBufferView()
+	{
+		D3D12_INDIRECT_ARGUMENT_DESC& argument = Arguments.emplace_back();
+		argument.Type = D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW;
+		ByteStride += sizeof(D3D12_INDEX_BUFFER_VIEW);
+
+		return *this;
+	}
+
+	CommandSignatureSpec& CommandSignatureSpec::AddDrawIndexed()
+	{
+		D3D12_INDIRECT_ARGUMENT_DESC& argument = Arguments.emplace_back();
+		argument.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+		ByteStride += sizeof(D3D12_DRAW_INDEXED_ARGUMENTS);
+
+		return *this;
+	}
+
+	CommandSignatureSpec& CommandSignatureSpec::AddDispatchMesh()
+	{
+		D3D12_INDIRECT_ARGUMENT_DESC& argument = Arguments.emplace_back();
+		argument.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH_MESH;
+		ByteStride += sizeof(D3D12_DISPATCH_MESH_ARGUMENTS);
+
+		return *this;
+	}
+
+	CommandSignatureSpec& CommandSignatureSpec::SetByteStride(uint32 byteStride)
+	{
+		check(byteStride >= ByteStride && byteStride % sizeof(uint32) == 0);
+		ByteStride = byteStride;
+
+		return *this;
+	}
+
+	CommandSignature::CommandSignature(const std::string& name, const CommandSignatureSpec& spec, RootSignatureHandle rootSignature)
+		: m_Name(name), m_ByteStride(spec.ByteStride)
+	{
+		D3D12_COMMAND_SIGNATURE_DESC desc = {
+			.ByteStride = spec.ByteStride,
+			.NumArgumentDescs = (uint32)spec.Arguments.size(),
+			.pArgumentDescs = spec.Arguments.data(),
+			.NodeMask = 0
+		};
+
+		ID3D12RootSignature* d3dRootSignature = rootSignature.IsValid() ? RM_GET(rootSignature)->Get() : nullptr;
+		DX_CHECK(Device::Ptr->GetDevice()->CreateCommandSignature(&desc, d3dRootSignature, IID_PPV_ARGS(m_CommandSignature.ReleaseAndGetAddressOf())));
+
+		std::wstring wname;
+		Utils::StringConvert(m_Name, wname);
+		DX_CHECK(m_CommandSignature->SetName(wname.c_str()));
+	}
+}
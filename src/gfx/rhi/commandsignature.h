@@ -0,0 +1,41 @@
+#pragma once
+
+#include "rootsignature.h"
+#include "core/refcountptr.h"
+
+#include <vector>
+#include <string>
+
+namespace limbo::RHI
+{
+	struct CommandSignatureSpec
+	{
+		std::vector<D3D12_INDIRECT_ARGUMENT_DESC>	Arguments;
+		uint32										ByteStride;
+
+		CommandSignatureSpec& Init();
+		// Root constants of the root signature set by every command
+		CommandSignatureSpec& AddConstants(uint32 rootParameter, uint32 num32BitValues, uint32 destOffsetIn32BitValues = 0);
+		CommandSignatureSpec& AddIndexBufferView();
+		CommandSignatureSpec& AddDrawIndexed();
+		CommandSignatureSpec& AddDispatchMesh();
+		// Only needed when the commands are padded, by default it is the size of the arguments
+		CommandSignatureSpec& SetByteStride(uint32 byteStride);
+	};
+
+	class CommandSignature
+	{
+	private:
+		std::string							m_Name;
+		RefCountPtr<ID3D12CommandSignature>	m_CommandSignature;
+		uint32								m_ByteStride = 0;
+
+	public:
+		CommandSignature() = default;
+		// The root signature is only needed when the commands change root arguments
+		CommandSignature(const std::string& name, const CommandSignatureSpec& spec, RootSignatureHandle rootSignature = RootSignatureHandle());
+
+		ID3D12CommandSignature* Get() const { return m_CommandSignature.Get(); }
+		uint32 GetByteStride() const { return m_ByteStride; }
+	};
+}
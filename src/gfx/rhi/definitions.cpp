@@ -1,10 +1,13 @@
 ﻿#include "stdafx.h"
 #include "definitions.h"
 
+#if defined(_WIN32)
 #include <comdef.h>
+#endif
 
 namespace limbo::RHI
 {
+#if defined(_WIN32)
 	namespace Internal
 	{
 		void DXHandleError(HRESULT hr, const char* file, int line)
@@ -32,8 +35,9 @@ namespace limbo::RHI
 			}
 		}
 	}
+#endif
 
-	#define FORMAT_TYPE(name) Format::name
+	#define FORMAT_TYPE(name) Format::name, #name
 
 	static constexpr FormatInfo sFormatInfo[] = {
 	    // Format							Bytes	BlockSize  Components
@@ -115,7 +119,7 @@ namespace limbo::RHI
 
 	    { FORMAT_TYPE(BGRA8_UNORM),			4,		1,		   4,		  },
 	};
-	static_assert(ARRAYSIZE(sFormatInfo) == (uint32)Format::MAX);
+	static_assert(ARRAY_LEN(sFormatInfo) == (uint32)Format::MAX);
 
 	std::string_view CmdListTypeToStr(ContextType type)
 	{
@@ -134,6 +138,7 @@ namespace limbo::RHI
 		}
 	}
 	
+#if defined(_WIN32)
 	D3D12_COMMAND_LIST_TYPE D3DCmdListType(ContextType type)
 	{
 		switch (type)
@@ -184,6 +189,7 @@ namespace limbo::RHI
 		ensure(false);
 		return Format::MAX;
 	}
+#endif
 
 	bool IsFormatSRGB(Format format)
 	{
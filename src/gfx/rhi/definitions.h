@@ -16,11 +16,13 @@ namespace limbo::RHI
 		inline TOnShadersReloaded OnShadersReloaded;
 	}
 
+#if defined(_WIN32)
 	namespace Internal
 	{
 		void DXHandleError(HRESULT hr, const char* file, int line);
 		void DXMessageCallback(D3D12_MESSAGE_CATEGORY Category, D3D12_MESSAGE_SEVERITY Severity, D3D12_MESSAGE_ID ID, LPCSTR pDescription, void* pContext);
 	}
+#endif
 
 	enum class ContextType : uint8
 	{
@@ -142,7 +144,8 @@ namespace limbo::RHI
 
 	struct FormatInfo
 	{
-		Format			Format;
+		RHI::Format		Format;
+		const char*		Name;
 		uint8			BytesPerBlock : 8;
 		uint8			BlockSize : 4;
 		uint8			NumComponents : 3;
@@ -150,11 +153,13 @@ namespace limbo::RHI
 
 	std::string_view CmdListTypeToStr(ContextType type);
 
+#if defined(_WIN32)
 	D3D12_COMMAND_LIST_TYPE D3DCmdListType(ContextType type);
 	D3D12_RESOURCE_DIMENSION D3DTextureType(TextureType type);
 	DXGI_FORMAT D3DFormat(Format format);
 
 	Format GetFormat(DXGI_FORMAT format);
+#endif
 	Format ConvertToSRGBFormat(Format format);
 
 	uint16 CalculateMipCount(uint32 width, uint32 height = 0, uint32 depth = 0);
@@ -163,9 +168,15 @@ namespace limbo::RHI
 	uint64 GetSlicePitch(Format format, uint32 width, uint32 height, uint32 mipIndex = 0);
 	uint64 GetTextureMipByteSize(Format format, uint32 width, uint32 height, uint32 depth, uint32 mipIndex = 0);
 
+	constexpr uint8 gRHIBufferCount = 3;
+
+	// The format helpers above build everywhere, the rest is only for the D3D12 backend
+#if defined(_WIN32)
 	inline DXGI_FORMAT gRHIPixelFormats[(uint32)Format::MAX];
 
-	constexpr uint8 gRHIBufferCount = 3;
 	constexpr uint8 gRHIMaxRenderTargets = D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT;
+#endif
 }
+#if defined(_WIN32)
 #define DX_CHECK(expression) { HRESULT _hr = expression; if (_hr != S_OK) limbo::RHI::Internal::DXHandleError(_hr, __FILE__, __LINE__); }
+#endif
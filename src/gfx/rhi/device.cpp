@@ -498,7 +498,7 @@ namespace limbo::RHI
 
 		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {
 			.Format = format,
-			.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING
+			.Shader4ComponentMapping = texture->Spec.ComponentMapping
 		};
 
 		uint32 mostDetailedMip = mipLevel;
@@ -88,9 +88,10 @@ namespace limbo::RHI
 		Free(allocation);
 	}
 
-	void RingBufferAllocator::Free(RingBufferAllocation& allocation)
+	uint64 RingBufferAllocator::Free(RingBufferAllocation& allocation)
 	{
 		uint64 fenceValue = allocation.Context->Execute();
 		m_PreDeletedList.emplace(fenceValue, allocation.Offset, allocation.Size);
+		return fenceValue;
 	}
 }
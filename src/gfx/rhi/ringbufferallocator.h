@@ -57,6 +57,7 @@ namespace limbo::RHI
 
 		void Allocate(uint64 size, RingBufferAllocation& allocation);
 		void AllocateTemp(uint64 size, RingBufferAllocation& allocation);
-		void Free(RingBufferAllocation& allocation);
+		// Submits the commands recorded in the allocation context, returns the fence value that signals when they are done
+		uint64 Free(RingBufferAllocation& allocation);
 	};
 }
@@ -284,6 +284,21 @@ namespace limbo::RHI
 		InitResource(Spec);
 	}
 
+	void Texture::SwapResource(Texture* other)
+	{
+		check(Spec.Format == other->Spec.Format);
+
+		Resource.Swap(other->Resource);
+		std::swap(Spec.Width, other->Spec.Width);
+		std::swap(Spec.Height, other->Spec.Height);
+		std::swap(Spec.MipLevels, other->Spec.MipLevels);
+		bResetState = true;
+		other->bResetState = true;
+
+		if (EnumHasAllFlags(Spec.Flags, TextureUsage::ShaderResource))
+			CreateSRV();
+	}
+
 	uint64 Texture::TextureID()
 	{
 		return m_SRVHandle.GPUHandle.ptr;
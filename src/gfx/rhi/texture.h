@@ -34,6 +34,7 @@ namespace limbo::RHI
 		Format					Format = Format::R8_UNORM;
 		TextureType				Type = TextureType::Texture2D;
 		TextureInitialData		InitialData;
+		uint32					ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING; // Used by the SRV, lets two channel formats be read from other channels
 	};
 
 	// Helpers
@@ -64,6 +65,10 @@ namespace limbo::RHI
 
 		void ReloadSize(uint32 width, uint32 height);
 
+		// Takes the resource of another texture with the same format and keeps the descriptors of this one.
+		// The other texture ends up with the old resource, so destroying it keeps the old resource alive until the GPU is done with it.
+		void SwapResource(Texture* other);
+
 		// D3D12 Specific
 		void CreateUAV(uint8 mipLevel);
 		void CreateSRV();
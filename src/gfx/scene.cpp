@@ -2,21 +2,22 @@
 #include "scene.h"
 #include "core/paths.h"
 #include "gfx/rhi/commandcontext.h"
+#include "gfx/rhi/commandqueue.h"
+#include "gfx/rhi/device.h"
 #include "gfx/shaderinterop.h"
 #include "core/jobsystem.h"
 #include "rhi/resourcemanager.h"
 #include "core/timer.h"
+#include "scenecache.h"
+#include "sceneimport.h"
+#include "texturecompressor.h"
+#include "textureresidency.h"
+#include "sharedtextures.h"
+#include "core/algo.h"
+#include "core/commandline.h"
 
-#pragma warning(push)
-#pragma warning(disable: 4996) // disable _CRT_SECURE_NO_WARNINGS
-#define CGLTF_IMPLEMENTATION
 #include <cgltf/cgltf.h>
-#pragma warning(pop)
-
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb/stb_image.h>
 #include <dds/dds.h>
-#include <meshoptimizer.h>
 
 #include "core/utils.h"
 
@@ -24,22 +25,6 @@ namespace limbo::Gfx
 {
 	namespace
 	{
-		struct PrimitiveData
-		{
-			std::vector<float3>		PositionStream;
-			std::vector<float3>		NormalsStream;
-			std::vector<float4>		TangentsStream;
-			std::vector<float2>		TexCoordsStream;
-
-			std::vector<MeshVertex> VerticesStream;
-			std::vector<uint32>		IndicesStream;
-
-			std::vector<Meshlet>			Meshlets;
-			std::vector<uint32>				MeshletVertices;
-			std::vector<Meshlet::Triangle>	MeshletTriangles;
-		};
-		std::vector<PrimitiveData> PrimitivesStreams;
-
 		struct TextureData
 		{
 			std::string Name;
@@ -47,28 +32,85 @@ namespace limbo::Gfx
 			int			Height = 0;
 			int			Channels = 0;
 			void*		Data = nullptr;
+			uint64		DataSize = 0;
 			uint16		NumMips = 1;
-			bool		bGenerateMips = true;
 			RHI::Format Format;
+			uint32		ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+
+			// File that holds the same mip chain, the texture streaming reads the mips from there. Empty if there is none.
+			std::string SourcePath;
+			uint64		SourceOffset = 0;
+
+			// Hash of the encoded image and of how it is used, see HashEncodedImage()
+			uint64		ContentHash = 0;
+		};
+
+		// Wall time of an import stage. Stages run in jobs, so the stage only ends when the last of its jobs finishes.
+		struct ImportStage
+		{
+			uint64				Start = 0;
+			std::atomic<uint64>	End = 0;
+
+			void Begin()
+			{
+				Start = Core::Timestamp::Now();
+				End.store(Start);
+			}
+
+			// Can be called from any thread
+			void Finish()
+			{
+				const uint64 now = Core::Timestamp::Now();
+				uint64 end = End.load();
+				while (end < now && !End.compare_exchange_weak(end, now)) {}
+			}
+
+			double GetMilliseconds() const
+			{
+				return Core::Timestamp::ToMilliseconds(int64(End.load() - Start));
+			}
 		};
 
-		std::vector<TextureData> TextureStreams;
-		// map the cgltf_texture to the index in TextureStreams
-		std::unordered_map<uintptr_t, uint32> TexturesMap;
+		// Meshes with few enough vertices get 16 bit indices
+		RHI::Format GetIndexFormat(size_t vertexCount)
+		{
+			return vertexCount < 65536 ? RHI::Format::R16_UINT : RHI::Format::R32_UINT;
+		}
 
-		void CopyVertexData(RHI::VertexBufferView& view, uint8* data, uint64 gpuAddress, uint64& offset, const auto& stream)
+		uint64 GetIndicesByteSize(const SceneImport::PrimitiveData& primitiveData)
 		{
-			auto streamSize = stream.size() * sizeof(stream[0]);
+			// Padded so the next primitive starts 4 bytes aligned
+			const uint32 indexSize = RHI::GetFormatInfo(GetIndexFormat(primitiveData.VerticesStream.size())).BytesPerBlock;
+			return Math::Align<uint64>(primitiveData.IndicesStream.size() * indexSize, 4);
+		}
+
+		void PackVertexData(RHI::VertexBufferView& view, uint8* data, uint64 gpuAddress, uint64& offset, const std::vector<MeshVertex>& vertices, const float3& positionOffset, const float3& positionScale)
+		{
+			const uint64 streamSize = vertices.size() * sizeof(PackedMeshVertex);
 			view = {
 				.BufferLocation = gpuAddress + offset,
 				.SizeInBytes = (uint32)streamSize,
-				.StrideInBytes = sizeof(stream[0]),
+				.StrideInBytes = sizeof(PackedMeshVertex),
 				.Offset = (uint32)offset
 			};
-			memcpy(data + offset, stream.data(), streamSize);
+
+			PackedMeshVertex* packed = (PackedMeshVertex*)(data + offset);
+			for (size_t i = 0; i < vertices.size(); ++i)
+				packed[i] = VertexPacking::PackMeshVertex(vertices[i], positionOffset, positionScale);
 			offset += streamSize;
 		}
 
+		uint64 GetPrimitiveByteSize(const SceneImport::PrimitiveData& primitiveData)
+		{
+			uint64 size = 0;
+			size += primitiveData.VerticesStream.size()   * sizeof(PackedMeshVertex);
+			size += primitiveData.Meshlets.size()		  * sizeof(Meshlet);
+			size += primitiveData.MeshletVertices.size()  * sizeof(uint32);
+			size += primitiveData.MeshletTriangles.size() * sizeof(Meshlet::Triangle);
+			size += GetIndicesByteSize(primitiveData);
+			return size;
+		}
+
 		void CopyMeshletData(uint32& currentDataOffset, uint8* data, uint64& offset, const auto& stream)
 		{
 			auto streamSize = stream.size() * sizeof(stream[0]);
@@ -77,235 +119,545 @@ namespace limbo::Gfx
 			offset += streamSize;
 		}
 
-		void CreateVertexStream(PrimitiveData& primitiveData)
+		// Everything that comes from the primitive, the rest of the mesh belongs to the node that instances it
+		void CopyMeshGeometry(const Mesh& geometry, Mesh& mesh)
 		{
-			size_t vertexCount = primitiveData.PositionStream.size();
+			mesh.VerticesLocation		= geometry.VerticesLocation;
+			mesh.IndicesLocation		= geometry.IndicesLocation;
+			mesh.MeshletsOffset			= geometry.MeshletsOffset;
+			mesh.MeshletVerticesOffset	= geometry.MeshletVerticesOffset;
+			mesh.MeshletTrianglesOffset	= geometry.MeshletTrianglesOffset;
+			mesh.BoundingSphere			= geometry.BoundingSphere;
+			mesh.PositionOffset			= geometry.PositionOffset;
+			mesh.PositionScale			= geometry.PositionScale;
+			mesh.IndexCount				= geometry.IndexCount;
+			mesh.VertexCount			= geometry.VertexCount;
+			mesh.MeshletsCount			= geometry.MeshletsCount;
+			mesh.NumLODs				= geometry.NumLODs;
+			memcpy(mesh.LODs, geometry.LODs, sizeof(mesh.LODs));
+		}
 
-			primitiveData.VerticesStream.resize(vertexCount);
-			for (int i = 0; i < vertexCount; ++i)
+		// The same file or the same embedded bytes give the same hash, whatever image of whatever scene points to them.
+		// The usage is part of it as the cooked texture depends on it. The files were already hashed for the cache check.
+		uint64 HashEncodedImage(const cgltf_image* image, const char* folderPath, const SceneImport::ImageUsage& usage, SceneCache::SourceFileHashes& sourceFiles)
+		{
+			uint64 hash = 0;
+			if (image->uri && strncmp(image->uri, "data:", 5) != 0)
 			{
-				MeshVertex& vertex = primitiveData.VerticesStream[i];
-				vertex = {};
-
-				vertex.Position = primitiveData.PositionStream[i];
-				if (primitiveData.NormalsStream.size() > i) vertex.Normal = primitiveData.NormalsStream[i];
-				if (primitiveData.TexCoordsStream.size() > i) vertex.UV = primitiveData.TexCoordsStream[i];
-				if (primitiveData.TangentsStream.size() > i) vertex.Tangent = primitiveData.TangentsStream[i];
+				hash = sourceFiles.HashFile(folderPath, image->uri);
+			}
+			else if (image->uri)
+			{
+				hash = Algo::Hash64(image->uri, strlen(image->uri));
+			}
+			else if (image->buffer_view)
+			{
+				const cgltf_buffer_view* bufferView = image->buffer_view;
+				hash = Algo::Hash64((const uint8*)bufferView->buffer->data + bufferView->offset, bufferView->size);
 			}
-		}
-		
-		void OptimizePrimitiveData(PrimitiveData& primitiveData)
-		{
-			size_t indexCount = primitiveData.IndicesStream.size();
-			size_t vertexCount = primitiveData.VerticesStream.size();
-
-			std::vector<uint32> remap(vertexCount);
-			meshopt_optimizeVertexFetchRemap(&remap[0], primitiveData.IndicesStream.data(), indexCount, vertexCount);
 
-			meshopt_remapIndexBuffer(primitiveData.IndicesStream.data(), primitiveData.IndicesStream.data(), indexCount, remap.data());
-			meshopt_remapVertexBuffer(primitiveData.VerticesStream.data(), primitiveData.VerticesStream.data(), vertexCount, sizeof(MeshVertex), remap.data());
-			meshopt_optimizeVertexCache(primitiveData.IndicesStream.data(), primitiveData.IndicesStream.data(), indexCount, vertexCount);
-			meshopt_optimizeOverdraw(primitiveData.IndicesStream.data(), primitiveData.IndicesStream.data(), indexCount, &primitiveData.VerticesStream[0].Position.x, vertexCount, sizeof(MeshVertex), 1.05f);
+			hash = Algo::Hash64(&usage.Role, sizeof(usage.Role), hash);
+			return Algo::Hash64(&usage.AlphaCutoff, sizeof(usage.AlphaCutoff), hash);
 		}
 
-		void CreateMeshlets(PrimitiveData& data)
+		// Materials with the same factors and the same textures become one, the meshes point to the one that is kept.
+		// Returns how many were removed.
+		uint32 DeduplicateMaterials(std::vector<Material>& materials, std::vector<Mesh>& meshes)
 		{
-			size_t indexCount = data.IndicesStream.size();
-			size_t vertexCount = data.VerticesStream.size();
-
-			size_t maxMeshlets = meshopt_buildMeshletsBound(indexCount, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
-
-			std::vector<meshopt_Meshlet> meshlets(maxMeshlets);
-			std::vector<uint8>indices(maxMeshlets * MESHLET_MAX_TRIANGLES * 3);
-			data.MeshletVertices.resize(maxMeshlets * MESHLET_MAX_VERTICES);
-			size_t meshletCount = meshopt_buildMeshlets(meshlets.data(), data.MeshletVertices.data(), indices.data(),
-														data.IndicesStream.data(), indexCount, &data.VerticesStream[0].Position.x, vertexCount,
-														sizeof(MeshVertex), MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES, 0.0f);
-
-			// Trimming
-			const meshopt_Meshlet& last = meshlets[meshletCount - 1];
-
-			meshlets.resize(meshletCount);
-			indices.resize(last.triangle_offset + ((last.triangle_count * 3 + 3) & ~3));
-			data.Meshlets.reserve(meshletCount);
-			data.MeshletVertices.resize(last.vertex_offset + last.vertex_count);
-			data.MeshletTriangles.resize(indices.size() / 3);
-
-			uint32 triangleOffset = 0;
-			for (const meshopt_Meshlet& meshlet : meshlets)
+			std::vector<uint32> remap(materials.size());
+			std::unordered_map<uint64, uint32> uniqueMaterials;
+			uint32 numUnique = 0;
+			for (uint32 i = 0; i < (uint32)materials.size(); ++i)
 			{
-				uint8* pData = indices.data() + meshlet.triangle_offset;
-				for (uint32 i = 0; i < meshlet.triangle_count; ++i)
+				const auto [it, bInserted] = uniqueMaterials.try_emplace(Algo::Hash64(&materials[i], sizeof(Material)), numUnique);
+				if (!bInserted && memcmp(&materials[it->second], &materials[i], sizeof(Material)) == 0)
 				{
-					Meshlet::Triangle& triangle = data.MeshletTriangles[i + triangleOffset];
-					triangle.V0 = *pData++;
-					triangle.V1 = *pData++;
-					triangle.V2 = *pData++;
+					remap[i] = it->second;
+					continue;
 				}
 
-				data.Meshlets.emplace_back(meshlet.vertex_offset, triangleOffset, meshlet.vertex_count, meshlet.triangle_count);
-				triangleOffset += meshlet.triangle_count;
+				// A hash collision keeps both
+				remap[i] = numUnique;
+				materials[numUnique++] = materials[i];
 			}
-			data.MeshletTriangles.resize(triangleOffset);
+
+			const uint32 numRemoved = (uint32)materials.size() - numUnique;
+			materials.resize(numUnique);
+			for (Mesh& mesh : meshes)
+			{
+				if (mesh.LocalMaterialIndex < remap.size())
+					mesh.LocalMaterialIndex = remap[mesh.LocalMaterialIndex];
+			}
+			return numRemoved;
 		}
 
-		void CalculateNormals(PrimitiveData& data)
+		bool LoadDDS(const char* filename, TextureData& data)
 		{
-			data.NormalsStream.resize(data.PositionStream.size(), float3(0.0f));
+			std::vector<uint8> filedata;
+			if (!Utils::FileRead(filename, filedata))
+				return false;
+
+			dds::Header header = dds::read_header(filedata.data(), filedata.size());
+			if (!header.is_valid())
+				return false;
+
+			uint8* textureData = filedata.data() + header.data_offset();
+			data.DataSize = filedata.size() - header.data_offset();
+			data.Data = malloc(data.DataSize);
+			memcpy(data.Data, textureData, data.DataSize);
+
+			data.Width = header.width();
+			data.Height = header.height();
+			data.NumMips = header.mip_levels();
+			data.Format = RHI::GetFormat((DXGI_FORMAT)header.format());
+			data.SourcePath = filename;
+			data.SourceOffset = header.data_offset();
+			return true;
+		}
 
-			for (int i = 0; i < data.IndicesStream.size(); ++i)
+		// Replaces the decoded RGBA8 pixels with the full mip chain, BC compressed when the size allows it.
+		// The result is saved as a DDS so the next import can skip all of it.
+		void CookTexture(TextureData& data, const SceneImport::ImageUsage& usage, const std::string& cachePath)
+		{
+			const uint32 width = (uint32)data.Width;
+			const uint32 height = (uint32)data.Height;
+			const TextureCompressor::Quality quality = Core::CommandLine::HasArg(LIMBO_CMD_FAST_TEXTURE_COMPRESSION) ? TextureCompressor::Quality::Fast : TextureCompressor::Quality::High;
+
+			// Keep the DDS header in front of the data so the file can be written without another copy
+			SceneImport::CookedImage cooked;
+			uint8* filedata = SceneImport::CookImage((const uint8*)data.Data, width, height, usage, quality, sizeof(dds::Header), cooked);
+			free(data.Data);
+			dds::write_header(filedata, (dds::DXGI_FORMAT)RHI::D3DFormat(cooked.Format), width, height, cooked.NumMips);
+
+			const uint64 textureSize = cooked.DataSize;
+			if (Utils::FileWrite(cachePath.c_str(), filedata, sizeof(dds::Header) + textureSize))
 			{
-				const uint idx0 = data.IndicesStream[i + 0];
-				const uint idx1 = data.IndicesStream[i + 1];
-				const uint idx2 = data.IndicesStream[i + 2];
+				data.SourcePath = cachePath;
+				data.SourceOffset = sizeof(dds::Header);
+			}
+			else
+			{
+				LB_WARN("Failed to write cooked texture %s", cachePath.c_str());
+			}
 
-				const float3 p0 = data.PositionStream[idx0];
-				const float3 p1 = data.PositionStream[idx1];
-				const float3 p2 = data.PositionStream[idx2];
+			data.Data = malloc(textureSize);
+			memcpy(data.Data, filedata + sizeof(dds::Header), textureSize);
+			free(filedata);
 
-				const float3 v0 = glm::normalize(p0 - p1);
-				const float3 v1 = glm::normalize(p1 - p2);
+			data.DataSize = textureSize;
+			data.NumMips = cooked.NumMips;
+			data.Format = cooked.Format;
+		}
+	}
 
-				float3 normal = glm::normalize(glm::cross(v0, v1));
-				ensure(!glm::any(glm::isnan(normal)));
+	// Everything one import works on, so several scenes can be loaded at the same time
+	struct SceneImportContext
+	{
+		std::string									Path;
+		std::string									CachePath;
+		uint64										SourceHash = 0;
+		// Hashes of the files SourceHash is made of, the images hash their file from it too
+		SceneCache::SourceFileHashes				SourceFiles;
+		cgltf_data*									Data = nullptr;
+		Core::Timer									Timer;
+
+		// Open when the scene comes from the cache, the images and the geometry are read from the mapped file
+		SceneCache::Reader							Cache;
+		bool										bFromCache = false;
+
+		std::vector<SceneImport::PrimitiveData>		PrimitivesStreams;
+		// Nodes that instance the same mesh share its primitives, every primitive is processed once
+		std::unordered_map<const cgltf_primitive*, uint32> PrimitiveToGeometry;
+
+		std::vector<TextureData>					TextureStreams;
+		// map the cgltf_image index to the index in TextureStreams
+		std::unordered_map<uint32, uint32>			TexturesMap;
+		// Images with the same contents point to the first one that was loaded, they are never decoded
+		std::unordered_map<uint64, uint32>			ImagesByHash;
+		std::unordered_map<uint32, uint32>			ImageAliases;
+		std::mutex									TexturesMutex;
+		// map the cgltf_image to its usage, filled before the textures are loaded
+		SceneImport::ImageUsageMap					ImageUsages;
+
+		// Every texture resource of the scene, in the same order as Scene::m_TextureKeys.
+		// The materials point into it until the GPU resources are created, this is also what the cache stores.
+		std::vector<SceneCache::TextureEntry>		TextureResources;
+		// The material slots that sample the same image the same way share a texture resource
+		std::unordered_map<uint64, uint32>			TextureResourcesMap;
+		uint32										NumSharedTextureResources = 0;
+		uint32										NumDuplicateMaterials = 0;
+
+		// CPU copy of the geometry buffer contents
+		std::vector<uint8>							GeometryStream;
+		// Kept until the copy queue is done with it
+		RHI::BufferHandle							GeometryUpload;
+
+		std::atomic<SceneLoadStage>					Stage = SceneLoadStage::Parsing;
+		std::atomic<uint32>							NumSteps = 0;
+		std::atomic<uint32>							NumStepsDone = 0;
+
+		explicit SceneImportContext(const char* path)
+			: Path(path)
+		{
+		}
 
-				data.NormalsStream[i + 0] = normal;
-				data.NormalsStream[i + 1] = normal;
-				data.NormalsStream[i + 2] = normal;
-			}
+		~SceneImportContext()
+		{
+			if (Data)
+				cgltf_free(Data);
+			for (TextureData& texture : TextureStreams)
+				free(texture.Data);
+			if (GeometryUpload.IsValid())
+				DestroyBuffer(GeometryUpload);
 		}
+	};
+
+	bool Scene::Import(SceneImportContext& context)
+	{
+		const char* path = context.Path.c_str();
+		LB_LOG("Starting loading %s", path);
+
+		cgltf_options options = {};
+		cgltf_result result = cgltf_parse_file(&options, path, &context.Data);
+		ENSURE_RETURN(result != cgltf_result_success, false);
+		cgltf_data* data = context.Data;
 
-		void CalculateTangents(PrimitiveData& data)
+		Paths::GetPath(path, m_FolderPath);
+		Paths::GetFilename(path, m_SceneName);
+		Paths::GetExtension(path, m_Extension);
+
+		// Only the json was parsed so far, but that is enough to know every file the scene depends on.
+		// The cache records the size and the write time of each of them, only the ones that changed since are read and hashed.
+		context.CachePath = SceneCache::GetCachePath(path);
+		uint64 cachedSourceHash = 0;
+		std::vector<SceneCache::SourceFileEntry> cachedSourceFiles;
+		const bool bHasCache = SceneCache::ReadSourceFiles(context.CachePath.c_str(), cachedSourceHash, cachedSourceFiles);
+		context.SourceFiles.SetRecorded(cachedSourceFiles);
+		context.SourceHash = SceneCache::ComputeSourceHash(path, m_FolderPath, data, context.SourceFiles);
+
+		// Same contents with new write times, like after a copy. They are recorded so the next load does not read the files again.
+		if (bHasCache && context.SourceHash == cachedSourceHash && context.SourceFiles.HasChangedFiles())
+			SceneCache::WriteSourceFiles(context.CachePath.c_str(), context.SourceFiles.GetFiles());
+
+		if (LoadFromCache(context))
 		{
-			// https://terathon.com/blog/tangent-space.html
-			std::vector<float3> bitangents, tangents;
-			bitangents.resize(data.PositionStream.size(), float3(0.0f));
-			tangents.resize(data.PositionStream.size(), float3(0.0f));
+			LB_LOG("Imported %s from cache (took %.3fs)", path, context.Timer.ElapsedSeconds());
+			m_Report.AddStage("Parse and read cache", context.Timer.ElapsedMilliseconds());
+			return true;
+		}
 
-			for (int i = 0; i < data.IndicesStream.size(); ++i)
-			{
-				const uint idx0 = data.IndicesStream[i + 0];
-				const uint idx1 = data.IndicesStream[i + 1];
-				const uint idx2 = data.IndicesStream[i + 2];
+		// The import runs as a small dependency graph:
+		//   buffers -> { texture decode, accessor decode -> optimize -> meshlets } -> material binding -> geometry packing
+		// Texture decode and the geometry processing are independent until the materials are bound, so they overlap.
+		// This runs in a job, the waits below only wait for the jobs of this import.
+		ImportStage parseStage, texturesStage, geometryStage, materialsStage, packStage;
+		parseStage.Start = context.Timer.GetTimestamp();
 
-				const float3 p0 = data.PositionStream[idx0];
-				const float3 p1 = data.PositionStream[idx1];
-				const float3 p2 = data.PositionStream[idx2];
+		result = cgltf_load_buffers(&options, data, path);
+		ENSURE_RETURN(result != cgltf_result_success, false);
+		parseStage.Finish();
+		context.Stage = SceneLoadStage::Importing;
+
+		// Image decode and compression, the compression format depends on how the materials use each image
+		Core::JobContext texturesContext;
+		texturesStage.Begin();
+		SceneImport::GatherImageUsages(data, context.ImageUsages);
+		context.NumSteps += (uint32)data->images_count;
+		Core::JobSystem::ExecuteMany(texturesContext, (uint32)data->images_count, 1, Core::TOnJobSystemExecuteMany::CreateLambda([this, data, &context, &texturesStage](Core::JobDispatchArgs args)
+		{
+			LoadTextureImage(context, &data->images[args.jobIndex], args.jobIndex);
+			texturesStage.Finish();
+			context.NumStepsDone++;
+		}));
 
-				const float2 uv0 = data.TexCoordsStream[idx0];
-				const float2 uv1 = data.TexCoordsStream[idx1];
-				const float2 uv2 = data.TexCoordsStream[idx2];
+		// The material indices are known up front, the materials themselves are only created once the textures are decoded
+		for (size_t i = 0; i < data->materials_count; ++i)
+			m_MaterialPtrToIndex[&data->materials[i]] = (uint32)i;
 
-				const float3 q1 = p1 - p0;
-				const float3 q2 = p2 - p0;
+		// Geometry, the node walk only registers the unique primitives and each one is then processed in its own job.
+		// Use a group size of 1 as the primitive sizes vary a lot and bigger groups would leave threads idle.
+		Core::JobContext geometryContext;
+		geometryStage.Begin();
+		cgltf_scene* scene = data->scene;
+		m_Transforms.Reserve((uint32)data->nodes_count);
+		for (size_t i = 0; i < scene->nodes_count; ++i)
+			ProcessNode(context, scene->nodes[i], TransformHierarchy::InvalidNode);
 
-				const float s1 = uv1.x - uv0.x;
-				const float s2 = uv2.x - uv0.x;
+		// Every node is new, this computes all the world matrices
+		m_Transforms.Update();
+		for (Mesh& mesh : m_Meshes)
+			mesh.Transform = m_Transforms.GetWorldMatrix(mesh.NodeIndex);
 
-				const float t1 = uv1.y - uv0.y;
-				const float t2 = uv2.y - uv0.y;
+		// Each primitive is decoded once and packed once
+		context.NumSteps += 2 * (uint32)context.PrimitivesStreams.size();
+		Core::JobSystem::ExecuteMany(geometryContext, (uint32)context.PrimitivesStreams.size(), 1, Core::TOnJobSystemExecuteMany::CreateLambda([&context, &geometryStage](Core::JobDispatchArgs args)
+		{
+			SceneImport::ProcessPrimitive(context.PrimitivesStreams[args.jobIndex]);
+			geometryStage.Finish();
+			context.NumStepsDone++;
+		}));
 
-				const float r = 1 / ((s1 * t2) - (s2 * t1));
+		// Material binding, the materials point to the texture table until the GPU resources are created
+		Core::JobSystem::Wait(texturesContext);
+		materialsStage.Begin();
+		for (size_t i = 0; i < data->materials_count; ++i)
+			ProcessMaterial(context, &data->materials[i]);
+		context.NumDuplicateMaterials = DeduplicateMaterials(Materials, m_Meshes);
+		materialsStage.Finish();
 
-				float3 t = float3((t2 * q1 - t1 * q2) * r);
-				float3 b = float3((s1 * q2 - s2 * q1) * r);
-				
-				tangents[idx0] += t;
-				tangents[idx1] += t;
-				tangents[idx2] += t;
+		// Pack the geometry buffer contents and the Vertex/Index buffer views of the meshes, relative to the start of the buffer
+		Core::JobSystem::Wait(geometryContext);
+		cgltf_free(data);
+		context.Data = nullptr;
+
+		packStage.Begin();
+		ProcessPrimitivesData(context);
+		packStage.Finish();
+
+		BuildBVH();
+
+		LB_LOG("Imported %s (took %.3fs) - parse: %.1fms, textures: %.1fms, geometry: %.1fms, materials: %.1fms, pack: %.1fms - %zu meshes, %zu unique primitives",
+			   path, context.Timer.ElapsedSeconds(), parseStage.GetMilliseconds(), texturesStage.GetMilliseconds(), geometryStage.GetMilliseconds(), materialsStage.GetMilliseconds(), packStage.GetMilliseconds(),
+			   m_Meshes.size(), context.PrimitivesStreams.size());
+		m_Report.AddStage("Parse", parseStage.GetMilliseconds());
+		m_Report.AddStage("Textures", texturesStage.GetMilliseconds());
+		m_Report.AddStage("Geometry", geometryStage.GetMilliseconds());
+		m_Report.AddStage("Materials", materialsStage.GetMilliseconds());
+		m_Report.AddStage("Pack", packStage.GetMilliseconds());
+		LB_LOG("Deduplicated %s - %zu duplicate images, %u shared texture resources, %u duplicate materials",
+			   path, context.ImageAliases.size(), context.NumSharedTextureResources, context.NumDuplicateMaterials);
+
+		// Everything the cache needs is on the CPU, so it is written before any GPU resource exists
+		context.Stage = SceneLoadStage::WritingCache;
+		WriteCache(context);
+
+		std::vector<SceneImport::PrimitiveData>().swap(context.PrimitivesStreams);
+		std::unordered_map<const cgltf_primitive*, uint32>().swap(context.PrimitiveToGeometry);
+		return true;
+	}
 
-				bitangents[idx0] += b;
-				bitangents[idx1] += b;
-				bitangents[idx2] += b;
-			}
+	uint64 Scene::CreateGPUResources(SceneImportContext& context)
+	{
+		Core::Timer timer;
+		context.Stage = SceneLoadStage::Uploading;
 
-			data.TangentsStream.resize(data.PositionStream.size(), float4(0.0f));
-			for (int i = 0; i < data.IndicesStream.size(); ++i)
+		// A texture that another scene already created is shared, only the new ones are created and uploaded
+		std::vector<int> textureSRVs;
+		uint32 numSharedTextures = 0;
+		uint64 sharedTexturesSize = 0;
+		auto acquireTexture = [&](const SceneCache::TextureEntry& entry, const uint8* mipChain, const std::string& sourcePath, uint64 sourceOffset)
+		{
+			RHI::TextureHandle texture = SharedTextures::Acquire(entry.ContentHash);
+			const bool bShared = texture.IsValid();
+			if (bShared)
 			{
-				const float3 t = tangents[i];
-				const float3 b = bitangents[i];
-				const float3 n = data.NormalsStream[i];
+				numSharedTextures++;
+				sharedTexturesSize += GetResidentMipsSize(entry.Width, entry.Height, entry.MipLevels, (RHI::Format)entry.Format, 0);
+			}
+			else
+			{
+				texture = CreateStreamableTexture(entry, mipChain, sourcePath, sourceOffset);
+				if (texture.IsValid())
+					SharedTextures::Add(entry.ContentHash, texture);
+			}
+
+			RHI::Texture* t = RM_GET(texture);
+			textureSRVs.push_back(t ? (int)t->SRV() : -1);
+			if (!t)
+				return;
 
-				// Gram-Schmidt process to make sure the vectors are perpendicular to each other. Here is a nice explanation of it: https://youtu.be/4FaWLgsctqY?si=TlqfkJl2AtK3cNxJ&t=1218
-				float3 tangent = t - glm::dot(t, n) * n;
-				float handedness = (glm::dot(glm::cross(n, t), b) < 0.0F) ? -1.0F : 1.0F;;
+			m_TextureKeys.push_back(entry.ContentHash);
 
-				data.TangentsStream[i] = float4(tangent, handedness);
+			// A streamed texture only has the tail of its chain
+			const RHI::Format format = (RHI::Format)entry.Format;
+			uint64 mipBytes[D3D12_REQ_MIP_LEVELS] = {};
+			const uint16 mipLevels = Math::Min<uint16>(entry.MipLevels, D3D12_REQ_MIP_LEVELS);
+			for (uint16 mip = 0; mip < mipLevels; ++mip)
+				mipBytes[mip] = RHI::GetTextureMipByteSize(format, entry.Width, entry.Height, 1, mip);
+			m_Report.AddTexture(RHI::GetFormatInfo(format).Name, Span<uint64>(mipBytes, mipLevels), entry.MipLevels - t->Spec.MipLevels, bShared);
+		};
+
+		// The image data comes from the decoded images or straight from the mapped cache file, the streamed mips are read from the same file later
+		if (context.bFromCache)
+		{
+			for (const SceneCache::TextureEntry& entry : context.Cache.GetTextures())
+				acquireTexture(entry, context.Cache.GetImageData(entry.ImageIndex), context.CachePath, context.Cache.GetImageFileOffset(entry.ImageIndex));
+		}
+		else
+		{
+			for (const SceneCache::TextureEntry& entry : context.TextureResources)
+			{
+				const TextureData& image = context.TextureStreams[entry.ImageIndex];
+				acquireTexture(entry, (const uint8*)image.Data, image.SourcePath, image.SourceOffset);
 			}
 		}
-	}
 
-	Scene::Scene(const char* path)
-	{
-		LB_LOG("Starting loading %s", path);
-		Core::Timer timer;
+		auto toDescriptorIndex = [&textureSRVs](int textureIndex)
+		{
+			return textureIndex >= 0 && textureIndex < (int)textureSRVs.size() ? textureSRVs[textureIndex] : -1;
+		};
 
-		cgltf_options options = {};
-		cgltf_data* data = nullptr;
-		cgltf_result result = cgltf_parse_file(&options, path, &data);
-		ENSURE_RETURN(result != cgltf_result_success);
-		result = cgltf_load_buffers(&options, data, path);
-		ENSURE_RETURN(result != cgltf_result_success);
+		for (Material& material : Materials)
+		{
+			material.BaseColorIndex			= toDescriptorIndex(material.BaseColorIndex);
+			material.NormalIndex			= toDescriptorIndex(material.NormalIndex);
+			material.RoughnessMetalIndex	= toDescriptorIndex(material.RoughnessMetalIndex);
+			material.EmissiveIndex			= toDescriptorIndex(material.EmissiveIndex);
+			material.AmbientOcclusionIndex	= toDescriptorIndex(material.AmbientOcclusionIndex);
+		}
 
-		Paths::GetPath(path, m_FolderPath);
-		Paths::GetFilename(path, m_SceneName);
-		Paths::GetExtension(path, m_Extension);
+		const uint8* geometry = context.bFromCache ? context.Cache.GetGeometry() : context.GeometryStream.data();
+		const uint64 geometrySize = context.bFromCache ? context.Cache.GetGeometrySize() : context.GeometryStream.size();
+		D3D12_GPU_VIRTUAL_ADDRESS geoBufferAddress = CreateGeometryBuffer(geometrySize);
+		for (Mesh& mesh : m_Meshes)
+		{
+			mesh.VerticesLocation.BufferLocation = geoBufferAddress + mesh.VerticesLocation.Offset;
+			mesh.IndicesLocation.BufferLocation = geoBufferAddress + mesh.IndicesLocation.Offset;
+		}
+
+		const uint64 fenceValue = UploadGeometryBuffer(context, geometry, geometrySize);
+
+		m_Report.Name = context.Path;
+		m_Report.bFromCache = context.bFromCache;
+		m_Report.NumMeshes = NumMeshes();
+		m_Report.NumNodes = m_Transforms.NumNodes();
+		m_Report.NumMaterials = (uint32)Materials.size();
+		ReportGeometries(geometrySize);
+		m_Report.AddStage("GPU resources", timer.ElapsedMilliseconds());
+		LB_LOG("Created the GPU resources of %s (took %.1fms) - %zu textures, %u of them shared with the loaded scenes (%.1fMB), %.1fMB of geometry",
+			   context.Path.c_str(), timer.ElapsedMilliseconds(), m_TextureKeys.size(), numSharedTextures, sharedTexturesSize / (1024.0f * 1024.0f), geometrySize / (1024.0f * 1024.0f));
+		return fenceValue;
+	}
 
-		// load all textures
-#if 0
-		for (size_t i = 0; i < data->textures_count; ++i)
-			LoadTexture(&data->textures[i]);
-#else
-		Core::JobSystem::ExecuteMany((uint32)data->textures_count, Math::Max((uint32)data->textures_count / Core::JobSystem::ThreadCount(), 1u), Core::TOnJobSystemExecuteMany::CreateLambda([this, data](Core::JobDispatchArgs args)
+	Scene* Scene::Load(const char* path)
+	{
+		SceneImportContext context(path);
+		Scene* scene = new Scene();
+		if (scene->Import(context))
 		{
-			LoadTexture(&data->textures[args.jobIndex]);
+			const uint64 fenceValue = scene->CreateGPUResources(context);
+			RHI::Device::Ptr->GetCommandQueue(RHI::ContextType::Copy)->GetFence()->CpuWait(fenceValue);
+			LB_LOG("Finished loading %s (took %.3fs)", path, context.Timer.ElapsedSeconds());
+			scene->m_Report.LoadMilliseconds = context.Timer.ElapsedMilliseconds();
+		}
+		return scene;
+	}
+
+	AsyncSceneLoad::AsyncSceneLoad(const char* path)
+		: m_Path(path)
+		, m_Scene(new Scene())
+		, m_Context(new SceneImportContext(path))
+	{
+		// In the background so the frames never help with the import or with the textures it cooks
+		Core::JobSystem::ExecuteBackground(m_JobContext, Core::TOnJobSystemExecute::CreateLambda([this]()
+		{
+			if (!m_Scene->Import(*m_Context))
+				m_Context->Stage = SceneLoadStage::Failed;
 		}));
-		Core::JobSystem::WaitIdle();
-#endif
+	}
 
-		// process materials
-		for (size_t i = 0; i < data->materials_count; ++i)
-			ProcessMaterial(&data->materials[i]);
+	AsyncSceneLoad::~AsyncSceneLoad()
+	{
+		// The import job works on the scene and on the context, the copy queue reads from the upload buffer
+		Core::JobSystem::Wait(m_JobContext);
+		if (m_Context && m_Context->Stage == SceneLoadStage::Uploading)
+			RHI::Device::Ptr->GetCommandQueue(RHI::ContextType::Copy)->GetFence()->CpuWait(m_UploadFenceValue);
+
+		delete m_Context;
+		if (m_Scene)
+			DestroyScene(m_Scene);
+	}
 
-		cgltf_scene* scene = data->scene;
-		for (size_t i = 0; i < scene->nodes_count; ++i)
-			ProcessNode(scene->nodes[i]);
+	bool AsyncSceneLoad::Update()
+	{
+		if (!m_Context)
+			return true;
+		if (Core::JobSystem::IsBusy(m_JobContext))
+			return false;
 
-		cgltf_free(data);
+		switch (m_Context->Stage)
+		{
+		case SceneLoadStage::Failed:
+			DestroyScene(m_Scene);
+			m_Scene = nullptr;
+			m_Stage = SceneLoadStage::Failed;
+			break;
+		case SceneLoadStage::Uploading:
+			if (!RHI::Device::Ptr->GetCommandQueue(RHI::ContextType::Copy)->GetFence()->IsComplete(m_UploadFenceValue))
+				return false;
+
+			LB_LOG("Finished loading %s (took %.3fs)", m_Context->Path.c_str(), m_Context->Timer.ElapsedSeconds());
+			m_Scene->m_Report.LoadMilliseconds = m_Context->Timer.ElapsedMilliseconds();
+			m_Stage = SceneLoadStage::Ready;
+			break;
+		default:
+			// The import is done, the resources are created here as the resource pools and the copy context are not thread safe
+			m_UploadFenceValue = m_Scene->CreateGPUResources(*m_Context);
+			return false;
+		}
 
-		// Create the geometry buffer and create the Vertex/Index buffer views for the respective meshes
-		ProcessPrimitivesData();
+		delete m_Context;
+		m_Context = nullptr;
+		return true;
+	}
 
-		LB_LOG("Finished loading %s (took %.3fs)", path, timer.ElapsedSeconds());
+	Scene* AsyncSceneLoad::TakeScene()
+	{
+		if (m_Stage != SceneLoadStage::Ready)
+			return nullptr;
+
+		Scene* scene = m_Scene;
+		m_Scene = nullptr;
+		return scene;
+	}
+
+	SceneLoadStage AsyncSceneLoad::GetStage() const
+	{
+		return m_Context ? m_Context->Stage.load() : m_Stage;
+	}
 
-		// Clear streams
-		std::vector<PrimitiveData>().swap(PrimitivesStreams);
-		std::unordered_map<uintptr_t, uint32>().swap(TexturesMap);
-		for (TextureData& texture : TextureStreams)
+	const char* AsyncSceneLoad::GetStageName() const
+	{
+		switch (GetStage())
 		{
-			free(texture.Data);
-			texture.Data = nullptr;
+		case SceneLoadStage::Parsing:		return "Parsing";
+		case SceneLoadStage::Importing:		return "Importing";
+		case SceneLoadStage::WritingCache:	return "Writing cache";
+		case SceneLoadStage::Uploading:		return "Uploading";
+		case SceneLoadStage::Ready:			return "Ready";
+		case SceneLoadStage::Failed:		return "Failed";
 		}
-		std::vector<TextureData>().swap(TextureStreams);
+		return "";
 	}
 
-	Scene* Scene::Load(const char* path)
+	float AsyncSceneLoad::GetProgress() const
 	{
-		return new Scene(path);
+		if (!m_Context)
+			return 1.0f;
+
+		const uint32 numSteps = m_Context->NumSteps.load();
+		return numSteps > 0 ? Math::Min((float)m_Context->NumStepsDone.load() / numSteps, 1.0f) : 0.0f;
+	}
+
+	const char* AsyncSceneLoad::GetPath() const
+	{
+		return m_Path.c_str();
 	}
 
 	void Scene::Destroy()
 	{
-		for (const Mesh& mesh : m_Meshes)
+		for (RHI::BufferHandle blas : m_BLASes)
 		{
-			if (mesh.BLAS.IsValid()) // Some meshes don't have a BLAS set
-				DestroyBuffer(mesh.BLAS);
+			if (blas.IsValid()) // Some geometries don't have a BLAS set
+				DestroyBuffer(blas);
 		}
 
-		for (RHI::TextureHandle texture : m_Textures)
-			RHI::DestroyTexture(texture);
+		for (uint64 textureKey : m_TextureKeys)
+			SharedTextures::Release(textureKey);
 
-		DestroyBuffer(m_GeometryBuffer);
+		// A scene that failed to load never got one
+		if (m_GeometryBuffer.IsValid())
+			DestroyBuffer(m_GeometryBuffer);
 	}
 
 	void Scene::IterateMeshes(TOnDrawMesh drawDelegate) const
@@ -320,24 +672,149 @@ namespace limbo::Gfx
 			drawDelegate.ExecuteIfBound(m);
 	}
 
-	void Scene::ProcessNode(const cgltf_node* node)
+	void Scene::UpdateTransforms(std::vector<const Mesh*>& outMovedMeshes)
+	{
+		m_Transforms.Update();
+		if (m_Transforms.GetChangedNodes().empty())
+			return;
+
+		std::vector<uint32> movedMeshIndices;
+		for (uint32 i = 0; i < NumMeshes(); ++i)
+		{
+			Mesh& mesh = m_Meshes[i];
+			if (!m_Transforms.HasWorldChanged(mesh.NodeIndex))
+				continue;
+
+			mesh.Transform = m_Transforms.GetWorldMatrix(mesh.NodeIndex);
+			mesh.WorldBounds = Math::TransformAABB({ mesh.PositionOffset, mesh.PositionOffset + mesh.PositionScale }, mesh.Transform);
+			m_MeshBounds[i] = mesh.WorldBounds;
+			movedMeshIndices.push_back(i);
+			outMovedMeshes.push_back(&mesh);
+		}
+
+		m_BVH.Refit(movedMeshIndices, m_MeshBounds);
+	}
+
+	void Scene::BuildBVH()
+	{
+		// The quantization range of the positions is the local box of the mesh
+		m_MeshBounds.resize(m_Meshes.size());
+		for (uint32 i = 0; i < NumMeshes(); ++i)
+		{
+			Mesh& mesh = m_Meshes[i];
+			mesh.WorldBounds = Math::TransformAABB({ mesh.PositionOffset, mesh.PositionOffset + mesh.PositionScale }, mesh.Transform);
+			m_MeshBounds[i] = mesh.WorldBounds;
+		}
+
+		m_BVH.Build(m_MeshBounds);
+	}
+
+	void Scene::ReportGeometries(uint64 geometrySize)
+	{
+		std::vector<SceneGeometryReport> geometries(m_BLASes.size());
+		std::vector<const Mesh*> geometryMeshes(m_BLASes.size(), nullptr);
+		for (uint32 i = 0; i < NumMeshes(); ++i)
+		{
+			const Mesh& mesh = m_Meshes[i];
+			SceneGeometryReport& geometry = geometries[mesh.GeometryIndex];
+			if (geometry.NumInstances++ > 0)
+				continue;
+
+			geometryMeshes[mesh.GeometryIndex] = &mesh;
+			geometry.GeometryIndex = mesh.GeometryIndex;
+			geometry.FirstMesh = i;
+			geometry.NumVertices = mesh.VertexCount;
+			geometry.NumTriangles = mesh.IndexCount / 3;
+		}
+
+		// Every geometry is its vertices, its meshlets, then the indices of every LOD, and the next geometry starts right after
+		std::vector<uint32> order;
+		for (uint32 i = 0; i < (uint32)geometries.size(); ++i)
+		{
+			if (geometryMeshes[i])
+				order.push_back(i);
+		}
+		std::sort(order.begin(), order.end(), [&geometryMeshes](uint32 a, uint32 b)
+		{
+			return geometryMeshes[a]->VerticesLocation.Offset < geometryMeshes[b]->VerticesLocation.Offset;
+		});
+
+		for (uint32 i = 0; i < (uint32)order.size(); ++i)
+		{
+			const Mesh& mesh = *geometryMeshes[order[i]];
+			const uint64 end = i + 1 < (uint32)order.size() ? geometryMeshes[order[i + 1]]->VerticesLocation.Offset : geometrySize;
+
+			SceneGeometryReport& geometry = geometries[order[i]];
+			geometry.VertexBytes = mesh.VerticesLocation.SizeInBytes;
+			geometry.MeshletBytes = mesh.IndicesLocation.Offset - mesh.MeshletsOffset;
+			geometry.IndexBytes = end - mesh.IndicesLocation.Offset;
+			m_Report.AddGeometry(geometry);
+		}
+	}
+
+	const SceneReport& Scene::GetReport()
+	{
+		m_Report.NumBLASes = 0;
+		m_Report.BLASBytes = 0;
+		for (RHI::BufferHandle blas : m_BLASes)
+		{
+			if (!blas.IsValid())
+				continue;
+
+			m_Report.NumBLASes++;
+			m_Report.BLASBytes += RM_GET(blas)->ByteSize;
+		}
+		return m_Report;
+	}
+
+	bool Scene::WriteReport()
+	{
+		const std::string path = std::format("{}{}.report.json", m_FolderPath, m_SceneName);
+		const std::string json = GetReport().ToJson();
+		if (!Utils::FileWrite(path.c_str(), json.data(), json.size()))
+		{
+			LB_WARN("Failed to write the scene report %s", path.c_str());
+			return false;
+		}
+
+		LB_LOG("Wrote the scene report %s", path.c_str());
+		return true;
+	}
+
+	void Scene::ProcessNode(SceneImportContext& context, const cgltf_node* node, uint32 parentIndex)
 	{
+		// cgltf fills the identity TRS when the node does not have one
+		uint32 nodeIndex;
+		if (node->has_matrix)
+		{
+			float4x4 localMatrix;
+			memcpy(&localMatrix[0][0], node->matrix, sizeof(float4x4));
+			nodeIndex = m_Transforms.AddNode(parentIndex, localMatrix);
+		}
+		else
+		{
+			nodeIndex = m_Transforms.AddNode(parentIndex,
+											 float3(node->translation[0], node->translation[1], node->translation[2]),
+											 quat(node->rotation[3], node->rotation[0], node->rotation[1], node->rotation[2]),
+											 float3(node->scale[0], node->scale[1], node->scale[2]));
+		}
+
 		const cgltf_mesh* mesh = node->mesh;
 		if (mesh)
 		{
 			for (size_t i = 0; i < mesh->primitives_count; i++)
 			{
 				const cgltf_primitive& primitive = mesh->primitives[i];
-				ProcessMesh(node, mesh, &primitive);
+				ProcessMesh(context, nodeIndex, mesh, &primitive);
 			}
 		}
 
 		// then do the same for each of its children
 		for (size_t i = 0; i < node->children_count; i++)
-			ProcessNode(node->children[i]);
+			ProcessNode(context, node->children[i], nodeIndex);
 	}
 
-	void Scene::ProcessMaterial(cgltf_material* cgltfMaterial)
+	void Scene::ProcessMaterial(SceneImportContext& context, cgltf_material* cgltfMaterial)
 	{
 		uint32 index = (uint32)Materials.size();
 		Material& material = Materials.emplace_back();
@@ -349,12 +826,12 @@ namespace limbo::Gfx
 			const cgltf_pbr_metallic_roughness& workflow = cgltfMaterial->pbr_metallic_roughness;
 			{
 				std::string debugName = std::format(" Material({}) {}", index, "Albedo");
-				material.BaseColorIndex  = CreateTextureResource(&workflow.base_color_texture, debugName.c_str(), true);
+				material.BaseColorIndex  = AddTextureResource(context, &workflow.base_color_texture, debugName.c_str(), true);
 				material.BaseColorFactor = float4(workflow.base_color_factor[0], workflow.base_color_factor[1], workflow.base_color_factor[2], workflow.base_color_factor[3]);
 			}
 			{
 				std::string debugName = std::format(" Material({}) {}", index, "MetallicRoughness");
-				material.RoughnessMetalIndex = CreateTextureResource(&workflow.metallic_roughness_texture, debugName.c_str(), false);
+				material.RoughnessMetalIndex = AddTextureResource(context, &workflow.metallic_roughness_texture, debugName.c_str(), false);
 				material.RoughnessFactor = workflow.roughness_factor;
 				material.MetallicFactor = workflow.metallic_factor;
 			}
@@ -366,12 +843,12 @@ namespace limbo::Gfx
 			const cgltf_pbr_specular_glossiness& workflow = cgltfMaterial->pbr_specular_glossiness;
 			{
 				std::string debugName = std::format(" Material({}) {}", index, "Albedo");
-				material.BaseColorIndex  = CreateTextureResource(&workflow.diffuse_texture, debugName.c_str(), true);
+				material.BaseColorIndex  = AddTextureResource(context, &workflow.diffuse_texture, debugName.c_str(), true);
 				material.BaseColorFactor = float4(workflow.diffuse_factor[0], workflow.diffuse_factor[1], workflow.diffuse_factor[2], workflow.diffuse_factor[3]);
 			}
 			{
 				std::string debugName = std::format(" Material({}) {}", index, "MetallicRoughness");
-				material.RoughnessMetalIndex = CreateTextureResource(&workflow.specular_glossiness_texture, debugName.c_str(), true);
+				material.RoughnessMetalIndex = AddTextureResource(context, &workflow.specular_glossiness_texture, debugName.c_str(), true);
 				material.RoughnessFactor = 1 - workflow.glossiness_factor;
 				material.SpecularFactor = float3(workflow.specular_factor[0], workflow.specular_factor[1], workflow.specular_factor[2]);
 			}
@@ -383,76 +860,88 @@ namespace limbo::Gfx
 
 		{
 			std::string debugName = std::format(" Material({}) {}", index, "Normal");
-			material.NormalIndex = CreateTextureResource(&cgltfMaterial->normal_texture, debugName.c_str(), false);
+			material.NormalIndex = AddTextureResource(context, &cgltfMaterial->normal_texture, debugName.c_str(), false);
 		}
 
 		{
 			std::string debugName   = std::format(" Material({}) {}", index, "Emissive");
-			material.EmissiveIndex  = CreateTextureResource(&cgltfMaterial->emissive_texture, debugName.c_str(), false);
+			material.EmissiveIndex  = AddTextureResource(context, &cgltfMaterial->emissive_texture, debugName.c_str(), false);
 			material.EmissiveFactor = float3(cgltfMaterial->emissive_factor[0], cgltfMaterial->emissive_factor[1], cgltfMaterial->emissive_factor[2]);
 		}
 
 		{
 			std::string debugName			= std::format(" Material({}) {}", index, "AmbientOcclusion");
-			material.AmbientOcclusionIndex  = CreateTextureResource(&cgltfMaterial->occlusion_texture, debugName.c_str(), false);
+			material.AmbientOcclusionIndex  = AddTextureResource(context, &cgltfMaterial->occlusion_texture, debugName.c_str(), false);
 		}
 	}
 
 
-	void Scene::LoadTexture(const cgltf_texture* texture)
+	void Scene::LoadTextureImage(SceneImportContext& context, const cgltf_image* image, uint32 imageIndex)
 	{
-		if (!texture)
-			return;
+		const SceneImport::ImageUsage usage = SceneImport::GetImageUsage(context.ImageUsages, image);
+		const uint64 contentHash = HashEncodedImage(image, m_FolderPath, usage, context.SourceFiles);
+		{
+			std::scoped_lock<std::mutex> lock(context.TexturesMutex);
+			const auto [it, bInserted] = context.ImagesByHash.try_emplace(contentHash, imageIndex);
+			if (!bInserted)
+			{
+				context.ImageAliases[imageIndex] = it->second;
+				return;
+			}
+		}
 
 		TextureData data;
+		data.ContentHash = contentHash;
 
-		cgltf_image* image = texture->image;
-		if (image->uri)
+		if (image->uri && std::string_view(image->uri).find(".dds") != std::string_view::npos)
 		{
 			data.Name = image->uri;
 			std::string filename = std::string(m_FolderPath) + std::string(image->uri);
-			if (filename.find(".dds") != std::string::npos)
-			{
-				std::vector<uint8> filedata;
-				bool bIsValid = Utils::FileRead(filename.c_str(), filedata);
-				dds::Header header = dds::read_header(filedata.data(), filedata.size());
-				bIsValid &= header.is_valid();
-
-				if (!bIsValid)
-				{
-					LB_WARN("Failed to load texture");
-					return;
-				}
-
-				uint8* textureData = filedata.data() + header.data_offset(); 
-				data.Data = malloc(filedata.size());
-				memcpy(data.Data, textureData, filedata.size());
-
-				data.Width = header.width();
-				data.Height = header.height();
-				data.NumMips = header.mip_levels();
-				data.bGenerateMips = false;
-				data.Format = RHI::GetFormat((DXGI_FORMAT)header.format());
-			}
-			else
+			if (!LoadDDS(filename.c_str(), data))
 			{
-				data.Data = stbi_load(filename.c_str(), &data.Width, &data.Height, &data.Channels, 4);
-				data.NumMips = RHI::CalculateMipCount(data.Width);
-				data.bGenerateMips = true;
-				data.Format = RHI::Format::RGBA8_UNORM;
+				LB_WARN("Failed to load texture");
+				return;
 			}
 		}
 		else
 		{
-			data.Name = m_SceneName;
-			cgltf_buffer_view* bufferView = image->buffer_view;
-			cgltf_buffer* buffer = bufferView->buffer;
-			uint32 size = (uint32)bufferView->size;
-			void* bufferLocation = (uint8*)buffer->data + bufferView->offset;
-			data.Data = stbi_load_from_memory((stbi_uc*)bufferLocation, size, &data.Width, &data.Height, &data.Channels, 4);
-			data.NumMips = RHI::CalculateMipCount(data.Width);
-			data.bGenerateMips = true;
-			data.Format = RHI::Format::RGBA8_UNORM;
+			// The cooked texture is cached next to the file the image comes from
+			const TextureCompressor::TextureRole role = usage.Role;
+			std::string sourcePath;
+			std::string cachePath;
+			if (image->uri)
+			{
+				data.Name = image->uri;
+				sourcePath = std::string(m_FolderPath) + std::string(image->uri);
+				cachePath = std::format("{}.{}.dds", sourcePath, TextureCompressor::GetRoleName(role));
+			}
+			else
+			{
+				data.Name = m_SceneName;
+				const cgltf_buffer* buffer = image->buffer_view->buffer;
+				if (buffer->uri && strncmp(buffer->uri, "data:", 5) != 0)
+					sourcePath = std::string(m_FolderPath) + std::string(buffer->uri);
+				else
+					sourcePath = std::format("{}{}.{}", m_FolderPath, m_SceneName, m_Extension);
+				cachePath = std::format("{}{}.image{}.{}.dds", m_FolderPath, m_SceneName, imageIndex, TextureCompressor::GetRoleName(role));
+			}
+
+			if (!Utils::IsFileNewer(cachePath.c_str(), sourcePath.c_str()) || !LoadDDS(cachePath.c_str(), data))
+			{
+				data.Data = SceneImport::DecodeImage(image, sourcePath.c_str(), data.Width, data.Height, data.Channels);
+				if (data.Data)
+					CookTexture(data, usage, cachePath);
+			}
+
+			// Roughness and metal live in g and b, BC5 stores them in r and g
+			if (role == TextureCompressor::TextureRole::RoughnessMetal && data.Format == RHI::Format::BC5_UNORM)
+			{
+				data.ComponentMapping = D3D12_ENCODE_SHADER_4_COMPONENT_MAPPING(
+					D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_0,
+					D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_0,
+					D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_1,
+					D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_1);
+			}
 		}
 
 		if (!data.Data)
@@ -461,53 +950,98 @@ namespace limbo::Gfx
 			return;
 		}
 
-		std::scoped_lock<std::mutex> lock(m_AddToTextureMapMutex);
-		TexturesMap[(uintptr_t)texture] = (uint32)TextureStreams.size();
-		TextureStreams.emplace_back(data);
+		std::scoped_lock<std::mutex> lock(context.TexturesMutex);
+		context.TexturesMap[imageIndex] = (uint32)context.TextureStreams.size();
+		context.TextureStreams.emplace_back(data);
 	}
 
-	uint Scene::CreateTextureResource(const cgltf_texture_view* textureView, const std::string& debugName, bool bIsSRGB)
+	uint Scene::AddTextureResource(SceneImportContext& context, const cgltf_texture_view* textureView, const std::string& debugName, bool bIsSRGB)
 	{
-		if (!textureView->texture)
+		if (!textureView->texture || !textureView->texture->image)
 			return -1;
 
-		TextureData& textureData = TextureStreams.at(TexturesMap[(uintptr_t)textureView->texture]);
+		uint32 imageIndex = (uint32)(textureView->texture->image - context.Data->images);
+		if (auto alias = context.ImageAliases.find(imageIndex); alias != context.ImageAliases.end())
+			imageIndex = alias->second;
+
+		auto it = context.TexturesMap.find(imageIndex);
+		if (it == context.TexturesMap.end())
+			return -1;
+
+		const uint32 streamIndex = it->second;
+		TextureData& textureData = context.TextureStreams.at(streamIndex);
 		if (!textureData.Data)
 			return -1;
-		textureData.Name += debugName;
 
-		uint16 numMips = textureData.bGenerateMips ? 1u : textureData.NumMips;
-		RHI::TextureUsage usage = RHI::TextureUsage::ShaderResource;
-		if (textureData.bGenerateMips)
-			usage |= RHI::TextureUsage::UnorderedAccess;
+		const auto [resource, bIsNewResource] = context.TextureResourcesMap.try_emplace(((uint64)streamIndex << 1) | (bIsSRGB ? 1 : 0), (uint32)context.TextureResources.size());
+		if (!bIsNewResource)
+		{
+			context.NumSharedTextureResources++;
+			return resource->second;
+		}
+		textureData.Name += debugName;
 
 		RHI::Format format = bIsSRGB ? RHI::ConvertToSRGBFormat(textureData.Format) : textureData.Format;
 
-		RHI::TextureHandle texture = RHI::CreateTexture({
+		SceneCache::TextureEntry& entry = context.TextureResources.emplace_back();
+		entry = {
+			.ImageIndex = streamIndex,
 			.Width = (uint32)textureData.Width,
 			.Height = (uint32)textureData.Height,
+			.Format = (uint32)format,
 			.MipLevels = textureData.NumMips,
-			.DebugName = textureData.Name.c_str(),
-			.Flags = usage,
+			.ComponentMapping = textureData.ComponentMapping,
+		};
+		// The key of the texture in SharedTextures, the same image can be both an sRGB and a linear texture
+		entry.ContentHash = Algo::Hash64(&entry.Format, sizeof(entry.Format), textureData.ContentHash);
+		entry.ContentHash = Algo::Hash64(&entry.ComponentMapping, sizeof(entry.ComponentMapping), entry.ContentHash);
+		strncpy_s(entry.Name, textureData.Name.c_str(), _TRUNCATE);
+		return resource->second;
+	}
+
+	RHI::TextureHandle Scene::CreateStreamableTexture(const SceneCache::TextureEntry& entry, const uint8* mipChain, const std::string& sourcePath, uint64 sourceOffset)
+	{
+		const RHI::Format format = (RHI::Format)entry.Format;
+
+		// Only the tail of the chain is uploaded now, a texture without a file to read the other mips from stays fully resident
+		uint16 tailMip = 0;
+		if (!sourcePath.empty() && !Core::CommandLine::HasArg(LIMBO_CMD_NO_TEXTURE_STREAMING))
+			tailMip = GetStreamingTailMip(entry.Width, entry.Height, entry.MipLevels, format);
+
+		const uint64 tailOffset = GetResidentMipsSize(entry.Width, entry.Height, entry.MipLevels, format, 0) - GetResidentMipsSize(entry.Width, entry.Height, entry.MipLevels, format, tailMip);
+		const uint16 numMips = entry.MipLevels - tailMip;
+		RHI::TextureHandle texture = RHI::CreateTexture({
+			.Width = Math::Max(1u, entry.Width >> tailMip),
+			.Height = Math::Max(1u, entry.Height >> tailMip),
+			.MipLevels = numMips,
+			.DebugName = entry.Name,
+			.Flags = RHI::TextureUsage::ShaderResource,
 			.Format = format,
 			.Type = RHI::TextureType::Texture2D,
 			.InitialData = {
-				.Data = textureData.Data,
+				.Data = (void*)(mipChain + tailOffset),
 				.NumMips = numMips
-			}
+			},
+			.ComponentMapping = entry.ComponentMapping
 		});
 
-		if (textureData.bGenerateMips)
-			RHI::CommandContext::GetCommandContext()->GenerateMipLevels(texture);
-		m_Textures.push_back(texture);
-
-		RHI::Texture* t = RM_GET(texture);
-		if (!t)
-			return -1;
-		return t->SRV();
+		if (tailMip > 0)
+		{
+			m_StreamableTextures.push_back({
+				.Texture = texture,
+				.Width = entry.Width,
+				.Height = entry.Height,
+				.MipLevels = entry.MipLevels,
+				.TailMip = tailMip,
+				.Format = format,
+				.SourcePath = sourcePath,
+				.SourceOffset = sourceOffset,
+			});
+		}
+		return texture;
 	}
 
-	void Scene::ProcessMesh(const cgltf_node* node, const cgltf_mesh* mesh, const cgltf_primitive* primitive)
+	void Scene::ProcessMesh(SceneImportContext& context, uint32 nodeIndex, const cgltf_mesh* mesh, const cgltf_primitive* primitive)
 	{
 		std::string meshName;
 		if (mesh->name)
@@ -515,121 +1049,271 @@ namespace limbo::Gfx
 		else
 			meshName = m_SceneName;
 
-		PrimitiveData& primitiveData = PrimitivesStreams.emplace_back();
-
-		// process vertices
-		for (size_t attributeIndex = 0; attributeIndex < primitive->attributes_count; ++attributeIndex)
+		// The accessors are decoded later in a job, only the first time a primitive shows up
+		const auto [it, bIsNewPrimitive] = context.PrimitiveToGeometry.try_emplace(primitive, (uint32)context.PrimitivesStreams.size());
+		if (bIsNewPrimitive)
 		{
-			const cgltf_attribute& attribute = primitive->attributes[attributeIndex];
-
-			auto readAttributeData = [&attribute](const char* name, auto& stream, uint32 numComponents)
-			{
-				if (strcmp(attribute.name, name) == 0)
-				{
-					stream.resize(attribute.data->count);
-					for (size_t i = 0; i < attribute.data->count; ++i)
-					{
-						ensure(cgltf_accessor_read_float(attribute.data, i, &stream[i].x, numComponents));
-					}
-				}
-			};
-
-			readAttributeData("POSITION", primitiveData.PositionStream, 3);
-			readAttributeData("NORMAL", primitiveData.NormalsStream, 3);
-			readAttributeData("TANGENT", primitiveData.TangentsStream, 4);
-			readAttributeData("TEXCOORD_0", primitiveData.TexCoordsStream, 2);
+			SceneImport::PrimitiveData& primitiveData = context.PrimitivesStreams.emplace_back();
+			primitiveData.Primitive = primitive;
 		}
 
-		if (primitiveData.NormalsStream.empty() && !primitiveData.PositionStream.empty())
-			CalculateNormals(primitiveData);
-
-		if (primitiveData.TangentsStream.empty() && !primitiveData.TexCoordsStream.empty())
-			CalculateTangents(primitiveData);
-
-		// process indices
-		cgltf_accessor* indices = primitive->indices;
-		primitiveData.IndicesStream.resize(indices->count);
-		for (size_t idx = 0; idx < indices->count; ++idx)
-			primitiveData.IndicesStream[idx] = (uint32)cgltf_accessor_read_index(primitive->indices, idx);
-
 		cgltf_material* material = primitive->material;
 		Mesh& result = m_Meshes.emplace_back();
-		cgltf_node_transform_world(node, &result.Transform[0][0]);
+		result.GeometryIndex = it->second;
+		result.NodeIndex = nodeIndex;
 		result.LocalMaterialIndex = m_MaterialPtrToIndex[material];
 		result.bIsOpaque = material ? material->alpha_mode == cgltf_alpha_mode_opaque : true;
 		result.Name = meshName.c_str();
 	}
 
-	void Scene::ProcessPrimitivesData()
+	void Scene::ProcessPrimitivesData(SceneImportContext& context)
 	{
-		uint64 bufferSize = 0;
-		uint32 elementCount = 0;
+		const uint32 numPrimitives = (uint32)context.PrimitivesStreams.size();
 
-		for (size_t i = 0; i < PrimitivesStreams.size(); ++i)
+		// Exclusive scan over the primitive sizes, each unique primitive gets its own range of the geometry buffer
+		std::vector<uint64> primitiveOffsets(numPrimitives);
+		uint64 bufferSize = 0;
+		for (uint32 i = 0; i < numPrimitives; ++i)
 		{
-			CreateVertexStream(PrimitivesStreams[i]);
-			
-			// Optimize the mesh data and create the meshlets
-			OptimizePrimitiveData(PrimitivesStreams[i]);
-			CreateMeshlets(PrimitivesStreams[i]);
-
-			// Calculate the geometry buffer size
-			bufferSize += PrimitivesStreams[i].VerticesStream.size()   * sizeof(MeshVertex);
-			bufferSize += PrimitivesStreams[i].IndicesStream.size()    * sizeof(uint32);
-			bufferSize += PrimitivesStreams[i].Meshlets.size()		   * sizeof(Meshlet);
-			bufferSize += PrimitivesStreams[i].MeshletVertices.size()  * sizeof(uint32);
-			bufferSize += PrimitivesStreams[i].MeshletTriangles.size() * sizeof(Meshlet::Triangle);
+			primitiveOffsets[i] = bufferSize;
+			bufferSize += GetPrimitiveByteSize(context.PrimitivesStreams[i]);
 		}
 		check(bufferSize <= 0xffffffffu);
 
-		elementCount = (uint32)bufferSize / sizeof(uint32);
+		// The buffer does not exist yet, the views start at address 0 and are moved to the buffer when it is created
+		constexpr D3D12_GPU_VIRTUAL_ADDRESS geoBufferAddress = 0;
+
+		// Build the buffer contents on the CPU first, they are also written to the scene cache.
+		// The ranges are disjoint so every primitive can be written in parallel.
+		context.GeometryStream.resize(bufferSize);
+		uint8* data = context.GeometryStream.data();
+		std::vector<Mesh> geometries(numPrimitives);
+		Core::JobContext jobContext;
+		Core::JobSystem::ExecuteMany(jobContext, numPrimitives, 1, Core::TOnJobSystemExecuteMany::CreateLambda([data, &context, &primitiveOffsets, &geometries](Core::JobDispatchArgs args)
+		{
+			const uint32 i = args.jobIndex;
+			const SceneImport::PrimitiveData& primitiveData = context.PrimitivesStreams[i];
+			Mesh& mesh = geometries[i];
+
+			uint64 dataOffset = primitiveOffsets[i];
+			check(dataOffset % sizeof(uint32) == 0); // the offset is a 32bit value, do not let it overflow
+
+			SceneImport::ComputePositionQuantization(primitiveData.VerticesStream, mesh.PositionOffset, mesh.PositionScale);
+			PackVertexData(mesh.VerticesLocation, data, geoBufferAddress, dataOffset, primitiveData.VerticesStream, mesh.PositionOffset, mesh.PositionScale);
+
+			CopyMeshletData(mesh.MeshletsOffset, data, dataOffset, primitiveData.Meshlets);
+			CopyMeshletData(mesh.MeshletVerticesOffset, data, dataOffset, primitiveData.MeshletVertices);
+			CopyMeshletData(mesh.MeshletTrianglesOffset, data, dataOffset, primitiveData.MeshletTriangles);
+
+			// The view only covers LOD 0, the other LODs come right after it
+			const MeshLOD& lod0 = primitiveData.LODs[0];
+			const RHI::Format indexFormat = GetIndexFormat(primitiveData.VerticesStream.size());
+			mesh.IndicesLocation = {
+				.BufferLocation = geoBufferAddress + dataOffset,
+				.SizeInBytes = lod0.IndexCount * RHI::GetFormatInfo(indexFormat).BytesPerBlock,
+				.Offset = (uint32)dataOffset,
+				.Format = indexFormat
+			};
+			if (indexFormat == RHI::Format::R16_UINT)
+			{
+				uint16* indices = (uint16*)(data + dataOffset);
+				for (size_t index = 0; index < primitiveData.IndicesStream.size(); ++index)
+					indices[index] = (uint16)primitiveData.IndicesStream[index];
+			}
+			else
+			{
+				memcpy(data + dataOffset, primitiveData.IndicesStream.data(), primitiveData.IndicesStream.size() * sizeof(uint32));
+			}
+			dataOffset += GetIndicesByteSize(primitiveData);
+			check(dataOffset == primitiveOffsets[i] + GetPrimitiveByteSize(primitiveData));
+
+			mesh.IndexCount    = lod0.IndexCount;
+			mesh.VertexCount   = primitiveData.VerticesStream.size();
+			mesh.MeshletsCount = lod0.MeshletCount;
+			mesh.NumLODs       = (uint32)primitiveData.LODs.size();
+			memcpy(mesh.LODs, primitiveData.LODs.data(), mesh.NumLODs * sizeof(MeshLOD));
+			mesh.BoundingSphere = SceneImport::ComputeBoundingSphere(primitiveData.VerticesStream);
+			context.NumStepsDone++;
+		}));
+		Core::JobSystem::Wait(jobContext);
+
+		// The meshes that instance the same primitive only differ in their transform
+		for (Mesh& mesh : m_Meshes)
+			CopyMeshGeometry(geometries[mesh.GeometryIndex], mesh);
+		m_BLASes.resize(numPrimitives);
+	}
+
+	D3D12_GPU_VIRTUAL_ADDRESS Scene::CreateGeometryBuffer(uint64 size)
+	{
+		check(size <= 0xffffffffu);
 
 		std::string debugName = std::format("{}_GeometryBuffer", m_SceneName);
 		m_GeometryBuffer = RHI::CreateBuffer({
 			.DebugName = debugName.c_str(),
-			.NumElements = elementCount,
-			.ByteSize = bufferSize,
+			.NumElements = (uint32)size / sizeof(uint32),
+			.ByteSize = size,
 			.Flags = RHI::BufferUsage::Byte | RHI::BufferUsage::ShaderResourceView
 		});
-		D3D12_GPU_VIRTUAL_ADDRESS geoBufferAddress = RM_GET(m_GeometryBuffer)->Resource->GetGPUVirtualAddress();
+		return RM_GET(m_GeometryBuffer)->Resource->GetGPUVirtualAddress();
+	}
 
-		RHI::BufferHandle upload = RHI::CreateBuffer({
+	uint64 Scene::UploadGeometryBuffer(SceneImportContext& context, const uint8* data, uint64 size)
+	{
+		std::string debugName = std::format("{}_GeometryBuffer_Upload", m_SceneName);
+		context.GeometryUpload = RHI::CreateBuffer({
 			.DebugName = debugName.c_str(),
-			.ByteSize = bufferSize,
+			.ByteSize = size,
 			.Flags = RHI::BufferUsage::Upload
 		});
 
-		RHI::Buffer* pUploadBuffer = RM_GET(upload);
+		RHI::Buffer* pUploadBuffer = RM_GET(context.GeometryUpload);
 		pUploadBuffer->Map();
-		uint8* data = (uint8*)pUploadBuffer->MappedData;
-		uint64 dataOffset = 0;
-		for (size_t i = 0; i < PrimitivesStreams.size(); ++i)
+
+		// Split the copy in chunks, a single thread does not saturate the bandwidth to the upload heap
+		constexpr uint64 chunkSize = 4 * 1024 * 1024;
+		uint8* uploadData = (uint8*)pUploadBuffer->MappedData;
+		Core::JobContext jobContext;
+		Core::JobSystem::ExecuteMany(jobContext, (uint32)Math::DivideAndRoundUp(size, chunkSize), 1, Core::TOnJobSystemExecuteMany::CreateLambda([uploadData, data, size](Core::JobDispatchArgs args)
 		{
-			check(dataOffset % sizeof(uint32) == 0); // the offset is a 32bit value, do not let it overflow
+			const uint64 offset = args.jobIndex * chunkSize;
+			memcpy(uploadData + offset, data + offset, Math::Min(chunkSize, size - offset));
+		}));
+		Core::JobSystem::Wait(jobContext);
+
+		// On the copy queue like the texture uploads, so the copy does not wait for the frame.
+		// The buffer decays to the common state once the copy is done and the direct queue promotes it from there.
+		RHI::CommandContext* cmd = RHI::CommandContext::GetCommandContext(RHI::ContextType::Copy);
+		cmd->CopyBufferToBuffer(context.GeometryUpload, m_GeometryBuffer, size);
+		RM_GET(m_GeometryBuffer)->bResetState = true;
+		return cmd->Execute();
+	}
 
-			CopyVertexData(m_Meshes[i].VerticesLocation, data, geoBufferAddress, dataOffset, PrimitivesStreams[i].VerticesStream);
+	bool Scene::LoadFromCache(SceneImportContext& context)
+	{
+		SceneCache::Reader& reader = context.Cache;
+		if (!reader.Open(context.CachePath.c_str(), context.SourceHash))
+			return false;
+
+		// The file stays mapped until the GPU resources are created, the textures and the geometry are uploaded straight from it.
+		// Until then the materials point to the texture table and the views start at address 0, like a fresh import.
+		context.bFromCache = true;
+		Materials.assign(reader.GetMaterials().begin(), reader.GetMaterials().end());
+
+		Span<SceneCache::MeshEntry> meshes = reader.GetMeshes();
+		m_Meshes.reserve(meshes.GetSize());
+		for (const SceneCache::MeshEntry& entry : meshes)
+		{
+			Mesh& mesh = m_Meshes.emplace_back();
+			mesh.VerticesLocation = {
+				.BufferLocation = entry.VerticesOffset,
+				.SizeInBytes = entry.VerticesSize,
+				.StrideInBytes = sizeof(PackedMeshVertex),
+				.Offset = entry.VerticesOffset
+			};
+			mesh.IndicesLocation = {
+				.BufferLocation = entry.IndicesOffset,
+				.SizeInBytes = entry.IndicesSize,
+				.Offset = entry.IndicesOffset,
+				.Format = GetIndexFormat(entry.VertexCount)
+			};
+			mesh.MeshletsOffset			= entry.MeshletsOffset;
+			mesh.MeshletVerticesOffset	= entry.MeshletVerticesOffset;
+			mesh.MeshletTrianglesOffset	= entry.MeshletTrianglesOffset;
+			mesh.LocalMaterialIndex		= entry.LocalMaterialIndex;
+			mesh.bIsOpaque				= entry.bIsOpaque;
+			mesh.NodeIndex				= entry.NodeIndex;
+			mesh.BoundingSphere			= entry.BoundingSphere;
+			mesh.PositionOffset			= entry.PositionOffset;
+			mesh.PositionScale			= entry.PositionScale;
+			mesh.IndexCount				= entry.IndexCount;
+			mesh.VertexCount			= entry.VertexCount;
+			mesh.MeshletsCount			= entry.MeshletsCount;
+			mesh.NumLODs				= entry.NumLODs;
+			memcpy(mesh.LODs, entry.LODs, sizeof(mesh.LODs));
+			mesh.Name					= m_SceneName;
+			mesh.GeometryIndex			= entry.GeometryIndex;
+			m_BLASes.resize(Math::Max((size_t)entry.GeometryIndex + 1, m_BLASes.size()));
+		}
 
-			CopyMeshletData(m_Meshes[i].MeshletsOffset, data, dataOffset, PrimitivesStreams[i].Meshlets);
-			CopyMeshletData(m_Meshes[i].MeshletVerticesOffset, data, dataOffset, PrimitivesStreams[i].MeshletVertices);
-			CopyMeshletData(m_Meshes[i].MeshletTrianglesOffset, data, dataOffset, PrimitivesStreams[i].MeshletTriangles);
+		Span<SceneCache::NodeEntry> nodes = reader.GetNodes();
+		m_Transforms.Reserve(nodes.GetSize());
+		for (const SceneCache::NodeEntry& entry : nodes)
+			m_Transforms.AddNode(entry.Parent, entry.Translation, quat(entry.Rotation.w, entry.Rotation.x, entry.Rotation.y, entry.Rotation.z), entry.Scale);
 
-			size_t streamSize = PrimitivesStreams[i].IndicesStream.size() * sizeof(uint32);
-			m_Meshes[i].IndicesLocation = {
-				.BufferLocation = geoBufferAddress + dataOffset,
-				.SizeInBytes = (uint32)streamSize,
-				.Offset = (uint32)dataOffset
+		m_Transforms.Update();
+		for (Mesh& mesh : m_Meshes)
+			mesh.Transform = m_Transforms.GetWorldMatrix(mesh.NodeIndex);
+
+		BuildBVH();
+		return true;
+	}
+
+	void Scene::WriteCache(const SceneImportContext& context)
+	{
+		// The materials still point to the texture table, which is what the cache stores
+		std::vector<SceneCache::MeshEntry> meshes;
+		meshes.reserve(m_Meshes.size());
+		for (const Mesh& mesh : m_Meshes)
+		{
+			SceneCache::MeshEntry& entry = meshes.emplace_back();
+			entry = {
+				.BoundingSphere = mesh.BoundingSphere,
+				.PositionOffset = mesh.PositionOffset,
+				.PositionScale = mesh.PositionScale,
+				.VerticesOffset = mesh.VerticesLocation.Offset,
+				.VerticesSize = mesh.VerticesLocation.SizeInBytes,
+				.IndicesOffset = mesh.IndicesLocation.Offset,
+				.IndicesSize = mesh.IndicesLocation.SizeInBytes,
+				.MeshletsOffset = mesh.MeshletsOffset,
+				.MeshletVerticesOffset = mesh.MeshletVerticesOffset,
+				.MeshletTrianglesOffset = mesh.MeshletTrianglesOffset,
+				.LocalMaterialIndex = mesh.LocalMaterialIndex,
+				.IndexCount = (uint32)mesh.IndexCount,
+				.VertexCount = (uint32)mesh.VertexCount,
+				.MeshletsCount = (uint32)mesh.MeshletsCount,
+				.bIsOpaque = mesh.bIsOpaque,
+				.NumLODs = mesh.NumLODs,
+				.GeometryIndex = mesh.GeometryIndex,
+				.NodeIndex = mesh.NodeIndex,
 			};
-			memcpy(data + dataOffset, PrimitivesStreams[i].IndicesStream.data(), streamSize);
-			dataOffset += streamSize;
+			memcpy(entry.LODs, mesh.LODs, sizeof(entry.LODs));
+		}
 
-			m_Meshes[i].IndexCount    = PrimitivesStreams[i].IndicesStream.size();
-			m_Meshes[i].VertexCount   = PrimitivesStreams[i].VerticesStream.size();
-			m_Meshes[i].MeshletsCount = PrimitivesStreams[i].Meshlets.size();
+		std::vector<SceneCache::NodeEntry> nodes(m_Transforms.NumNodes());
+		for (uint32 i = 0; i < m_Transforms.NumNodes(); ++i)
+		{
+			const quat& rotation = m_Transforms.GetRotation(i);
+			nodes[i] = {
+				.Parent = m_Transforms.GetParent(i),
+				.Translation = m_Transforms.GetTranslation(i),
+				.Rotation = float4(rotation.x, rotation.y, rotation.z, rotation.w),
+				.Scale = m_Transforms.GetScale(i),
+			};
 		}
-		check(dataOffset <= 0xffffffffu);
 
-		RHI::CommandContext::GetCommandContext()->CopyBufferToBuffer(upload, m_GeometryBuffer, bufferSize);
-		RHI::CommandContext::GetCommandContext()->InsertResourceBarrier(m_GeometryBuffer, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER | D3D12_RESOURCE_STATE_INDEX_BUFFER | D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE);
-		DestroyBuffer(upload);
+		std::vector<SceneCache::ImageBlob> images;
+		images.reserve(context.TextureStreams.size());
+		for (const TextureData& texture : context.TextureStreams)
+			images.push_back({ texture.Data, texture.DataSize });
+
+		Core::Timer timer;
+		const SceneCache::CookedScene cookedScene = {
+			.Meshes = meshes,
+			.Nodes = nodes,
+			.Materials = Materials,
+			.Images = images,
+			.Textures = context.TextureResources,
+			.SourceFiles = context.SourceFiles.GetFiles(),
+			.Geometry = context.GeometryStream,
+		};
+		if (SceneCache::Write(context.CachePath.c_str(), context.SourceHash, cookedScene))
+		{
+			LB_LOG("Wrote scene cache %s (took %.3fs)", context.CachePath.c_str(), timer.ElapsedSeconds());
+		}
+		else
+		{
+			LB_WARN("Failed to write scene cache %s", context.CachePath.c_str());
+		}
+		m_Report.AddStage("Write cache", timer.ElapsedMilliseconds());
 	}
 }
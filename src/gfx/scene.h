@@ -1,19 +1,24 @@
 #pragma once
 
+#include "meshlod.h"
+#include "instancebvh.h"
+#include "transformhierarchy.h"
+#include "scenereport.h"
 #include "core/math.h"
+#include "core/jobsystem.h"
 #include "gfx/shaderinterop.h"
 #include "rhi/resourcemanager.h"
 #include "rhi/definitions.h"
 
 #include <cgltf/cgltf.h>
 #include <CppDelegates/Delegates.h>
-#include <mutex>
 
 struct cgltf_node;
 struct cgltf_scene;
 struct cgltf_mesh;
 struct cgltf_primitive;
 struct cgltf_texture_view;
+struct cgltf_image;
 struct cgltf_material;
 
 namespace limbo::RHI
@@ -22,8 +27,15 @@ namespace limbo::RHI
 	class Buffer;
 }
 
+namespace limbo::Gfx::SceneCache
+{
+	struct TextureEntry;
+}
+
 namespace limbo::Gfx
 {
+	struct SceneImportContext;
+
 	struct Mesh
 	{
 		// Positions in the geometry buffer
@@ -34,27 +46,80 @@ namespace limbo::Gfx
 		uint32						MeshletVerticesOffset;
 		uint32						MeshletTrianglesOffset;
 
-		RHI::BufferHandle			BLAS;
-
 		uint32						LocalMaterialIndex;
 		bool						bIsOpaque;
 		uint32						InstanceID;
 
+		// Meshes instancing the same glTF primitive share its geometry and its BLAS
+		uint32						GeometryIndex = 0;
+
+		// Node of the scene transform hierarchy, Transform is its world matrix
+		uint32						NodeIndex = 0;
 		float4x4					Transform;
+		float4						BoundingSphere; // xyz center and w radius, in local space
+		Math::AABB					WorldBounds;
+
+		// Dequantization of the packed vertex positions, position = PositionOffset + unorm * PositionScale
+		float3						PositionOffset = float3(0.0f);
+		float3						PositionScale = float3(1.0f);
 
+		// Counts of LOD 0, the ray tracing always uses it
 		size_t						IndexCount = 0;
 		size_t						VertexCount = 0;
 		size_t						MeshletsCount = 0;
 
+		MeshLOD						LODs[MaxMeshLODs];
+		uint32						NumLODs = 0;
+
 		const char*					Name;
+
+		// Takes the packed unorm positions to local space
+		float4x4 GetPositionDequantization() const
+		{
+			float4x4 result(1.0f);
+			result[0][0] = PositionScale.x;
+			result[1][1] = PositionScale.y;
+			result[2][2] = PositionScale.z;
+			result[3] = float4(PositionOffset, 1.0f);
+			return result;
+		}
+
+		// The indices of every LOD come one after the other, LOD 0 is the same as IndicesLocation
+		RHI::IndexBufferView GetLODIndices(uint32 lod) const
+		{
+			const uint32 indexSize = RHI::GetFormatInfo(IndicesLocation.Format).BytesPerBlock;
+			const uint32 offset = LODs[lod].FirstIndex * indexSize;
+			return {
+				.BufferLocation = IndicesLocation.BufferLocation + offset,
+				.SizeInBytes = LODs[lod].IndexCount * indexSize,
+				.Offset = IndicesLocation.Offset + offset,
+				.Format = IndicesLocation.Format
+			};
+		}
 	};
 	DECLARE_DELEGATE(TOnDrawMesh, const Mesh&);
 	DECLARE_DELEGATE(TOnDrawMeshNoConst, Mesh&);
 
+	// A scene texture created with only the tail of its mip chain, the texture streamer reads the other mips from the source file
+	struct StreamableTexture
+	{
+		RHI::TextureHandle			Texture;
+		uint32						Width;
+		uint32						Height;
+		uint16						MipLevels;
+		uint16						TailMip;
+		RHI::Format					Format;
+
+		std::string					SourcePath;
+		uint64						SourceOffset; // where the first mip of the full chain starts in the source file
+	};
+
 	class Scene
 	{
 		std::vector<Mesh>								m_Meshes;
-		std::vector<RHI::TextureHandle>					m_Textures;
+		// Keys of the textures in SharedTextures, they can be shared with the other scenes
+		std::vector<uint64>								m_TextureKeys;
+		std::vector<StreamableTexture>					m_StreamableTextures;
 		char											m_FolderPath[256];
 		char											m_SceneName[128];
 		char											m_Extension[16];
@@ -63,17 +128,27 @@ namespace limbo::Gfx
 
 		// this will contains all the geometry information about all the meshes
 		RHI::BufferHandle								m_GeometryBuffer;
+		// One per unique geometry, built by the acceleration structure the first time it is needed
+		std::vector<RHI::BufferHandle>					m_BLASes;
 
-		std::mutex										m_AddToTextureMapMutex;
+		TransformHierarchy								m_Transforms;
+
+		// World space box of each mesh, indexed like m_Meshes
+		std::vector<Math::AABB>							m_MeshBounds;
+		InstanceBVH										m_BVH;
+
+		SceneReport										m_Report;
 
 	public:
 		std::vector<Material>							Materials;
 
+		friend class AsyncSceneLoad;
+
 	protected:
 		Scene() = default;
-		Scene(const char* path);
 
 	public:
+		// Loads the scene on the calling thread and waits for its uploads, see AsyncSceneLoad to keep rendering while a scene loads
 		static Scene* Load(const char* path);
 		void Destroy();
 
@@ -81,17 +156,102 @@ namespace limbo::Gfx
 		void IterateMeshesNoConst(TOnDrawMeshNoConst drawDelegate);
 
 		uint32 NumMeshes() const { return (uint32)m_Meshes.size(); }
+		const Mesh& GetMesh(uint32 index) const { return m_Meshes[index]; }
 
 		RHI::Buffer* GetGeometryBuffer() const { return RM_GET(m_GeometryBuffer); }
 
+		uint32 NumGeometries() const { return (uint32)m_BLASes.size(); }
+		RHI::BufferHandle GetBLAS(uint32 geometryIndex) const { return m_BLASes[geometryIndex]; }
+		void SetBLAS(uint32 geometryIndex, RHI::BufferHandle blas) { m_BLASes[geometryIndex] = blas; }
+
+		const std::vector<StreamableTexture>& GetStreamableTextures() const { return m_StreamableTextures; }
+
+		// Moving a node moves every mesh under it, the changes are picked up by UpdateTransforms()
+		TransformHierarchy& GetTransforms() { return m_Transforms; }
+		// Propagates the node transforms that changed since the last call, the meshes that moved are added to the list
+		void UpdateTransforms(std::vector<const Mesh*>& outMovedMeshes);
+
+		// The instances of the BVH are the mesh indices
+		const InstanceBVH& GetBVH() const { return m_BVH; }
+		const Math::AABB& GetMeshBounds(uint32 meshIndex) const { return m_MeshBounds[meshIndex]; }
+
+		// Memory and load time of the scene, the BLAS sizes are read again on every call
+		const SceneReport& GetReport();
+		// Writes the report as JSON next to the scene file
+		bool WriteReport();
+
 	private:
-		void ProcessNode(const cgltf_node* node);
-		void ProcessMaterial(cgltf_material* cgltfMaterial);
-		void ProcessMesh(const cgltf_node* node, const cgltf_mesh* mesh, const cgltf_primitive* primitive);
-		void ProcessPrimitivesData();
+		// CPU side of the load, can run on any thread. Fills the meshes, the nodes and the materials, the materials point to the
+		// texture table of the context and the mesh views start at address 0 until CreateGPUResources() is called.
+		bool Import(SceneImportContext& context);
+		// Has to run on the render thread, returns the copy queue fence value the scene can be used after
+		uint64 CreateGPUResources(SceneImportContext& context);
+
+		void ProcessNode(SceneImportContext& context, const cgltf_node* node, uint32 parentIndex);
+		void ProcessMaterial(SceneImportContext& context, cgltf_material* cgltfMaterial);
+		void ProcessMesh(SceneImportContext& context, uint32 nodeIndex, const cgltf_mesh* mesh, const cgltf_primitive* primitive);
+		void ProcessPrimitivesData(SceneImportContext& context);
+		void BuildBVH();
+		// The geometries are read back from the views of the meshes, so it works for an import and for the cache
+		void ReportGeometries(uint64 geometrySize);
+
+		D3D12_GPU_VIRTUAL_ADDRESS CreateGeometryBuffer(uint64 size);
+		uint64 UploadGeometryBuffer(SceneImportContext& context, const uint8* data, uint64 size);
+
+		bool LoadFromCache(SceneImportContext& context);
+		void WriteCache(const SceneImportContext& context);
+
+		void LoadTextureImage(SceneImportContext& context, const cgltf_image* image, uint32 imageIndex);
+		// Returns the index in the texture table of the context
+		uint AddTextureResource(SceneImportContext& context, const cgltf_texture_view* textureView, const std::string& debugName, bool bIsSRGB);
+		RHI::TextureHandle CreateStreamableTexture(const SceneCache::TextureEntry& entry, const uint8* mipChain, const std::string& sourcePath, uint64 sourceOffset);
+	};
+
+	enum class SceneLoadStage : uint8
+	{
+		Parsing,
+		Importing,
+		WritingCache,
+		Uploading,
+		Ready,
+		Failed
+	};
+
+	/**
+	 * Loads a scene while the frames keep rendering.
+	 *
+	 * The parse, the texture decode, the geometry processing and the cache write run in a background job, the Wait() calls of
+	 * the frame never end up running them. Update() has to be called from the render thread, once the job is done it creates
+	 * the GPU resources and records the uploads on the copy queue.
+	 * The scene can be taken when the copy queue is done with them.
+	 */
+	class AsyncSceneLoad
+	{
+		std::string					m_Path;
+		Scene*						m_Scene = nullptr;
+		SceneImportContext*			m_Context = nullptr;
+		Core::JobContext			m_JobContext;
+		uint64						m_UploadFenceValue = 0;
+		SceneLoadStage				m_Stage = SceneLoadStage::Parsing;
+
+	public:
+		explicit AsyncSceneLoad(const char* path);
+		// Waits for the import job and the uploads that are in flight
+		~AsyncSceneLoad();
+
+		AsyncSceneLoad(const AsyncSceneLoad&) = delete;
+		AsyncSceneLoad& operator=(const AsyncSceneLoad&) = delete;
+
+		// Returns true once the load is over, TakeScene() returns the scene if it did not fail
+		bool Update();
+		// The caller owns the scene from now on
+		Scene* TakeScene();
 
-		void LoadTexture(const cgltf_texture* texture);
-		uint CreateTextureResource(const cgltf_texture_view* textureView, const std::string& debugName, bool bIsSRGB);
+		SceneLoadStage GetStage() const;
+		const char* GetStageName() const;
+		// Of the import steps, the upload is not counted
+		float GetProgress() const;
+		const char* GetPath() const;
 	};
 
 	inline Scene* LoadScene(const char* path)
@@ -0,0 +1,311 @@
+#include "stdafx.h"
+#include "scenecache.h"
+#include "core/algo.h"
+#include "core/paths.h"
+
+#include <cgltf/cgltf.h>
+
+namespace limbo::Gfx::SceneCache
+{
+	namespace
+	{
+		constexpr uint64 SectionAlignment = 16;
+
+		bool IsExternalUri(const char* uri)
+		{
+			return uri && strncmp(uri, "data:", 5) != 0;
+		}
+	}
+
+	std::string GetCachePath(const char* scenePath)
+	{
+		char folderPath[256];
+		char sceneName[128];
+		Paths::GetPath(scenePath, folderPath);
+		Paths::GetFilename(scenePath, sceneName);
+		return std::format("{}{}.lbscene", folderPath, sceneName);
+	}
+
+	void SourceFileHashes::SetRecorded(Span<SourceFileEntry> files)
+	{
+		std::scoped_lock<std::mutex> lock(m_Mutex);
+		for (const SourceFileEntry& file : files)
+			m_Recorded[std::string(file.Path, strnlen(file.Path, sizeof(file.Path)))] = file;
+	}
+
+	uint64 SourceFileHashes::HashFile(const char* folderPath, const char* relativePath)
+	{
+		const std::string filename = std::string(folderPath) + relativePath;
+		SourceFileEntry file = {};
+		if (!Utils::GetFileStamp(filename.c_str(), file.Size, file.WriteTime))
+		{
+			// A missing dependency still has to change the hash, otherwise a stale cache could be used
+			return Algo::Hash64(relativePath, strlen(relativePath));
+		}
+
+		{
+			std::scoped_lock<std::mutex> lock(m_Mutex);
+			if (auto it = m_FileIndices.find(relativePath); it != m_FileIndices.end())
+				return m_Files[it->second].ContentHash;
+
+			auto recorded = m_Recorded.find(relativePath);
+			if (recorded != m_Recorded.end() && recorded->second.Size == file.Size && recorded->second.WriteTime == file.WriteTime)
+			{
+				m_FileIndices.emplace(relativePath, (uint32)m_Files.size());
+				m_Files.push_back(recorded->second);
+				return recorded->second.ContentHash;
+			}
+		}
+
+		// Outside of the lock, the other jobs keep going while this one reads
+		std::vector<uint8> filedata;
+		if (!Utils::FileRead(filename.c_str(), filedata))
+			return Algo::Hash64(relativePath, strlen(relativePath));
+		file.ContentHash = Algo::Hash64(filedata.data(), filedata.size());
+
+		// A path that does not fit is never recorded, the file is hashed on every load
+		if (strlen(relativePath) >= sizeof(file.Path))
+			return file.ContentHash;
+		strncpy_s(file.Path, relativePath, _TRUNCATE);
+
+		std::scoped_lock<std::mutex> lock(m_Mutex);
+		const auto [it, bInserted] = m_FileIndices.try_emplace(relativePath, (uint32)m_Files.size());
+		if (bInserted)
+		{
+			m_Files.push_back(file);
+			m_bHasChangedFiles |= m_Recorded.contains(relativePath);
+		}
+		return m_Files[it->second].ContentHash;
+	}
+
+	uint64 ComputeSourceHash(const char* scenePath, const char* folderPath, const cgltf_data* data, SourceFileHashes& sourceFiles)
+	{
+		// Seed with the layout of the cooked structures so a change in any of them invalidates old caches even if the version was not bumped
+		const uint32 layout[] = { Version, sizeof(PackedMeshVertex), sizeof(Meshlet), sizeof(Material), sizeof(MeshEntry), sizeof(TextureEntry) };
+		uint64 hash = Algo::Hash64(layout, sizeof(layout));
+
+		auto hashFile = [&](const char* relativePath)
+		{
+			const uint64 fileHash = sourceFiles.HashFile(folderPath, relativePath);
+			hash = Algo::Hash64(&fileHash, sizeof(fileHash), hash);
+		};
+
+		// The folder is the start of the scene path
+		hashFile(scenePath + strlen(folderPath));
+
+		for (size_t i = 0; i < data->buffers_count; ++i)
+		{
+			if (IsExternalUri(data->buffers[i].uri))
+				hashFile(data->buffers[i].uri);
+		}
+
+		for (size_t i = 0; i < data->images_count; ++i)
+		{
+			if (IsExternalUri(data->images[i].uri))
+				hashFile(data->images[i].uri);
+		}
+
+		return hash;
+	}
+
+	bool Write(const char* cachePath, uint64 sourceHash, const CookedScene& scene)
+	{
+		Header header = {
+			.Magic = Magic,
+			.Version = Version,
+			.SourceHash = sourceHash,
+			.NumMeshes = scene.Meshes.GetSize(),
+			.NumNodes = scene.Nodes.GetSize(),
+			.NumMaterials = scene.Materials.GetSize(),
+			.NumImages = scene.Images.GetSize(),
+			.NumTextures = scene.Textures.GetSize(),
+			.NumSourceFiles = scene.SourceFiles.GetSize(),
+		};
+
+		// Layout: header, tables, geometry and then the image data. Every section is aligned so it can be read in place from the mapped file.
+		uint64 size = sizeof(Header);
+		auto reserveSection = [&size](uint64 sectionSize) -> uint64
+		{
+			uint64 offset = Math::Align(size, SectionAlignment);
+			size = offset + sectionSize;
+			return offset;
+		};
+
+		header.MeshesOffset		= reserveSection(sizeof(MeshEntry) * header.NumMeshes);
+		header.NodesOffset		= reserveSection(sizeof(NodeEntry) * header.NumNodes);
+		header.MaterialsOffset	= reserveSection(sizeof(Material) * header.NumMaterials);
+		header.ImagesOffset		= reserveSection(sizeof(ImageEntry) * header.NumImages);
+		header.TexturesOffset	= reserveSection(sizeof(TextureEntry) * header.NumTextures);
+		header.SourceFilesOffset = reserveSection(sizeof(SourceFileEntry) * header.NumSourceFiles);
+		header.GeometrySize		= scene.Geometry.GetSize();
+		header.GeometryOffset	= reserveSection(header.GeometrySize);
+
+		std::vector<ImageEntry> images(header.NumImages);
+		for (uint32 i = 0; i < header.NumImages; ++i)
+		{
+			images[i].DataSize = scene.Images[i].Size;
+			images[i].DataOffset = reserveSection(images[i].DataSize);
+		}
+		header.FileSize = size;
+
+		std::vector<uint8> filedata(size, 0);
+		auto writeSection = [&filedata](uint64 offset, const void* data, uint64 sectionSize)
+		{
+			if (sectionSize > 0)
+				memcpy(filedata.data() + offset, data, sectionSize);
+		};
+
+		writeSection(0, &header, sizeof(Header));
+		writeSection(header.MeshesOffset, scene.Meshes.begin(), sizeof(MeshEntry) * header.NumMeshes);
+		writeSection(header.NodesOffset, scene.Nodes.begin(), sizeof(NodeEntry) * header.NumNodes);
+		writeSection(header.MaterialsOffset, scene.Materials.begin(), sizeof(Material) * header.NumMaterials);
+		writeSection(header.ImagesOffset, images.data(), sizeof(ImageEntry) * header.NumImages);
+		writeSection(header.TexturesOffset, scene.Textures.begin(), sizeof(TextureEntry) * header.NumTextures);
+		writeSection(header.SourceFilesOffset, scene.SourceFiles.begin(), sizeof(SourceFileEntry) * header.NumSourceFiles);
+		writeSection(header.GeometryOffset, scene.Geometry.begin(), header.GeometrySize);
+		for (uint32 i = 0; i < header.NumImages; ++i)
+			writeSection(images[i].DataOffset, scene.Images[i].Data, images[i].DataSize);
+
+		return Utils::FileWrite(cachePath, filedata.data(), filedata.size());
+	}
+
+	bool ReadSourceFiles(const char* cachePath, uint64& outSourceHash, std::vector<SourceFileEntry>& outFiles)
+	{
+		Header header;
+		if (!Utils::FileReadRange(cachePath, 0, sizeof(Header), &header))
+			return false;
+
+		if (header.Magic != Magic || header.Version != Version || header.NumSourceFiles > header.FileSize / sizeof(SourceFileEntry))
+			return false;
+
+		outSourceHash = header.SourceHash;
+		outFiles.resize(header.NumSourceFiles);
+		return Utils::FileReadRange(cachePath, header.SourceFilesOffset, sizeof(SourceFileEntry) * header.NumSourceFiles, outFiles.data());
+	}
+
+	bool WriteSourceFiles(const char* cachePath, Span<SourceFileEntry> files)
+	{
+		Header header;
+		if (!Utils::FileReadRange(cachePath, 0, sizeof(Header), &header))
+			return false;
+
+		if (header.Magic != Magic || header.Version != Version || header.NumSourceFiles != files.GetSize())
+			return false;
+
+		return Utils::FileWriteRange(cachePath, header.SourceFilesOffset, files.begin(), sizeof(SourceFileEntry) * files.GetSize());
+	}
+
+	bool Reader::Open(const char* cachePath, uint64 sourceHash)
+	{
+		Close();
+
+		if (!m_File.Open(cachePath))
+			return false;
+
+		if (m_File.GetSize() < sizeof(Header))
+		{
+			Close();
+			return false;
+		}
+
+		const Header* header = GetSection<Header>(0);
+		if (header->Magic != Magic || header->Version != Version || header->SourceHash != sourceHash || header->FileSize != m_File.GetSize())
+		{
+			Close();
+			return false;
+		}
+
+		// Make sure a truncated or corrupted file is not read out of bounds
+		auto isInBounds = [header](uint64 offset, uint64 sectionSize)
+		{
+			return offset <= header->FileSize && sectionSize <= header->FileSize - offset;
+		};
+
+		bool bIsValid = isInBounds(header->MeshesOffset, sizeof(MeshEntry) * header->NumMeshes);
+		bIsValid &= isInBounds(header->NodesOffset, sizeof(NodeEntry) * header->NumNodes);
+		bIsValid &= isInBounds(header->MaterialsOffset, sizeof(Material) * header->NumMaterials);
+		bIsValid &= isInBounds(header->ImagesOffset, sizeof(ImageEntry) * header->NumImages);
+		bIsValid &= isInBounds(header->TexturesOffset, sizeof(TextureEntry) * header->NumTextures);
+		bIsValid &= isInBounds(header->SourceFilesOffset, sizeof(SourceFileEntry) * header->NumSourceFiles);
+		bIsValid &= isInBounds(header->GeometryOffset, header->GeometrySize);
+		if (bIsValid)
+		{
+			const ImageEntry* images = GetSection<ImageEntry>(header->ImagesOffset);
+			for (uint32 i = 0; i < header->NumImages; ++i)
+				bIsValid &= isInBounds(images[i].DataOffset, images[i].DataSize);
+
+			const TextureEntry* textures = GetSection<TextureEntry>(header->TexturesOffset);
+			for (uint32 i = 0; i < header->NumTextures; ++i)
+				bIsValid &= textures[i].ImageIndex < header->NumImages;
+
+			// The transform hierarchy is rebuilt in order, a parent has to be read before its children
+			const NodeEntry* nodes = GetSection<NodeEntry>(header->NodesOffset);
+			for (uint32 i = 0; i < header->NumNodes; ++i)
+				bIsValid &= nodes[i].Parent == ~0u || nodes[i].Parent < i;
+
+			const MeshEntry* meshes = GetSection<MeshEntry>(header->MeshesOffset);
+			for (uint32 i = 0; i < header->NumMeshes; ++i)
+				bIsValid &= meshes[i].NodeIndex < header->NumNodes;
+		}
+
+		if (!bIsValid)
+		{
+			LB_WARN("Scene cache '%s' is corrupted, it will be cooked again", cachePath);
+			Close();
+			return false;
+		}
+
+		m_Header = header;
+		return true;
+	}
+
+	void Reader::Close()
+	{
+		m_Header = nullptr;
+		m_File.Close();
+	}
+
+	Span<MeshEntry> Reader::GetMeshes() const
+	{
+		return Span<MeshEntry>(GetSection<MeshEntry>(m_Header->MeshesOffset), m_Header->NumMeshes);
+	}
+
+	Span<NodeEntry> Reader::GetNodes() const
+	{
+		return Span<NodeEntry>(GetSection<NodeEntry>(m_Header->NodesOffset), m_Header->NumNodes);
+	}
+
+	Span<Material> Reader::GetMaterials() const
+	{
+		return Span<Material>(GetSection<Material>(m_Header->MaterialsOffset), m_Header->NumMaterials);
+	}
+
+	Span<TextureEntry> Reader::GetTextures() const
+	{
+		return Span<TextureEntry>(GetSection<TextureEntry>(m_Header->TexturesOffset), m_Header->NumTextures);
+	}
+
+	const uint8* Reader::GetImageData(uint32 imageIndex) const
+	{
+		check(imageIndex < m_Header->NumImages);
+		const ImageEntry* images = GetSection<ImageEntry>(m_Header->ImagesOffset);
+		return GetSection<uint8>(images[imageIndex].DataOffset);
+	}
+
+	uint64 Reader::GetImageFileOffset(uint32 imageIndex) const
+	{
+		check(imageIndex < m_Header->NumImages);
+		const ImageEntry* images = GetSection<ImageEntry>(m_Header->ImagesOffset);
+		return images[imageIndex].DataOffset;
+	}
+
+	const uint8* Reader::GetGeometry() const
+	{
+		return GetSection<uint8>(m_Header->GeometryOffset);
+	}
+
+	uint64 Reader::GetGeometrySize() const
+	{
+		return m_Header->GeometrySize;
+	}
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "core/utils.h"
+#include "gfx/meshlod.h"
+#include "gfx/shaderinterop.h"
+
+struct cgltf_data;
+
+namespace limbo::Gfx::SceneCache
+{
+	// "LBSC"
+	constexpr uint32 Magic = 0x4353424c;
+
+	// Bump this every time the layout of the cooked data changes (PackedMeshVertex, Meshlet, Material, geometry buffer packing, ...)
+	constexpr uint32 Version = 10;
+
+	struct Header
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint64 SourceHash;
+		uint64 FileSize;
+
+		uint32 NumMeshes;
+		uint32 NumNodes;
+		uint32 NumMaterials;
+		uint32 NumImages;
+		uint32 NumTextures;
+		uint32 NumSourceFiles;
+
+		uint64 MeshesOffset;
+		uint64 NodesOffset;
+		uint64 MaterialsOffset;
+		uint64 ImagesOffset;
+		uint64 TexturesOffset;
+		uint64 SourceFilesOffset;
+
+		uint64 GeometryOffset;
+		uint64 GeometrySize;
+	};
+
+	// Offsets are relative to the start of the geometry buffer
+	struct MeshEntry
+	{
+		float4	 BoundingSphere;
+		float3	 PositionOffset;
+		float3	 PositionScale;
+
+		uint32 VerticesOffset;
+		uint32 VerticesSize;
+		uint32 IndicesOffset;
+		uint32 IndicesSize;
+
+		uint32 MeshletsOffset;
+		uint32 MeshletVerticesOffset;
+		uint32 MeshletTrianglesOffset;
+
+		uint32 LocalMaterialIndex;
+		uint32 IndexCount;
+		uint32 VertexCount;
+		uint32 MeshletsCount;
+		uint32 bIsOpaque;
+
+		uint32	NumLODs;
+		MeshLOD LODs[MaxMeshLODs];
+
+		// Meshes that instance the same primitive point to the same ranges of the geometry buffer
+		uint32	GeometryIndex;
+		uint32	NodeIndex;
+	};
+
+	// Local transform of a node, the parents always come before their children
+	struct NodeEntry
+	{
+		uint32 Parent;
+		float3 Translation;
+		float4 Rotation; // xyzw
+		float3 Scale;
+	};
+
+	// Decoded pixels, an image can be used by more than one texture
+	struct ImageEntry
+	{
+		uint64 DataOffset;
+		uint64 DataSize;
+	};
+
+	struct TextureEntry
+	{
+		uint32 ImageIndex;
+		uint32 Width;
+		uint32 Height;
+		uint32 Format; // RHI::Format
+		uint16 MipLevels; // the image always holds the full chain
+		uint16 Padding;
+		uint32 ComponentMapping;
+		// Key of the texture in SharedTextures, hash of the image contents, its usage and the texture format
+		uint64 ContentHash;
+		char   Name[128];
+	};
+
+	// A file the scene was cooked from, its contents are only hashed again when its size or its write time changes
+	struct SourceFileEntry
+	{
+		uint64 Size;
+		int64  WriteTime;
+		uint64 ContentHash;
+		char   Path[256]; // relative to the scene folder
+	};
+
+	struct ImageBlob
+	{
+		const void* Data;
+		uint64		Size;
+	};
+
+	// Everything needed to write the cache, the material texture indices must be indices into Textures and not descriptor indices
+	struct CookedScene
+	{
+		Span<MeshEntry>		Meshes;
+		Span<NodeEntry>		Nodes;
+		Span<Material>		Materials;
+		Span<ImageBlob>		Images;
+		Span<TextureEntry>	Textures;
+		Span<SourceFileEntry> SourceFiles;
+		Span<uint8>			Geometry;
+	};
+
+	// Content hashes of the source files of one import. The files that have the size and the write time recorded by the
+	// last cook are not read at all, the others are read and hashed once. It is safe to use from several jobs.
+	class SourceFileHashes
+	{
+	public:
+		// The files of the last cook, see ReadSourceFiles()
+		void SetRecorded(Span<SourceFileEntry> files);
+
+		// Hash of the contents of a file of the scene folder, or of its path if it does not exist
+		uint64 HashFile(const char* folderPath, const char* relativePath);
+
+		// True if a recorded file had to be hashed again because its size or its write time changed
+		bool HasChangedFiles() const { return m_bHasChangedFiles; }
+
+		// Every file hashed so far, in the order they were first hashed
+		Span<SourceFileEntry> GetFiles() const { return m_Files; }
+
+	private:
+		std::mutex									m_Mutex;
+		std::unordered_map<std::string, SourceFileEntry> m_Recorded;
+		std::unordered_map<std::string, uint32>		m_FileIndices;
+		std::vector<SourceFileEntry>				m_Files;
+		bool										m_bHasChangedFiles = false;
+	};
+
+	// Returns the path of the cooked file for a given source scene
+	std::string GetCachePath(const char* scenePath);
+
+	// Hashes the scene file plus every external buffer and image it references, together with the cache version
+	uint64 ComputeSourceHash(const char* scenePath, const char* folderPath, const cgltf_data* data, SourceFileHashes& sourceFiles);
+
+	bool Write(const char* cachePath, uint64 sourceHash, const CookedScene& scene);
+
+	// Only reads the header and the source files of a cache, so they can be checked before anything is mapped
+	bool ReadSourceFiles(const char* cachePath, uint64& outSourceHash, std::vector<SourceFileEntry>& outFiles);
+	// Replaces the source files of a cache in place, there has to be as many as when it was written
+	bool WriteSourceFiles(const char* cachePath, Span<SourceFileEntry> files);
+
+	class Reader
+	{
+	public:
+		// Fails if the file does not exist, is from another version or was cooked from a different source
+		bool Open(const char* cachePath, uint64 sourceHash);
+		void Close();
+
+		Span<MeshEntry> GetMeshes() const;
+		Span<NodeEntry> GetNodes() const;
+		Span<Material> GetMaterials() const;
+		Span<TextureEntry> GetTextures() const;
+
+		const uint8* GetImageData(uint32 imageIndex) const;
+		// Offset of the image data from the start of the file, used to read it again without mapping the whole file
+		uint64 GetImageFileOffset(uint32 imageIndex) const;
+		const uint8* GetGeometry() const;
+		uint64 GetGeometrySize() const;
+
+	private:
+		template<typename T>
+		const T* GetSection(uint64 offset) const { return (const T*)(m_File.GetData() + offset); }
+
+	private:
+		Utils::MappedFile	m_File;
+		const Header*		m_Header = nullptr;
+	};
+}
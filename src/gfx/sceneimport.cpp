@@ -0,0 +1,311 @@
+#include "stdafx.h"
+#include "sceneimport.h"
+#include "gltfaccessors.h"
+#include "mipgenerator.h"
+#include "tangentspace.h"
+
+#if defined(_WIN32)
+#pragma warning(push)
+#pragma warning(disable: 4996) // disable _CRT_SECURE_NO_WARNINGS
+#endif
+#define CGLTF_IMPLEMENTATION
+#include <cgltf/cgltf.h>
+#if defined(_WIN32)
+#pragma warning(pop)
+#endif
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+#include <meshoptimizer.h>
+
+namespace limbo::Gfx::SceneImport
+{
+	void DecodePrimitive(PrimitiveData& data)
+	{
+		const cgltf_primitive* primitive = data.Primitive;
+
+		// Find the attributes we care about
+		const cgltf_accessor* positions = nullptr;
+		const cgltf_accessor* normals	= nullptr;
+		const cgltf_accessor* tangents	= nullptr;
+		const cgltf_accessor* texCoords	= nullptr;
+		for (size_t attributeIndex = 0; attributeIndex < primitive->attributes_count; ++attributeIndex)
+		{
+			const cgltf_attribute& attribute = primitive->attributes[attributeIndex];
+			if (attribute.type == cgltf_attribute_type_position)
+				positions = attribute.data;
+			else if (attribute.type == cgltf_attribute_type_normal)
+				normals = attribute.data;
+			else if (attribute.type == cgltf_attribute_type_tangent)
+				tangents = attribute.data;
+			else if (attribute.type == cgltf_attribute_type_texcoord && attribute.index == 0)
+				texCoords = attribute.data;
+		}
+
+		// Decode every attribute straight into the interleaved vertex stream
+		const size_t vertexCount = positions ? positions->count : 0;
+		data.VerticesStream.resize(vertexCount);
+
+		auto unpackAttribute = [vertexCount](const cgltf_accessor* accessor, float* firstElement, uint32 numComponents)
+		{
+			if (!accessor)
+				return false;
+
+			if (accessor->count != vertexCount)
+			{
+				LB_WARN("Vertex attribute has %zu elements but the primitive has %zu vertices, skipping it", accessor->count, vertexCount);
+				return false;
+			}
+			return ensure(GLTF::UnpackFloats(accessor, numComponents, firstElement, sizeof(MeshVertex)));
+		};
+
+		MeshVertex* vertices = data.VerticesStream.data();
+		unpackAttribute(positions, &vertices->Position.x, 3);
+		const bool bHasNormals	 = unpackAttribute(normals, &vertices->Normal.x, 3);
+		const bool bHasTangents  = unpackAttribute(tangents, &vertices->Tangent.x, 4);
+		const bool bHasTexCoords = unpackAttribute(texCoords, &vertices->UV.x, 2);
+
+		data.bMissingNormals = !bHasNormals && vertexCount > 0;
+		data.bMissingTangents = !bHasTangents && bHasTexCoords;
+
+		// process indices
+		cgltf_accessor* indices = primitive->indices;
+		data.IndicesStream.resize(indices->count);
+		ensure(GLTF::UnpackIndices(indices, data.IndicesStream.data()));
+	}
+
+	void GenerateMissingAttributes(PrimitiveData& data)
+	{
+		// The tangents are built on top of the normals
+		if (data.bMissingNormals)
+			TangentSpace::GenerateNormals(data.IndicesStream.data(), data.IndicesStream.size(), data.VerticesStream.data(), data.VerticesStream.size());
+
+		if (data.bMissingTangents)
+			TangentSpace::GenerateTangents(data.IndicesStream.data(), data.IndicesStream.size(), data.VerticesStream.data(), data.VerticesStream.size());
+	}
+
+	void OptimizePrimitiveData(PrimitiveData& primitiveData)
+	{
+		size_t indexCount = primitiveData.IndicesStream.size();
+		size_t vertexCount = primitiveData.VerticesStream.size();
+
+		std::vector<uint32> remap(vertexCount);
+		meshopt_optimizeVertexFetchRemap(&remap[0], primitiveData.IndicesStream.data(), indexCount, vertexCount);
+
+		meshopt_remapIndexBuffer(primitiveData.IndicesStream.data(), primitiveData.IndicesStream.data(), indexCount, remap.data());
+		meshopt_remapVertexBuffer(primitiveData.VerticesStream.data(), primitiveData.VerticesStream.data(), vertexCount, sizeof(MeshVertex), remap.data());
+		meshopt_optimizeVertexCache(primitiveData.IndicesStream.data(), primitiveData.IndicesStream.data(), indexCount, vertexCount);
+		meshopt_optimizeOverdraw(primitiveData.IndicesStream.data(), primitiveData.IndicesStream.data(), indexCount, &primitiveData.VerticesStream[0].Position.x, vertexCount, sizeof(MeshVertex), 1.05f);
+	}
+
+	void CreateMeshlets(PrimitiveData& data, const uint32* indices, size_t indexCount)
+	{
+		size_t vertexCount = data.VerticesStream.size();
+		if (indexCount == 0)
+			return;
+
+		size_t maxMeshlets = meshopt_buildMeshletsBound(indexCount, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+
+		std::vector<meshopt_Meshlet> meshlets(maxMeshlets);
+		std::vector<uint32> meshletVertices(maxMeshlets * MESHLET_MAX_VERTICES);
+		std::vector<uint8> meshletTriangles(maxMeshlets * MESHLET_MAX_TRIANGLES * 3);
+		size_t meshletCount = meshopt_buildMeshlets(meshlets.data(), meshletVertices.data(), meshletTriangles.data(),
+													indices, indexCount, &data.VerticesStream[0].Position.x, vertexCount,
+													sizeof(MeshVertex), MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES, 0.0f);
+
+		// The meshlets of every LOD go in the same streams, the new ones start after the ones that are already there
+		const meshopt_Meshlet& last = meshlets[meshletCount - 1];
+		const uint32 vertexOffset = (uint32)data.MeshletVertices.size();
+		data.MeshletVertices.insert(data.MeshletVertices.end(), meshletVertices.begin(), meshletVertices.begin() + last.vertex_offset + last.vertex_count);
+		data.Meshlets.reserve(data.Meshlets.size() + meshletCount);
+
+		uint32 triangleOffset = (uint32)data.MeshletTriangles.size();
+		for (size_t m = 0; m < meshletCount; ++m)
+		{
+			const meshopt_Meshlet& meshlet = meshlets[m];
+			const uint8* pData = meshletTriangles.data() + meshlet.triangle_offset;
+			for (uint32 i = 0; i < meshlet.triangle_count; ++i)
+			{
+				Meshlet::Triangle& triangle = data.MeshletTriangles.emplace_back();
+				triangle.V0 = *pData++;
+				triangle.V1 = *pData++;
+				triangle.V2 = *pData++;
+			}
+
+			// The snorm8 cone is rounded so it stays conservative
+			const meshopt_Bounds bounds = meshopt_computeMeshletBounds(&meshletVertices[meshlet.vertex_offset], &meshletTriangles[meshlet.triangle_offset], meshlet.triangle_count,
+																	   &data.VerticesStream[0].Position.x, vertexCount, sizeof(MeshVertex));
+			const uint32 normalCone = (uint8)bounds.cone_axis_s8[0] | ((uint8)bounds.cone_axis_s8[1] << 8) | ((uint8)bounds.cone_axis_s8[2] << 16) | ((uint32)(uint8)bounds.cone_cutoff_s8 << 24);
+
+			data.Meshlets.emplace_back(vertexOffset + meshlet.vertex_offset, triangleOffset, meshlet.vertex_count, meshlet.triangle_count,
+									   float4(bounds.center[0], bounds.center[1], bounds.center[2], bounds.radius), normalCone);
+			triangleOffset += meshlet.triangle_count;
+		}
+	}
+
+	void CreateMeshLODs(PrimitiveData& data)
+	{
+		data.LODs.push_back({
+			.FirstIndex = 0,
+			.IndexCount = (uint32)data.IndicesStream.size(),
+			.FirstMeshlet = 0,
+			.MeshletCount = (uint32)data.Meshlets.size(),
+			.Error = 0.0f
+		});
+		if (data.VerticesStream.empty())
+			return;
+
+		std::vector<MeshLODIndices> lods;
+		BuildMeshLODs(data.IndicesStream.data(), data.IndicesStream.size(), &data.VerticesStream[0].Position.x, data.VerticesStream.size(), sizeof(MeshVertex), lods);
+		for (const MeshLODIndices& lod : lods)
+		{
+			MeshLOD& result = data.LODs.emplace_back();
+			result.FirstIndex = (uint32)data.IndicesStream.size();
+			result.IndexCount = (uint32)lod.Indices.size();
+			result.FirstMeshlet = (uint32)data.Meshlets.size();
+			result.Error = lod.Error;
+
+			data.IndicesStream.insert(data.IndicesStream.end(), lod.Indices.begin(), lod.Indices.end());
+			CreateMeshlets(data, lod.Indices.data(), lod.Indices.size());
+			result.MeshletCount = (uint32)data.Meshlets.size() - result.FirstMeshlet;
+		}
+	}
+
+	void ProcessPrimitive(PrimitiveData& data)
+	{
+		DecodePrimitive(data);
+		GenerateMissingAttributes(data);
+		OptimizePrimitiveData(data);
+		CreateMeshlets(data, data.IndicesStream.data(), data.IndicesStream.size());
+		CreateMeshLODs(data);
+	}
+
+	void ComputeBounds(const std::vector<MeshVertex>& vertices, float3& outMin, float3& outMax)
+	{
+		outMin = outMax = vertices.empty() ? float3(0.0f) : vertices[0].Position;
+		for (const MeshVertex& vertex : vertices)
+		{
+			outMin = glm::min(outMin, vertex.Position);
+			outMax = glm::max(outMax, vertex.Position);
+		}
+	}
+
+	// The packed positions are unorms inside of the bounding box. Flat meshes still get some scale on every axis,
+	// the dequantization is part of the BLAS instance transform and that one has to be invertible.
+	void ComputePositionQuantization(const std::vector<MeshVertex>& vertices, float3& outOffset, float3& outScale)
+	{
+		float3 boundsMin, boundsMax;
+		ComputeBounds(vertices, boundsMin, boundsMax);
+
+		const float3 extents = boundsMax - boundsMin;
+		const float minScale = Math::Max(Math::Max(extents.x, Math::Max(extents.y, extents.z)) * 1e-3f, 1e-6f);
+		outOffset = boundsMin;
+		outScale = glm::max(extents, float3(minScale));
+	}
+
+	float4 ComputeBoundingSphere(const std::vector<MeshVertex>& vertices)
+	{
+		if (vertices.empty())
+			return float4(0.0f);
+
+		float3 boundsMin, boundsMax;
+		ComputeBounds(vertices, boundsMin, boundsMax);
+
+		const float3 center = (boundsMin + boundsMax) * 0.5f;
+		float radiusSq = 0.0f;
+		for (const MeshVertex& vertex : vertices)
+		{
+			const float3 offset = vertex.Position - center;
+			radiusSq = Math::Max(radiusSq, glm::dot(offset, offset));
+		}
+		return float4(center, sqrtf(radiusSq));
+	}
+
+	void GatherImageUsages(const cgltf_data* data, ImageUsageMap& outUsages)
+	{
+		auto addRole = [&outUsages](const cgltf_texture_view& textureView, TextureCompressor::TextureRole role, float alphaCutoff = -1.0f)
+		{
+			if (!textureView.texture || !textureView.texture->image)
+				return;
+
+			auto [it, bInserted] = outUsages.try_emplace((uintptr_t)textureView.texture->image, ImageUsage{ role, alphaCutoff });
+			if (!bInserted)
+			{
+				if (it->second.Role != role)
+					it->second.Role = TextureCompressor::TextureRole::Color;
+				it->second.AlphaCutoff = Math::Max(it->second.AlphaCutoff, alphaCutoff);
+			}
+		};
+
+		for (size_t i = 0; i < data->materials_count; ++i)
+		{
+			const cgltf_material& material = data->materials[i];
+			const float alphaCutoff = material.alpha_mode == cgltf_alpha_mode_mask ? material.alpha_cutoff : -1.0f;
+			if (material.has_pbr_metallic_roughness)
+			{
+				addRole(material.pbr_metallic_roughness.base_color_texture, TextureCompressor::TextureRole::Albedo, alphaCutoff);
+				addRole(material.pbr_metallic_roughness.metallic_roughness_texture, TextureCompressor::TextureRole::RoughnessMetal);
+			}
+			else if (material.has_pbr_specular_glossiness)
+			{
+				addRole(material.pbr_specular_glossiness.diffuse_texture, TextureCompressor::TextureRole::Albedo, alphaCutoff);
+				addRole(material.pbr_specular_glossiness.specular_glossiness_texture, TextureCompressor::TextureRole::Color);
+			}
+			addRole(material.normal_texture, TextureCompressor::TextureRole::Normal);
+			addRole(material.emissive_texture, TextureCompressor::TextureRole::Emissive);
+			addRole(material.occlusion_texture, TextureCompressor::TextureRole::Occlusion);
+		}
+	}
+
+	ImageUsage GetImageUsage(const ImageUsageMap& usages, const cgltf_image* image)
+	{
+		auto it = usages.find((uintptr_t)image);
+		return it != usages.end() ? it->second : ImageUsage();
+	}
+
+	uint8* DecodeImage(const cgltf_image* image, const char* sourcePath, int& outWidth, int& outHeight, int& outChannels)
+	{
+		if (image->uri)
+			return stbi_load(sourcePath, &outWidth, &outHeight, &outChannels, 4);
+
+		const cgltf_buffer_view* bufferView = image->buffer_view;
+		const uint8* bufferLocation = (const uint8*)bufferView->buffer->data + bufferView->offset;
+		return stbi_load_from_memory(bufferLocation, (int)bufferView->size, &outWidth, &outHeight, &outChannels, 4);
+	}
+
+	uint8* CookImage(const uint8* pixels, uint32 width, uint32 height, const ImageUsage& usage, TextureCompressor::Quality quality, uint64 headerSize, CookedImage& outImage)
+	{
+		const uint16 mipLevels = RHI::CalculateMipCount(width, height);
+
+		// Only the base color is sampled as sRGB
+		const MipGenerator::MipSettings mipSettings = {
+			.Filter = quality == TextureCompressor::Quality::Fast ? MipGenerator::MipFilter::Box : MipGenerator::MipFilter::Kaiser,
+			.bSRGB = usage.Role == TextureCompressor::TextureRole::Albedo,
+			.bNormalMap = usage.Role == TextureCompressor::TextureRole::Normal,
+			.AlphaCutoff = usage.AlphaCutoff,
+		};
+
+		const uint64 mipChainSize = MipGenerator::GetMipChainSize(width, height, mipLevels);
+		uint8* mipChain = (uint8*)malloc(mipChainSize);
+		MipGenerator::GenerateMipChain(pixels, width, height, mipLevels, mipSettings, mipChain);
+
+		// Textures that are not a multiple of the block size stay uncompressed
+		RHI::Format format = RHI::Format::RGBA8_UNORM;
+		uint64 textureSize = mipChainSize;
+		if (TextureCompressor::CanCompress(width, height))
+		{
+			format = TextureCompressor::SelectFormat(usage.Role, TextureCompressor::HasAlpha(mipChain, width, height), quality);
+			textureSize = TextureCompressor::GetMipChainSize(format, width, height, mipLevels);
+		}
+
+		uint8* result = (uint8*)malloc(headerSize + textureSize);
+		if (format == RHI::Format::RGBA8_UNORM)
+			memcpy(result + headerSize, mipChain, mipChainSize);
+		else
+			TextureCompressor::CompressMipChain(mipChain, width, height, mipLevels, format, usage.Role, quality, result + headerSize);
+		free(mipChain);
+
+		outImage = { .Format = format, .NumMips = mipLevels, .DataSize = textureSize };
+		return result;
+	}
+}
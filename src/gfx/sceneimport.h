@@ -0,0 +1,88 @@
+#pragma once
+
+#include "shaderinterop.h"
+#include "meshlod.h"
+#include "texturecompressor.h"
+
+#include <vector>
+#include <unordered_map>
+
+struct cgltf_data;
+struct cgltf_primitive;
+struct cgltf_image;
+
+/**
+ * The CPU side of the scene import, everything between the glTF file and the data that gets uploaded.
+ *
+ * None of it touches the RHI, Scene runs it in its import jobs and the import benchmark in tools/importbench
+ * runs it on its own to time every stage.
+ */
+namespace limbo::Gfx::SceneImport
+{
+	struct PrimitiveData
+	{
+		const cgltf_primitive*	Primitive = nullptr;
+
+		std::vector<MeshVertex> VerticesStream;
+		// The indices of every LOD, one after the other
+		std::vector<uint32>		IndicesStream;
+
+		std::vector<Meshlet>			Meshlets;
+		std::vector<uint32>				MeshletVertices;
+		std::vector<Meshlet::Triangle>	MeshletTriangles;
+
+		std::vector<MeshLOD>	LODs;
+
+		// Attributes the primitive does not have, GenerateMissingAttributes() computes them
+		bool					bMissingNormals = false;
+		bool					bMissingTangents = false;
+	};
+
+	// How the materials sample an image, this drives the mip filtering and the compression format
+	struct ImageUsage
+	{
+		TextureCompressor::TextureRole	Role = TextureCompressor::TextureRole::Color;
+		// Alpha cutoff of the masked materials that use the image as base color, negative if there is none
+		float							AlphaCutoff = -1.0f;
+	};
+	using ImageUsageMap = std::unordered_map<uintptr_t, ImageUsage>;
+
+	// The cooked image is the full mip chain, BC compressed when the size allows it
+	struct CookedImage
+	{
+		RHI::Format	Format = RHI::Format::RGBA8_UNORM;
+		uint16		NumMips = 1;
+		uint64		DataSize = 0;
+	};
+
+	// Decodes the attributes and the indices of the primitive into its streams
+	void DecodePrimitive(PrimitiveData& data);
+	// Smooth normals and MikkTSpace tangents, see TangentSpace
+	void GenerateMissingAttributes(PrimitiveData& data);
+	void OptimizePrimitiveData(PrimitiveData& data);
+	// Appends the meshlets of an index buffer to the meshlet streams of the primitive
+	void CreateMeshlets(PrimitiveData& data, const uint32* indices, size_t indexCount);
+	// Appends the indices and the meshlets of the simplified LODs after the ones of LOD 0
+	void CreateMeshLODs(PrimitiveData& data);
+
+	// Every step above in order, this is what the import does to each primitive
+	void ProcessPrimitive(PrimitiveData& data);
+
+	void ComputeBounds(const std::vector<MeshVertex>& vertices, float3& outMin, float3& outMax);
+	// The packed positions are unorms inside of the bounding box, see VertexPacking
+	void ComputePositionQuantization(const std::vector<MeshVertex>& vertices, float3& outOffset, float3& outScale);
+	// Sphere around the bounding box of the vertices, xyz center and w radius
+	float4 ComputeBoundingSphere(const std::vector<MeshVertex>& vertices);
+
+	// An image used for more than one role keeps every channel
+	void GatherImageUsages(const cgltf_data* data, ImageUsageMap& outUsages);
+	ImageUsage GetImageUsage(const ImageUsageMap& usages, const cgltf_image* image);
+
+	// Decodes an image that is not a DDS to RGBA8. sourcePath is only read when the image has a uri.
+	// The pixels are freed with free(), returns nullptr if the image could not be decoded.
+	uint8* DecodeImage(const cgltf_image* image, const char* sourcePath, int& outWidth, int& outHeight, int& outChannels);
+
+	// Cooks the RGBA8 pixels, the result is freed with free(). headerSize bytes are left in front of the
+	// cooked data so a file header can be written there without another copy.
+	uint8* CookImage(const uint8* pixels, uint32 width, uint32 height, const ImageUsage& usage, TextureCompressor::Quality quality, uint64 headerSize, CookedImage& outImage);
+}
@@ -0,0 +1,138 @@
+#include "stdafx.h"
+#include "scenereport.h"
+
+namespace limbo::Gfx
+{
+	namespace
+	{
+		std::string EscapeJson(std::string_view str)
+		{
+			std::string result;
+			result.reserve(str.size());
+			for (char c : str)
+			{
+				switch (c)
+				{
+				case '"':  result += "\\\""; break;
+				case '\\': result += "\\\\"; break;
+				case '\n': result += "\\n";  break;
+				case '\r': result += "\\r";  break;
+				case '\t': result += "\\t";  break;
+				default:
+					if ((unsigned char)c < 0x20)
+						result += std::format("\\u{:04x}", (uint32)(unsigned char)c);
+					else
+						result += c;
+					break;
+				}
+			}
+			return result;
+		}
+	}
+
+	void SceneReport::AddTexture(const char* format, Span<uint64> mipBytes, uint32 firstResidentMip, bool bShared)
+	{
+		auto it = std::find_if(TextureFormats.begin(), TextureFormats.end(), [format](const SceneTextureFormatReport& report) { return report.Format == format; });
+		SceneTextureFormatReport& report = it != TextureFormats.end() ? *it : TextureFormats.emplace_back(SceneTextureFormatReport{ .Format = format });
+
+		report.NumTextures++;
+		if (report.MipBytes.size() < mipBytes.GetSize())
+			report.MipBytes.resize(mipBytes.GetSize(), 0);
+		for (uint32 mip = 0; mip < mipBytes.GetSize(); ++mip)
+		{
+			report.MipBytes[mip] += mipBytes[mip];
+			report.TotalBytes += mipBytes[mip];
+			if (mip >= firstResidentMip)
+				report.ResidentBytes += mipBytes[mip];
+		}
+
+		NumTextures++;
+		if (bShared)
+			NumSharedTextures++;
+	}
+
+	void SceneReport::AddGeometry(const SceneGeometryReport& geometry)
+	{
+		NumGeometries++;
+		VertexBytes += geometry.VertexBytes;
+		IndexBytes += geometry.IndexBytes;
+		MeshletBytes += geometry.MeshletBytes;
+
+		auto it = std::upper_bound(LargestGeometries.begin(), LargestGeometries.end(), geometry, [](const SceneGeometryReport& a, const SceneGeometryReport& b)
+		{
+			return a.GetTotalBytes() > b.GetTotalBytes();
+		});
+		if (it - LargestGeometries.begin() >= MaxLargestGeometries)
+			return;
+
+		LargestGeometries.insert(it, geometry);
+		if (LargestGeometries.size() > MaxLargestGeometries)
+			LargestGeometries.pop_back();
+	}
+
+	void SceneReport::AddStage(const char* name, double milliseconds)
+	{
+		Stages.push_back({ name, milliseconds });
+	}
+
+	uint64 SceneReport::GetTextureBytes() const
+	{
+		uint64 bytes = 0;
+		for (const SceneTextureFormatReport& format : TextureFormats)
+			bytes += format.TotalBytes;
+		return bytes;
+	}
+
+	uint64 SceneReport::GetResidentTextureBytes() const
+	{
+		uint64 bytes = 0;
+		for (const SceneTextureFormatReport& format : TextureFormats)
+			bytes += format.ResidentBytes;
+		return bytes;
+	}
+
+	std::string SceneReport::ToJson() const
+	{
+		std::string json = "{\n";
+		json += std::format("  \"name\": \"{}\",\n", EscapeJson(Name));
+		json += std::format("  \"fromCache\": {},\n", bFromCache);
+		json += std::format("  \"meshes\": {},\n  \"geometries\": {},\n  \"nodes\": {},\n  \"materials\": {},\n", NumMeshes, NumGeometries, NumNodes, NumMaterials);
+
+		json += std::format("  \"geometry\": {{ \"vertexBytes\": {}, \"indexBytes\": {}, \"meshletBytes\": {}, \"totalBytes\": {} }},\n",
+							VertexBytes, IndexBytes, MeshletBytes, GetGeometryBytes());
+		json += std::format("  \"blas\": {{ \"count\": {}, \"bytes\": {} }},\n", NumBLASes, BLASBytes);
+
+		json += std::format("  \"textures\": {{\n    \"count\": {},\n    \"shared\": {},\n    \"totalBytes\": {},\n    \"residentBytes\": {},\n    \"formats\": [",
+							NumTextures, NumSharedTextures, GetTextureBytes(), GetResidentTextureBytes());
+		for (size_t i = 0; i < TextureFormats.size(); ++i)
+		{
+			const SceneTextureFormatReport& format = TextureFormats[i];
+			std::string mips;
+			for (size_t mip = 0; mip < format.MipBytes.size(); ++mip)
+				mips += std::format("{}{}", mip > 0 ? ", " : "", format.MipBytes[mip]);
+
+			json += std::format("{}\n      {{ \"format\": \"{}\", \"count\": {}, \"totalBytes\": {}, \"residentBytes\": {}, \"mipBytes\": [{}] }}",
+								i > 0 ? "," : "", EscapeJson(format.Format), format.NumTextures, format.TotalBytes, format.ResidentBytes, mips);
+		}
+		json += TextureFormats.empty() ? "]\n  },\n" : "\n    ]\n  },\n";
+
+		json += "  \"largestGeometries\": [";
+		for (size_t i = 0; i < LargestGeometries.size(); ++i)
+		{
+			const SceneGeometryReport& geometry = LargestGeometries[i];
+			json += std::format("{}\n    {{ \"geometry\": {}, \"firstMesh\": {}, \"instances\": {}, \"vertices\": {}, \"triangles\": {}, \"vertexBytes\": {}, \"indexBytes\": {}, \"meshletBytes\": {}, \"totalBytes\": {} }}",
+								i > 0 ? "," : "", geometry.GeometryIndex, geometry.FirstMesh, geometry.NumInstances, geometry.NumVertices, geometry.NumTriangles,
+								geometry.VertexBytes, geometry.IndexBytes, geometry.MeshletBytes, geometry.GetTotalBytes());
+		}
+		json += LargestGeometries.empty() ? "],\n" : "\n  ],\n";
+
+		json += std::format("  \"loadMs\": {:.3f},\n", LoadMilliseconds);
+		json += "  \"stages\": [";
+		for (size_t i = 0; i < Stages.size(); ++i)
+			json += std::format("{}\n    {{ \"name\": \"{}\", \"ms\": {:.3f} }}", i > 0 ? "," : "", EscapeJson(Stages[i].Name), Stages[i].Milliseconds);
+		json += Stages.empty() ? "]\n" : "\n  ]\n";
+
+		json += "}\n";
+		return json;
+	}
+}
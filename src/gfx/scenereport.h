@@ -0,0 +1,90 @@
+#pragma once
+
+#include "core/array.h"
+
+#include <string>
+#include <vector>
+
+namespace limbo::Gfx
+{
+	// One unique geometry of the scene, the meshes that instance it share its bytes
+	struct SceneGeometryReport
+	{
+		uint32 GeometryIndex = 0;
+		uint32 FirstMesh = 0;
+		uint32 NumInstances = 0;
+		uint64 NumVertices = 0;
+		uint64 NumTriangles = 0; // LOD 0
+
+		uint64 VertexBytes = 0;
+		uint64 IndexBytes = 0; // every LOD
+		uint64 MeshletBytes = 0;
+
+		uint64 GetTotalBytes() const { return VertexBytes + IndexBytes + MeshletBytes; }
+	};
+
+	struct SceneTextureFormatReport
+	{
+		std::string			Format;
+		uint32				NumTextures = 0;
+		// The full mip chains, and what was resident when the textures were created, the texture streaming brings in the rest
+		uint64				TotalBytes = 0;
+		uint64				ResidentBytes = 0;
+		// Bytes of each mip level of these textures, mip 0 first
+		std::vector<uint64>	MipBytes;
+	};
+
+	struct SceneStageTime
+	{
+		const char* Name;
+		double		Milliseconds;
+	};
+
+	/**
+	 * What a scene costs in memory and in load time, filled while it loads.
+	 * Shown in the debug window and written as JSON, to find the assets that go over budget.
+	 */
+	struct SceneReport
+	{
+		static constexpr uint32 MaxLargestGeometries = 10;
+
+		std::string		Name;
+		bool			bFromCache = false;
+
+		uint32			NumMeshes = 0;
+		uint32			NumGeometries = 0;
+		uint32			NumNodes = 0;
+		uint32			NumMaterials = 0;
+
+		uint64			VertexBytes = 0;
+		uint64			IndexBytes = 0;
+		uint64			MeshletBytes = 0;
+
+		uint32			NumTextures = 0;
+		// Textures that another scene had already created
+		uint32			NumSharedTextures = 0;
+		std::vector<SceneTextureFormatReport> TextureFormats;
+
+		// The acceleration structure builds them after the load
+		uint32			NumBLASes = 0;
+		uint64			BLASBytes = 0;
+
+		// Biggest first
+		std::vector<SceneGeometryReport> LargestGeometries;
+		std::vector<SceneStageTime>		 Stages;
+		// Wall time from the start of the load until the scene could be used, the stages overlap
+		double			LoadMilliseconds = 0.0;
+
+		// mipBytes has the size of every mip of the full chain, the mips from firstResidentMip on are resident
+		void AddTexture(const char* format, Span<uint64> mipBytes, uint32 firstResidentMip, bool bShared);
+		// Adds to the totals and keeps the MaxLargestGeometries biggest ones
+		void AddGeometry(const SceneGeometryReport& geometry);
+		void AddStage(const char* name, double milliseconds);
+
+		uint64 GetGeometryBytes() const { return VertexBytes + IndexBytes + MeshletBytes; }
+		uint64 GetTextureBytes() const;
+		uint64 GetResidentTextureBytes() const;
+
+		std::string ToJson() const;
+	};
+}
@@ -3,9 +3,16 @@
 #ifdef __cplusplus
 	#include "core/math.h"
 
+	#include <glm/common.hpp>
+	#include <glm/geometric.hpp>
+	#include <glm/trigonometric.hpp>
+	#include <glm/gtc/packing.hpp>
+
 	#define __CONST constexpr
+	#define __INLINE inline
 #else
 	#define __CONST static const
+	#define __INLINE
 #endif
 
 #define CONCAT_IMPL( x, y ) x##y
@@ -92,6 +99,7 @@ struct Material
 	float3 EmissiveFactor;
 };
 
+/* Decoded vertex, the importer works with it and the shaders get it back from a PackedMeshVertex */
 struct MeshVertex
 {
 	float3 Position;
@@ -100,6 +108,157 @@ struct MeshVertex
 	float2 UV;
 };
 
+/* Vertex as it is stored in the geometry buffer */
+struct PackedMeshVertex
+{
+	/* 16 bit unorm positions inside of the mesh bounds, the layout is the same as R16G16B16A16_UNORM so the BLAS can read them */
+	uint PositionXY;
+	uint PositionZ;
+	/* 11 + 11 bits octahedral normal, 9 bits tangent angle around the normal and the bitangent sign in the last bit */
+	uint NormalTangent;
+	/* Two halfs */
+	uint UV;
+};
+#ifdef __cplusplus
+static_assert(sizeof(PackedMeshVertex) == 16);
+#endif
+
+namespace VertexPacking
+{
+#ifdef __cplusplus
+	using glm::abs;
+	using glm::round;
+	using glm::sin;
+	using glm::cos;
+	using glm::dot;
+	using glm::normalize;
+
+	inline float saturate(float v) { return glm::clamp(v, 0.0f, 1.0f); }
+	inline float atan2(float y, float x) { return glm::atan(y, x); }
+	inline uint f32tof16(float v) { return glm::packHalf1x16(v); }
+	inline float f16tof32(uint v) { return glm::unpackHalf1x16((glm::uint16)(v & 0xffff)); }
+#endif
+
+	__CONST float TWO_PI = 6.28318530717958647692f;
+	__CONST uint OCT_BITS = 11;
+	__CONST uint OCT_MASK = (1u << OCT_BITS) - 1;
+	__CONST uint TANGENT_ANGLE_BITS = 9;
+	__CONST uint TANGENT_ANGLE_STEPS = 1u << TANGENT_ANGLE_BITS;
+
+	__INLINE float SignNotZero(float v)
+	{
+		return v >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	/* Both components in [-1, 1], the lower hemisphere is folded over the diagonals */
+	__INLINE float2 OctahedralEncode(float3 n)
+	{
+		n /= abs(n.x) + abs(n.y) + abs(n.z);
+		if (n.z >= 0.0f)
+			return float2(n.x, n.y);
+		return float2((1.0f - abs(n.y)) * SignNotZero(n.x), (1.0f - abs(n.x)) * SignNotZero(n.y));
+	}
+
+	__INLINE float3 OctahedralDecode(float2 e)
+	{
+		float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+		float t = saturate(-n.z);
+		n.x += n.x >= 0.0f ? -t : t;
+		n.y += n.y >= 0.0f ? -t : t;
+		return normalize(n);
+	}
+
+	/* Signed values on an odd number of steps, so 0 and +-1 are exact */
+	__INLINE uint QuantizeOctahedral(float v)
+	{
+		return uint(round(v * float(OCT_MASK / 2)) + float(OCT_MASK / 2));
+	}
+
+	__INLINE float DequantizeOctahedral(uint q)
+	{
+		return (float(q) - float(OCT_MASK / 2)) / float(OCT_MASK / 2);
+	}
+
+	struct Basis
+	{
+		float3 X;
+		float3 Y;
+	};
+
+	/* Orthonormal basis around a unit vector, from "Building an Orthonormal Basis, Revisited" (Duff et al. 2017) */
+	__INLINE Basis BuildBasis(float3 n)
+	{
+		float s = SignNotZero(n.z);
+		float a = -1.0f / (s + n.z);
+		float b = n.x * n.y * a;
+
+		Basis result;
+		result.X = float3(1.0f + s * n.x * n.x * a, s * b, -s * n.x);
+		result.Y = float3(b, s + n.y * n.y * a, -n.y);
+		return result;
+	}
+
+	/* The tangent is stored as an angle around the basis of the decoded normal, so the decoder rebuilds the exact same basis */
+	__INLINE uint EncodeNormalTangent(float3 normal, float4 tangent)
+	{
+		float2 oct = OctahedralEncode(normal);
+		uint octX = QuantizeOctahedral(oct.x);
+		uint octY = QuantizeOctahedral(oct.y);
+
+		Basis basis = BuildBasis(OctahedralDecode(float2(DequantizeOctahedral(octX), DequantizeOctahedral(octY))));
+		float3 t = float3(tangent.x, tangent.y, tangent.z);
+		float angle = atan2(dot(t, basis.Y), dot(t, basis.X)) / TWO_PI; // [-0.5, 0.5]
+		uint angleQ = uint(round((angle + 1.0f) * float(TANGENT_ANGLE_STEPS))) & (TANGENT_ANGLE_STEPS - 1);
+
+		uint sign = tangent.w < 0.0f ? 1u : 0u;
+		return octX | (octY << OCT_BITS) | (angleQ << (2 * OCT_BITS)) | (sign << 31);
+	}
+
+	__INLINE float3 DecodeNormal(uint packed)
+	{
+		return OctahedralDecode(float2(DequantizeOctahedral(packed & OCT_MASK), DequantizeOctahedral((packed >> OCT_BITS) & OCT_MASK)));
+	}
+
+	/* The normal has to be the one decoded from the same value */
+	__INLINE float4 DecodeTangent(uint packed, float3 normal)
+	{
+		Basis basis = BuildBasis(normal);
+		float angle = float((packed >> (2 * OCT_BITS)) & (TANGENT_ANGLE_STEPS - 1)) * (TWO_PI / float(TANGENT_ANGLE_STEPS));
+		float3 t = basis.X * cos(angle) + basis.Y * sin(angle);
+		return float4(t.x, t.y, t.z, (packed >> 31) != 0 ? -1.0f : 1.0f);
+	}
+
+	__INLINE uint QuantizeUnorm16(float v)
+	{
+		return uint(round(saturate(v) * 65535.0f));
+	}
+
+	/* The positions are relative to the mesh bounds: position = offset + unorm * scale */
+	__INLINE PackedMeshVertex PackMeshVertex(MeshVertex vertex, float3 positionOffset, float3 positionScale)
+	{
+		float3 p = (vertex.Position - positionOffset) / positionScale;
+
+		PackedMeshVertex result;
+		result.PositionXY = QuantizeUnorm16(p.x) | (QuantizeUnorm16(p.y) << 16);
+		result.PositionZ = QuantizeUnorm16(p.z);
+		result.NormalTangent = EncodeNormalTangent(vertex.Normal, vertex.Tangent);
+		result.UV = f32tof16(vertex.UV.x) | (f32tof16(vertex.UV.y) << 16);
+		return result;
+	}
+
+	__INLINE MeshVertex UnpackMeshVertex(PackedMeshVertex packed, float3 positionOffset, float3 positionScale)
+	{
+		float3 p = float3(float(packed.PositionXY & 0xffff), float(packed.PositionXY >> 16), float(packed.PositionZ & 0xffff)) / 65535.0f;
+
+		MeshVertex result;
+		result.Position = positionOffset + p * positionScale;
+		result.Normal = DecodeNormal(packed.NormalTangent);
+		result.Tangent = DecodeTangent(packed.NormalTangent, result.Normal);
+		result.UV = float2(f16tof32(packed.UV & 0xffff), f16tof32(packed.UV >> 16));
+		return result;
+	}
+}
+
 struct Instance
 {
 	uint		Material;
@@ -109,8 +268,13 @@ struct Instance
 	uint		MeshletsOffset;
 	uint		MeshletsTrianglesOffset;
 	uint		MeshletsVerticesOffset;
+	uint		b16BitIndices;
 
-	float4x4	LocalTransform; // Same as ObjectToWorld in raytracing
+	/* Dequantization of the vertex positions, see PackedMeshVertex */
+	float3		PositionOffset;
+	float3		PositionScale;
+
+	float4x4	LocalTransform; // ObjectToWorld in raytracing is this with the position dequantization
 };
 
 struct Meshlet
@@ -123,6 +287,11 @@ struct Meshlet
 	uint VertexCount;
 	uint TriangleCount;
 
+	/* Bounding sphere in mesh local space, xyz center and w radius */
+	float4 BoundingSphere;
+	/* Normal cone axis in xyz and cutoff in w as snorm8, the cutoff is 1 when the cone cannot be culled */
+	uint NormalCone;
+
 	struct Triangle
 	{
 		uint V0 : 10;
@@ -132,6 +301,28 @@ struct Meshlet
 	};
 };
 
+namespace MeshletCulling
+{
+	__INLINE float UnpackSnorm8(uint v)
+	{
+		return float(int(v << 24) >> 24) / 127.0f;
+	}
+
+	/* xyz axis and w cutoff */
+	__INLINE float4 UnpackNormalCone(uint packed)
+	{
+		return float4(UnpackSnorm8(packed), UnpackSnorm8(packed >> 8), UnpackSnorm8(packed >> 16), UnpackSnorm8(packed >> 24));
+	}
+
+	/* Every triangle of the meshlet faces away from the eye. The eye has to be in the same space as the meshlet, the test holds through any transform that does not mirror the mesh. */
+	__INLINE bool IsConeBackfacing(float4 boundingSphere, float4 normalCone, float3 eye)
+	{
+		float3 view = float3(boundingSphere.x, boundingSphere.y, boundingSphere.z) - eye;
+		float3 axis = float3(normalCone.x, normalCone.y, normalCone.z);
+		return dot(view, axis) >= normalCone.w * length(view) + boundingSphere.w;
+	}
+}
+
 struct PathTracerConstants
 {
 	uint NumAccumulatedFrames;
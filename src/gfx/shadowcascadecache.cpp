@@ -0,0 +1,69 @@
+#include "stdafx.h"
+#include "shadowcascadecache.h"
+
+namespace limbo::Gfx
+{
+	void ShadowCascadeCache::Invalidate()
+	{
+		for (CascadeState& cascade : m_Cascades)
+			cascade.bValid = false;
+	}
+
+	void ShadowCascadeCache::SetSettings(const Settings& settings)
+	{
+		m_Settings = settings;
+		m_Settings.ScheduleInterval = Math::Max(m_Settings.ScheduleInterval, 1u);
+		Invalidate();
+	}
+
+	bool ShadowCascadeCache::IsCascadeTurn(uint32 cascade) const
+	{
+		if (!IsScheduled(cascade))
+			return true;
+		return m_FrameIndex % m_Settings.ScheduleInterval == (cascade - m_Settings.FirstScheduledCascade) % m_Settings.ScheduleInterval;
+	}
+
+	uint32 ShadowCascadeCache::Update(const float3& sunDirection, const float4x4 lightViewProj[NumCascades], Span<Math::AABB> movedCasterBounds)
+	{
+		const bool bSunChanged = !(sunDirection == m_SunDirection);
+		m_SunDirection = sunDirection;
+
+		uint32 cascadesToDraw = 0;
+		for (uint32 i = 0; i < NumCascades; ++i)
+		{
+			CascadeState& cascade = m_Cascades[i];
+			if (!m_Settings.bEnabled || !cascade.bValid || bSunChanged)
+			{
+				cascadesToDraw |= 1u << i;
+				continue;
+			}
+
+			if (!cascade.bPending)
+				cascade.bPending = !(lightViewProj[i] == cascade.LightViewProj);
+
+			// The shadow of a caster changes where it was and where it is now, against what the cascade has drawn
+			for (uint32 box = 0; box < movedCasterBounds.GetSize() && !cascade.bPending; ++box)
+				cascade.bPending = Math::AABBInFrustum(cascade.Planes, movedCasterBounds[box]);
+
+			if (cascade.bPending && IsCascadeTurn(i))
+				cascadesToDraw |= 1u << i;
+		}
+
+		for (uint32 i = 0; i < NumCascades; ++i)
+		{
+			if ((cascadesToDraw & (1u << i)) == 0)
+				continue;
+
+			// The shadow pass does not clip the depth, everything between the light and the cascade casts into it
+			CascadeState& cascade = m_Cascades[i];
+			cascade.LightViewProj = lightViewProj[i];
+			Math::ExtractFrustumPlanes(cascade.LightViewProj, cascade.Planes);
+			cascade.Planes[4] = float4(0.0f, 0.0f, 0.0f, 1.0f);
+			cascade.bValid = true;
+			cascade.bPending = false;
+		}
+
+		m_FrameIndex++;
+		return cascadesToDraw;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "shaderinterop.h"
+#include "core/array.h"
+
+namespace limbo::Gfx
+{
+	/**
+	 * Decides which shadow cascades have to be drawn again, the others keep the depth of the last time they were drawn.
+	 *
+	 * A cascade is drawn again when the sun direction changes, when its light matrix changes or when a caster moves inside of it.
+	 * The cascades from FirstScheduledCascade on only catch up on their turn, one frame out of ScheduleInterval, and keep using
+	 * the matrix they were drawn with until then. A change of the sun direction redraws every cascade right away.
+	 */
+	class ShadowCascadeCache
+	{
+	public:
+		static constexpr uint32 NumCascades = SHADOWMAP_CASCADES;
+
+		struct Settings
+		{
+			bool	bEnabled = true;
+			uint32	FirstScheduledCascade = 2;
+			uint32	ScheduleInterval = 4;
+		};
+
+	private:
+		struct CascadeState
+		{
+			// The matrix the depth was drawn with
+			float4x4	LightViewProj;
+			float4		Planes[6];
+			bool		bValid = false;
+			// Changed since it was drawn, waiting for its turn
+			bool		bPending = false;
+		};
+
+		CascadeState	m_Cascades[NumCascades];
+		float3			m_SunDirection = float3(0.0f);
+		uint64			m_FrameIndex = 0;
+		Settings		m_Settings;
+
+	public:
+		// Every cascade is drawn in the next update, for things the cache can not see like a new scene
+		void Invalidate();
+
+		// Returns the cascades to draw this frame as a bit mask, and takes their new matrix.
+		// movedCasterBounds has the box before and the box after the move of every caster that moved since the last update.
+		uint32 Update(const float3& sunDirection, const float4x4 lightViewProj[NumCascades], Span<Math::AABB> movedCasterBounds);
+
+		// The matrix the depth of the cascade was drawn with, the shading has to sample it with this one
+		const float4x4& GetLightViewProj(uint32 cascade) const { return m_Cascades[cascade].LightViewProj; }
+		bool IsScheduled(uint32 cascade) const { return m_Settings.bEnabled && cascade >= m_Settings.FirstScheduledCascade; }
+
+		const Settings& GetSettings() const { return m_Settings; }
+		void SetSettings(const Settings& settings);
+
+	private:
+		bool IsCascadeTurn(uint32 cascade) const;
+	};
+}
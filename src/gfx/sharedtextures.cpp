@@ -0,0 +1,50 @@
+#include "stdafx.h"
+#include "sharedtextures.h"
+
+namespace limbo::Gfx::SharedTextures
+{
+	struct SharedTexture
+	{
+		RHI::TextureHandle	Texture;
+		uint32				NumReferences;
+	};
+
+	std::unordered_map<uint64, SharedTexture> s_Textures;
+
+	RHI::TextureHandle Acquire(uint64 key)
+	{
+		auto it = s_Textures.find(key);
+		if (it == s_Textures.end())
+			return RHI::TextureHandle();
+
+		it->second.NumReferences++;
+		return it->second.Texture;
+	}
+
+	void Add(uint64 key, RHI::TextureHandle texture)
+	{
+		const bool bInserted = s_Textures.try_emplace(key, SharedTexture{ texture, 1 }).second;
+		check(bInserted);
+	}
+
+	void Release(uint64 key)
+	{
+		auto it = s_Textures.find(key);
+		ENSURE_RETURN(it == s_Textures.end());
+
+		if (--it->second.NumReferences > 0)
+			return;
+
+		RHI::DestroyTexture(it->second.Texture);
+		s_Textures.erase(it);
+	}
+
+	SharedTexturesStats GetStats()
+	{
+		SharedTexturesStats stats;
+		stats.NumTextures = (uint32)s_Textures.size();
+		for (const auto& [key, texture] : s_Textures)
+			stats.NumReferences += texture.NumReferences;
+		return stats;
+	}
+}
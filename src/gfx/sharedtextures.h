@@ -0,0 +1,30 @@
+#pragma once
+
+#include "rhi/resourcemanager.h"
+
+namespace limbo::Gfx
+{
+	struct SharedTexturesStats
+	{
+		uint32 NumTextures = 0;
+		uint32 NumReferences = 0;
+	};
+
+	/**
+	 * Scene textures shared by every loaded scene.
+	 *
+	 * The key is the hash of the image contents together with how the image is used and the format of the texture, so the
+	 * same image referenced by another texture or by another scene ends up in the same resource. The texture is destroyed
+	 * with its last reference. Only used from the render thread.
+	 */
+	namespace SharedTextures
+	{
+		// Adds a reference to the texture with this key, returns an invalid handle if there is none yet
+		RHI::TextureHandle Acquire(uint64 key);
+		// The caller holds the first reference
+		void Add(uint64 key, RHI::TextureHandle texture);
+		void Release(uint64 key);
+
+		SharedTexturesStats GetStats();
+	}
+}
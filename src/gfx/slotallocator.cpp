@@ -0,0 +1,75 @@
+#include "stdafx.h"
+#include "slotallocator.h"
+
+namespace limbo::Gfx
+{
+	uint32 SlotAllocator::Allocate(uint32 count)
+	{
+		if (count == 0)
+			return InvalidSlot;
+
+		m_NumAllocated += count;
+		for (size_t i = 0; i < m_FreeRanges.size(); ++i)
+		{
+			SlotRange& range = m_FreeRanges[i];
+			if (range.Count < count)
+				continue;
+
+			const uint32 first = range.First;
+			range.First += count;
+			range.Count -= count;
+			if (range.Count == 0)
+				m_FreeRanges.erase(m_FreeRanges.begin() + i);
+			return first;
+		}
+
+		// Nothing fits, the table grows
+		const uint32 first = m_Size;
+		m_Size += count;
+		return first;
+	}
+
+	void SlotAllocator::Free(uint32 first, uint32 count)
+	{
+		if (count == 0)
+			return;
+
+		check(first + count <= m_Size && count <= m_NumAllocated);
+		m_NumAllocated -= count;
+
+		auto next = std::lower_bound(m_FreeRanges.begin(), m_FreeRanges.end(), first, [](const SlotRange& range, uint32 slot) { return range.First < slot; });
+		check(next == m_FreeRanges.end() || first + count <= next->First);
+
+		// Merge with the ranges right before and right after
+		SlotRange range = { first, count };
+		if (next != m_FreeRanges.end() && next->First == first + count)
+		{
+			range.Count += next->Count;
+			next = m_FreeRanges.erase(next);
+		}
+		if (next != m_FreeRanges.begin())
+		{
+			auto previous = next - 1;
+			check(previous->First + previous->Count <= first);
+			if (previous->First + previous->Count == first)
+			{
+				range.First = previous->First;
+				range.Count += previous->Count;
+				next = m_FreeRanges.erase(previous);
+			}
+		}
+
+		// The end of the table is never a free range, the table shrinks instead
+		if (range.First + range.Count == m_Size)
+			m_Size = range.First;
+		else
+			m_FreeRanges.insert(next, range);
+	}
+
+	void SlotAllocator::Reset()
+	{
+		m_FreeRanges.clear();
+		m_Size = 0;
+		m_NumAllocated = 0;
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+namespace limbo::Gfx
+{
+	/**
+	 * Hands out ranges of consecutive slots of a table, like the instances or the materials of a scene.
+	 *
+	 * A range is taken from the first free range that is big enough, otherwise the table grows at its end.
+	 * Freed ranges are merged with the free ranges next to them, and the table shrinks back when the range at its end is freed.
+	 */
+	class SlotAllocator
+	{
+	public:
+		static constexpr uint32 InvalidSlot = ~0u;
+
+	private:
+		struct SlotRange
+		{
+			uint32 First;
+			uint32 Count;
+		};
+
+		// Sorted by first slot, never touching each other
+		std::vector<SlotRange>	m_FreeRanges;
+		uint32					m_Size = 0;
+		uint32					m_NumAllocated = 0;
+
+	public:
+		// Returns the first slot of the range, InvalidSlot for an empty range
+		uint32 Allocate(uint32 count);
+		void Free(uint32 first, uint32 count);
+		void Reset();
+
+		// One past the last slot in use, the table needs to be at least this big
+		uint32 GetSize() const { return m_Size; }
+		uint32 NumAllocated() const { return m_NumAllocated; }
+		uint32 NumFreeRanges() const { return (uint32)m_FreeRanges.size(); }
+	};
+}
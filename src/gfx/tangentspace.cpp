@@ -0,0 +1,276 @@
+#include "stdafx.h"
+#include "tangentspace.h"
+#include "core/jobsystem.h"
+
+#include <algorithm>
+#include <meshoptimizer.h>
+
+namespace limbo::Gfx::TangentSpace
+{
+	namespace
+	{
+		// Vertices per job when the ranges are summed and when the results are written back
+		constexpr uint32 VerticesPerJob = 16 * 1024;
+
+		template<typename T>
+		struct TriangleRange
+		{
+			uint32			FirstTriangle = 0;
+			uint32			NumTriangles = 0;
+			// Accumulators of the vertices between the smallest and the biggest one the range touches
+			uint32			FirstVertex = 0;
+			std::vector<T>	Accumulators;
+
+			T& operator[](uint32 vertex) { return Accumulators[vertex - FirstVertex]; }
+		};
+
+		// Calls function(first, last) on blocks of vertices, on the job system when there is more than one block
+		template<typename TFunction>
+		void ForEachVertexBlock(uint32 numVertices, TFunction&& function)
+		{
+			const uint32 numBlocks = Math::DivideAndRoundUp(numVertices, VerticesPerJob);
+			if (numBlocks <= 1)
+			{
+				function(0u, numVertices);
+				return;
+			}
+
+			Core::JobContext context;
+			Core::JobSystem::ExecuteMany(context, numBlocks, 1, Core::TOnJobSystemExecuteMany::CreateLambda([&](Core::JobDispatchArgs args)
+			{
+				const uint32 first = args.jobIndex * VerticesPerJob;
+				function(first, Math::Min(first + VerticesPerJob, numVertices));
+			}));
+			Core::JobSystem::Wait(context);
+		}
+
+		// Calls accumulate(triangle, range) for every triangle with the range it belongs to, then sums the ranges into outResult.
+		// The accumulators are addressed with the targets, one per index, that go from 0 to numTargets.
+		template<typename T, typename TAccumulate>
+		void AccumulateTriangles(const uint32* targets, uint32 numTriangles, uint32 numTargets, TAccumulate&& accumulate, std::vector<T>& outResult)
+		{
+			const uint32 numRanges = Math::Max(Math::Min(Core::JobSystem::ThreadCount(), numTriangles / MinTrianglesPerJob), 1u);
+			if (numRanges == 1)
+			{
+				TriangleRange<T> range = { .NumTriangles = numTriangles };
+				range.Accumulators.assign(numTargets, T(0.0f));
+				for (uint32 triangle = 0; triangle < numTriangles; ++triangle)
+					accumulate(triangle, range);
+				outResult = std::move(range.Accumulators);
+				return;
+			}
+
+			const uint32 trianglesPerRange = Math::DivideAndRoundUp(numTriangles, numRanges);
+			std::vector<TriangleRange<T>> ranges(numRanges);
+
+			Core::JobContext context;
+			Core::JobSystem::ExecuteMany(context, numRanges, 1, Core::TOnJobSystemExecuteMany::CreateLambda([&](Core::JobDispatchArgs args)
+			{
+				TriangleRange<T>& range = ranges[args.jobIndex];
+				range.FirstTriangle = args.jobIndex * trianglesPerRange;
+				if (range.FirstTriangle >= numTriangles)
+					return;
+				range.NumTriangles = Math::Min(trianglesPerRange, numTriangles - range.FirstTriangle);
+
+				// The triangles of a range are usually close to each other in the vertex buffer, so the window is a lot smaller than the mesh
+				const uint32* first = &targets[range.FirstTriangle * 3];
+				const uint32* last = first + range.NumTriangles * 3;
+				const auto [minTarget, maxTarget] = std::minmax_element(first, last);
+				range.FirstVertex = *minTarget;
+				range.Accumulators.assign(*maxTarget - *minTarget + 1, T(0.0f));
+
+				for (uint32 triangle = range.FirstTriangle; triangle < range.FirstTriangle + range.NumTriangles; ++triangle)
+					accumulate(triangle, range);
+			}));
+			Core::JobSystem::Wait(context);
+
+			// Always summed in the order of the ranges, the result is the same from run to run
+			outResult.resize(numTargets);
+			ForEachVertexBlock(numTargets, [&](uint32 first, uint32 last)
+			{
+				std::fill(outResult.begin() + first, outResult.begin() + last, T(0.0f));
+				for (TriangleRange<T>& range : ranges)
+				{
+					const uint32 begin = Math::Max(first, range.FirstVertex);
+					const uint32 end = Math::Min(last, range.FirstVertex + (uint32)range.Accumulators.size());
+					for (uint32 vertex = begin; vertex < end; ++vertex)
+						outResult[vertex] += range[vertex];
+				}
+			});
+		}
+
+		// Gives the vertices with the same data in the streams the same target, returns the number of targets.
+		// The vertices that no triangle uses get ~0u.
+		uint32 WeldVertices(const uint32* indices, size_t indexCount, size_t vertexCount, const meshopt_Stream* streams, size_t numStreams, std::vector<uint32>& outRemap, std::vector<uint32>& outTargets)
+		{
+			outRemap.resize(vertexCount);
+			const uint32 numTargets = (uint32)meshopt_generateVertexRemapMulti(outRemap.data(), indices, indexCount, vertexCount, streams, numStreams);
+			outTargets.resize(indexCount);
+			meshopt_remapIndexBuffer(outTargets.data(), indices, indexCount, outRemap.data());
+			return numTargets;
+		}
+
+		float3 NormalizeSafe(const float3& v)
+		{
+			const float length = glm::length(v);
+			return length > 0.0f ? v / length : v;
+		}
+
+		// A zero vector gives a right angle, like in MikkTSpace
+		float AngleBetween(const float3& a, const float3& b)
+		{
+			return acosf(glm::clamp(glm::dot(NormalizeSafe(a), NormalizeSafe(b)), -1.0f, 1.0f));
+		}
+
+		// Angles of the triangle at each of its corners, the triangle can not be degenerate
+		float3 CornerAngles(const float3& p0, const float3& p1, const float3& p2)
+		{
+			const float3 e01 = glm::normalize(p1 - p0);
+			const float3 e12 = glm::normalize(p2 - p1);
+			const float3 e20 = glm::normalize(p0 - p2);
+			return float3(
+				acosf(glm::clamp(-glm::dot(e01, e20), -1.0f, 1.0f)),
+				acosf(glm::clamp(-glm::dot(e12, e01), -1.0f, 1.0f)),
+				acosf(glm::clamp(-glm::dot(e20, e12), -1.0f, 1.0f)));
+		}
+
+		float3 ProjectOnPlane(const float3& v, const float3& normal)
+		{
+			return v - glm::dot(v, normal) * normal;
+		}
+	}
+
+	void GenerateNormals(const uint32* indices, size_t indexCount, MeshVertex* vertices, size_t vertexCount, const NormalSettings& settings)
+	{
+		const uint32 numTriangles = (uint32)(indexCount / 3);
+		if (vertexCount == 0)
+			return;
+
+		std::vector<uint32> remap;
+		std::vector<uint32> welded;
+		const uint32* targets = indices;
+		uint32 numTargets = (uint32)vertexCount;
+		if (settings.bWeldPositions)
+		{
+			const meshopt_Stream position = { &vertices[0].Position, sizeof(float3), sizeof(MeshVertex) };
+			numTargets = WeldVertices(indices, numTriangles * 3, vertexCount, &position, 1, remap, welded);
+			targets = welded.data();
+		}
+
+		std::vector<float3> normals;
+		AccumulateTriangles<float3>(targets, numTriangles, numTargets, [&](uint32 triangle, TriangleRange<float3>& range)
+		{
+			const uint32* corners = &indices[triangle * 3];
+			const uint32* cornerTargets = &targets[triangle * 3];
+			const float3 p0 = vertices[corners[0]].Position;
+			const float3 p1 = vertices[corners[1]].Position;
+			const float3 p2 = vertices[corners[2]].Position;
+
+			// Degenerate triangles have no normal
+			const float3 normal = glm::cross(p1 - p0, p2 - p0);
+			const float length = glm::length(normal);
+			if (!(length > 0.0f))
+				return;
+
+			if (settings.Weighting == NormalWeighting::Area)
+			{
+				// The length of the cross product is twice the area
+				range[cornerTargets[0]] += normal;
+				range[cornerTargets[1]] += normal;
+				range[cornerTargets[2]] += normal;
+				return;
+			}
+
+			const float3 unitNormal = normal / length;
+			const float3 angles = CornerAngles(p0, p1, p2);
+			range[cornerTargets[0]] += unitNormal * angles.x;
+			range[cornerTargets[1]] += unitNormal * angles.y;
+			range[cornerTargets[2]] += unitNormal * angles.z;
+		}, normals);
+
+		ForEachVertexBlock((uint32)vertexCount, [&](uint32 first, uint32 last)
+		{
+			for (uint32 vertex = first; vertex < last; ++vertex)
+			{
+				const uint32 target = settings.bWeldPositions ? remap[vertex] : vertex;
+				const float3 normal = target != ~0u ? normals[target] : float3(0.0f);
+				const float length = glm::length(normal);
+				vertices[vertex].Normal = length > 0.0f ? normal / length : float3(0.0f, 0.0f, 1.0f);
+			}
+		});
+	}
+
+	void GenerateTangents(const uint32* indices, size_t indexCount, MeshVertex* vertices, size_t vertexCount)
+	{
+		const uint32 numTriangles = (uint32)(indexCount / 3);
+		if (vertexCount == 0)
+			return;
+
+		// MikkTSpace also merges the vertices that have the same position, normal and uv
+		const meshopt_Stream streams[] = {
+			{ &vertices[0].Position,	sizeof(float3), sizeof(MeshVertex) },
+			{ &vertices[0].Normal,		sizeof(float3), sizeof(MeshVertex) },
+			{ &vertices[0].UV,			sizeof(float2), sizeof(MeshVertex) },
+		};
+		std::vector<uint32> remap;
+		std::vector<uint32> targets;
+		const uint32 numTargets = WeldVertices(indices, numTriangles * 3, vertexCount, streams, ARRAY_LEN(streams), remap, targets);
+
+		// xyz is the tangent and w the sum of the signs, both weighted by the angle of the triangles
+		std::vector<float4> tangents;
+		AccumulateTriangles<float4>(targets.data(), numTriangles, numTargets, [&](uint32 triangle, TriangleRange<float4>& range)
+		{
+			const MeshVertex* corners[] = { &vertices[indices[triangle * 3 + 0]], &vertices[indices[triangle * 3 + 1]], &vertices[indices[triangle * 3 + 2]] };
+
+			const float3 d1 = corners[1]->Position - corners[0]->Position;
+			const float3 d2 = corners[2]->Position - corners[0]->Position;
+			const float2 t21 = corners[1]->UV - corners[0]->UV;
+			const float2 t31 = corners[2]->UV - corners[0]->UV;
+
+			// Twice the area of the triangle in uv space, negative when the uvs are mirrored
+			const float signedArea = t21.x * t31.y - t21.y * t31.x;
+			const float3 direction = t31.y * d1 - t21.y * d2;
+			const float directionLength = glm::length(direction);
+
+			// The uvs do not span an area, the triangle can not say anything about the tangents
+			if (signedArea == 0.0f || !(directionLength > 0.0f))
+				return;
+
+			const float sign = signedArea > 0.0f ? 1.0f : -1.0f;
+			const float3 tangent = direction * (sign / directionLength);
+
+			for (uint32 i = 0; i < 3; ++i)
+			{
+				const float3 position = corners[i]->Position;
+				const float3 normal = corners[i]->Normal;
+
+				// Everything is projected on the plane of the vertex normal, the angle is the one of the triangle on that plane
+				const float3 previous = ProjectOnPlane(corners[(i + 2) % 3]->Position - position, normal);
+				const float3 next = ProjectOnPlane(corners[(i + 1) % 3]->Position - position, normal);
+				const float angle = AngleBetween(previous, next);
+
+				range[targets[triangle * 3 + i]] += float4(NormalizeSafe(ProjectOnPlane(tangent, normal)) * angle, sign * angle);
+			}
+		}, tangents);
+
+		ForEachVertexBlock((uint32)vertexCount, [&](uint32 first, uint32 last)
+		{
+			for (uint32 vertex = first; vertex < last; ++vertex)
+			{
+				const float4 sum = remap[vertex] != ~0u ? tangents[remap[vertex]] : float4(0.0f);
+				const float3 tangent = float3(sum);
+				const float length = glm::length(tangent);
+				if (length > 0.0f)
+				{
+					vertices[vertex].Tangent = float4(tangent / length, sum.w < 0.0f ? -1.0f : 1.0f);
+					continue;
+				}
+
+				// No triangle with usable uvs, any direction on the plane of the normal is as good as another
+				const float3 normal = vertices[vertex].Normal;
+				const float3 axis = fabsf(normal.x) < 0.9f ? float3(1.0f, 0.0f, 0.0f) : float3(0.0f, 1.0f, 0.0f);
+				vertices[vertex].Tangent = float4(glm::normalize(ProjectOnPlane(axis, normal)), 1.0f);
+			}
+		});
+	}
+}
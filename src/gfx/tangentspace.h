@@ -0,0 +1,41 @@
+#pragma once
+
+#include "shaderinterop.h"
+
+/**
+ * Normals and tangents for the meshes that do not come with them.
+ *
+ * The triangles are split in one range per thread. Every range adds its triangles into its own accumulators,
+ * which only cover the vertices the range touches, and the ranges are summed per vertex afterwards. There are
+ * no atomics and the result does not depend on the order the jobs run in.
+ */
+namespace limbo::Gfx::TangentSpace
+{
+	// How much a triangle adds to the normal of each of its vertices
+	enum class NormalWeighting : uint8
+	{
+		// The triangle area, big triangles win over the small ones
+		Area = 0,
+		// The angle of the triangle at the vertex, the result does not change with how a face is triangulated
+		Angle,
+	};
+
+	struct NormalSettings
+	{
+		NormalWeighting Weighting = NormalWeighting::Angle;
+		// Vertices at the same position get the same normal, a uv seam does not show up in the lighting
+		bool			bWeldPositions = true;
+	};
+
+	// Ranges smaller than this are not worth a job
+	constexpr uint32 MinTrianglesPerJob = 16 * 1024;
+
+	// Smooth normals. Degenerate triangles are ignored, a vertex without any other triangle gets +Z.
+	// It is safe to call this from a job.
+	void GenerateNormals(const uint32* indices, size_t indexCount, MeshVertex* vertices, size_t vertexCount, const NormalSettings& settings = NormalSettings());
+
+	// MikkTSpace tangents from the normals and the uvs. The bitangent is cross(normal, tangent.xyz) * tangent.w like in glTF.
+	// A vertex shared by mirrored and not mirrored triangles is not split, it keeps the sign of the biggest side.
+	// It is safe to call this from a job.
+	void GenerateTangents(const uint32* indices, size_t indexCount, MeshVertex* vertices, size_t vertexCount);
+}
@@ -2,6 +2,7 @@
 #include "gbuffer.h"
 
 #include "gfx/psocache.h"
+#include "gfx/profiler.h"
 #include "gfx/rendercontext.h"
 #include "gfx/scene.h"
 #include "gfx/rhi/commandcontext.h"
@@ -11,10 +12,14 @@ namespace limbo::Gfx
 	namespace 
 	{
 		bool bMeshShadersRendering = true;
+		bool bExecuteIndirect = true;
+		bool bEnableMeshLODs = true;
+		float MeshLODPixelError = 1.0f;
 	}
 
 	GBuffer::GBuffer()
 		: RenderTechnique("GBuffer")
+		, m_IndirectCommands("GBuffer Indirect Commands")
 	{
 	}
 
@@ -27,11 +32,19 @@ namespace limbo::Gfx
 	{
 		auto renderTargets = context.GetGBufferTextures();
 
+		const PipelineID pipeline = bMeshShadersRendering ? PipelineID::DeferredShading_Mesh : PipelineID::DeferredShading;
+		{
+			// Opaque first and front to back, so the early depth test rejects as much as it can
+			PROFILE_CPU_SCOPE("Sort GBuffer Draws");
+			m_DrawList.Build(context.GetVisibleInstances(CV_Camera), context.GetDrawInstances(), context.GetInstanceBounds(), {
+				.Origin = context.Camera.Eye,
+				.Direction = context.Camera.Center,
+				.Pipeline = (uint32)pipeline
+			});
+		}
+
 		cmd.BeginProfileEvent(m_Name.data());
-		if (!bMeshShadersRendering)
-			cmd.SetPipelineState(PSOCache::Get(PipelineID::DeferredShading));
-		else
-			cmd.SetPipelineState(PSOCache::Get(PipelineID::DeferredShading_Mesh));
+		cmd.SetPipelineState(PSOCache::Get(pipeline));
 		cmd.SetPrimitiveTopology();
 		cmd.SetRenderTargets(renderTargets, context.SceneTextures.GBufferDepthTarget);
 		cmd.SetViewport(context.RenderSize.x, context.RenderSize.y);
@@ -40,18 +53,57 @@ namespace limbo::Gfx
 		cmd.ClearDepthTarget(context.SceneTextures.GBufferDepthTarget, 0.0f);
 
 		cmd.BindTempConstantBuffer(1, context.SceneInfo);
-		for (const Scene* scene : context.GetScenes())
+		const MeshLODView lodView = context.GetMeshLODView(MeshLODPixelError);
+		if (bExecuteIndirect)
+		{
+			// The geometry is bindless, the whole pass is a single call
+			const uint32 numDraws = m_DrawList.GetSize();
+			uint64 commandsOffset = 0;
+			{
+				PROFILE_CPU_SCOPE("Pack GBuffer Commands");
+				if (!bMeshShadersRendering)
+				{
+					m_IndirectCommands.Reset(numDraws * sizeof(IndirectDrawIndexedCommand));
+					IndirectDrawIndexedCommand* commands = (IndirectDrawIndexedCommand*)m_IndirectCommands.Allocate(numDraws * sizeof(IndirectDrawIndexedCommand), commandsOffset);
+					PackIndirectCommands(m_DrawList.GetKeys(), commands, [&](uint32 instance)
+					{
+						const Mesh& mesh = context.GetInstanceMesh(instance);
+						const uint32 lodIndex = bEnableMeshLODs ? SelectMeshLOD(mesh.LODs, mesh.NumLODs, mesh.BoundingSphere, mesh.Transform, lodView) : 0;
+						return CreateDrawIndexedCommand(mesh.InstanceID, mesh.LODs[lodIndex].FirstMeshlet, CreateIndirectIndexBufferView(mesh.GetLODIndices(lodIndex)), mesh.LODs[lodIndex].IndexCount);
+					});
+				}
+				else
+				{
+					m_IndirectCommands.Reset(numDraws * sizeof(IndirectDispatchMeshCommand));
+					IndirectDispatchMeshCommand* commands = (IndirectDispatchMeshCommand*)m_IndirectCommands.Allocate(numDraws * sizeof(IndirectDispatchMeshCommand), commandsOffset);
+					PackIndirectCommands(m_DrawList.GetKeys(), commands, [&](uint32 instance)
+					{
+						const Mesh& mesh = context.GetInstanceMesh(instance);
+						const uint32 lodIndex = bEnableMeshLODs ? SelectMeshLOD(mesh.LODs, mesh.NumLODs, mesh.BoundingSphere, mesh.Transform, lodView) : 0;
+						return CreateDispatchMeshCommand(mesh.InstanceID, mesh.LODs[lodIndex].FirstMeshlet, mesh.LODs[lodIndex].MeshletCount);
+					});
+				}
+			}
+
+			cmd.ExecuteIndirect(PSOCache::GetCommandSignature(pipeline), m_IndirectCommands.GetBuffer(), numDraws, commandsOffset);
+		}
+		else
 		{
-			scene->IterateMeshes(TOnDrawMesh::CreateLambda([&](const Mesh& mesh)
+			for (uint64 key : m_DrawList.GetKeys())
 			{
+				const Mesh& mesh = context.GetInstanceMesh(DrawList::GetInstance(key));
+				const uint32 lodIndex = bEnableMeshLODs ? SelectMeshLOD(mesh.LODs, mesh.NumLODs, mesh.BoundingSphere, mesh.Transform, lodView) : 0;
+				const MeshLOD& lod = mesh.LODs[lodIndex];
+
 				cmd.BindConstants(0, 0, mesh.InstanceID);
+				cmd.BindConstants(0, 1, lod.FirstMeshlet);
 
-				cmd.SetIndexBufferView(mesh.IndicesLocation);
+				cmd.SetIndexBufferView(mesh.GetLODIndices(lodIndex));
 				if (!bMeshShadersRendering)
-					cmd.DrawIndexed((uint32)mesh.IndexCount);
+					cmd.DrawIndexed(lod.IndexCount);
 				else
-					cmd.DispatchMesh((uint32)mesh.MeshletsCount, 1, 1);
-			}));
+					cmd.DispatchMesh(lod.MeshletCount, 1, 1);
+			}
 		}
 		cmd.EndProfileEvent(m_Name.data());
 	}
@@ -61,6 +113,9 @@ namespace limbo::Gfx
 		if (ImGui::TreeNode("GBuffer"))
 		{
 			ImGui::Checkbox("Enable Mesh Shading", &bMeshShadersRendering);
+			ImGui::Checkbox("Execute Indirect", &bExecuteIndirect);
+			ImGui::Checkbox("Enable Mesh LODs", &bEnableMeshLODs);
+			ImGui::DragFloat("LOD Pixel Error", &MeshLODPixelError, 0.1f, 0.0f, 32.0f);
 
 			ImGui::TreePop();
 		}
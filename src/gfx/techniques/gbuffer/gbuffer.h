@@ -1,10 +1,15 @@
 #pragma once
 #include "gfx/techniques/rendertechnique.h"
+#include "gfx/drawlist.h"
+#include "gfx/indirectcommands.h"
 
 namespace limbo::Gfx
 {
 	class GBuffer : public RenderTechnique
 	{
+		DrawList				m_DrawList;
+		IndirectCommandBuffer	m_IndirectCommands;
+
 	public:
 		GBuffer();
 
@@ -17,6 +17,10 @@ namespace limbo::Gfx
 	{
 	}
 
+	void RenderTechnique::PreRender(RenderContext& context)
+	{
+	}
+
 	void RenderTechnique::RenderUI(RenderContext& context)
 	{
 	}
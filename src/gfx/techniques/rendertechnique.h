@@ -37,6 +37,12 @@ namespace limbo::Gfx
 		 */
 		virtual void OnResize(uint32 width, uint32 height);
 
+		/**
+		 * Called for every technique that renders this frame before any of them renders.
+		 * Used to set up the data the culling or the other techniques need, like the shadow cascades.
+		 */
+		virtual void PreRender(RenderContext& context);
+
 		/**
 		 * Perform Render operations
 		 */
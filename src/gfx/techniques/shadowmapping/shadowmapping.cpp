@@ -13,16 +13,21 @@
 #include <format>
 
 #include "gfx/psocache.h"
+#include "gfx/profiler.h"
 
 namespace limbo::Gfx
 {
 	namespace
 	{
 		bool bStabilizeCascades = true;
+		bool bEnableMeshLODs = true;
+		// The shadows are filtered and seen from further away, they can take coarser LODs than the GBuffer
+		float MeshLODPixelError = 4.0f;
 	}
 
 	ShadowMapping::ShadowMapping()
 		: RenderTechnique("Shadow Mapping")
+		, m_IndirectCommands("Shadow Map Indirect Commands")
 	{
 	}
 
@@ -45,6 +50,23 @@ namespace limbo::Gfx
 		return context.CanRenderShadows();
 	}
 
+	void ShadowMapping::PreRender(RenderContext& context)
+	{
+		// The culling needs the cascades before anything renders
+		CreateLightMatrices(context);
+
+		if (context.GetScenesVersion() != m_ScenesVersion)
+		{
+			m_CascadeCache.Invalidate();
+			m_ScenesVersion = context.GetScenesVersion();
+		}
+
+		// The cascades that are not drawn keep the matrix their depth was drawn with
+		m_CascadesToDraw = m_CascadeCache.Update(float3(context.SceneInfo.SunDirection), context.ShadowMapData.LightViewProj, context.GetMovedInstanceBounds());
+		for (uint32 cascade = 0; cascade < SHADOWMAP_CASCADES; ++cascade)
+			context.ShadowMapData.LightViewProj[cascade] = m_CascadeCache.GetLightViewProj(cascade);
+	}
+
 	void ShadowMapping::Render(RHI::CommandContext& cmd, RenderContext& context)
 	{
 		if (UIGlobals::bDebugShadowMaps)
@@ -54,14 +76,41 @@ namespace limbo::Gfx
 		for (int i = 0; i < SHADOWMAP_CASCADES; ++i)
 			context.SceneTextures.ShadowMaps[i] = m_ShadowMaps[i];
 
-		CreateLightMatrices(context);
+		{
+			// Front to back from the sun
+			PROFILE_CPU_SCOPE("Sort Shadow Draws");
+			const float3 lightDirection = glm::normalize(-float3(context.SceneInfo.SunDirection));
+			for (uint32 cascade = 0; cascade < SHADOWMAP_CASCADES; ++cascade)
+			{
+				if ((m_CascadesToDraw & (1u << cascade)) == 0)
+					continue;
+
+				m_DrawLists[cascade].Build(context.GetVisibleInstances(CV_ShadowCascade0 + cascade), context.GetDrawInstances(), context.GetInstanceBounds(), {
+					.Direction = lightDirection,
+					.Pipeline = (uint32)PipelineID::ShadowMapping
+				});
+			}
+		}
 
 		// Shadow map
 		cmd.BeginProfileEvent("Shadow Maps Pass");
 		cmd.SetPipelineState(PSOCache::Get(PipelineID::ShadowMapping));
 		cmd.SetPrimitiveTopology();
-		for (int cascade = 0; cascade < SHADOWMAP_CASCADES; ++cascade)
+		const MeshLODView lodView = context.GetMeshLODView(MeshLODPixelError);
+
+		uint32 numCommands = 0;
+		for (uint32 cascade = 0; cascade < SHADOWMAP_CASCADES; ++cascade)
 		{
+			if (m_CascadesToDraw & (1u << cascade))
+				numCommands += m_DrawLists[cascade].GetSize();
+		}
+		m_IndirectCommands.Reset(numCommands * sizeof(IndirectDrawIndexedCommand));
+
+		for (uint32 cascade = 0; cascade < SHADOWMAP_CASCADES; ++cascade)
+		{
+			if ((m_CascadesToDraw & (1u << cascade)) == 0)
+				continue;
+
 			std::string profileName = std::format("Shadow Cascade {}", cascade);
 
 			cmd.BeginProfileEvent(profileName.c_str());
@@ -70,21 +119,21 @@ namespace limbo::Gfx
 
 			cmd.ClearDepthTarget(m_ShadowMaps[cascade], 1.0f);
 
-			cmd.BindConstants(2, 0, cascade);
-
 			cmd.BindTempConstantBuffer(0, context.SceneInfo);
 			cmd.BindTempConstantBuffer(1, context.ShadowMapData);
 
-			for (const Scene* scene : context.GetScenes())
+			// Every command sets the cascade and the instance, the cascade is drawn in a single call
+			const DrawList& drawList = m_DrawLists[cascade];
+			uint64 commandsOffset = 0;
+			IndirectDrawIndexedCommand* commands = (IndirectDrawIndexedCommand*)m_IndirectCommands.Allocate(drawList.GetSize() * sizeof(IndirectDrawIndexedCommand), commandsOffset);
+			PackIndirectCommands(drawList.GetKeys(), commands, [&](uint32 instance)
 			{
-				scene->IterateMeshes(TOnDrawMesh::CreateLambda([&](const Mesh& mesh)
-				{
-					cmd.BindConstants(2, 1, mesh.InstanceID);
+				const Mesh& mesh = context.GetInstanceMesh(instance);
+				const uint32 lodIndex = bEnableMeshLODs ? SelectMeshLOD(mesh.LODs, mesh.NumLODs, mesh.BoundingSphere, mesh.Transform, lodView) : 0;
+				return CreateDrawIndexedCommand(cascade, mesh.InstanceID, CreateIndirectIndexBufferView(mesh.GetLODIndices(lodIndex)), mesh.LODs[lodIndex].IndexCount);
+			});
+			cmd.ExecuteIndirect(PSOCache::GetCommandSignature(PipelineID::ShadowMapping), m_IndirectCommands.GetBuffer(), drawList.GetSize(), commandsOffset);
 
-					cmd.SetIndexBufferView(mesh.IndicesLocation);
-					cmd.DrawIndexed((uint32)mesh.IndexCount);
-				}));
-			}
 			cmd.EndProfileEvent(profileName.c_str());
 		}
 		cmd.EndProfileEvent("Shadow Maps Pass");
@@ -95,6 +144,22 @@ namespace limbo::Gfx
 		if (ImGui::TreeNode("Shadows"))
 		{
 			ImGui::Checkbox("Stabilize cascades", &bStabilizeCascades);
+
+			// Anything that changes what the cascades draw makes the cached ones stale
+			bool bInvalidate = false;
+			bInvalidate |= ImGui::Checkbox("Enable Mesh LODs", &bEnableMeshLODs);
+			bInvalidate |= ImGui::DragFloat("LOD Pixel Error", &MeshLODPixelError, 0.1f, 0.0f, 32.0f);
+			if (bInvalidate)
+				m_CascadeCache.Invalidate();
+
+			ShadowCascadeCache::Settings cacheSettings = m_CascadeCache.GetSettings();
+			bool bCacheChanged = ImGui::Checkbox("Cache cascades", &cacheSettings.bEnabled);
+			bCacheChanged |= ImGui::SliderInt("First scheduled cascade", (int*)&cacheSettings.FirstScheduledCascade, 0, SHADOWMAP_CASCADES);
+			bCacheChanged |= ImGui::SliderInt("Scheduled cascades interval", (int*)&cacheSettings.ScheduleInterval, 1, 8);
+			if (bCacheChanged)
+				m_CascadeCache.SetSettings(cacheSettings);
+
+			ImGui::Text("Drawn this frame: %s%s%s%s", (m_CascadesToDraw & 1) ? "0 " : "", (m_CascadesToDraw & 2) ? "1 " : "", (m_CascadesToDraw & 4) ? "2 " : "", (m_CascadesToDraw & 8) ? "3" : "");
 			ImGui::TreePop();
 		}
 	}
@@ -188,6 +253,17 @@ namespace limbo::Gfx
 			glm::vec3 minExtents = -maxExtents;
 
 			glm::vec3 lightDir = glm::normalize(-context.SceneInfo.SunDirection);
+			if (bStabilizeCascades)
+			{
+				// Snap the center to the texels of the cascade in light space, the matrix then stays the same until the camera moves
+				// by a whole texel, which is what lets the cascade cache keep the cascade. The radius grows to cover the snapping.
+				const float texelSize = 2.0f * radius / SHADOWMAP_SIZES[cascade];
+				const glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), lightDir, glm::vec3(0.0f, 1.0f, 0.0f));
+				const float3 lightSpaceCenter = glm::floor(float3(lightRotation * float4(frustumCenter, 1.0f)) / texelSize) * texelSize;
+				frustumCenter = float3(glm::transpose(lightRotation) * float4(lightSpaceCenter, 1.0f));
+				maxExtents += texelSize * 2.0f;
+				minExtents -= texelSize * 2.0f;
+			}
 			glm::mat4 lightViewMatrix = glm::lookAt(frustumCenter - lightDir * -minExtents.z, frustumCenter, glm::vec3(0.0f, 1.0f, 0.0f));
 			glm::mat4 lightOrthoMatrix = glm::orthoZO(minExtents.x, maxExtents.x, minExtents.y, maxExtents.y, 0.0f, maxExtents.z - minExtents.z);
 			glm::mat4 shadowMatrix = lightOrthoMatrix * lightViewMatrix;
@@ -1,5 +1,8 @@
 ﻿#pragma once
 #include "gfx/shaderinterop.h"
+#include "gfx/shadowcascadecache.h"
+#include "gfx/drawlist.h"
+#include "gfx/indirectcommands.h"
 #include "gfx/rhi/texture.h"
 #include "gfx/techniques/rendertechnique.h"
 
@@ -12,12 +15,20 @@ namespace limbo::Gfx
 		RHI::TextureHandle			m_ShadowMaps[SHADOWMAP_CASCADES];
 		float						m_CascadeSplitLambda = 0.95f;
 
+		ShadowCascadeCache			m_CascadeCache;
+		// Bit mask of the cascades drawn this frame
+		uint32						m_CascadesToDraw = 0;
+		DrawList					m_DrawLists[SHADOWMAP_CASCADES];
+		IndirectCommandBuffer		m_IndirectCommands;
+		uint32						m_ScenesVersion = ~0u;
+
 	public:
 		ShadowMapping();
 		virtual ~ShadowMapping() override;
 
 		virtual bool Init() override;
 		virtual bool ConditionalRender(RenderContext& context) override;
+		virtual void PreRender(RenderContext& context) override;
 		virtual void Render(RHI::CommandContext& cmd, RenderContext& context) override;
 		virtual void RenderUI(RenderContext& context) override;
 
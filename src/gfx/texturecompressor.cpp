@@ -0,0 +1,811 @@
+#include "stdafx.h"
+#include "texturecompressor.h"
+#include "core/jobsystem.h"
+
+#include <emmintrin.h>
+#include <cfloat>
+#include <cmath>
+
+namespace limbo::Gfx::TextureCompressor
+{
+	namespace
+	{
+		constexpr uint32 BlockSize = 4;
+		constexpr uint32 BlockPixels = BlockSize * BlockSize;
+
+		// BC7 index interpolation weights for 4 bit indices, out of 64
+		constexpr int BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		template<typename T>
+		T Clamp(T value, T min, T max)
+		{
+			return Math::Min(Math::Max(value, min), max);
+		}
+
+		struct BitWriter
+		{
+			uint64 Bits[2] = {};
+			uint32 Offset = 0;
+
+			void Write(uint32 value, uint32 count)
+			{
+				for (uint32 i = 0; i < count; ++i, ++Offset)
+					Bits[Offset >> 6] |= uint64((value >> i) & 1u) << (Offset & 63);
+			}
+		};
+
+		// Per channel min/max of the 16 pixels
+		void GetBoundingBox(const uint8* rgba, uint8* minColor, uint8* maxColor)
+		{
+			const __m128i p0 = _mm_loadu_si128((const __m128i*)(rgba + 0));
+			const __m128i p1 = _mm_loadu_si128((const __m128i*)(rgba + 16));
+			const __m128i p2 = _mm_loadu_si128((const __m128i*)(rgba + 32));
+			const __m128i p3 = _mm_loadu_si128((const __m128i*)(rgba + 48));
+
+			__m128i min = _mm_min_epu8(_mm_min_epu8(p0, p1), _mm_min_epu8(p2, p3));
+			__m128i max = _mm_max_epu8(_mm_max_epu8(p0, p1), _mm_max_epu8(p2, p3));
+
+			// Fold the 4 pixels of each register into one
+			min = _mm_min_epu8(min, _mm_shuffle_epi32(min, _MM_SHUFFLE(2, 3, 0, 1)));
+			min = _mm_min_epu8(min, _mm_shuffle_epi32(min, _MM_SHUFFLE(1, 0, 3, 2)));
+			max = _mm_max_epu8(max, _mm_shuffle_epi32(max, _MM_SHUFFLE(2, 3, 0, 1)));
+			max = _mm_max_epu8(max, _mm_shuffle_epi32(max, _MM_SHUFFLE(1, 0, 3, 2)));
+
+			const int32 minValue = _mm_cvtsi128_si32(min);
+			const int32 maxValue = _mm_cvtsi128_si32(max);
+			memcpy(minColor, &minValue, 4);
+			memcpy(maxColor, &maxValue, 4);
+		}
+
+		// The bounding box only gives the right endpoints when every channel grows in the same direction.
+		// Flip the channels that go against the channel with the widest range.
+		void SelectDiagonal(const uint8* rgba, uint32 numChannels, uint8* minColor, uint8* maxColor)
+		{
+			uint32 majorChannel = 0;
+			for (uint32 c = 1; c < numChannels; ++c)
+			{
+				if (maxColor[c] - minColor[c] > maxColor[majorChannel] - minColor[majorChannel])
+					majorChannel = c;
+			}
+
+			int center[4];
+			for (uint32 c = 0; c < numChannels; ++c)
+				center[c] = (minColor[c] + maxColor[c] + 1) >> 1;
+
+			int covariance[4] = {};
+			for (uint32 i = 0; i < BlockPixels; ++i)
+			{
+				const int major = rgba[i * 4 + majorChannel] - center[majorChannel];
+				for (uint32 c = 0; c < numChannels; ++c)
+					covariance[c] += major * (rgba[i * 4 + c] - center[c]);
+			}
+
+			for (uint32 c = 0; c < numChannels; ++c)
+			{
+				if (covariance[c] < 0)
+					std::swap(minColor[c], maxColor[c]);
+			}
+		}
+
+		// Position of every pixel along the axis going from origin to origin + axis, rounded to [0, maxLevel].
+		// Channels with a zero axis component do not contribute.
+		void QuantizeToAxis(const uint8* rgba, const int* origin, const int* axis, uint32 maxLevel, uint8* levels)
+		{
+			const int axisLengthSq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3];
+			if (axisLengthSq == 0)
+			{
+				memset(levels, 0, BlockPixels);
+				return;
+			}
+
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i o = _mm_set_epi16((int16)origin[3], (int16)origin[2], (int16)origin[1], (int16)origin[0], (int16)origin[3], (int16)origin[2], (int16)origin[1], (int16)origin[0]);
+			const __m128i a = _mm_set_epi16((int16)axis[3], (int16)axis[2], (int16)axis[1], (int16)axis[0], (int16)axis[3], (int16)axis[2], (int16)axis[1], (int16)axis[0]);
+			const __m128 scale = _mm_set1_ps((float)maxLevel / (float)axisLengthSq);
+			const __m128 maxValue = _mm_set1_ps((float)maxLevel);
+
+			for (uint32 i = 0; i < 4; ++i)
+			{
+				const __m128i pixels = _mm_loadu_si128((const __m128i*)(rgba + i * 16));
+
+				// [p0.rg, p0.ba, p1.rg, p1.ba] and the same for p2, p3
+				__m128i lo = _mm_madd_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(pixels, zero), o), a);
+				__m128i hi = _mm_madd_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(pixels, zero), o), a);
+				lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+				hi = _mm_add_epi32(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+				const __m128 dots = _mm_cvtepi32_ps(_mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0))));
+
+				const __m128 position = _mm_min_ps(_mm_max_ps(_mm_mul_ps(dots, scale), _mm_setzero_ps()), maxValue);
+				const __m128i rounded = _mm_cvtps_epi32(position);
+				const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(rounded, zero), zero);
+
+				const int32 value = _mm_cvtsi128_si32(packed);
+				memcpy(levels + i * 4, &value, 4);
+			}
+		}
+
+		// Principal axis of the pixels through power iteration, only the first numChannels channels are used
+		void GetPrincipalAxis(const uint8* rgba, uint32 numChannels, float* mean, float* axis)
+		{
+			for (uint32 c = 0; c < 4; ++c)
+			{
+				mean[c] = 0.0f;
+				axis[c] = 0.0f;
+			}
+
+			for (uint32 i = 0; i < BlockPixels; ++i)
+			{
+				for (uint32 c = 0; c < numChannels; ++c)
+					mean[c] += rgba[i * 4 + c];
+			}
+			for (uint32 c = 0; c < numChannels; ++c)
+				mean[c] /= (float)BlockPixels;
+
+			float covariance[4][4] = {};
+			for (uint32 i = 0; i < BlockPixels; ++i)
+			{
+				float d[4];
+				for (uint32 c = 0; c < numChannels; ++c)
+					d[c] = rgba[i * 4 + c] - mean[c];
+
+				for (uint32 r = 0; r < numChannels; ++r)
+				{
+					for (uint32 c = 0; c < numChannels; ++c)
+						covariance[r][c] += d[r] * d[c];
+				}
+			}
+
+			for (uint32 c = 0; c < numChannels; ++c)
+				axis[c] = 1.0f;
+
+			for (uint32 iteration = 0; iteration < 8; ++iteration)
+			{
+				float next[4] = {};
+				float length = 0.0f;
+				for (uint32 r = 0; r < numChannels; ++r)
+				{
+					for (uint32 c = 0; c < numChannels; ++c)
+						next[r] += covariance[r][c] * axis[c];
+					length = Math::Max(length, fabsf(next[r]));
+				}
+
+				// Flat block, any axis works
+				if (length < 1e-6f)
+					return;
+
+				for (uint32 c = 0; c < numChannels; ++c)
+					axis[c] = next[c] / length;
+			}
+		}
+
+		// Extremes of the pixels projected on the axis
+		void GetAxisEndpoints(const uint8* rgba, uint32 numChannels, const float* mean, const float* axis, float* e0, float* e1)
+		{
+			float minProjection = FLT_MAX;
+			float maxProjection = -FLT_MAX;
+			float axisLengthSq = 0.0f;
+			for (uint32 c = 0; c < numChannels; ++c)
+				axisLengthSq += axis[c] * axis[c];
+
+			for (uint32 i = 0; i < BlockPixels; ++i)
+			{
+				float projection = 0.0f;
+				for (uint32 c = 0; c < numChannels; ++c)
+					projection += (rgba[i * 4 + c] - mean[c]) * axis[c];
+				minProjection = Math::Min(minProjection, projection);
+				maxProjection = Math::Max(maxProjection, projection);
+			}
+
+			if (axisLengthSq > 0.0f)
+			{
+				minProjection /= axisLengthSq;
+				maxProjection /= axisLengthSq;
+			}
+			else
+			{
+				minProjection = maxProjection = 0.0f;
+			}
+
+			for (uint32 c = 0; c < numChannels; ++c)
+			{
+				e0[c] = Clamp(mean[c] + axis[c] * minProjection, 0.0f, 255.0f);
+				e1[c] = Clamp(mean[c] + axis[c] * maxProjection, 0.0f, 255.0f);
+			}
+		}
+
+		// Least squares fit of the two endpoints for the given interpolation weights (weight of e1, in [0, 1])
+		bool RefineEndpoints(const uint8* rgba, uint32 numChannels, const float* weights, float* e0, float* e1)
+		{
+			float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+			float ap[4] = {}, bp[4] = {};
+			for (uint32 i = 0; i < BlockPixels; ++i)
+			{
+				const float b = weights[i];
+				const float a = 1.0f - b;
+				aa += a * a;
+				ab += a * b;
+				bb += b * b;
+				for (uint32 c = 0; c < numChannels; ++c)
+				{
+					ap[c] += a * rgba[i * 4 + c];
+					bp[c] += b * rgba[i * 4 + c];
+				}
+			}
+
+			const float determinant = aa * bb - ab * ab;
+			if (fabsf(determinant) < 1e-6f)
+				return false;
+
+			const float invDeterminant = 1.0f / determinant;
+			for (uint32 c = 0; c < numChannels; ++c)
+			{
+				e0[c] = Clamp((ap[c] * bb - bp[c] * ab) * invDeterminant, 0.0f, 255.0f);
+				e1[c] = Clamp((bp[c] * aa - ap[c] * ab) * invDeterminant, 0.0f, 255.0f);
+			}
+			return true;
+		}
+
+		//
+		// BC1
+		//
+		uint16 PackRGB565(const float* color)
+		{
+			const uint32 r = (uint32)Clamp(color[0] * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f);
+			const uint32 g = (uint32)Clamp(color[1] * 63.0f / 255.0f + 0.5f, 0.0f, 63.0f);
+			const uint32 b = (uint32)Clamp(color[2] * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f);
+			return (uint16)((r << 11) | (g << 5) | b);
+		}
+
+		void UnpackRGB565(uint16 value, int* color)
+		{
+			const int r = (value >> 11) & 31;
+			const int g = (value >> 5) & 63;
+			const int b = value & 31;
+			color[0] = (r << 3) | (r >> 2);
+			color[1] = (g << 2) | (g >> 4);
+			color[2] = (b << 3) | (b >> 2);
+			color[3] = 0;
+		}
+
+		// Four color palette, c0 > c1 is assumed
+		void GetBC1Palette(uint16 c0, uint16 c1, int palette[4][4])
+		{
+			UnpackRGB565(c0, palette[0]);
+			UnpackRGB565(c1, palette[1]);
+			for (uint32 c = 0; c < 3; ++c)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+		}
+
+		struct BC1Block
+		{
+			uint16 C0 = 0;
+			uint16 C1 = 0;
+			uint8  Indices[BlockPixels] = {};
+			uint32 Error = UINT_MAX;
+		};
+
+		// Nearest palette entry for every pixel
+		void EvaluateBC1(const uint8* rgba, uint16 c0, uint16 c1, BC1Block& block)
+		{
+			// The four color mode needs c0 > c1, the palette is symmetric so the endpoints can be swapped freely
+			if (c0 < c1)
+				std::swap(c0, c1);
+
+			block.C0 = c0;
+			block.C1 = c1;
+			block.Error = 0;
+
+			int palette[4][4];
+			GetBC1Palette(c0, c1, palette);
+			for (uint32 i = 0; i < BlockPixels; ++i)
+			{
+				uint32 bestError = UINT_MAX;
+				for (uint8 p = 0; p < 4; ++p)
+				{
+					const int dr = rgba[i * 4 + 0] - palette[p][0];
+					const int dg = rgba[i * 4 + 1] - palette[p][1];
+					const int db = rgba[i * 4 + 2] - palette[p][2];
+					const uint32 error = (uint32)(dr * dr + dg * dg + db * db);
+					if (error < bestError)
+					{
+						bestError = error;
+						block.Indices[i] = p;
+					}
+				}
+				block.Error += bestError;
+			}
+		}
+
+		void EncodeBC1Fast(const uint8* rgba, BC1Block& block)
+		{
+			uint8 minColor[4], maxColor[4];
+			GetBoundingBox(rgba, minColor, maxColor);
+			SelectDiagonal(rgba, 3, minColor, maxColor);
+
+			// Inset the bounding box a bit, the extremes are rarely the best endpoints
+			float e0[3], e1[3];
+			for (uint32 c = 0; c < 3; ++c)
+			{
+				const int inset = (maxColor[c] - minColor[c]) / 16;
+				e0[c] = (float)(maxColor[c] - inset);
+				e1[c] = (float)(minColor[c] + inset);
+			}
+
+			block.C0 = PackRGB565(e0);
+			block.C1 = PackRGB565(e1);
+			if (block.C0 == block.C1)
+				return;
+			if (block.C0 < block.C1)
+				std::swap(block.C0, block.C1);
+
+			int palette[4][4];
+			GetBC1Palette(block.C0, block.C1, palette);
+			const int origin[4] = { palette[1][0], palette[1][1], palette[1][2], 0 };
+			const int axis[4] = { palette[0][0] - palette[1][0], palette[0][1] - palette[1][1], palette[0][2] - palette[1][2], 0 };
+
+			// Position along c1 -> c0 to palette index
+			constexpr uint8 levelToIndex[4] = { 1, 3, 2, 0 };
+			uint8 levels[BlockPixels];
+			QuantizeToAxis(rgba, origin, axis, 3, levels);
+			for (uint32 i = 0; i < BlockPixels; ++i)
+				block.Indices[i] = levelToIndex[levels[i]];
+		}
+
+		void EncodeBC1High(const uint8* rgba, BC1Block& block)
+		{
+			float mean[4], axis[4];
+			GetPrincipalAxis(rgba, 3, mean, axis);
+
+			float e0[4], e1[4];
+			GetAxisEndpoints(rgba, 3, mean, axis, e0, e1);
+			EvaluateBC1(rgba, PackRGB565(e1), PackRGB565(e0), block);
+
+			// The bounding box sometimes wins on blocks that are not well described by a single axis
+			uint8 minColor[4], maxColor[4];
+			GetBoundingBox(rgba, minColor, maxColor);
+			SelectDiagonal(rgba, 3, minColor, maxColor);
+			const float minColorF[3] = { (float)minColor[0], (float)minColor[1], (float)minColor[2] };
+			const float maxColorF[3] = { (float)maxColor[0], (float)maxColor[1], (float)maxColor[2] };
+			BC1Block candidate;
+			EvaluateBC1(rgba, PackRGB565(maxColorF), PackRGB565(minColorF), candidate);
+			if (candidate.Error < block.Error)
+				block = candidate;
+
+			constexpr float indexToWeight[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+			for (uint32 iteration = 0; iteration < 2 && block.Error > 0; ++iteration)
+			{
+				float weights[BlockPixels];
+				for (uint32 i = 0; i < BlockPixels; ++i)
+					weights[i] = indexToWeight[block.Indices[i]];
+
+				if (!RefineEndpoints(rgba, 3, weights, e0, e1))
+					break;
+
+				EvaluateBC1(rgba, PackRGB565(e0), PackRGB565(e1), candidate);
+				if (candidate.Error >= block.Error)
+					break;
+				block = candidate;
+			}
+		}
+
+		void WriteBC1(const BC1Block& block, uint8* dst)
+		{
+			uint32 indices = 0;
+			if (block.C0 != block.C1)
+			{
+				for (uint32 i = 0; i < BlockPixels; ++i)
+					indices |= uint32(block.Indices[i]) << (i * 2);
+			}
+
+			memcpy(dst + 0, &block.C0, 2);
+			memcpy(dst + 2, &block.C1, 2);
+			memcpy(dst + 4, &indices, 4);
+		}
+
+		//
+		// BC7, only mode 6 is used: one subset, 7.7.7.7 endpoints with a unique p-bit each and 4 bit indices
+		//
+		struct BC7Block
+		{
+			uint8  Endpoints[2][4] = {}; // 8 bit values, the lowest bit is the p-bit
+			uint8  Indices[BlockPixels] = {};
+			uint32 Error = UINT_MAX;
+		};
+
+		void QuantizeBC7Endpoint(const float* endpoint, uint32 pbit, uint8* quantized)
+		{
+			for (uint32 c = 0; c < 4; ++c)
+			{
+				const int value = (int)Clamp((endpoint[c] - (float)pbit) * 0.5f + 0.5f, 0.0f, 127.0f);
+				quantized[c] = (uint8)((value << 1) | pbit);
+			}
+		}
+
+		// p-bit that best preserves the endpoint
+		uint32 SelectBC7PBit(const float* endpoint)
+		{
+			float errors[2] = {};
+			for (uint32 pbit = 0; pbit < 2; ++pbit)
+			{
+				uint8 quantized[4];
+				QuantizeBC7Endpoint(endpoint, pbit, quantized);
+				for (uint32 c = 0; c < 4; ++c)
+					errors[pbit] += (endpoint[c] - quantized[c]) * (endpoint[c] - quantized[c]);
+			}
+			return errors[1] < errors[0] ? 1 : 0;
+		}
+
+		void GetBC7Palette(const uint8 endpoints[2][4], int palette[16][4])
+		{
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				for (uint32 c = 0; c < 4; ++c)
+					palette[i][c] = ((64 - BC7Weights[i]) * endpoints[0][c] + BC7Weights[i] * endpoints[1][c] + 32) >> 6;
+			}
+		}
+
+		void EvaluateBC7(const uint8* rgba, BC7Block& block)
+		{
+			int palette[16][4];
+			GetBC7Palette(block.Endpoints, palette);
+
+			block.Error = 0;
+			for (uint32 i = 0; i < BlockPixels; ++i)
+			{
+				uint32 bestError = UINT_MAX;
+				for (uint8 p = 0; p < 16; ++p)
+				{
+					uint32 error = 0;
+					for (uint32 c = 0; c < 4; ++c)
+					{
+						const int d = rgba[i * 4 + c] - palette[p][c];
+						error += (uint32)(d * d);
+					}
+
+					if (error < bestError)
+					{
+						bestError = error;
+						block.Indices[i] = p;
+					}
+				}
+				block.Error += bestError;
+			}
+		}
+
+		// Tries every p-bit combination and keeps the best one
+		void EvaluateBC7Endpoints(const uint8* rgba, const float* e0, const float* e1, BC7Block& best)
+		{
+			for (uint32 pbits = 0; pbits < 4; ++pbits)
+			{
+				BC7Block candidate;
+				QuantizeBC7Endpoint(e0, pbits & 1, candidate.Endpoints[0]);
+				QuantizeBC7Endpoint(e1, pbits >> 1, candidate.Endpoints[1]);
+				EvaluateBC7(rgba, candidate);
+				if (candidate.Error < best.Error)
+					best = candidate;
+			}
+		}
+
+		void EncodeBC7Fast(const uint8* rgba, BC7Block& block)
+		{
+			uint8 minColor[4], maxColor[4];
+			GetBoundingBox(rgba, minColor, maxColor);
+			SelectDiagonal(rgba, 4, minColor, maxColor);
+
+			float e0[4], e1[4];
+			for (uint32 c = 0; c < 4; ++c)
+			{
+				const int inset = (maxColor[c] - minColor[c]) / 32;
+				e0[c] = (float)(minColor[c] + inset);
+				e1[c] = (float)(maxColor[c] - inset);
+			}
+
+			QuantizeBC7Endpoint(e0, SelectBC7PBit(e0), block.Endpoints[0]);
+			QuantizeBC7Endpoint(e1, SelectBC7PBit(e1), block.Endpoints[1]);
+
+			// The 4 bit weights are close enough to uniform steps to use the axis projection directly
+			const int origin[4] = { block.Endpoints[0][0], block.Endpoints[0][1], block.Endpoints[0][2], block.Endpoints[0][3] };
+			int axis[4];
+			for (uint32 c = 0; c < 4; ++c)
+				axis[c] = block.Endpoints[1][c] - block.Endpoints[0][c];
+			QuantizeToAxis(rgba, origin, axis, 15, block.Indices);
+		}
+
+		void EncodeBC7High(const uint8* rgba, BC7Block& block)
+		{
+			float mean[4], axis[4];
+			GetPrincipalAxis(rgba, 4, mean, axis);
+
+			float e0[4], e1[4];
+			GetAxisEndpoints(rgba, 4, mean, axis, e0, e1);
+			EvaluateBC7Endpoints(rgba, e0, e1, block);
+
+			for (uint32 iteration = 0; iteration < 2 && block.Error > 0; ++iteration)
+			{
+				float weights[BlockPixels];
+				for (uint32 i = 0; i < BlockPixels; ++i)
+					weights[i] = BC7Weights[block.Indices[i]] / 64.0f;
+
+				if (!RefineEndpoints(rgba, 4, weights, e0, e1))
+					break;
+
+				const uint32 previousError = block.Error;
+				EvaluateBC7Endpoints(rgba, e0, e1, block);
+				if (block.Error >= previousError)
+					break;
+			}
+		}
+
+		void WriteBC7(BC7Block& block, uint8* dst)
+		{
+			// The anchor index is stored without its highest bit, so it has to be below 8
+			if (block.Indices[0] >= 8)
+			{
+				for (uint32 c = 0; c < 4; ++c)
+					std::swap(block.Endpoints[0][c], block.Endpoints[1][c]);
+				for (uint32 i = 0; i < BlockPixels; ++i)
+					block.Indices[i] = 15 - block.Indices[i];
+			}
+
+			BitWriter writer;
+			writer.Write(1 << 6, 7);
+			for (uint32 c = 0; c < 4; ++c)
+			{
+				writer.Write(block.Endpoints[0][c] >> 1, 7);
+				writer.Write(block.Endpoints[1][c] >> 1, 7);
+			}
+			writer.Write(block.Endpoints[0][0] & 1, 1);
+			writer.Write(block.Endpoints[1][0] & 1, 1);
+
+			writer.Write(block.Indices[0], 3);
+			for (uint32 i = 1; i < BlockPixels; ++i)
+				writer.Write(block.Indices[i], 4);
+
+			check(writer.Offset == 128);
+			memcpy(dst, writer.Bits, 16);
+		}
+
+		//
+		// Images
+		//
+
+		// Reads a block clamping to the image edges, the last row and column of blocks can go over the image
+		void LoadBlock(const uint8* rgba, uint32 width, uint32 height, uint32 blockX, uint32 blockY, uint8* block)
+		{
+			for (uint32 y = 0; y < BlockSize; ++y)
+			{
+				const uint32 sourceY = Math::Min(blockY * BlockSize + y, height - 1);
+				for (uint32 x = 0; x < BlockSize; ++x)
+				{
+					const uint32 sourceX = Math::Min(blockX * BlockSize + x, width - 1);
+					memcpy(block + (y * BlockSize + x) * 4, rgba + ((uint64)sourceY * width + sourceX) * 4, 4);
+				}
+			}
+		}
+
+		void EncodeBlock(const uint8* block, RHI::Format format, uint32 channel0, uint32 channel1, Quality quality, uint8* dst)
+		{
+			switch (format)
+			{
+			case RHI::Format::BC1_UNORM:
+			case RHI::Format::BC1_UNORM_SRGB:
+				EncodeBC1Block(block, dst, quality);
+				break;
+			case RHI::Format::BC3_UNORM:
+			case RHI::Format::BC3_UNORM_SRGB:
+				EncodeBC3Block(block, dst, quality);
+				break;
+			case RHI::Format::BC4_UNORM:
+				EncodeBC4Block(block, channel0, dst);
+				break;
+			case RHI::Format::BC5_UNORM:
+				EncodeBC5Block(block, channel0, channel1, dst);
+				break;
+			case RHI::Format::BC7_UNORM:
+			case RHI::Format::BC7_UNORM_SRGB:
+				EncodeBC7Block(block, dst, quality);
+				break;
+			default:
+				ensure(false);
+				break;
+			}
+		}
+	}
+
+	const char* GetRoleName(TextureRole role)
+	{
+		switch (role)
+		{
+		case TextureRole::Color:			return "color";
+		case TextureRole::Albedo:			return "albedo";
+		case TextureRole::Normal:			return "normal";
+		case TextureRole::RoughnessMetal:	return "roughnessmetal";
+		case TextureRole::Occlusion:		return "occlusion";
+		case TextureRole::Emissive:			return "emissive";
+		default:
+			ensure(false);
+			return "unknown";
+		}
+	}
+
+	RHI::Format SelectFormat(TextureRole role, bool bHasAlpha, Quality quality)
+	{
+		switch (role)
+		{
+		case TextureRole::Normal:
+		case TextureRole::RoughnessMetal:
+			return RHI::Format::BC5_UNORM;
+		case TextureRole::Occlusion:
+			return RHI::Format::BC4_UNORM;
+		case TextureRole::Emissive:
+			return quality == Quality::High ? RHI::Format::BC7_UNORM : RHI::Format::BC1_UNORM;
+		case TextureRole::Color:
+		case TextureRole::Albedo:
+		default:
+			if (quality == Quality::High)
+				return RHI::Format::BC7_UNORM;
+			return bHasAlpha ? RHI::Format::BC3_UNORM : RHI::Format::BC1_UNORM;
+		}
+	}
+
+	void GetSourceChannels(TextureRole role, uint32& channel0, uint32& channel1)
+	{
+		if (role == TextureRole::RoughnessMetal)
+		{
+			channel0 = 1;
+			channel1 = 2;
+		}
+		else
+		{
+			channel0 = 0;
+			channel1 = 1;
+		}
+	}
+
+	bool HasAlpha(const uint8* rgba, uint32 width, uint32 height)
+	{
+		const uint64 numPixels = (uint64)width * height;
+		for (uint64 i = 0; i < numPixels; ++i)
+		{
+			if (rgba[i * 4 + 3] != 255)
+				return true;
+		}
+		return false;
+	}
+
+	bool CanCompress(uint32 width, uint32 height)
+	{
+		return width > 0 && height > 0 && width % BlockSize == 0 && height % BlockSize == 0;
+	}
+
+	uint64 GetMipChainSize(RHI::Format format, uint32 width, uint32 height, uint16 mipLevels)
+	{
+		uint64 size = 0;
+		for (uint16 mip = 0; mip < mipLevels; ++mip)
+			size += RHI::GetTextureMipByteSize(format, width, height, 1, mip);
+		return size;
+	}
+
+	void CompressMipChain(const uint8* mipChain, uint32 width, uint32 height, uint16 mipLevels, RHI::Format format, TextureRole role, Quality quality, uint8* dst)
+	{
+		struct MipLevel
+		{
+			const uint8*	Pixels;
+			uint32			Width;
+			uint32			Height;
+			uint32			BlocksX;
+			uint32			FirstRow; // first row of blocks of this level, counting from the top level
+			uint64			DstOffset;
+		};
+
+		const uint32 bytesPerBlock = (uint32)RHI::GetTextureMipByteSize(format, BlockSize, BlockSize, 1);
+
+		// Every level is compressed at the same time
+		std::vector<MipLevel> levels(mipLevels);
+		uint32 numRows = 0;
+		uint64 srcOffset = 0;
+		uint64 dstOffset = 0;
+		for (uint16 mip = 0; mip < mipLevels; ++mip)
+		{
+			MipLevel& level = levels[mip];
+			level.Width = Math::Max(1u, width >> mip);
+			level.Height = Math::Max(1u, height >> mip);
+			level.Pixels = mipChain + srcOffset;
+			level.BlocksX = Math::DivideAndRoundUp(level.Width, BlockSize);
+			level.FirstRow = numRows;
+			level.DstOffset = dstOffset;
+			numRows += Math::DivideAndRoundUp(level.Height, BlockSize);
+			srcOffset += (uint64)level.Width * level.Height * 4;
+			dstOffset += RHI::GetTextureMipByteSize(format, width, height, 1, mip);
+		}
+
+		uint32 channel0, channel1;
+		GetSourceChannels(role, channel0, channel1);
+
+		// One job per row of blocks, grouped so there are a few groups per thread
+		const uint32 groupSize = Math::Max(1u, numRows / (Core::JobSystem::ThreadCount() * 4));
+		Core::JobContext context;
+		Core::JobSystem::ExecuteMany(context, numRows, groupSize, Core::TOnJobSystemExecuteMany::CreateLambda([&](Core::JobDispatchArgs args)
+		{
+			uint32 mip = 0;
+			while (mip + 1 < (uint32)levels.size() && levels[mip + 1].FirstRow <= args.jobIndex)
+				++mip;
+
+			const MipLevel& level = levels[mip];
+			const uint32 blockY = args.jobIndex - level.FirstRow;
+			uint8* rowDst = dst + level.DstOffset + (uint64)blockY * level.BlocksX * bytesPerBlock;
+
+			uint8 block[BlockPixels * 4];
+			for (uint32 blockX = 0; blockX < level.BlocksX; ++blockX)
+			{
+				LoadBlock(level.Pixels, level.Width, level.Height, blockX, blockY, block);
+				EncodeBlock(block, format, channel0, channel1, quality, rowDst + blockX * bytesPerBlock);
+			}
+		}));
+		Core::JobSystem::Wait(context);
+	}
+
+	void EncodeBC1Block(const uint8* rgba, uint8* dst, Quality quality)
+	{
+		BC1Block block;
+		if (quality == Quality::Fast)
+			EncodeBC1Fast(rgba, block);
+		else
+			EncodeBC1High(rgba, block);
+		WriteBC1(block, dst);
+	}
+
+	void EncodeBC3Block(const uint8* rgba, uint8* dst, Quality quality)
+	{
+		// Alpha is stored like a BC4 block followed by a BC1 color block that is always in four color mode
+		EncodeBC4Block(rgba, 3, dst);
+		EncodeBC1Block(rgba, dst + 8, quality);
+	}
+
+	void EncodeBC4Block(const uint8* rgba, uint32 channel, uint8* dst)
+	{
+		uint8 minValue = 255;
+		uint8 maxValue = 0;
+		for (uint32 i = 0; i < BlockPixels; ++i)
+		{
+			minValue = Math::Min(minValue, rgba[i * 4 + channel]);
+			maxValue = Math::Max(maxValue, rgba[i * 4 + channel]);
+		}
+
+		// e0 > e1 selects the eight value mode, the palette is uniform so rounding the position gives the nearest entry
+		uint64 indices = 0;
+		if (maxValue > minValue)
+		{
+			const float scale = 7.0f / (float)(maxValue - minValue);
+			for (uint32 i = 0; i < BlockPixels; ++i)
+			{
+				const uint32 position = (uint32)((rgba[i * 4 + channel] - minValue) * scale + 0.5f);
+				const uint32 index = position == 7 ? 0 : position == 0 ? 1 : 8 - position;
+				indices |= uint64(index) << (i * 3);
+			}
+		}
+
+		dst[0] = maxValue;
+		dst[1] = minValue;
+		memcpy(dst + 2, &indices, 6);
+	}
+
+	void EncodeBC5Block(const uint8* rgba, uint32 channel0, uint32 channel1, uint8* dst)
+	{
+		EncodeBC4Block(rgba, channel0, dst);
+		EncodeBC4Block(rgba, channel1, dst + 8);
+	}
+
+	void EncodeBC7Block(const uint8* rgba, uint8* dst, Quality quality)
+	{
+		BC7Block block;
+		if (quality == Quality::Fast)
+			EncodeBC7Fast(rgba, block);
+		else
+			EncodeBC7High(rgba, block);
+		WriteBC7(block, dst);
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "gfx/rhi/definitions.h"
+
+namespace limbo::Gfx::TextureCompressor
+{
+	// How the shaders sample a texture, this decides which channels have to survive the compression
+	enum class TextureRole : uint8
+	{
+		Color = 0,		// rgba, also used when a texture is shared between roles
+		Albedo,			// rgb + alpha
+		Normal,			// rg, z is reconstructed in the shader
+		RoughnessMetal,	// roughness in g and metal in b
+		Occlusion,		// r
+		Emissive,		// rgb
+
+		MAX
+	};
+
+	enum class Quality : uint8
+	{
+		// Bounding box endpoints with SIMD index selection
+		Fast = 0,
+		// Principal axis endpoints with a least squares refinement
+		High,
+	};
+
+	const char* GetRoleName(TextureRole role);
+
+	// Picks the BC format for a role, bHasAlpha is only used by the color roles
+	RHI::Format SelectFormat(TextureRole role, bool bHasAlpha, Quality quality);
+
+	// The channels of the source image that end up in the first and second channel of a BC4/BC5 texture
+	void GetSourceChannels(TextureRole role, uint32& channel0, uint32& channel1);
+
+	bool HasAlpha(const uint8* rgba, uint32 width, uint32 height);
+
+	// BC textures need the top level to be a multiple of the block size
+	bool CanCompress(uint32 width, uint32 height);
+
+	// Size of the whole mip chain tightly packed, this is the layout used by RHI::CreateTexture and by DDS files
+	uint64 GetMipChainSize(RHI::Format format, uint32 width, uint32 height, uint16 mipLevels);
+
+	// Compresses every level of a tightly packed RGBA8 mip chain into dst.
+	// The blocks of every level are compressed in parallel on the job system, it is safe to call this from a job.
+	void CompressMipChain(const uint8* mipChain, uint32 width, uint32 height, uint16 mipLevels, RHI::Format format, TextureRole role, Quality quality, uint8* dst);
+
+	// Block encoders, the source is a 4x4 block of RGBA8 pixels in row order. Exposed for testing.
+	void EncodeBC1Block(const uint8* rgba, uint8* dst, Quality quality);
+	void EncodeBC3Block(const uint8* rgba, uint8* dst, Quality quality);
+	void EncodeBC4Block(const uint8* rgba, uint32 channel, uint8* dst);
+	void EncodeBC5Block(const uint8* rgba, uint32 channel0, uint32 channel1, uint8* dst);
+	void EncodeBC7Block(const uint8* rgba, uint8* dst, Quality quality);
+}
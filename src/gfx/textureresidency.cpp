@@ -0,0 +1,175 @@
+#include "stdafx.h"
+#include "textureresidency.h"
+
+namespace limbo::Gfx
+{
+	uint16 GetStreamingTailMip(uint32 width, uint32 height, uint16 mipLevels, RHI::Format format)
+	{
+		uint16 tailMip = 0;
+		while (tailMip + 1 < mipLevels && Math::Max(width >> tailMip, height >> tailMip) > TextureStreamingTailSize)
+			tailMip++;
+
+		// The streamer creates a texture with the resident mips only, block compressed textures need its top level to be a multiple of the block size
+		const uint32 blockSize = Math::Max(1u, (uint32)RHI::GetFormatInfo(format).BlockSize);
+		while (tailMip > 0 && (Math::Max(1u, width >> tailMip) % blockSize != 0 || Math::Max(1u, height >> tailMip) % blockSize != 0))
+			tailMip--;
+
+		return tailMip;
+	}
+
+	uint16 GetStreamingMip(uint32 width, uint32 height, float screenSize)
+	{
+		const float numTexels = (float)Math::Max(width, height);
+		if (screenSize >= numTexels)
+			return 0;
+		return (uint16)floorf(log2f(numTexels / Math::Max(screenSize, 1.0f)));
+	}
+
+	uint64 GetResidentMipsSize(uint32 width, uint32 height, uint16 mipLevels, RHI::Format format, uint16 firstMip)
+	{
+		uint64 size = 0;
+		for (uint16 mip = firstMip; mip < mipLevels; ++mip)
+			size += RHI::GetTextureMipByteSize(format, width, height, 1, mip);
+		return size;
+	}
+
+	TextureResidency::TextureResidency(uint64 budget)
+		: m_Budget(budget)
+	{
+	}
+
+	uint32 TextureResidency::AddTexture(const TextureDesc& desc)
+	{
+		check(desc.TailMip < desc.MipLevels);
+
+		TextureState& texture = m_Textures.emplace_back();
+		texture.Desc = desc;
+		texture.FirstMip = desc.TailMip;
+		texture.WantedMip = desc.TailMip;
+		texture.LastUsedFrame = m_FrameIndex;
+		m_ResidentSize += GetResidentMipsSize(desc.Width, desc.Height, desc.MipLevels, desc.Format, desc.TailMip);
+		return (uint32)m_Textures.size() - 1;
+	}
+
+	void TextureResidency::Clear()
+	{
+		m_Textures.clear();
+		m_ResidentSize = 0;
+	}
+
+	void TextureResidency::BeginFrame()
+	{
+		m_FrameIndex++;
+		for (TextureState& texture : m_Textures)
+		{
+			texture.WantedMip = texture.Desc.TailMip;
+			texture.Priority = 0.0f;
+		}
+	}
+
+	void TextureResidency::Request(uint32 texture, uint16 mip, float priority)
+	{
+		TextureState& state = m_Textures[texture];
+		state.WantedMip = Math::Min(state.WantedMip, mip);
+		state.Priority = Math::Max(state.Priority, priority);
+		state.LastUsedFrame = m_FrameIndex;
+	}
+
+	void TextureResidency::Update(uint32 maxLoads, std::vector<MipRequest>& outLoads, std::vector<MipRequest>& outEvictions)
+	{
+		const uint32 numTextures = (uint32)m_Textures.size();
+
+		// Textures that want a more detailed mip than the one they have, most important first
+		std::vector<uint32> loadOrder;
+		for (uint32 i = 0; i < numTextures; ++i)
+		{
+			if (!m_Textures[i].bBusy && !m_Textures[i].bFailed && m_Textures[i].WantedMip < m_Textures[i].FirstMip)
+				loadOrder.push_back(i);
+		}
+		std::stable_sort(loadOrder.begin(), loadOrder.end(), [this](uint32 a, uint32 b)
+		{
+			return m_Textures[a].Priority > m_Textures[b].Priority;
+		});
+
+		// Textures with more mips than they need, least recently used first. Textures that were not requested this frame only need their tail.
+		std::vector<uint32> lruOrder;
+		for (uint32 i = 0; i < numTextures; ++i)
+		{
+			if (!m_Textures[i].bBusy && m_Textures[i].FirstMip < m_Textures[i].WantedMip)
+				lruOrder.push_back(i);
+		}
+		std::stable_sort(lruOrder.begin(), lruOrder.end(), [this](uint32 a, uint32 b)
+		{
+			const TextureState& textureA = m_Textures[a];
+			const TextureState& textureB = m_Textures[b];
+			if (textureA.LastUsedFrame != textureB.LastUsedFrame)
+				return textureA.LastUsedFrame < textureB.LastUsedFrame;
+			return textureA.Priority < textureB.Priority;
+		});
+		uint32 lruCursor = 0;
+
+		// The budget can be lowered at any time, give memory back even if nothing is loaded this frame
+		while (m_ResidentSize > m_Budget && EvictOne(lruOrder, lruCursor, outEvictions)) {}
+
+		for (uint32 textureIndex : loadOrder)
+		{
+			if (outLoads.size() >= maxLoads)
+				break;
+
+			TextureState& texture = m_Textures[textureIndex];
+			const uint16 mip = texture.FirstMip - 1;
+			const uint64 mipSize = GetMipSize(texture, mip);
+			while (m_ResidentSize + mipSize > m_Budget && EvictOne(lruOrder, lruCursor, outEvictions)) {}
+
+			// Do not let less important textures take the space this one could not get
+			if (m_ResidentSize + mipSize > m_Budget)
+				break;
+
+			texture.FirstMip = mip;
+			texture.bBusy = true;
+			m_ResidentSize += mipSize;
+			outLoads.push_back({ textureIndex, mip });
+		}
+	}
+
+	void TextureResidency::OnRequestFinished(uint32 texture)
+	{
+		m_Textures[texture].bBusy = false;
+	}
+
+	void TextureResidency::OnLoadFailed(uint32 texture)
+	{
+		TextureState& state = m_Textures[texture];
+		check(state.FirstMip < state.Desc.TailMip);
+
+		m_ResidentSize -= GetMipSize(state, state.FirstMip);
+		state.FirstMip++;
+		// The mips it still has can not be read again either, they are never evicted
+		state.Desc.TailMip = state.FirstMip;
+		state.WantedMip = state.FirstMip;
+		state.bBusy = false;
+		state.bFailed = true;
+	}
+
+	uint64 TextureResidency::GetMipSize(const TextureState& texture, uint16 mip) const
+	{
+		return RHI::GetTextureMipByteSize(texture.Desc.Format, texture.Desc.Width, texture.Desc.Height, 1, mip);
+	}
+
+	bool TextureResidency::EvictOne(std::vector<uint32>& lruOrder, uint32& lruCursor, std::vector<MipRequest>& outEvictions)
+	{
+		if (lruCursor >= lruOrder.size())
+			return false;
+
+		// Every extra mip goes in the same request, the streamer only has to rebuild the texture once
+		const uint32 textureIndex = lruOrder[lruCursor++];
+		TextureState& texture = m_Textures[textureIndex];
+		const TextureDesc& desc = texture.Desc;
+		m_ResidentSize -= GetResidentMipsSize(desc.Width, desc.Height, desc.MipLevels, desc.Format, texture.FirstMip) -
+						  GetResidentMipsSize(desc.Width, desc.Height, desc.MipLevels, desc.Format, texture.WantedMip);
+		texture.FirstMip = texture.WantedMip;
+		texture.bBusy = true;
+		outEvictions.push_back({ textureIndex, texture.FirstMip });
+		return true;
+	}
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "gfx/rhi/definitions.h"
+
+namespace limbo::Gfx
+{
+	// Mips with both sides at or below this size are loaded with the scene and never evicted
+	constexpr uint32 TextureStreamingTailSize = 64;
+
+	// First mip of the part of the chain that is always resident. Returns 0 if the texture is too small to be streamed.
+	uint16 GetStreamingTailMip(uint32 width, uint32 height, uint16 mipLevels, RHI::Format format);
+
+	// The mip that matches the size of a mesh on screen, in pixels. It assumes the texture is mapped once over the mesh.
+	uint16 GetStreamingMip(uint32 width, uint32 height, float screenSize);
+
+	// Bytes used by the mips [firstMip, mipLevels) of a texture
+	uint64 GetResidentMipsSize(uint32 width, uint32 height, uint16 mipLevels, RHI::Format format, uint16 firstMip);
+
+	/**
+	 * CPU side of the texture streaming, decides which mips of every texture should be resident.
+	 * It never touches the GPU, the streamer executes the loads and evictions it asks for and reports back when they are done.
+	 *
+	 * Every frame the visible textures request the mip they need with a priority. Loads go one mip at a time, highest priority first,
+	 * and when a load does not fit in the budget the least recently used textures give back their extra mips.
+	 */
+	class TextureResidency
+	{
+	public:
+		struct TextureDesc
+		{
+			uint32		Width = 1;
+			uint32		Height = 1;
+			uint16		MipLevels = 1;
+			RHI::Format Format = RHI::Format::UNKNOWN;
+			// First mip loaded with the scene, see GetStreamingTailMip
+			uint16		TailMip = 0;
+		};
+
+		// Asks the streamer to make FirstMip the most detailed resident mip of a texture
+		struct MipRequest
+		{
+			uint32 Texture;
+			uint16 FirstMip;
+		};
+
+	public:
+		explicit TextureResidency(uint64 budget);
+
+		uint32 AddTexture(const TextureDesc& desc);
+		void Clear();
+
+		void SetBudget(uint64 budget) { m_Budget = budget; }
+		uint64 GetBudget() const { return m_Budget; }
+
+		// Memory of every resident mip, including the ones still being loaded
+		uint64 GetResidentSize() const { return m_ResidentSize; }
+		uint32 NumTextures() const { return (uint32)m_Textures.size(); }
+
+		// Starts a new frame, the requests of the previous frame are forgotten
+		void BeginFrame();
+
+		// The mip a texture needs this frame, when a texture is requested more than once the most detailed mip and the highest priority are kept
+		void Request(uint32 texture, uint16 mip, float priority);
+
+		// Decides the loads and evictions of this frame. Evictions are decided before the loads that need the space,
+		// a texture only has one request in flight at a time and stays busy until OnRequestFinished is called.
+		void Update(uint32 maxLoads, std::vector<MipRequest>& outLoads, std::vector<MipRequest>& outEvictions);
+
+		// The streamer finished the GPU work of the last request of the texture
+		void OnRequestFinished(uint32 texture);
+
+		// The last load of the texture could not be done, its mip is given back and the texture stops streaming
+		void OnLoadFailed(uint32 texture);
+
+		uint16 GetFirstMip(uint32 texture) const { return m_Textures[texture].FirstMip; }
+		uint16 GetWantedMip(uint32 texture) const { return m_Textures[texture].WantedMip; }
+		bool IsBusy(uint32 texture) const { return m_Textures[texture].bBusy; }
+
+	private:
+		struct TextureState
+		{
+			TextureDesc Desc;
+			// Most detailed resident mip, a mip that is being loaded already counts as resident
+			uint16		FirstMip;
+			uint16		WantedMip;
+			float		Priority = 0.0f;
+			uint64		LastUsedFrame = 0;
+			bool		bBusy = false;
+			// A load failed, the texture keeps the mips it has
+			bool		bFailed = false;
+		};
+
+		uint64 GetMipSize(const TextureState& texture, uint16 mip) const;
+
+		// Drops the extra mips of the least recently used texture that has more than it needs, returns false if there is nothing left to evict
+		bool EvictOne(std::vector<uint32>& lruOrder, uint32& lruCursor, std::vector<MipRequest>& outEvictions);
+
+	private:
+		std::vector<TextureState>	m_Textures;
+		uint64						m_Budget;
+		uint64						m_ResidentSize = 0;
+		uint64						m_FrameIndex = 0;
+	};
+}
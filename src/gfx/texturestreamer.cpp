@@ -0,0 +1,276 @@
+#include "stdafx.h"
+#include "texturestreamer.h"
+#include "fpscamera.h"
+#include "profiler.h"
+#include "core/commandline.h"
+#include "core/utils.h"
+#include "rhi/commandcontext.h"
+#include "rhi/commandqueue.h"
+#include "rhi/device.h"
+#include "rhi/ringbufferallocator.h"
+
+#include <imgui/imgui.h>
+
+namespace limbo::Gfx
+{
+	namespace
+	{
+		// Every load ends up as a copy queue submission, keep them few per frame so the streaming does not stall the frame
+		constexpr uint32 MaxLoadsPerFrame = 8;
+		constexpr uint64 DefaultBudgetMB = 512;
+
+		uint64 GetBudgetFromCommandLine()
+		{
+			std::string budget;
+			Core::CommandLine::Parse(LIMBO_CMD_TEXTURE_BUDGET, budget);
+			if (budget.empty())
+				return Utils::ToMB(DefaultBudgetMB);
+			return Utils::ToMB(strtoull(budget.c_str(), nullptr, 10));
+		}
+	}
+
+	TextureStreamer::TextureStreamer()
+		: m_Residency(GetBudgetFromCommandLine())
+	{
+	}
+
+	TextureStreamer::~TextureStreamer()
+	{
+		Clear();
+	}
+
+	void TextureStreamer::AddScene(const Scene* scene)
+	{
+		for (const StreamableTexture& texture : scene->GetStreamableTextures())
+		{
+			const uint32 index = m_Residency.AddTexture({
+				.Width = texture.Width,
+				.Height = texture.Height,
+				.MipLevels = texture.MipLevels,
+				.Format = texture.Format,
+				.TailMip = texture.TailMip
+			});
+			check(index == m_Textures.size());
+			m_Textures.push_back(texture);
+
+			// The materials reference the textures by their descriptor, which stays the same when the resource is swapped
+			m_DescriptorToTexture[(int)RM_GET(texture.Texture)->SRV()] = index;
+		}
+	}
+
+	void TextureStreamer::Clear()
+	{
+		// The reads write into buffers owned by the pending reads
+		Core::JobSystem::Wait(m_ReadsContext);
+		for (const std::unique_ptr<PendingRead>& read : m_PendingReads)
+			free(read->Data);
+		m_PendingReads.clear();
+
+		FinishSwaps(true);
+
+		m_Residency.Clear();
+		m_Textures.clear();
+		m_DescriptorToTexture.clear();
+	}
+
+	void TextureStreamer::Update(const FPSCamera& camera, uint2 renderSize, const std::vector<Scene*>& scenes)
+	{
+		if (m_Textures.empty())
+			return;
+
+		PROFILE_CPU_SCOPE("Texture Streaming");
+
+		FinishSwaps(false);
+		FinishReads();
+		RequestMips(camera, renderSize, scenes);
+
+		std::vector<TextureResidency::MipRequest> loads;
+		std::vector<TextureResidency::MipRequest> evictions;
+		m_Residency.Update(MaxLoadsPerFrame, loads, evictions);
+
+		// Evictions only copy the mips that stay resident, they can be submitted right away
+		for (const TextureResidency::MipRequest& eviction : evictions)
+		{
+			PendingSwap& swap = m_PendingSwaps.emplace_back();
+			swap.Texture = eviction.Texture;
+			swap.FenceValue = RebuildTexture(eviction.Texture, eviction.FirstMip, nullptr, swap.NewTexture);
+		}
+		m_TotalEvictions += evictions.size();
+
+		for (const TextureResidency::MipRequest& load : loads)
+			StartRead(load.Texture, load.FirstMip);
+	}
+
+	void TextureStreamer::RenderUI()
+	{
+		int budget = (int)(m_Residency.GetBudget() >> 20);
+		if (ImGui::DragInt("Budget (MB)", &budget, 8.0f, 16, 16384))
+			m_Residency.SetBudget(Utils::ToMB(budget));
+
+		ImGui::Text("Resident: %.1f MB", m_Residency.GetResidentSize() / (1024.0f * 1024.0f));
+		ImGui::Text("Streamable textures: %u", m_Residency.NumTextures());
+		ImGui::Text("In flight: %zu reads, %zu copies", m_PendingReads.size(), m_PendingSwaps.size());
+		ImGui::Text("Loads: %llu, Evictions: %llu", m_TotalLoads, m_TotalEvictions);
+		ImGui::Text("Read from disk: %.1f MB", m_TotalBytesRead / (1024.0f * 1024.0f));
+	}
+
+	void TextureStreamer::RequestMips(const FPSCamera& camera, uint2 renderSize, const std::vector<Scene*>& scenes)
+	{
+		m_Residency.BeginFrame();
+
+		const float fovY = glm::radians(camera.FOV);
+		const float screenHeight = (float)renderSize.y;
+		for (const Scene* scene : scenes)
+		{
+			scene->IterateMeshes(TOnDrawMesh::CreateLambda([&](const Mesh& mesh)
+			{
+				const float4 sphere = Math::TransformBoundingSphere(mesh.BoundingSphere, mesh.Transform);
+				const float3 center = float3(sphere);
+
+				// Meshes fully behind the camera do not request anything, their mips go away when the budget needs them
+				const float viewZ = (camera.View * float4(center, 1.0f)).z;
+				if (viewZ > sphere.w)
+					return;
+
+				const float distance = glm::length(center - camera.Eye);
+				const float screenSize = Math::ProjectedSphereSize(distance, sphere.w, fovY, screenHeight);
+				// The size on screen decides, the distance only breaks the ties
+				const float priority = screenSize + 1.0f / (1.0f + distance);
+
+				const Material& material = scene->Materials[mesh.LocalMaterialIndex];
+				for (int descriptor : { material.BaseColorIndex, material.NormalIndex, material.RoughnessMetalIndex, material.EmissiveIndex, material.AmbientOcclusionIndex })
+				{
+					const auto it = m_DescriptorToTexture.find(descriptor);
+					if (it == m_DescriptorToTexture.end())
+						continue;
+
+					const StreamableTexture& texture = m_Textures[it->second];
+					m_Residency.Request(it->second, GetStreamingMip(texture.Width, texture.Height, screenSize), priority);
+				}
+			}));
+		}
+	}
+
+	void TextureStreamer::StartRead(uint32 texture, uint16 mip)
+	{
+		const StreamableTexture& streamable = m_Textures[texture];
+
+		// The source holds the whole chain from mip 0, the mips are stored one after the other
+		const uint64 fullSize = GetResidentMipsSize(streamable.Width, streamable.Height, streamable.MipLevels, streamable.Format, 0);
+		const uint64 offset = streamable.SourceOffset + fullSize - GetResidentMipsSize(streamable.Width, streamable.Height, streamable.MipLevels, streamable.Format, mip);
+		const uint64 size = RHI::GetTextureMipByteSize(streamable.Format, streamable.Width, streamable.Height, 1, mip);
+
+		PendingRead* read = m_PendingReads.emplace_back(std::make_unique<PendingRead>()).get();
+		read->Texture = texture;
+		read->Mip = mip;
+		read->Data = (uint8*)malloc(size);
+		m_TotalBytesRead += size;
+
+		Core::JobSystem::Execute(m_ReadsContext, Core::TOnJobSystemExecute::CreateLambda([read, path = streamable.SourcePath, offset, size]()
+		{
+			read->bSucceeded = Utils::FileReadRange(path.c_str(), offset, size, read->Data);
+			read->bFinished.store(true, std::memory_order_release);
+		}));
+	}
+
+	void TextureStreamer::FinishReads()
+	{
+		for (size_t i = 0; i < m_PendingReads.size();)
+		{
+			PendingRead& read = *m_PendingReads[i];
+			if (!read.bFinished.load(std::memory_order_acquire))
+			{
+				++i;
+				continue;
+			}
+
+			if (read.bSucceeded)
+			{
+				PendingSwap& swap = m_PendingSwaps.emplace_back();
+				swap.Texture = read.Texture;
+				swap.FenceValue = RebuildTexture(read.Texture, read.Mip, read.Data, swap.NewTexture);
+				m_TotalLoads++;
+			}
+			else
+			{
+				LB_WARN("Failed to stream mip %d of '%s', the texture stays at its current mip", read.Mip, m_Textures[read.Texture].SourcePath.c_str());
+				m_Residency.OnLoadFailed(read.Texture);
+			}
+
+			free(read.Data);
+			m_PendingReads[i] = std::move(m_PendingReads.back());
+			m_PendingReads.pop_back();
+		}
+	}
+
+	void TextureStreamer::FinishSwaps(bool bWait)
+	{
+		RHI::Fence* fence = RHI::Device::Ptr->GetCommandQueue(RHI::ContextType::Copy)->GetFence();
+		for (size_t i = 0; i < m_PendingSwaps.size();)
+		{
+			const PendingSwap& swap = m_PendingSwaps[i];
+			if (bWait)
+			{
+				fence->CpuWait(swap.FenceValue);
+			}
+			else if (!fence->IsComplete(swap.FenceValue))
+			{
+				++i;
+				continue;
+			}
+
+			RHI::Texture* texture = RM_GET(m_Textures[swap.Texture].Texture);
+			texture->SwapResource(RM_GET(swap.NewTexture));
+			// The new texture holds the old resource now, the deletion queue keeps it alive until the frames in flight are done with it
+			RHI::DestroyTexture(swap.NewTexture);
+			m_Residency.OnRequestFinished(swap.Texture);
+
+			m_PendingSwaps[i] = m_PendingSwaps.back();
+			m_PendingSwaps.pop_back();
+		}
+	}
+
+	uint64 TextureStreamer::RebuildTexture(uint32 texture, uint16 firstMip, const uint8* firstMipData, RHI::TextureHandle& outNewTexture)
+	{
+		const StreamableTexture& streamable = m_Textures[texture];
+		RHI::Texture* current = RM_GET(streamable.Texture);
+		const uint16 currentFirstMip = streamable.MipLevels - current->Spec.MipLevels;
+
+		// No views, the descriptors of the current texture end up pointing to this resource after the swap
+		outNewTexture = RHI::CreateTexture({
+			.Width = Math::Max(1u, streamable.Width >> firstMip),
+			.Height = Math::Max(1u, streamable.Height >> firstMip),
+			.MipLevels = (uint16)(streamable.MipLevels - firstMip),
+			.DebugName = current->Spec.DebugName,
+			.Flags = RHI::TextureUsage::None,
+			.Format = streamable.Format,
+			.Type = RHI::TextureType::Texture2D,
+			.ComponentMapping = current->Spec.ComponentMapping
+		});
+		RHI::Texture* newTexture = RM_GET(outNewTexture);
+
+		RHI::CommandContext* cmd = RHI::CommandContext::GetCommandContext(RHI::ContextType::Copy);
+		for (uint16 mip = Math::Max(firstMip, currentFirstMip); mip < streamable.MipLevels; ++mip)
+			cmd->CopyTextureMip(current, mip - currentFirstMip, newTexture, mip - firstMip);
+
+		if (!firstMipData)
+			return cmd->Execute();
+
+		// The streamed mip is the only one that comes from the CPU, it is uploaded on its own
+		const D3D12_RESOURCE_DESC resourceDesc = newTexture->Resource->GetDesc();
+		uint64 uploadSize;
+		RHI::Device::Ptr->GetDevice()->GetCopyableFootprints(&resourceDesc, 0, 1, 0, nullptr, nullptr, nullptr, &uploadSize);
+
+		const D3D12_SUBRESOURCE_DATA data = {
+			.pData = firstMipData,
+			.RowPitch = (LONG_PTR)RHI::GetRowPitch(streamable.Format, streamable.Width, firstMip),
+			.SlicePitch = (LONG_PTR)RHI::GetSlicePitch(streamable.Format, streamable.Width, streamable.Height, firstMip)
+		};
+
+		RHI::RingBufferAllocation allocation;
+		RHI::GetRingBufferAllocator()->Allocate(uploadSize, allocation);
+		check(allocation.Context == cmd);
+		UpdateSubresources(allocation.Context->Get(), newTexture->Resource.Get(), allocation.Buffer->Resource.Get(), allocation.Offset, 0, 1, &data);
+		return RHI::GetRingBufferAllocator()->Free(allocation);
+	}
+}
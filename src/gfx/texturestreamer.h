@@ -0,0 +1,77 @@
+#pragma once
+
+#include "scene.h"
+#include "textureresidency.h"
+#include "core/jobsystem.h"
+
+namespace limbo::Gfx
+{
+	struct FPSCamera;
+
+	/**
+	 * Streams the mips of the scene textures that were created with only the tail of their chain.
+	 *
+	 * Every frame the visible meshes ask for the mip that matches their size on screen, TextureResidency turns that into
+	 * loads and evictions under the memory budget. A load reads one mip from the source file in a job, then the texture is
+	 * rebuilt on the copy queue with that mip uploaded on its own and the other mips copied from the current resource.
+	 * Once the copy queue is done the new resource takes the place of the old one, so the descriptor used by the materials never changes.
+	 */
+	class TextureStreamer
+	{
+	public:
+		TextureStreamer();
+		~TextureStreamer();
+
+		// Starts streaming the textures of a scene, it must stay alive until Clear is called
+		void AddScene(const Scene* scene);
+
+		// Stops streaming every texture and waits for the work in flight
+		void Clear();
+
+		void Update(const FPSCamera& camera, uint2 renderSize, const std::vector<Scene*>& scenes);
+
+		void RenderUI();
+
+	private:
+		// A mip being read from disk in a job
+		struct PendingRead
+		{
+			uint32				Texture;
+			uint16				Mip;
+			uint8*				Data = nullptr;
+			std::atomic<bool>	bFinished = false;
+			bool				bSucceeded = false;
+		};
+
+		// A rebuilt texture waiting for its copies to finish on the copy queue
+		struct PendingSwap
+		{
+			uint32				Texture;
+			RHI::TextureHandle	NewTexture;
+			uint64				FenceValue;
+		};
+
+		void RequestMips(const FPSCamera& camera, uint2 renderSize, const std::vector<Scene*>& scenes);
+		void StartRead(uint32 texture, uint16 mip);
+		void FinishReads();
+		void FinishSwaps(bool bWait);
+
+		// Creates the texture with the mips [firstMip, MipLevels) and records the copies of the mips the current resource already has.
+		// Returns the fence value of the copy queue submission.
+		uint64 RebuildTexture(uint32 texture, uint16 firstMip, const uint8* firstMipData, RHI::TextureHandle& outNewTexture);
+
+	private:
+		TextureResidency							m_Residency;
+		std::vector<StreamableTexture>				m_Textures;
+		// Material descriptor index to index in m_Textures
+		std::unordered_map<int, uint32>				m_DescriptorToTexture;
+
+		Core::JobContext							m_ReadsContext;
+		std::vector<std::unique_ptr<PendingRead>>	m_PendingReads;
+		std::vector<PendingSwap>					m_PendingSwaps;
+
+		uint64										m_TotalLoads = 0;
+		uint64										m_TotalEvictions = 0;
+		uint64										m_TotalBytesRead = 0;
+	};
+}
@@ -0,0 +1,204 @@
+#include "stdafx.h"
+#include "transformhierarchy.h"
+#include "core/jobsystem.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+namespace limbo::Gfx
+{
+	void TransformHierarchy::Reserve(uint32 numNodes)
+	{
+		m_Parents.reserve(numNodes);
+		m_Depths.reserve(numNodes);
+		m_Translations.reserve(numNodes);
+		m_Rotations.reserve(numNodes);
+		m_Scales.reserve(numNodes);
+		m_WorldMatrices.reserve(numNodes);
+		m_LocalDirty.reserve(numNodes);
+		m_WorldChanged.reserve(numNodes);
+	}
+
+	void TransformHierarchy::Clear()
+	{
+		m_Parents.clear();
+		m_Depths.clear();
+		m_Translations.clear();
+		m_Rotations.clear();
+		m_Scales.clear();
+		m_WorldMatrices.clear();
+		m_LocalDirty.clear();
+		m_WorldChanged.clear();
+		m_LevelNodes.clear();
+		m_LevelOffsets.clear();
+		m_ChangedNodes.clear();
+		m_NumLocalDirty = 0;
+		m_bLevelsDirty = false;
+	}
+
+	uint32 TransformHierarchy::AddNode(uint32 parent, const float3& translation, const quat& rotation, const float3& scale)
+	{
+		const uint32 node = NumNodes();
+		ENSURE_RETURN(parent != InvalidNode && parent >= node, InvalidNode);
+
+		m_Parents.push_back(parent);
+		m_Depths.push_back(parent != InvalidNode ? m_Depths[parent] + 1 : 0);
+		m_Translations.push_back(translation);
+		m_Rotations.push_back(rotation);
+		m_Scales.push_back(scale);
+		m_WorldMatrices.emplace_back(1.0f);
+		m_LocalDirty.push_back(1);
+		m_WorldChanged.push_back(0);
+		m_NumLocalDirty++;
+		m_bLevelsDirty = true;
+		return node;
+	}
+
+	uint32 TransformHierarchy::AddNode(uint32 parent, const float4x4& localMatrix)
+	{
+		float3 translation, scale;
+		quat rotation;
+		DecomposeMatrix(localMatrix, translation, rotation, scale);
+		return AddNode(parent, translation, rotation, scale);
+	}
+
+	void TransformHierarchy::SetLocalTransform(uint32 node, const float3& translation, const quat& rotation, const float3& scale)
+	{
+		m_Translations[node] = translation;
+		m_Rotations[node] = rotation;
+		m_Scales[node] = scale;
+		MarkDirty(node);
+	}
+
+	void TransformHierarchy::SetTranslation(uint32 node, const float3& translation)
+	{
+		m_Translations[node] = translation;
+		MarkDirty(node);
+	}
+
+	void TransformHierarchy::SetRotation(uint32 node, const quat& rotation)
+	{
+		m_Rotations[node] = rotation;
+		MarkDirty(node);
+	}
+
+	void TransformHierarchy::SetScale(uint32 node, const float3& scale)
+	{
+		m_Scales[node] = scale;
+		MarkDirty(node);
+	}
+
+	void TransformHierarchy::MarkDirty(uint32 node)
+	{
+		if (!m_LocalDirty[node])
+		{
+			m_LocalDirty[node] = 1;
+			m_NumLocalDirty++;
+		}
+	}
+
+	void TransformHierarchy::BuildLevels()
+	{
+		// Counting sort by depth, the nodes of a level keep the order they were added in
+		uint32 numLevels = 0;
+		for (uint32 depth : m_Depths)
+			numLevels = Math::Max(numLevels, depth + 1);
+
+		m_LevelOffsets.assign(numLevels + 1, 0);
+		for (uint32 depth : m_Depths)
+			m_LevelOffsets[depth + 1]++;
+		for (uint32 level = 0; level < numLevels; ++level)
+			m_LevelOffsets[level + 1] += m_LevelOffsets[level];
+
+		std::vector<uint32> cursors(m_LevelOffsets.begin(), m_LevelOffsets.end() - 1);
+		m_LevelNodes.resize(m_Parents.size());
+		for (uint32 node = 0; node < NumNodes(); ++node)
+			m_LevelNodes[cursors[m_Depths[node]]++] = node;
+
+		m_bLevelsDirty = false;
+	}
+
+	void TransformHierarchy::UpdateNode(uint32 node)
+	{
+		const uint32 parent = m_Parents[node];
+		const bool bParentChanged = parent != InvalidNode && m_WorldChanged[parent];
+		if (!m_LocalDirty[node] && !bParentChanged)
+			return;
+
+		const float4x4 local = ComposeMatrix(m_Translations[node], m_Rotations[node], m_Scales[node]);
+		m_WorldMatrices[node] = parent != InvalidNode ? m_WorldMatrices[parent] * local : local;
+		m_WorldChanged[node] = 1;
+		m_LocalDirty[node] = 0;
+	}
+
+	void TransformHierarchy::Update()
+	{
+		for (uint32 node : m_ChangedNodes)
+			m_WorldChanged[node] = 0;
+		m_ChangedNodes.clear();
+
+		if (m_NumLocalDirty == 0)
+			return;
+
+		if (m_bLevelsDirty)
+			BuildLevels();
+
+		for (uint32 level = 0; level < NumLevels(); ++level)
+		{
+			const uint32 first = m_LevelOffsets[level];
+			const uint32 count = m_LevelOffsets[level + 1] - first;
+			if (count < MinParallelLevelSize)
+			{
+				for (uint32 i = first; i < first + count; ++i)
+					UpdateNode(m_LevelNodes[i]);
+				continue;
+			}
+
+			// A level has to be done before the next one reads its world matrices
+			Core::JobContext context;
+			Core::JobSystem::ExecuteMany(context, count, NodesPerJob, Core::TOnJobSystemExecuteMany::CreateLambda([this, first](Core::JobDispatchArgs args)
+			{
+				UpdateNode(m_LevelNodes[first + args.jobIndex]);
+			}));
+			Core::JobSystem::Wait(context);
+		}
+
+		for (uint32 node : m_LevelNodes)
+		{
+			if (m_WorldChanged[node])
+				m_ChangedNodes.push_back(node);
+		}
+		m_NumLocalDirty = 0;
+	}
+
+	float4x4 TransformHierarchy::ComposeMatrix(const float3& translation, const quat& rotation, const float3& scale)
+	{
+		float4x4 result = glm::mat4_cast(rotation);
+		result[0] *= scale.x;
+		result[1] *= scale.y;
+		result[2] *= scale.z;
+		result[3] = float4(translation, 1.0f);
+		return result;
+	}
+
+	void TransformHierarchy::DecomposeMatrix(const float4x4& matrix, float3& translation, quat& rotation, float3& scale)
+	{
+		const float3 x = float3(matrix[0]);
+		const float3 y = float3(matrix[1]);
+		const float3 z = float3(matrix[2]);
+
+		translation = float3(matrix[3]);
+		scale = float3(glm::length(x), glm::length(y), glm::length(z));
+
+		// A mirrored matrix gets a negative scale on x so the rotation stays a proper rotation
+		if (glm::dot(glm::cross(x, y), z) < 0.0f)
+			scale.x = -scale.x;
+
+		if (Math::Abs(scale.x) < 1e-8f || Math::Abs(scale.y) < 1e-8f || Math::Abs(scale.z) < 1e-8f)
+		{
+			rotation = quat(1.0f, 0.0f, 0.0f, 0.0f);
+			return;
+		}
+
+		rotation = glm::normalize(glm::quat_cast(float3x3(x / scale.x, y / scale.y, z / scale.z)));
+	}
+}
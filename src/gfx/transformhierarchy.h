@@ -0,0 +1,87 @@
+#pragma once
+
+#include "core/math.h"
+
+#include <vector>
+
+namespace limbo::Gfx
+{
+	/**
+	 * Flat node hierarchy, stored as structure of arrays. A node has to be added after its parent.
+	 *
+	 * The world matrices are updated one depth level at a time, the nodes of a level only read the world
+	 * matrices of the level above so every level is updated in parallel. Only the nodes whose local transform
+	 * changed, and their descendants, are recomputed.
+	 */
+	class TransformHierarchy
+	{
+	public:
+		static constexpr uint32 InvalidNode = ~0u;
+
+		// Levels smaller than this are not worth the job dispatch
+		static constexpr uint32 MinParallelLevelSize = 4096;
+		static constexpr uint32 NodesPerJob = 1024;
+
+	private:
+		std::vector<uint32>		m_Parents;
+		std::vector<uint32>		m_Depths;
+
+		// Local transform
+		std::vector<float3>		m_Translations;
+		std::vector<quat>		m_Rotations;
+		std::vector<float3>		m_Scales;
+
+		std::vector<float4x4>	m_WorldMatrices;
+
+		// Set when the local transform changed since the last update
+		std::vector<uint8>		m_LocalDirty;
+		// Set when the world matrix changed in the last update
+		std::vector<uint8>		m_WorldChanged;
+		uint32					m_NumLocalDirty = 0;
+
+		// Node indices sorted by depth, level i is [m_LevelOffsets[i], m_LevelOffsets[i + 1])
+		std::vector<uint32>		m_LevelNodes;
+		std::vector<uint32>		m_LevelOffsets;
+		bool					m_bLevelsDirty = false;
+
+		std::vector<uint32>		m_ChangedNodes;
+
+	public:
+		void Reserve(uint32 numNodes);
+		void Clear();
+
+		uint32 AddNode(uint32 parent, const float3& translation, const quat& rotation, const float3& scale);
+		// The matrix is decomposed, a shear can not be represented
+		uint32 AddNode(uint32 parent, const float4x4& localMatrix);
+
+		void SetLocalTransform(uint32 node, const float3& translation, const quat& rotation, const float3& scale);
+		void SetTranslation(uint32 node, const float3& translation);
+		void SetRotation(uint32 node, const quat& rotation);
+		void SetScale(uint32 node, const float3& scale);
+
+		// Recomputes the world matrices of the dirty nodes and their descendants
+		void Update();
+
+		uint32 NumNodes() const { return (uint32)m_Parents.size(); }
+		uint32 NumLevels() const { return m_LevelOffsets.empty() ? 0 : (uint32)m_LevelOffsets.size() - 1; }
+
+		uint32 GetParent(uint32 node) const { return m_Parents[node]; }
+		const float3& GetTranslation(uint32 node) const { return m_Translations[node]; }
+		const quat& GetRotation(uint32 node) const { return m_Rotations[node]; }
+		const float3& GetScale(uint32 node) const { return m_Scales[node]; }
+		const float4x4& GetWorldMatrix(uint32 node) const { return m_WorldMatrices[node]; }
+
+		// Whether the world matrix changed in the last update
+		bool HasWorldChanged(uint32 node) const { return m_WorldChanged[node] != 0; }
+		// The nodes whose world matrix changed in the last update, sorted by depth
+		const std::vector<uint32>& GetChangedNodes() const { return m_ChangedNodes; }
+
+		static float4x4 ComposeMatrix(const float3& translation, const quat& rotation, const float3& scale);
+		static void DecomposeMatrix(const float4x4& matrix, float3& translation, quat& rotation, float3& scale);
+
+	private:
+		void MarkDirty(uint32 node);
+		void BuildLevels();
+		void UpdateNode(uint32 node);
+	};
+}
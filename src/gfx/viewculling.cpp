@@ -0,0 +1,183 @@
+#include "stdafx.h"
+#include "viewculling.h"
+#include "core/jobsystem.h"
+
+#include <bit>
+#include <immintrin.h>
+
+namespace limbo::Gfx
+{
+	namespace
+	{
+#if defined(__AVX__)
+		// Bit i is set when lane i of the block is at least partly inside of all the planes
+		uint32 TestBlockPlanes(const float* centerX, const float* centerY, const float* centerZ, const float* extentX, const float* extentY, const float* extentZ, const float4 planes[6])
+		{
+			const __m256 cx = _mm256_load_ps(centerX);
+			const __m256 cy = _mm256_load_ps(centerY);
+			const __m256 cz = _mm256_load_ps(centerZ);
+			const __m256 ex = _mm256_load_ps(extentX);
+			const __m256 ey = _mm256_load_ps(extentY);
+			const __m256 ez = _mm256_load_ps(extentZ);
+
+			__m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (uint32 i = 0; i < 6; ++i)
+			{
+				const float4& plane = planes[i];
+
+				// Same operations in the same order as Math::AABBInFrustum(), the radius is the extents projected on the absolute normal
+				__m256 distance = _mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(plane.x)), _mm256_mul_ps(cy, _mm256_set1_ps(plane.y)));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(cz, _mm256_set1_ps(plane.z)));
+				distance = _mm256_add_ps(distance, _mm256_set1_ps(plane.w));
+
+				__m256 radius = _mm256_add_ps(_mm256_mul_ps(ex, _mm256_set1_ps(fabsf(plane.x))), _mm256_mul_ps(ey, _mm256_set1_ps(fabsf(plane.y))));
+				radius = _mm256_add_ps(radius, _mm256_mul_ps(ez, _mm256_set1_ps(fabsf(plane.z))));
+				visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, _mm256_sub_ps(_mm256_setzero_ps(), radius), _CMP_GE_OQ));
+			}
+			return (uint32)_mm256_movemask_ps(visible);
+		}
+#else
+		// Without AVX the 8 lanes are done as two halves
+		uint32 TestHalfBlockPlanes(const float* centerX, const float* centerY, const float* centerZ, const float* extentX, const float* extentY, const float* extentZ, const float4 planes[6])
+		{
+			const __m128 cx = _mm_load_ps(centerX);
+			const __m128 cy = _mm_load_ps(centerY);
+			const __m128 cz = _mm_load_ps(centerZ);
+			const __m128 ex = _mm_load_ps(extentX);
+			const __m128 ey = _mm_load_ps(extentY);
+			const __m128 ez = _mm_load_ps(extentZ);
+
+			__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (uint32 i = 0; i < 6; ++i)
+			{
+				const float4& plane = planes[i];
+				__m128 distance = _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y)));
+				distance = _mm_add_ps(distance, _mm_mul_ps(cz, _mm_set1_ps(plane.z)));
+				distance = _mm_add_ps(distance, _mm_set1_ps(plane.w));
+
+				__m128 radius = _mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(fabsf(plane.x))), _mm_mul_ps(ey, _mm_set1_ps(fabsf(plane.y))));
+				radius = _mm_add_ps(radius, _mm_mul_ps(ez, _mm_set1_ps(fabsf(plane.z))));
+				visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, _mm_sub_ps(_mm_setzero_ps(), radius)));
+			}
+			return (uint32)_mm_movemask_ps(visible);
+		}
+
+		uint32 TestBlockPlanes(const float* centerX, const float* centerY, const float* centerZ, const float* extentX, const float* extentY, const float* extentZ, const float4 planes[6])
+		{
+			const uint32 low = TestHalfBlockPlanes(centerX, centerY, centerZ, extentX, extentY, extentZ, planes);
+			const uint32 high = TestHalfBlockPlanes(centerX + 4, centerY + 4, centerZ + 4, extentX + 4, extentY + 4, extentZ + 4, planes);
+			return low | (high << 4);
+		}
+#endif
+	}
+
+	void ViewCulling::SetInstances(Span<Math::AABB> instanceBounds)
+	{
+		m_NumInstances = instanceBounds.GetSize();
+		m_Blocks.assign(Math::DivideAndRoundUp(m_NumInstances, LaneCount), InstanceBlock());
+		m_VisibilityMasks.assign(m_Blocks.size() * MaxViews, 0);
+		for (uint32 i = 0; i < m_NumInstances; ++i)
+			UpdateInstance(i, instanceBounds[i]);
+	}
+
+	void ViewCulling::Resize(uint32 numInstances)
+	{
+		m_NumInstances = numInstances;
+		m_Blocks.resize(Math::DivideAndRoundUp(m_NumInstances, LaneCount), InstanceBlock());
+		m_VisibilityMasks.resize(m_Blocks.size() * MaxViews, 0);
+	}
+
+	void ViewCulling::UpdateInstance(uint32 instance, const Math::AABB& bounds)
+	{
+		check(instance < m_NumInstances);
+
+		InstanceBlock& block = m_Blocks[instance / LaneCount];
+		const uint32 lane = instance % LaneCount;
+		const float3 center = bounds.GetCenter();
+		const float3 extents = bounds.GetExtents();
+		block.CenterX[lane] = center.x;
+		block.CenterY[lane] = center.y;
+		block.CenterZ[lane] = center.z;
+		block.ExtentX[lane] = extents.x;
+		block.ExtentY[lane] = extents.y;
+		block.ExtentZ[lane] = extents.z;
+	}
+
+	void ViewCulling::SetView(uint32 view, const float4x4& viewProjection, bool bCullNearPlane)
+	{
+		check(view < MaxViews);
+
+		View& result = m_Views[view];
+		Math::ExtractFrustumPlanes(viewProjection, result.Planes);
+		if (!bCullNearPlane)
+			result.Planes[4] = float4(0.0f, 0.0f, 0.0f, 1.0f);
+		result.bEnabled = true;
+	}
+
+	void ViewCulling::DisableView(uint32 view)
+	{
+		check(view < MaxViews);
+		m_Views[view].bEnabled = false;
+		m_VisibleInstances[view].clear();
+	}
+
+	void ViewCulling::CullBlock(uint32 blockIndex)
+	{
+		const InstanceBlock& block = m_Blocks[blockIndex];
+
+		// The lanes past the last instance are never visible
+		const uint32 numLanes = Math::Min(m_NumInstances - blockIndex * LaneCount, LaneCount);
+		const uint32 laneMask = (1u << numLanes) - 1;
+
+		uint8* masks = &m_VisibilityMasks[blockIndex * MaxViews];
+		for (uint32 view = 0; view < MaxViews; ++view)
+		{
+			if (!m_Views[view].bEnabled)
+				continue;
+
+			masks[view] = (uint8)(TestBlockPlanes(block.CenterX, block.CenterY, block.CenterZ, block.ExtentX, block.ExtentY, block.ExtentZ, m_Views[view].Planes) & laneMask);
+		}
+	}
+
+	void ViewCulling::CompactView(uint32 view)
+	{
+		std::vector<uint32>& visible = m_VisibleInstances[view];
+		visible.clear();
+		for (uint32 block = 0; block < (uint32)m_Blocks.size(); ++block)
+		{
+			uint32 mask = m_VisibilityMasks[block * MaxViews + view];
+			while (mask != 0)
+			{
+				visible.push_back(block * LaneCount + std::countr_zero(mask));
+				mask &= mask - 1;
+			}
+		}
+	}
+
+	void ViewCulling::Cull()
+	{
+		// All the views are tested while the block is loaded, then each view is compacted in its own job
+		Core::JobContext context;
+		Core::JobSystem::ExecuteMany(context, (uint32)m_Blocks.size(), BlocksPerJob, Core::TOnJobSystemExecuteMany::CreateLambda([this](Core::JobDispatchArgs args)
+		{
+			CullBlock(args.jobIndex);
+		}));
+		Core::JobSystem::Wait(context);
+
+		Core::JobSystem::ExecuteMany(context, MaxViews, 1, Core::TOnJobSystemExecuteMany::CreateLambda([this](Core::JobDispatchArgs args)
+		{
+			if (m_Views[args.jobIndex].bEnabled)
+				CompactView(args.jobIndex);
+		}));
+		Core::JobSystem::Wait(context);
+	}
+
+	CullingViewStats ViewCulling::GetStats(uint32 view) const
+	{
+		if (!m_Views[view].bEnabled)
+			return CullingViewStats();
+
+		const uint32 numVisible = (uint32)m_VisibleInstances[view].size();
+		return { .NumVisible = numVisible, .NumCulled = m_NumInstances - numVisible };
+	}
+}
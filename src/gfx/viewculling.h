@@ -0,0 +1,79 @@
+#pragma once
+
+#include "core/math.h"
+#include "core/array.h"
+
+#include <vector>
+
+namespace limbo::Gfx
+{
+	struct CullingViewStats
+	{
+		uint32 NumVisible = 0;
+		uint32 NumCulled = 0;
+	};
+
+	/**
+	 * Frustum culling of the instance boxes against several views in one pass.
+	 *
+	 * The boxes are stored as structure of arrays in blocks of 8 instances, one block is tested against a
+	 * plane with a single AVX instruction per component. The blocks are split over the job system and every
+	 * view gets a compact list of the instances it sees.
+	 */
+	class ViewCulling
+	{
+	public:
+		static constexpr uint32 LaneCount = 8;
+		static constexpr uint32 MaxViews = 8;
+		static constexpr uint32 BlocksPerJob = 64;
+
+	private:
+		struct alignas(32) InstanceBlock
+		{
+			float CenterX[LaneCount];
+			float CenterY[LaneCount];
+			float CenterZ[LaneCount];
+			float ExtentX[LaneCount];
+			float ExtentY[LaneCount];
+			float ExtentZ[LaneCount];
+		};
+
+		struct View
+		{
+			float4	Planes[6];
+			bool	bEnabled = false;
+		};
+
+		std::vector<InstanceBlock>	m_Blocks;
+		uint32						m_NumInstances = 0;
+
+		View						m_Views[MaxViews];
+		// Lanes of each block that each view sees, m_VisibilityMasks[block * MaxViews + view]
+		std::vector<uint8>			m_VisibilityMasks;
+		std::vector<uint32>			m_VisibleInstances[MaxViews];
+
+	public:
+		// Replaces every instance, the instance indices are the indices of the boxes
+		void SetInstances(Span<Math::AABB> instanceBounds);
+		// Keeps the boxes of the instances below numInstances, the new ones have to be set with UpdateInstance()
+		void Resize(uint32 numInstances);
+		void UpdateInstance(uint32 instance, const Math::AABB& bounds);
+
+		// Planes from the view projection, a shadow view keeps what is between the light and its near plane as it still casts shadows
+		void SetView(uint32 view, const float4x4& viewProjection, bool bCullNearPlane = true);
+		void DisableView(uint32 view);
+
+		void Cull();
+
+		// Sorted by instance index
+		const std::vector<uint32>& GetVisibleInstances(uint32 view) const { return m_VisibleInstances[view]; }
+		CullingViewStats GetStats(uint32 view) const;
+
+		uint32 NumInstances() const { return m_NumInstances; }
+		bool IsViewEnabled(uint32 view) const { return m_Views[view].bEnabled; }
+
+	private:
+		void CullBlock(uint32 block);
+		void CompactView(uint32 view);
+	};
+}
@@ -24,6 +24,7 @@ int WINAPI WinMain(HINSTANCE /*hInstance*/, HINSTANCE /*hPrevInstance*/, PSTR lp
 {
 	Core::Timer initTimer;
 
+	Core::Timestamp::Calibrate();
 	Core::JobSystem::Initialize();
 
 	Core::CommandLine::Init(lpCmdLine);
@@ -8,18 +8,23 @@
 #include <set>
 #include <mutex>
 #include <format>
+#include <cstring>
 
 // Third Party
+#if defined(_WIN32)
 #include <d3d12/d3d12.h>
 #define D3DX12_NO_STATE_OBJECT_HELPERS
 #include <d3d12/d3dx12/d3dx12.h>
+#endif
 #define IMGUI_DEFINE_MATH_OPERATORS
 #include <imgui.h>
 #include <CppDelegates/Delegates.h>
+#if defined(_WIN32)
 #if !LB_RELEASE
 #	define USE_PIX
 #endif
 #include <WinPixEventRuntime/pix3.h>
+#endif
 
 #include "core/math.h"
 #include "core/array.h"
@@ -0,0 +1,165 @@
+#include "stdafx.h"
+#include "tests.h"
+#include "gfx/drawlist.h"
+#include "core/timer.h"
+
+#include <algorithm>
+#include <random>
+
+using namespace limbo;
+using namespace limbo::Gfx;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+namespace
+{
+	struct DrawListInputs
+	{
+		std::vector<DrawListInstance>	Instances;
+		std::vector<Math::AABB>			Bounds;
+		std::vector<uint32>				Visible;
+	};
+
+	DrawListInputs CreateInputs(uint32 numInstances, uint32 numMaterials, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+		std::uniform_int_distribution<uint32> material(0, numMaterials - 1);
+		std::bernoulli_distribution alphaTested(0.2);
+
+		DrawListInputs inputs;
+		inputs.Instances.resize(numInstances);
+		inputs.Bounds.resize(numInstances);
+		for (uint32 i = 0; i < numInstances; ++i)
+		{
+			inputs.Instances[i] = { .Material = material(rng), .Pass = alphaTested(rng) ? DrawPass::AlphaTested : DrawPass::Opaque };
+
+			const float3 center = float3(position(rng), position(rng), position(rng));
+			inputs.Bounds[i] = { center - 1.0f, center + 1.0f };
+
+			// Culling leaves holes in the instance IDs
+			if (i % 3 != 0)
+				inputs.Visible.push_back(i);
+		}
+		return inputs;
+	}
+}
+
+TEST_CASE("DrawList - Sort Order")
+{
+	LB_LOG("DrawList - Sort Order");
+
+	std::mt19937 rng(43);
+	const DrawListInputs inputs = CreateInputs(50'000, 40, rng);
+	const DrawListView view = { .Origin = float3(10.0f, 0.0f, -20.0f), .Direction = glm::normalize(float3(0.0f, 0.2f, 1.0f)), .Pipeline = 3 };
+
+	DrawList list;
+	list.Build(inputs.Visible, inputs.Instances, inputs.Bounds, view);
+	REQUIRE(list.GetSize() == (uint32)inputs.Visible.size());
+
+	// Every visible instance exactly once
+	std::vector<uint32> drawn;
+	for (uint64 key : list.GetKeys())
+		drawn.push_back(DrawList::GetInstance(key));
+	std::sort(drawn.begin(), drawn.end());
+	REQUIRE(drawn == inputs.Visible);
+
+	// Same as sorting the keys with the standard library
+	std::vector<uint64> expected;
+	for (uint32 instance : inputs.Visible)
+	{
+		const float depth = glm::dot(inputs.Bounds[instance].GetCenter() - view.Origin, view.Direction);
+		expected.push_back(DrawList::CreateKey(inputs.Instances[instance].Pass, view.Pipeline, inputs.Instances[instance].Material, depth, instance));
+	}
+	std::sort(expected.begin(), expected.end());
+	REQUIRE(std::equal(list.GetKeys().begin(), list.GetKeys().end(), expected.begin(), expected.end()));
+
+	// Opaque before alpha tested, then by material and front to back
+	const Span<uint64> opaque = list.GetKeys(DrawPass::Opaque);
+	const Span<uint64> alphaTested = list.GetKeys(DrawPass::AlphaTested);
+	REQUIRE(opaque.GetSize() + alphaTested.GetSize() == list.GetSize());
+	REQUIRE(opaque.GetSize() > 0);
+	REQUIRE(alphaTested.GetSize() > 0);
+	for (uint64 key : opaque)
+		REQUIRE(inputs.Instances[DrawList::GetInstance(key)].Pass == DrawPass::Opaque);
+	for (uint64 key : alphaTested)
+		REQUIRE(inputs.Instances[DrawList::GetInstance(key)].Pass == DrawPass::AlphaTested);
+
+	for (uint32 i = 1; i < opaque.GetSize(); ++i)
+	{
+		const uint32 previous = DrawList::GetInstance(opaque[i - 1]);
+		const uint32 current = DrawList::GetInstance(opaque[i]);
+		REQUIRE(inputs.Instances[previous].Material <= inputs.Instances[current].Material);
+		if (inputs.Instances[previous].Material == inputs.Instances[current].Material)
+		{
+			// The depth is quantized, allow what the 16 bits lose at this distance
+			const float previousDepth = glm::dot(inputs.Bounds[previous].GetCenter() - view.Origin, view.Direction);
+			const float currentDepth = glm::dot(inputs.Bounds[current].GetCenter() - view.Origin, view.Direction);
+			REQUIRE(previousDepth <= currentDepth + fabsf(currentDepth) * 0.01f);
+		}
+	}
+}
+
+TEST_CASE("DrawList - Keys")
+{
+	LB_LOG("DrawList - Keys");
+
+	// Negative depths are behind the origin and come first
+	REQUIRE(DrawList::CreateKey(DrawPass::Opaque, 0, 0, -10.0f, 0) < DrawList::CreateKey(DrawPass::Opaque, 0, 0, -1.0f, 0));
+	REQUIRE(DrawList::CreateKey(DrawPass::Opaque, 0, 0, -1.0f, 0) < DrawList::CreateKey(DrawPass::Opaque, 0, 0, 0.0f, 0));
+	REQUIRE(DrawList::CreateKey(DrawPass::Opaque, 0, 0, 1.0f, 0) < DrawList::CreateKey(DrawPass::Opaque, 0, 0, 10.0f, 0));
+
+	// The pass is above everything else
+	REQUIRE(DrawList::CreateKey(DrawPass::Opaque, 63, 65535, 1e30f, (1u << 24) - 1) < DrawList::CreateKey(DrawPass::AlphaTested, 0, 0, -1e30f, 0));
+
+	const uint64 key = DrawList::CreateKey(DrawPass::AlphaTested, 5, 1234, 3.0f, 98765);
+	REQUIRE(DrawList::GetInstance(key) == 98765);
+	REQUIRE(DrawList::GetPass(key) == DrawPass::AlphaTested);
+
+	// Every byte different, more than one job
+	std::mt19937_64 rng(7);
+	std::vector<uint64> keys(DrawList::KeysPerJob * 3 + 17);
+	for (uint64& k : keys)
+		k = rng();
+
+	DrawList list;
+	list.Sort(keys);
+	std::sort(keys.begin(), keys.end());
+	REQUIRE(std::equal(list.GetKeys().begin(), list.GetKeys().end(), keys.begin(), keys.end()));
+
+	DrawList empty;
+	empty.Build({}, {}, {}, {});
+	REQUIRE(empty.GetSize() == 0);
+	REQUIRE(empty.GetKeys(DrawPass::Opaque).GetSize() == 0);
+}
+
+TEST_CASE("DrawList - Benchmark")
+{
+	LB_LOG("DrawList - Benchmark");
+
+	std::mt19937 rng(45);
+	for (uint32 numInstances : { 10'000u, 100'000u, 1'000'000u })
+	{
+		const DrawListInputs inputs = CreateInputs(numInstances, 500, rng);
+		const DrawListView view = { .Origin = float3(0.0f), .Direction = float3(0.0f, 0.0f, 1.0f), .Pipeline = 2 };
+
+		// Every frame builds the lists again
+		constexpr uint32 numIterations = 20;
+		DrawList list;
+		Core::Timer timer;
+		for (uint32 i = 0; i < numIterations; ++i)
+			list.Build(inputs.Visible, inputs.Instances, inputs.Bounds, view);
+		const float buildTime = timer.ElapsedMilliseconds() / numIterations;
+
+		std::vector<uint64> keys(list.GetKeys().begin(), list.GetKeys().end());
+		std::shuffle(keys.begin(), keys.end(), rng);
+		timer.Record();
+		std::sort(keys.begin(), keys.end());
+		const float stdSortTime = timer.ElapsedMilliseconds();
+		REQUIRE(std::equal(list.GetKeys().begin(), list.GetKeys().end(), keys.begin(), keys.end()));
+
+		LB_LOG("%u draws: build and sort %.3fms, std::sort of the keys %.3fms", list.GetSize(), buildTime, stdSortTime);
+	}
+}
+
+#endif
@@ -0,0 +1,138 @@
+#include "stdafx.h"
+#include "tests.h"
+#include "gfx/gltfaccessors.h"
+
+#include <cgltf/cgltf.h>
+
+using namespace limbo;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+namespace
+{
+	struct TestAccessor
+	{
+		cgltf_buffer		Buffer = {};
+		cgltf_buffer_view	View = {};
+		cgltf_accessor		Accessor = {};
+
+		TestAccessor(void* data, size_t size, size_t count, size_t stride, cgltf_type type, cgltf_component_type componentType, bool bNormalized)
+		{
+			Buffer.data = data;
+			Buffer.size = size;
+			View.buffer = &Buffer;
+			View.size = size;
+			Accessor.buffer_view = &View;
+			Accessor.count = count;
+			Accessor.stride = stride;
+			Accessor.type = type;
+			Accessor.component_type = componentType;
+			Accessor.normalized = bNormalized;
+		}
+	};
+}
+
+TEST_CASE("GLTF - Normalized integer conversion")
+{
+	LB_LOG("GLTF - Normalized integer conversion");
+
+	// Enough values to go through the SIMD path and the scalar tail
+	std::vector<int16> signedValues;
+	std::vector<uint16> unsignedValues;
+	for (int32 i = 0; i < 37; ++i)
+	{
+		signedValues.push_back((int16)(i * 1771 - 32768));
+		unsignedValues.push_back((uint16)(i * 1771));
+	}
+
+	std::vector<float> result(signedValues.size());
+	Gfx::GLTF::ConvertToFloat(signedValues.data(), result.data(), result.size(), true);
+	for (size_t i = 0; i < signedValues.size(); ++i)
+		REQUIRE(result[i] == Approx(Math::Max(signedValues[i] / 32767.0f, -1.0f)));
+
+	Gfx::GLTF::ConvertToFloat(unsignedValues.data(), result.data(), result.size(), true);
+	for (size_t i = 0; i < unsignedValues.size(); ++i)
+		REQUIRE(result[i] == Approx(unsignedValues[i] / 65535.0f));
+
+	std::vector<int8> signedBytes;
+	for (int32 i = -128; i < 128; i += 7)
+		signedBytes.push_back((int8)i);
+	result.resize(signedBytes.size());
+	Gfx::GLTF::ConvertToFloat(signedBytes.data(), result.data(), result.size(), true);
+	for (size_t i = 0; i < signedBytes.size(); ++i)
+		REQUIRE(result[i] == Approx(Math::Max(signedBytes[i] / 127.0f, -1.0f)));
+
+	Gfx::GLTF::ConvertToFloat(signedBytes.data(), result.data(), result.size(), false);
+	for (size_t i = 0; i < signedBytes.size(); ++i)
+		REQUIRE(result[i] == (float)signedBytes[i]);
+}
+
+TEST_CASE("GLTF - Strided attribute decoding")
+{
+	LB_LOG("GLTF - Strided attribute decoding");
+
+	struct Vertex
+	{
+		float Position[3];
+		float Pad;
+		float UV[2];
+	};
+
+	// int16 normalized vec3 padded to 8 bytes, like KHR_mesh_quantization exports
+	constexpr size_t count = 300;
+	std::vector<int16> positions(count * 4);
+	for (size_t i = 0; i < count; ++i)
+	{
+		positions[i * 4 + 0] = (int16)i;
+		positions[i * 4 + 1] = (int16)-(int32)i;
+		positions[i * 4 + 2] = (int16)(i * 100);
+		positions[i * 4 + 3] = 12345; // padding, must be ignored
+	}
+	TestAccessor positionAccessor(positions.data(), positions.size() * sizeof(int16), count, 8, cgltf_type_vec3, cgltf_component_type_r_16, true);
+
+	std::vector<float> uvs(count * 2);
+	for (size_t i = 0; i < uvs.size(); ++i)
+		uvs[i] = (float)i * 0.5f;
+	TestAccessor uvAccessor(uvs.data(), uvs.size() * sizeof(float), count, 8, cgltf_type_vec2, cgltf_component_type_r_32f, false);
+
+	std::vector<Vertex> vertices(count, Vertex{ .Pad = 7.0f });
+	REQUIRE(Gfx::GLTF::UnpackFloats(&positionAccessor.Accessor, 3, vertices[0].Position, sizeof(Vertex)));
+	REQUIRE(Gfx::GLTF::UnpackFloats(&uvAccessor.Accessor, 2, vertices[0].UV, sizeof(Vertex)));
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		REQUIRE(vertices[i].Position[0] == Approx(positions[i * 4 + 0] / 32767.0f));
+		REQUIRE(vertices[i].Position[1] == Approx(positions[i * 4 + 1] / 32767.0f));
+		REQUIRE(vertices[i].Position[2] == Approx(positions[i * 4 + 2] / 32767.0f));
+		REQUIRE(vertices[i].Pad == 7.0f);
+		REQUIRE(vertices[i].UV[0] == uvs[i * 2 + 0]);
+		REQUIRE(vertices[i].UV[1] == uvs[i * 2 + 1]);
+	}
+}
+
+TEST_CASE("GLTF - Index decoding")
+{
+	LB_LOG("GLTF - Index decoding");
+
+	std::vector<uint16> indices16(1001);
+	for (size_t i = 0; i < indices16.size(); ++i)
+		indices16[i] = (uint16)(65535 - i * 13);
+	TestAccessor accessor16(indices16.data(), indices16.size() * sizeof(uint16), indices16.size(), sizeof(uint16), cgltf_type_scalar, cgltf_component_type_r_16u, false);
+
+	std::vector<uint32> result(indices16.size());
+	REQUIRE(Gfx::GLTF::UnpackIndices(&accessor16.Accessor, result.data()));
+	for (size_t i = 0; i < indices16.size(); ++i)
+		REQUIRE(result[i] == indices16[i]);
+
+	std::vector<uint8> indices8(77);
+	for (size_t i = 0; i < indices8.size(); ++i)
+		indices8[i] = (uint8)(255 - i * 3);
+	TestAccessor accessor8(indices8.data(), indices8.size(), indices8.size(), sizeof(uint8), cgltf_type_scalar, cgltf_component_type_r_8u, false);
+
+	result.resize(indices8.size());
+	REQUIRE(Gfx::GLTF::UnpackIndices(&accessor8.Accessor, result.data()));
+	for (size_t i = 0; i < indices8.size(); ++i)
+		REQUIRE(result[i] == indices8[i]);
+}
+#endif
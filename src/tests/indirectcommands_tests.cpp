@@ -0,0 +1,80 @@
+#include "stdafx.h"
+#include "tests.h"
+#include "gfx/indirectcommands.h"
+
+#include <cstring>
+
+using namespace limbo;
+using namespace limbo::Gfx;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+TEST_CASE("IndirectCommands - Layout")
+{
+	LB_LOG("IndirectCommands - Layout");
+
+	// The GPU reads the commands as raw 32 bit values, in the order of the command signature arguments
+	const IndirectIndexBufferView indexBuffer = { .BufferLocation = 0x1234'5678'9ABCull, .SizeInBytes = 600, .Format = 42 };
+	const IndirectDrawIndexedCommand draw = CreateDrawIndexedCommand(7, 11, indexBuffer, 300);
+
+	uint32 words[sizeof(IndirectDrawIndexedCommand) / sizeof(uint32)];
+	memcpy(words, &draw, sizeof(draw));
+	REQUIRE(words[0] == 7);
+	REQUIRE(words[1] == 11);
+	REQUIRE(words[2] == 0x5678'9ABCu);
+	REQUIRE(words[3] == 0x1234u);
+	REQUIRE(words[4] == 600);
+	REQUIRE(words[5] == 42);
+	REQUIRE(words[6] == 300);	// IndexCountPerInstance
+	REQUIRE(words[7] == 1);		// InstanceCount
+	REQUIRE(words[8] == 0);		// StartIndexLocation
+	REQUIRE(words[9] == 0);		// BaseVertexLocation
+	REQUIRE(words[10] == 0);	// StartInstanceLocation
+	REQUIRE(words[11] == 0);	// Padding
+
+	const IndirectDispatchMeshCommand dispatch = CreateDispatchMeshCommand(3, 5, 64);
+	uint32 dispatchWords[sizeof(IndirectDispatchMeshCommand) / sizeof(uint32)];
+	memcpy(dispatchWords, &dispatch, sizeof(dispatch));
+	REQUIRE(dispatchWords[0] == 3);
+	REQUIRE(dispatchWords[1] == 5);
+	REQUIRE(dispatchWords[2] == 64);
+	REQUIRE(dispatchWords[3] == 1);
+	REQUIRE(dispatchWords[4] == 1);
+}
+
+TEST_CASE("IndirectCommands - Packing")
+{
+	LB_LOG("IndirectCommands - Packing");
+
+	// More than one job, and the keys in the order of a draw list rather than by instance
+	const uint32 numDraws = IndirectCommandsPerJob * 3 + 5;
+	std::vector<uint64> keys(numDraws);
+	for (uint32 i = 0; i < numDraws; ++i)
+	{
+		const uint32 instance = (i * 7919) % numDraws;
+		keys[i] = DrawList::CreateKey(DrawPass::Opaque, 1, i % 13, (float)i, instance);
+	}
+
+	std::vector<IndirectDispatchMeshCommand> commands(numDraws);
+	PackIndirectCommands(Span<uint64>(keys), commands.data(), [](uint32 instance)
+	{
+		return CreateDispatchMeshCommand(instance, instance * 2, instance % 100 + 1);
+	});
+
+	for (uint32 i = 0; i < numDraws; ++i)
+	{
+		const uint32 instance = DrawList::GetInstance(keys[i]);
+		REQUIRE(commands[i].Constants[0] == instance);
+		REQUIRE(commands[i].Constants[1] == instance * 2);
+		REQUIRE(commands[i].Dispatch.ThreadGroupCountX == instance % 100 + 1);
+	}
+
+	// Nothing to draw writes nothing
+	PackIndirectCommands(Span<uint64>(), (IndirectDispatchMeshCommand*)nullptr, [](uint32 instance)
+	{
+		return CreateDispatchMeshCommand(instance, 0, 0);
+	});
+}
+
+#endif
@@ -0,0 +1,336 @@
+#include "stdafx.h"
+#include "tests.h"
+#include "gfx/instancebvh.h"
+#include "core/timer.h"
+#include "testhelpers.h"
+
+#include <cgltf/cgltf.h>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <algorithm>
+#include <random>
+
+using namespace limbo;
+using namespace limbo::Gfx;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+namespace
+{
+	void GetFrustumPlanes(const float3& eye, const float3& target, float4 outPlanes[6])
+	{
+		const float4x4 viewProjection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 200.0f) * glm::lookAt(eye, target, float3(0.0f, 1.0f, 0.0f));
+		Math::ExtractFrustumPlanes(viewProjection, outPlanes);
+	}
+
+	bool IsValidTree(const InstanceBVH& bvh)
+	{
+		// Every node contains its children and every instance is referenced once
+		uint32 numReferenced = 0;
+		for (uint32 i = 0; i < bvh.NumNodes(); ++i)
+		{
+			const InstanceBVH::Node& node = bvh.GetNode(i);
+			if (node.IsLeaf())
+			{
+				numReferenced += node.Count;
+				continue;
+			}
+
+			for (uint32 child = node.LeftFirst; child < node.LeftFirst + 2; ++child)
+			{
+				const InstanceBVH::Node& childNode = bvh.GetNode(child);
+				if (glm::any(glm::lessThan(childNode.Min, node.Min)) || glm::any(glm::greaterThan(childNode.Max, node.Max)))
+					return false;
+			}
+		}
+		return numReferenced == bvh.NumInstances();
+	}
+
+	// World space boxes of every mesh instance of a glTF file, from the min and max of the position accessors
+	bool LoadSceneBoxes(const char* path, std::vector<Math::AABB>& outBoxes)
+	{
+		cgltf_options options = {};
+		cgltf_data* data = nullptr;
+		if (cgltf_parse_file(&options, path, &data) != cgltf_result_success)
+			return false;
+
+		for (size_t i = 0; i < data->nodes_count; ++i)
+		{
+			const cgltf_node& node = data->nodes[i];
+			if (!node.mesh)
+				continue;
+
+			float4x4 world;
+			cgltf_node_transform_world(&node, &world[0][0]);
+			for (size_t p = 0; p < node.mesh->primitives_count; ++p)
+			{
+				const cgltf_primitive& primitive = node.mesh->primitives[p];
+				for (size_t a = 0; a < primitive.attributes_count; ++a)
+				{
+					const cgltf_accessor* accessor = primitive.attributes[a].data;
+					if (primitive.attributes[a].type != cgltf_attribute_type_position || !accessor->has_min || !accessor->has_max)
+						continue;
+
+					const Math::AABB local = { float3(accessor->min[0], accessor->min[1], accessor->min[2]), float3(accessor->max[0], accessor->max[1], accessor->max[2]) };
+					outBoxes.push_back(Math::TransformAABB(local, world));
+				}
+			}
+		}
+
+		cgltf_free(data);
+		return true;
+	}
+
+	void Benchmark(const char* name, const std::vector<Math::AABB>& boxes)
+	{
+		constexpr uint32 numQueries = 1000;
+
+		InstanceBVH bvh;
+		Core::Timer timer;
+		bvh.Build(boxes);
+		const float buildTime = timer.ElapsedMilliseconds();
+		REQUIRE(IsValidTree(bvh));
+
+		const Math::AABB bounds = bvh.GetBounds();
+		const float3 center = bounds.GetCenter();
+		const float3 extents = bounds.GetExtents();
+		std::mt19937 rng(3);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+		// Small moves of 10% of the instances
+		std::vector<Math::AABB> movedBoxes = boxes;
+		std::vector<uint32> moved;
+		for (uint32 i = 0; i < (uint32)boxes.size(); i += 10)
+		{
+			const float3 offset = float3(unit(rng), unit(rng), unit(rng)) * extents * 0.01f;
+			movedBoxes[i].Min += offset;
+			movedBoxes[i].Max += offset;
+			moved.push_back(i);
+		}
+		timer.Record();
+		bvh.Refit(moved, movedBoxes);
+		const float refitTime = timer.ElapsedMilliseconds();
+		REQUIRE(IsValidTree(bvh));
+
+		std::vector<uint32> result;
+		size_t numFrustumResults = 0;
+		timer.Record();
+		for (uint32 i = 0; i < numQueries; ++i)
+		{
+			float4 planes[6];
+			GetFrustumPlanes(center, center + float3(unit(rng), unit(rng) * 0.2f, unit(rng)), planes);
+			result.clear();
+			bvh.QueryFrustum(planes, result);
+			numFrustumResults += result.size();
+		}
+		const float frustumTime = timer.ElapsedMilliseconds();
+
+		size_t numSphereResults = 0;
+		timer.Record();
+		for (uint32 i = 0; i < numQueries; ++i)
+		{
+			result.clear();
+			bvh.QuerySphere(float4(center + float3(unit(rng), unit(rng), unit(rng)) * extents, glm::length(extents) * 0.1f), result);
+			numSphereResults += result.size();
+		}
+		const float sphereTime = timer.ElapsedMilliseconds();
+
+		uint32 numRayHits = 0;
+		timer.Record();
+		for (uint32 i = 0; i < numQueries; ++i)
+		{
+			InstanceBVH::RayHit hit;
+			numRayHits += bvh.Raycast({ center, float3(unit(rng), unit(rng), unit(rng)) }, hit) ? 1 : 0;
+		}
+		const float rayTime = timer.ElapsedMilliseconds();
+
+		LB_LOG("%s: %zu instances, %u nodes, SAH cost %.2f - build: %.3fms, refit of %zu: %.3fms", name, boxes.size(), bvh.NumNodes(), bvh.ComputeCost(), buildTime, moved.size(), refitTime);
+		LB_LOG("%s: %u queries - frustum: %.3fms (%.1f hits), sphere: %.3fms (%.1f hits), ray: %.3fms (%u hits)", name, numQueries,
+			   frustumTime, (float)numFrustumResults / numQueries, sphereTime, (float)numSphereResults / numQueries, rayTime, numRayHits);
+	}
+}
+
+TEST_CASE("InstanceBVH - Queries")
+{
+	LB_LOG("InstanceBVH - Queries");
+
+	std::mt19937 rng(7);
+	const std::vector<Math::AABB> boxes = Tests::CreateRandomBoxes(3000, 100.0f, rng);
+
+	InstanceBVH bvh;
+	bvh.Build(boxes);
+	REQUIRE(bvh.NumInstances() == 3000);
+	REQUIRE(IsValidTree(bvh));
+
+	// Every query has to return the same instances as testing all the boxes
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<uint32> result, expected;
+	for (uint32 i = 0; i < 50; ++i)
+	{
+		float4 planes[6];
+		GetFrustumPlanes(float3(unit(rng), unit(rng), unit(rng)) * 50.0f, float3(unit(rng), unit(rng), unit(rng)) * 50.0f, planes);
+		result.clear();
+		expected.clear();
+		bvh.QueryFrustum(planes, result);
+		for (uint32 b = 0; b < (uint32)boxes.size(); ++b)
+		{
+			if (Math::AABBInFrustum(planes, boxes[b]))
+				expected.push_back(b);
+		}
+		std::sort(result.begin(), result.end());
+		REQUIRE(result == expected);
+
+		const float4 sphere = float4(float3(unit(rng), unit(rng), unit(rng)) * 100.0f, 20.0f);
+		result.clear();
+		expected.clear();
+		bvh.QuerySphere(sphere, result);
+		for (uint32 b = 0; b < (uint32)boxes.size(); ++b)
+		{
+			if (Math::SphereIntersectsAABB(sphere, boxes[b]))
+				expected.push_back(b);
+		}
+		std::sort(result.begin(), result.end());
+		REQUIRE(result == expected);
+
+		// Rays from outside of every box, so the closest hit is the smallest enter distance
+		const Math::Ray ray = { float3(200.0f, unit(rng) * 100.0f, unit(rng) * 100.0f), glm::normalize(float3(-1.0f, unit(rng) * 0.3f, unit(rng) * 0.3f)) };
+		InstanceBVH::RayHit hit;
+		const bool bHit = bvh.Raycast(ray, hit);
+
+		float closest = FLT_MAX;
+		for (const Math::AABB& box : boxes)
+		{
+			float enter, exit;
+			if (Math::RayIntersectsAABB(ray.Origin, 1.0f / ray.Direction, box, closest, enter, exit))
+				closest = Math::Min(closest, enter);
+		}
+		REQUIRE(bHit == (closest < FLT_MAX));
+		if (bHit)
+			REQUIRE(hit.Distance == closest);
+	}
+
+	// A ray that starts inside of a big box still picks the smaller box in front of it
+	const std::vector<Math::AABB> room = { { float3(-10.0f), float3(10.0f) }, { float3(2.0f, -1.0f, -1.0f), float3(3.0f, 1.0f, 1.0f) } };
+	InstanceBVH roomBVH;
+	roomBVH.Build(room);
+	InstanceBVH::RayHit hit;
+	REQUIRE(roomBVH.Raycast({ float3(0.0f), float3(1.0f, 0.0f, 0.0f) }, hit));
+	REQUIRE(hit.Instance == 1);
+	REQUIRE(roomBVH.Raycast({ float3(0.0f), float3(-1.0f, 0.0f, 0.0f) }, hit));
+	REQUIRE(hit.Instance == 0);
+
+	InstanceBVH empty;
+	empty.Build(Span<Math::AABB>());
+	REQUIRE(!empty.Raycast({ float3(0.0f), float3(1.0f, 0.0f, 0.0f) }, hit));
+}
+
+TEST_CASE("InstanceBVH - Refit")
+{
+	LB_LOG("InstanceBVH - Refit");
+
+	std::mt19937 rng(11);
+	std::vector<Math::AABB> boxes = Tests::CreateRandomBoxes(1000, 50.0f, rng);
+
+	InstanceBVH bvh;
+	bvh.Build(boxes);
+	const float buildCost = bvh.ComputeCost();
+
+	// A few instances move, the walk up from their leaves has to keep every parent box around its children
+	std::uniform_int_distribution<uint32> instance(0, 999);
+	std::vector<uint32> moved;
+	for (uint32 i = 0; i < 20; ++i)
+	{
+		const uint32 index = instance(rng);
+		boxes[index].Min += float3(30.0f, 0.0f, 0.0f);
+		boxes[index].Max += float3(30.0f, 0.0f, 0.0f);
+		moved.push_back(index);
+	}
+	bvh.Refit(moved, boxes);
+	REQUIRE(IsValidTree(bvh));
+
+	const float4 sphere = float4(70.0f, 0.0f, 0.0f, 15.0f);
+	std::vector<uint32> result, expected;
+	bvh.QuerySphere(sphere, result);
+	for (uint32 b = 0; b < (uint32)boxes.size(); ++b)
+	{
+		if (Math::SphereIntersectsAABB(sphere, boxes[b]))
+			expected.push_back(b);
+	}
+	std::sort(result.begin(), result.end());
+	REQUIRE(result == expected);
+
+	// Everything moves, this goes through all the nodes instead
+	moved.clear();
+	for (uint32 b = 0; b < (uint32)boxes.size(); ++b)
+	{
+		boxes[b].Min *= 2.0f;
+		boxes[b].Max *= 2.0f;
+		moved.push_back(b);
+	}
+	bvh.Refit(moved, boxes);
+	REQUIRE(IsValidTree(bvh));
+
+	Math::AABB expectedBounds;
+	for (const Math::AABB& box : boxes)
+		expectedBounds.Extend(box);
+	REQUIRE(bvh.GetBounds() == expectedBounds);
+
+	// Moving the instances apart makes the tree worse, a new build fixes it
+	LB_LOG("SAH cost after the build: %.2f, after the refits: %.2f", buildCost, bvh.ComputeCost());
+	bvh.Build(boxes);
+	REQUIRE(IsValidTree(bvh));
+}
+
+TEST_CASE("InstanceBVH - Parallel Build")
+{
+	LB_LOG("InstanceBVH - Parallel Build");
+
+	// Big enough that the top of the tree is split over jobs, the tree does not depend on the order they run in.
+	// Only the node indices do, so the costs are summed in a different order.
+	std::mt19937 rng(13);
+	const std::vector<Math::AABB> boxes = Tests::CreateRandomBoxes(50'000, 1000.0f, rng);
+
+	InstanceBVH first, second;
+	first.Build(boxes);
+	second.Build(boxes);
+	REQUIRE(IsValidTree(first));
+	REQUIRE(first.NumNodes() == second.NumNodes());
+	REQUIRE(first.ComputeCost() == Approx(second.ComputeCost()));
+
+	// Instances that all share the same center can not be split by the SAH
+	const std::vector<Math::AABB> stacked(100, Math::AABB{ float3(-1.0f), float3(1.0f) });
+	InstanceBVH stackedBVH;
+	stackedBVH.Build(stacked);
+	REQUIRE(IsValidTree(stackedBVH));
+	std::vector<uint32> result;
+	stackedBVH.QuerySphere(float4(0.0f, 0.0f, 0.0f, 0.5f), result);
+	REQUIRE(result.size() == 100);
+}
+
+TEST_CASE("InstanceBVH - Benchmark")
+{
+	LB_LOG("InstanceBVH - Benchmark");
+
+	// The real scenes when they are there, Sponza is 103 instances and the bathroom 82
+	const char* scenes[] = { "assets/models/Sponza/Sponza.gltf", "assets/models/bathroom/LAZIENKA.gltf" };
+	for (const char* path : scenes)
+	{
+		std::vector<Math::AABB> boxes;
+		if (!LoadSceneBoxes(path, boxes))
+		{
+			LB_WARN("Could not load %s, skipping it", path);
+			continue;
+		}
+		Benchmark(path, boxes);
+	}
+
+	// And the same instance counts spread over a room, then the counts of bigger levels
+	std::mt19937 rng(17);
+	Benchmark("Sponza sized", Tests::CreateRandomBoxes(103, 20.0f, rng));
+	Benchmark("Bathroom sized", Tests::CreateRandomBoxes(82, 5.0f, rng));
+	Benchmark("10k instances", Tests::CreateRandomBoxes(10'000, 500.0f, rng));
+	Benchmark("100k instances", Tests::CreateRandomBoxes(100'000, 2000.0f, rng));
+}
+
+#endif
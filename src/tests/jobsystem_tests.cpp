@@ -3,6 +3,8 @@
 #include "core/jobsystem.h"
 #include "core/timer.h"
 
+#include <thread>
+
 #if ENABLE_LIMBO_TESTS
 #include <catch/catch.hpp>
 
@@ -93,4 +95,96 @@ TEST_CASE("jobsystem - ExecuteMany() speed")
     }
 }
 
+TEST_CASE("jobsystem - Wait() on a context")
+{
+    using namespace limbo;
+
+    std::atomic<uint32> counter = 0;
+    std::atomic<uint32> otherCounter = 0;
+
+    Core::JobContext context;
+    Core::JobSystem::ExecuteMany(context, 1000, 16, Core::TOnJobSystemExecuteMany::CreateLambda([&counter](Core::JobDispatchArgs args)
+    {
+        counter.fetch_add(1);
+    }));
+    Core::JobSystem::Execute(context, Core::TOnJobSystemExecute::CreateLambda([&counter]()
+    {
+        counter.fetch_add(1);
+    }));
+
+    // Jobs outside of the context are not waited on by Wait()
+    Core::JobSystem::Execute(Core::TOnJobSystemExecute::CreateLambda([&otherCounter]()
+    {
+        otherCounter.fetch_add(1);
+    }));
+
+    Core::JobSystem::Wait(context);
+    REQUIRE(counter.load() == 1001);
+    REQUIRE_FALSE(Core::JobSystem::IsBusy(context));
+
+    Core::JobSystem::WaitIdle();
+    REQUIRE(otherCounter.load() == 1);
+}
+
+TEST_CASE("jobsystem - Wait() does not run background jobs")
+{
+    using namespace limbo;
+
+    const std::thread::id mainThread = std::this_thread::get_id();
+    std::atomic<bool> bFrameJobStarted = false;
+    std::atomic<bool> bRelease = false;
+    std::atomic<uint32> numBackgroundDone = 0;
+    std::atomic<uint32> numBackgroundOnMainThread = 0;
+    std::atomic<uint32> nestedCounter = 0;
+
+    // A frame job that is running on a worker, the frame waits on it with nothing else to do in its own pool
+    Core::JobContext frameContext;
+    Core::JobSystem::Execute(frameContext, Core::TOnJobSystemExecute::CreateLambda([&bFrameJobStarted]()
+    {
+        bFrameJobStarted.store(true);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }));
+    while (!bFrameJobStarted.load())
+        std::this_thread::yield();
+
+    // Stand for scene loads, one more than the workers so at least one of them is still queued when the frame waits
+    Core::JobContext backgroundContext;
+    const uint32 numBackgroundJobs = Core::JobSystem::ThreadCount() + 1;
+    for (uint32 i = 0; i < numBackgroundJobs; ++i)
+    {
+        Core::JobSystem::ExecuteBackground(backgroundContext, Core::TOnJobSystemExecute::CreateLambda([&, mainThread]()
+        {
+            if (std::this_thread::get_id() == mainThread)
+                numBackgroundOnMainThread.fetch_add(1);
+
+            Core::Timer timer;
+            while (!bRelease.load() && timer.ElapsedMilliseconds() < 5000.0f)
+                std::this_thread::yield();
+
+            // The jobs it dispatches are background jobs too, it can still wait on them
+            Core::JobContext nestedContext;
+            Core::JobSystem::ExecuteMany(nestedContext, 10, 1, Core::TOnJobSystemExecuteMany::CreateLambda([&nestedCounter](Core::JobDispatchArgs args)
+            {
+                nestedCounter.fetch_add(1);
+            }));
+            Core::JobSystem::Wait(nestedContext);
+            numBackgroundDone.fetch_add(1);
+        }));
+    }
+
+    // The wait returns as soon as the frame job is done, the loads are still running
+    Core::Timer timer;
+    Core::JobSystem::Wait(frameContext);
+    REQUIRE(timer.ElapsedMilliseconds() < 1000.0f);
+    REQUIRE(numBackgroundOnMainThread.load() == 0);
+    REQUIRE(numBackgroundDone.load() == 0);
+    REQUIRE(Core::JobSystem::IsBusy(backgroundContext));
+
+    bRelease.store(true);
+    Core::JobSystem::Wait(backgroundContext);
+    REQUIRE(numBackgroundDone.load() == numBackgroundJobs);
+    REQUIRE(numBackgroundOnMainThread.load() == 0);
+    REQUIRE(nestedCounter.load() == numBackgroundJobs * 10);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "stdafx.h"
+#include "tests.h"
+#include "gfx/meshletculling.h"
+
+using namespace limbo;
+using namespace limbo::Gfx;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+namespace
+{
+	constexpr uint2 RenderSize = uint2(1920, 1080);
+
+	uint32 PackNormalCone(float3 axis, float cutoff)
+	{
+		auto toSnorm8 = [](float v) { return (uint32)(uint8)(int8)roundf(v * 127.0f); };
+		return toSnorm8(axis.x) | (toSnorm8(axis.y) << 8) | (toSnorm8(axis.z) << 16) | (toSnorm8(cutoff) << 24);
+	}
+
+	// A cutoff of 1 means that the cone never culls
+	Meshlet CreateMeshlet(float4 sphere, float3 coneAxis = float3(0.0f, 0.0f, 1.0f), float coneCutoff = 1.0f)
+	{
+		return {
+			.VertexCount = 64,
+			.TriangleCount = 124,
+			.BoundingSphere = sphere,
+			.NormalCone = PackNormalCone(coneAxis, coneCutoff)
+		};
+	}
+
+	// At the origin looking down -z
+	MeshletCullingView CreateView()
+	{
+		const float4x4 projection = Math::InfReversedProj_RH(Math::PI_DIV_2, (float)RenderSize.x / RenderSize.y, 0.1f);
+		return CreateMeshletCullingView(float4x4(1.0f), projection, float3(0.0f), RenderSize);
+	}
+
+	MeshletCullResult Cull(const Meshlet& meshlet, const float4x4& transform, const MeshletCullingView& view)
+	{
+		MeshletCullingStats stats;
+		std::vector<uint32> visible;
+		CullMeshlets(&meshlet, 1, transform, view, stats, &visible);
+		REQUIRE(stats.NumMeshlets == 1);
+		REQUIRE(visible.size() == stats.NumVisible());
+
+		for (uint32 i = 0; i < (uint32)MeshletCullResult::MAX; ++i)
+		{
+			if (stats.NumResults[i] == 1)
+				return (MeshletCullResult)i;
+		}
+		return MeshletCullResult::MAX;
+	}
+}
+
+TEST_CASE("MeshletCulling - Normal Cones")
+{
+	LB_LOG("MeshletCulling - Normal Cones");
+
+	const float4 cone = MeshletCulling::UnpackNormalCone(PackNormalCone(float3(1.0f, -1.0f, 0.0f), 0.5f));
+	REQUIRE(cone.x == 1.0f);
+	REQUIRE(cone.y == -1.0f);
+	REQUIRE(cone.z == 0.0f);
+	REQUIRE(fabsf(cone.w - 0.5f) <= 0.5f / 127.0f);
+
+	// Every normal points away from the eye
+	const float4 sphere = float4(0.0f, 0.0f, -10.0f, 1.0f);
+	REQUIRE(MeshletCulling::IsConeBackfacing(sphere, float4(0.0f, 0.0f, -1.0f, 0.5f), float3(0.0f)));
+	// Facing the eye, or a cone too wide for the angle the sphere covers
+	REQUIRE(!MeshletCulling::IsConeBackfacing(sphere, float4(0.0f, 0.0f, 1.0f, 0.5f), float3(0.0f)));
+	REQUIRE(!MeshletCulling::IsConeBackfacing(sphere, float4(0.0f, 0.0f, -1.0f, 0.95f), float3(0.0f)));
+	REQUIRE(!MeshletCulling::IsConeBackfacing(sphere, float4(0.0f, 0.0f, -1.0f, 1.0f), float3(0.0f)));
+}
+
+TEST_CASE("MeshletCulling - Results")
+{
+	LB_LOG("MeshletCulling - Results");
+
+	const MeshletCullingView view = CreateView();
+	const float4x4 identity(1.0f);
+
+	REQUIRE(Cull(CreateMeshlet(float4(0.0f, 0.0f, -10.0f, 1.0f)), identity, view) == MeshletCullResult::Visible);
+
+	// Behind the eye, out of the sides and crossing one of them
+	REQUIRE(Cull(CreateMeshlet(float4(0.0f, 0.0f, 10.0f, 1.0f)), identity, view) == MeshletCullResult::Frustum);
+	REQUIRE(Cull(CreateMeshlet(float4(100.0f, 0.0f, -10.0f, 1.0f)), identity, view) == MeshletCullResult::Frustum);
+	REQUIRE(Cull(CreateMeshlet(float4(0.0f, -20.0f, -10.0f, 1.0f)), identity, view) == MeshletCullResult::Frustum);
+	REQUIRE(Cull(CreateMeshlet(float4(0.0f, -10.5f, -10.0f, 1.0f)), identity, view) == MeshletCullResult::Visible);
+
+	// Normals pointing away from the eye
+	const Meshlet away = CreateMeshlet(float4(0.0f, 0.0f, -10.0f, 1.0f), float3(0.0f, 0.0f, -1.0f), 0.5f);
+	REQUIRE(Cull(away, identity, view) == MeshletCullResult::Backface);
+
+	// The cone test is done in local space, a scale does not change it
+	float4x4 scaled(1.0f);
+	scaled[0][0] = 4.0f;
+	scaled[2][2] = 0.25f;
+	scaled[3] = float4(0.0f, 0.0f, -20.0f, 1.0f);
+	const Meshlet awayAtOrigin = CreateMeshlet(float4(0.0f, 0.0f, 0.0f, 1.0f), float3(0.0f, 0.0f, -1.0f), 0.5f);
+	REQUIRE(Cull(awayAtOrigin, scaled, view) == MeshletCullResult::Backface);
+
+	// A mirrored mesh does not get the cone test
+	float4x4 mirrored = scaled;
+	mirrored[0][0] = -4.0f;
+	REQUIRE(Cull(awayAtOrigin, mirrored, view) == MeshletCullResult::Visible);
+
+	// Too small to cover a pixel center, the center of the screen is between pixels
+	REQUIRE(Cull(CreateMeshlet(float4(0.0f, 0.0f, -100.0f, 0.01f)), identity, view) == MeshletCullResult::SmallPrimitive);
+	// Covers the centers around it
+	REQUIRE(Cull(CreateMeshlet(float4(0.0f, 0.0f, -100.0f, 0.2f)), identity, view) == MeshletCullResult::Visible);
+	// The eye inside of the sphere
+	REQUIRE(Cull(CreateMeshlet(float4(0.0f, 0.0f, -0.5f, 1.0f)), identity, view) == MeshletCullResult::Visible);
+
+	// Every test can be turned off
+	MeshletCullingView noCulling = view;
+	noCulling.bFrustumCulling = false;
+	noCulling.bBackfaceCulling = false;
+	noCulling.bSmallPrimitiveCulling = false;
+	REQUIRE(Cull(CreateMeshlet(float4(0.0f, 0.0f, 10.0f, 1.0f)), identity, noCulling) == MeshletCullResult::Visible);
+	REQUIRE(Cull(away, identity, noCulling) == MeshletCullResult::Visible);
+	REQUIRE(Cull(CreateMeshlet(float4(0.0f, 0.0f, -100.0f, 0.01f)), identity, noCulling) == MeshletCullResult::Visible);
+}
+
+TEST_CASE("MeshletCulling - Stats")
+{
+	LB_LOG("MeshletCulling - Stats");
+
+	const Meshlet meshlets[] = {
+		CreateMeshlet(float4(0.0f, 0.0f, -10.0f, 1.0f)),
+		CreateMeshlet(float4(0.0f, 0.0f, 10.0f, 1.0f)),
+		CreateMeshlet(float4(0.0f, 0.0f, -10.0f, 1.0f), float3(0.0f, 0.0f, -1.0f), 0.5f),
+		CreateMeshlet(float4(2.0f, 0.0f, -10.0f, 1.0f)),
+	};
+
+	MeshletCullingStats stats;
+	std::vector<uint32> visible;
+	CullMeshlets(meshlets, 4, float4x4(1.0f), CreateView(), stats, &visible);
+	REQUIRE(stats.NumMeshlets == 4);
+	REQUIRE(stats.NumVisible() == 2);
+	REQUIRE(stats.NumResults[(uint32)MeshletCullResult::Frustum] == 1);
+	REQUIRE(stats.NumResults[(uint32)MeshletCullResult::Backface] == 1);
+	REQUIRE(stats.GetCullRate() == 0.5f);
+	REQUIRE(visible == std::vector<uint32>{ 0, 3 });
+}
+
+#endif
@@ -0,0 +1,97 @@
+#include "stdafx.h"
+#include "tests.h"
+#include "gfx/meshlod.h"
+
+using namespace limbo;
+using namespace limbo::Gfx;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+namespace
+{
+	// Every LOD doubles the error of the previous one
+	constexpr MeshLOD TestLODs[] = {
+		{ .FirstIndex = 0,		.IndexCount = 3000, .FirstMeshlet = 0,  .MeshletCount = 10, .Error = 0.0f },
+		{ .FirstIndex = 3000,	.IndexCount = 1500, .FirstMeshlet = 10, .MeshletCount = 5,  .Error = 0.01f },
+		{ .FirstIndex = 4500,	.IndexCount = 750,	.FirstMeshlet = 15, .MeshletCount = 3,  .Error = 0.02f },
+		{ .FirstIndex = 5250,	.IndexCount = 375,	.FirstMeshlet = 18, .MeshletCount = 2,  .Error = 0.04f },
+	};
+	constexpr uint32 NumTestLODs = 4;
+
+	// Unit sphere at the origin
+	const float4 TestSphere = float4(0.0f, 0.0f, 0.0f, 1.0f);
+
+	MeshLODView CreateView(float distance, float maxPixelError = 1.0f)
+	{
+		return {
+			.Eye = float3(0.0f, 0.0f, distance),
+			.FovY = Math::PI_DIV_2,
+			.ScreenHeight = 1000.0f,
+			.MaxPixelError = maxPixelError
+		};
+	}
+}
+
+TEST_CASE("MeshLOD - Selection")
+{
+	LB_LOG("MeshLOD - Selection");
+
+	const float4x4 identity(1.0f);
+
+	// Nothing to pick from
+	REQUIRE(SelectMeshLOD(TestLODs, 1, TestSphere, identity, CreateView(1000.0f)) == 0);
+
+	// Inside of the bounds every error is visible
+	REQUIRE(SelectMeshLOD(TestLODs, NumTestLODs, TestSphere, identity, CreateView(0.5f)) == 0);
+
+	// With a 90 degrees fov the error covers error / distance * 1000 pixels on screen, the closest point of the sphere is 1 unit closer
+	REQUIRE(SelectMeshLOD(TestLODs, NumTestLODs, TestSphere, identity, CreateView(6.0f)) == 0);
+	REQUIRE(SelectMeshLOD(TestLODs, NumTestLODs, TestSphere, identity, CreateView(16.0f)) == 1);
+	REQUIRE(SelectMeshLOD(TestLODs, NumTestLODs, TestSphere, identity, CreateView(31.0f)) == 2);
+	REQUIRE(SelectMeshLOD(TestLODs, NumTestLODs, TestSphere, identity, CreateView(61.0f)) == 3);
+	REQUIRE(SelectMeshLOD(TestLODs, NumTestLODs, TestSphere, identity, CreateView(10000.0f)) == 3);
+
+	// Moving away never picks a more detailed LOD
+	uint32 previousLOD = 0;
+	for (float distance = 0.0f; distance < 200.0f; distance += 0.5f)
+	{
+		const uint32 lod = SelectMeshLOD(TestLODs, NumTestLODs, TestSphere, identity, CreateView(distance));
+		REQUIRE(lod >= previousLOD);
+		previousLOD = lod;
+	}
+}
+
+TEST_CASE("MeshLOD - Views")
+{
+	LB_LOG("MeshLOD - Views");
+
+	const float4x4 identity(1.0f);
+
+	// A bigger pixel error, like the shadow passes use, picks coarser LODs from the same place
+	for (float distance = 2.0f; distance < 200.0f; distance += 1.0f)
+	{
+		const uint32 mainLOD = SelectMeshLOD(TestLODs, NumTestLODs, TestSphere, identity, CreateView(distance, 1.0f));
+		const uint32 shadowLOD = SelectMeshLOD(TestLODs, NumTestLODs, TestSphere, identity, CreateView(distance, 4.0f));
+		REQUIRE(shadowLOD >= mainLOD);
+	}
+	REQUIRE(SelectMeshLOD(TestLODs, NumTestLODs, TestSphere, identity, CreateView(21.0f, 4.0f)) == 3);
+
+	// The errors are in local space, a mesh scaled up shows them bigger
+	float4x4 scaled(4.0f);
+	scaled[3][3] = 1.0f;
+	REQUIRE(SelectMeshLOD(TestLODs, NumTestLODs, TestSphere, scaled, CreateView(64.0f)) == 1);
+	REQUIRE(SelectMeshLOD(TestLODs, NumTestLODs, TestSphere, identity, CreateView(64.0f)) == 3);
+
+	// Only the distance to the view matters, not where the mesh is
+	float4x4 translated(1.0f);
+	translated[3] = float4(100.0f, 0.0f, 0.0f, 1.0f);
+	const MeshLODView view = {
+		.Eye = float3(100.0f, 0.0f, 31.0f),
+		.FovY = Math::PI_DIV_2,
+		.ScreenHeight = 1000.0f
+	};
+	REQUIRE(SelectMeshLOD(TestLODs, NumTestLODs, TestSphere, translated, view) == 2);
+}
+
+#endif
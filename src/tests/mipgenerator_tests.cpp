@@ -0,0 +1,136 @@
+#include "stdafx.h"
+#include "tests.h"
+#include "gfx/mipgenerator.h"
+
+using namespace limbo;
+using namespace limbo::Gfx;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+namespace
+{
+	std::vector<uint8> GenerateChain(const std::vector<uint8>& image, uint32 width, uint32 height, uint16 mipLevels, const MipGenerator::MipSettings& settings)
+	{
+		std::vector<uint8> chain(MipGenerator::GetMipChainSize(width, height, mipLevels));
+		MipGenerator::GenerateMipChain(image.data(), width, height, mipLevels, settings, chain.data());
+		return chain;
+	}
+}
+
+TEST_CASE("MipGenerator - Filters")
+{
+	LB_LOG("MipGenerator - Filters");
+
+	REQUIRE(MipGenerator::GetMipChainSize(4, 2, 3) == (8 + 2 + 1) * 4);
+
+	// Odd sizes on purpose, the last column and row are clamped
+	constexpr uint32 width = 13;
+	constexpr uint32 height = 7;
+	constexpr uint16 mipLevels = 4;
+	std::vector<uint8> image(width * height * 4);
+	for (uint32 i = 0; i < width * height; ++i)
+	{
+		image[i * 4 + 0] = 10;
+		image[i * 4 + 1] = 128;
+		image[i * 4 + 2] = 250;
+		image[i * 4 + 3] = 77;
+	}
+
+	// A flat image stays flat with every filter, even with the negative lobes
+	for (MipGenerator::MipFilter filter : { MipGenerator::MipFilter::Box, MipGenerator::MipFilter::Kaiser, MipGenerator::MipFilter::Lanczos })
+	{
+		for (bool bSRGB : { false, true })
+		{
+			const std::vector<uint8> chain = GenerateChain(image, width, height, mipLevels, { .Filter = filter, .bSRGB = bSRGB });
+			REQUIRE(memcmp(chain.data(), image.data(), image.size()) == 0);
+			for (size_t i = 0; i < chain.size(); i += 4)
+			{
+				REQUIRE(abs(chain[i + 0] - 10) <= 1);
+				REQUIRE(abs(chain[i + 1] - 128) <= 1);
+				REQUIRE(abs(chain[i + 2] - 250) <= 1);
+				REQUIRE(chain[i + 3] == 77);
+			}
+		}
+	}
+}
+
+TEST_CASE("MipGenerator - sRGB")
+{
+	LB_LOG("MipGenerator - sRGB");
+
+	// Black and white columns, the average has to be done in linear space
+	std::vector<uint8> image(2 * 2 * 4, 255);
+	image[0] = image[1] = image[2] = 0;
+	image[8] = image[9] = image[10] = 0;
+
+	const std::vector<uint8> linear = GenerateChain(image, 2, 2, 2, { .Filter = MipGenerator::MipFilter::Box });
+	REQUIRE(abs(linear[16] - 128) <= 1);
+
+	// 0.5 in linear is 0.735 in sRGB
+	const std::vector<uint8> srgb = GenerateChain(image, 2, 2, 2, { .Filter = MipGenerator::MipFilter::Box, .bSRGB = true });
+	REQUIRE(abs(srgb[16] - 188) <= 1);
+	REQUIRE(srgb[19] == 255);
+}
+
+TEST_CASE("MipGenerator - Normal maps")
+{
+	LB_LOG("MipGenerator - Normal maps");
+
+	// Normals tilted in opposite directions, their average is shorter than 1
+	constexpr uint32 size = 8;
+	std::vector<uint8> image(size * size * 4);
+	for (uint32 y = 0; y < size; ++y)
+	{
+		for (uint32 x = 0; x < size; ++x)
+		{
+			uint8* texel = &image[(y * size + x) * 4];
+			texel[0] = (x + y) % 2 ? 218 : 37; // +-0.71
+			texel[1] = 128;
+			texel[2] = 218;
+			texel[3] = 255;
+		}
+	}
+
+	const std::vector<uint8> chain = GenerateChain(image, size, size, 4, { .Filter = MipGenerator::MipFilter::Kaiser, .bNormalMap = true });
+	for (size_t i = image.size(); i < chain.size(); i += 4)
+	{
+		const float x = chain[i + 0] / 255.0f * 2.0f - 1.0f;
+		const float y = chain[i + 1] / 255.0f * 2.0f - 1.0f;
+		const float z = chain[i + 2] / 255.0f * 2.0f - 1.0f;
+		REQUIRE(fabsf(sqrtf(x * x + y * y + z * z) - 1.0f) < 0.02f);
+	}
+}
+
+TEST_CASE("MipGenerator - Alpha coverage")
+{
+	LB_LOG("MipGenerator - Alpha coverage");
+
+	// Sparse alpha tested foliage, a plain filter averages most of it below the cutoff
+	constexpr uint32 size = 64;
+	constexpr float alphaCutoff = 0.5f;
+	std::vector<uint8> image(size * size * 4, 255);
+	uint32 seed = 1234;
+	for (uint32 i = 0; i < size * size; ++i)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		image[i * 4 + 3] = (seed >> 16) % 4 == 0 ? 255 : 0;
+	}
+
+	const float coverage = MipGenerator::GetAlphaCoverage(image.data(), size, size, alphaCutoff);
+	REQUIRE(coverage > 0.2f);
+	REQUIRE(coverage < 0.3f);
+
+	const std::vector<uint8> plain = GenerateChain(image, size, size, 3, { .Filter = MipGenerator::MipFilter::Box });
+	const std::vector<uint8> preserved = GenerateChain(image, size, size, 3, { .Filter = MipGenerator::MipFilter::Box, .AlphaCutoff = alphaCutoff });
+
+	// The coverage of a small level can only change in steps of a few texels
+	const uint8* plainMip2 = plain.data() + (size * size + (size / 2) * (size / 2)) * 4;
+	const uint8* preservedMip2 = preserved.data() + (size * size + (size / 2) * (size / 2)) * 4;
+	const float plainError = fabsf(MipGenerator::GetAlphaCoverage(plainMip2, size / 4, size / 4, alphaCutoff) - coverage);
+	const float preservedError = fabsf(MipGenerator::GetAlphaCoverage(preservedMip2, size / 4, size / 4, alphaCutoff) - coverage);
+	REQUIRE(plainError > 0.15f);
+	REQUIRE(preservedError < 0.1f);
+}
+
+#endif
@@ -0,0 +1,142 @@
+#include "stdafx.h"
+#include "tests.h"
+#include "gfx/scenecache.h"
+
+#include <cgltf/cgltf.h>
+#include <filesystem>
+#include <fstream>
+
+using namespace limbo;
+using namespace limbo::Gfx;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+namespace
+{
+	void WriteTestFile(const std::filesystem::path& path, const char* contents)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << contents;
+	}
+
+	struct TestScene
+	{
+		std::filesystem::path	Folder;
+		std::string				FolderPath;
+		std::string				ScenePath;
+		std::string				CachePath;
+		cgltf_buffer			Buffer = {};
+		cgltf_image				Image = {};
+		cgltf_data				Data = {};
+
+		TestScene()
+		{
+			Folder = std::filesystem::temp_directory_path() / "limbo_scenecache_tests";
+			std::filesystem::remove_all(Folder);
+			std::filesystem::create_directories(Folder);
+			FolderPath = Folder.generic_string() + "/";
+			ScenePath = FolderPath + "scene.gltf";
+			CachePath = SceneCache::GetCachePath(ScenePath.c_str());
+
+			WriteTestFile(Folder / "scene.gltf", "{ \"asset\": {} }");
+			WriteTestFile(Folder / "scene.bin", "vertices");
+			WriteTestFile(Folder / "albedo.png", "pixels");
+
+			Buffer.uri = (char*)"scene.bin";
+			Image.uri = (char*)"albedo.png";
+			Data.buffers = &Buffer;
+			Data.buffers_count = 1;
+			Data.images = &Image;
+			Data.images_count = 1;
+		}
+
+		~TestScene()
+		{
+			std::error_code error;
+			std::filesystem::remove_all(Folder, error);
+		}
+
+		// Hashes the sources with what the cache recorded, like an import does
+		uint64 Hash(SceneCache::SourceFileHashes& sourceFiles)
+		{
+			uint64 cachedSourceHash = 0;
+			std::vector<SceneCache::SourceFileEntry> cachedSourceFiles;
+			if (SceneCache::ReadSourceFiles(CachePath.c_str(), cachedSourceHash, cachedSourceFiles))
+				sourceFiles.SetRecorded(cachedSourceFiles);
+			return SceneCache::ComputeSourceHash(ScenePath.c_str(), FolderPath.c_str(), &Data, sourceFiles);
+		}
+	};
+}
+
+TEST_CASE("SceneCache - Source files are only read when their stamp changes")
+{
+	LB_LOG("SceneCache - Source files are only read when their stamp changes");
+
+	TestScene scene;
+
+	SceneCache::SourceFileHashes firstSourceFiles;
+	const uint64 sourceHash = scene.Hash(firstSourceFiles);
+	REQUIRE(firstSourceFiles.GetFiles().GetSize() == 3);
+	REQUIRE_FALSE(firstSourceFiles.HasChangedFiles());
+	REQUIRE(SceneCache::Write(scene.CachePath.c_str(), sourceHash, { .SourceFiles = firstSourceFiles.GetFiles() }));
+
+	// Same size and same write time, the recorded hash is used and the new contents are never read
+	const std::filesystem::path bufferPath = scene.Folder / "scene.bin";
+	const std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(bufferPath);
+	WriteTestFile(bufferPath, "VERTICES");
+	std::filesystem::last_write_time(bufferPath, writeTime);
+	{
+		SceneCache::SourceFileHashes sourceFiles;
+		REQUIRE(scene.Hash(sourceFiles) == sourceHash);
+		REQUIRE_FALSE(sourceFiles.HasChangedFiles());
+	}
+
+	// A new write time makes it read the file again
+	std::filesystem::last_write_time(bufferPath, writeTime + std::chrono::seconds(10));
+	{
+		SceneCache::SourceFileHashes sourceFiles;
+		REQUIRE(scene.Hash(sourceFiles) != sourceHash);
+		REQUIRE(sourceFiles.HasChangedFiles());
+	}
+}
+
+TEST_CASE("SceneCache - Touched source files are recorded again")
+{
+	LB_LOG("SceneCache - Touched source files are recorded again");
+
+	TestScene scene;
+
+	SceneCache::SourceFileHashes firstSourceFiles;
+	const uint64 sourceHash = scene.Hash(firstSourceFiles);
+	REQUIRE(SceneCache::Write(scene.CachePath.c_str(), sourceHash, { .SourceFiles = firstSourceFiles.GetFiles() }));
+
+	// Same contents with a new write time, the hash does not change
+	const std::filesystem::path imagePath = scene.Folder / "albedo.png";
+	std::filesystem::last_write_time(imagePath, std::filesystem::last_write_time(imagePath) + std::chrono::seconds(10));
+	SceneCache::SourceFileHashes sourceFiles;
+	REQUIRE(scene.Hash(sourceFiles) == sourceHash);
+	REQUIRE(sourceFiles.HasChangedFiles());
+	REQUIRE(SceneCache::WriteSourceFiles(scene.CachePath.c_str(), sourceFiles.GetFiles()));
+
+	uint64 cachedSourceHash = 0;
+	std::vector<SceneCache::SourceFileEntry> cachedSourceFiles;
+	REQUIRE(SceneCache::ReadSourceFiles(scene.CachePath.c_str(), cachedSourceHash, cachedSourceFiles));
+	REQUIRE(cachedSourceHash == sourceHash);
+	REQUIRE(cachedSourceFiles.size() == 3);
+	for (size_t i = 0; i < cachedSourceFiles.size(); ++i)
+	{
+		REQUIRE(strcmp(cachedSourceFiles[i].Path, sourceFiles.GetFiles()[(uint32)i].Path) == 0);
+		REQUIRE(cachedSourceFiles[i].WriteTime == sourceFiles.GetFiles()[(uint32)i].WriteTime);
+	}
+
+	// The next load trusts the new write time
+	SceneCache::SourceFileHashes nextSourceFiles;
+	REQUIRE(scene.Hash(nextSourceFiles) == sourceHash);
+	REQUIRE_FALSE(nextSourceFiles.HasChangedFiles());
+
+	// A cache written with other source files is left as it is
+	REQUIRE_FALSE(SceneCache::WriteSourceFiles(scene.CachePath.c_str(), Span<SceneCache::SourceFileEntry>(cachedSourceFiles.data(), 2)));
+}
+
+#endif
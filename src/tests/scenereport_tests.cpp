@@ -0,0 +1,84 @@
+#include "stdafx.h"
+#include "tests.h"
+#include "gfx/scenereport.h"
+
+using namespace limbo;
+using namespace limbo::Gfx;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+TEST_CASE("SceneReport - Totals")
+{
+	LB_LOG("SceneReport - Totals");
+
+	SceneReport report;
+
+	// Two BC7 textures with a different number of mips and one shared BC5 texture
+	report.AddTexture("BC7_UNORM", { 64ull, 16ull, 4ull }, 1, false);
+	report.AddTexture("BC7_UNORM", { 256ull, 64ull, 16ull, 4ull }, 0, false);
+	report.AddTexture("BC5_UNORM", { 32ull, 8ull }, 2, true);
+
+	REQUIRE(report.NumTextures == 3);
+	REQUIRE(report.NumSharedTextures == 1);
+	REQUIRE(report.TextureFormats.size() == 2);
+
+	const SceneTextureFormatReport& bc7 = report.TextureFormats[0];
+	REQUIRE(bc7.Format == "BC7_UNORM");
+	REQUIRE(bc7.NumTextures == 2);
+	REQUIRE(bc7.MipBytes == std::vector<uint64>{ 320, 80, 20, 4 });
+	REQUIRE(bc7.TotalBytes == 424);
+	REQUIRE(bc7.ResidentBytes == 20 + 340);
+	REQUIRE(report.TextureFormats[1].ResidentBytes == 0);
+	REQUIRE(report.GetTextureBytes() == 464);
+	REQUIRE(report.GetResidentTextureBytes() == 360);
+
+	// Only the biggest geometries are kept, biggest first
+	for (uint32 i = 0; i < 2 * SceneReport::MaxLargestGeometries; ++i)
+	{
+		const uint64 size = (i * 7) % (2 * SceneReport::MaxLargestGeometries);
+		report.AddGeometry({ .GeometryIndex = i, .VertexBytes = size, .IndexBytes = 2 * size, .MeshletBytes = 1 });
+	}
+
+	REQUIRE(report.NumGeometries == 2 * SceneReport::MaxLargestGeometries);
+	REQUIRE(report.LargestGeometries.size() == SceneReport::MaxLargestGeometries);
+	REQUIRE(report.LargestGeometries.front().VertexBytes == 2 * SceneReport::MaxLargestGeometries - 1);
+	for (uint32 i = 1; i < SceneReport::MaxLargestGeometries; ++i)
+		REQUIRE(report.LargestGeometries[i - 1].GetTotalBytes() > report.LargestGeometries[i].GetTotalBytes());
+
+	const uint64 sumOfSizes = (2 * SceneReport::MaxLargestGeometries - 1) * SceneReport::MaxLargestGeometries;
+	REQUIRE(report.VertexBytes == sumOfSizes);
+	REQUIRE(report.IndexBytes == 2 * sumOfSizes);
+	REQUIRE(report.GetGeometryBytes() == 3 * sumOfSizes + 2 * SceneReport::MaxLargestGeometries);
+}
+
+TEST_CASE("SceneReport - Json")
+{
+	LB_LOG("SceneReport - Json");
+
+	SceneReport report;
+	report.Name = "assets\\models\\\"Sponza\".gltf";
+	report.AddTexture("BC1_UNORM", { 8ull, 2ull }, 0, false);
+	report.AddGeometry({ .GeometryIndex = 3, .NumInstances = 2, .VertexBytes = 100 });
+	report.AddStage("Parse", 1.5);
+	report.LoadMilliseconds = 12.25;
+
+	const std::string json = report.ToJson();
+	REQUIRE(json.find("\"name\": \"assets\\\\models\\\\\\\"Sponza\\\".gltf\"") != std::string::npos);
+	REQUIRE(json.find("\"mipBytes\": [8, 2]") != std::string::npos);
+	REQUIRE(json.find("\"geometry\": 3, \"firstMesh\": 0, \"instances\": 2") != std::string::npos);
+	REQUIRE(json.find("{ \"name\": \"Parse\", \"ms\": 1.500 }") != std::string::npos);
+	REQUIRE(json.find("\"loadMs\": 12.250") != std::string::npos);
+
+	// Balanced, the strings do not hold any brace
+	REQUIRE(std::count(json.begin(), json.end(), '{') == std::count(json.begin(), json.end(), '}'));
+	REQUIRE(std::count(json.begin(), json.end(), '[') == std::count(json.begin(), json.end(), ']'));
+
+	// Empty lists are still valid
+	const std::string empty = SceneReport().ToJson();
+	REQUIRE(empty.find("\"formats\": []") != std::string::npos);
+	REQUIRE(empty.find("\"largestGeometries\": []") != std::string::npos);
+	REQUIRE(empty.find("\"stages\": []") != std::string::npos);
+}
+
+#endif
@@ -0,0 +1,132 @@
+#include "stdafx.h"
+#include "tests.h"
+#include "gfx/shadowcascadecache.h"
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <bit>
+
+using namespace limbo;
+using namespace limbo::Gfx;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+namespace
+{
+	constexpr uint32 AllCascades = (1u << ShadowCascadeCache::NumCascades) - 1;
+
+	// Boxes of growing size around the origin, looking down from the sun, like the cascades of the renderer
+	void CreateCascades(const float3& sunDirection, float offsetX, float4x4 outLightViewProj[ShadowCascadeCache::NumCascades])
+	{
+		for (uint32 i = 0; i < ShadowCascadeCache::NumCascades; ++i)
+		{
+			const float radius = 10.0f * (float)(1u << i);
+			const float3 center = float3(offsetX, 0.0f, 0.0f);
+			const float4x4 lightView = glm::lookAt(center + sunDirection * radius, center, float3(0.0f, 0.0f, 1.0f));
+			outLightViewProj[i] = glm::orthoZO(-radius, radius, -radius, radius, 0.0f, 2.0f * radius) * lightView;
+		}
+	}
+
+	Math::AABB CreateBox(const float3& center)
+	{
+		return { center - 0.5f, center + 0.5f };
+	}
+}
+
+TEST_CASE("ShadowCascadeCache - Redraw")
+{
+	LB_LOG("ShadowCascadeCache - Redraw");
+
+	const float3 sun = float3(0.0f, 1.0f, 0.0f);
+	float4x4 cascades[ShadowCascadeCache::NumCascades];
+	CreateCascades(sun, 0.0f, cascades);
+
+	// Nothing scheduled, every change is drawn right away
+	ShadowCascadeCache cache;
+	cache.SetSettings({ .bEnabled = true, .FirstScheduledCascade = ShadowCascadeCache::NumCascades, .ScheduleInterval = 1 });
+
+	REQUIRE(cache.Update(sun, cascades, {}) == AllCascades);
+	REQUIRE(cache.Update(sun, cascades, {}) == 0);
+	REQUIRE(cache.Update(sun, cascades, {}) == 0);
+
+	// A caster moving between 10 and 20 units away only touches the cascades from 1 on, one moving far away touches none
+	const float3 outside0 = float3(15.0f, 0.0f, 0.0f);
+	REQUIRE(cache.Update(sun, cascades, { CreateBox(outside0), CreateBox(outside0 + float3(0.0f, 0.0f, 1.0f)) }) == (AllCascades & ~1u));
+
+	const float3 outsideAll = float3(1000.0f, 0.0f, 0.0f);
+	REQUIRE(cache.Update(sun, cascades, { CreateBox(outsideAll), CreateBox(outsideAll + float3(1.0f, 0.0f, 0.0f)) }) == 0);
+
+	// Moving out of a cascade still has to erase the old shadow
+	REQUIRE(cache.Update(sun, cascades, { CreateBox(float3(0.0f)), CreateBox(outsideAll) }) == AllCascades);
+
+	// The caster is above the cascade, between it and the sun, it still casts into it
+	REQUIRE(cache.Update(sun, cascades, { CreateBox(float3(0.0f, 500.0f, 0.0f)), CreateBox(float3(0.0f, 501.0f, 0.0f)) }) == AllCascades);
+
+	// Only the cascade whose matrix changed
+	float4x4 moved[ShadowCascadeCache::NumCascades];
+	CreateCascades(sun, 0.0f, moved);
+	moved[0] = glm::translate(moved[0], float3(1.0f, 0.0f, 0.0f));
+	REQUIRE(cache.Update(sun, moved, {}) == 1u);
+	REQUIRE(cache.GetLightViewProj(0) == moved[0]);
+	REQUIRE(cache.Update(sun, moved, {}) == 0);
+
+	// The sun changes the whole shadow
+	const float3 newSun = glm::normalize(float3(0.2f, 1.0f, 0.0f));
+	CreateCascades(newSun, 0.0f, cascades);
+	REQUIRE(cache.Update(newSun, cascades, {}) == AllCascades);
+	REQUIRE(cache.Update(newSun, cascades, {}) == 0);
+
+	cache.Invalidate();
+	REQUIRE(cache.Update(newSun, cascades, {}) == AllCascades);
+
+	// Disabled, everything is drawn every frame
+	cache.SetSettings({ .bEnabled = false });
+	REQUIRE(cache.Update(newSun, cascades, {}) == AllCascades);
+	REQUIRE(cache.Update(newSun, cascades, {}) == AllCascades);
+}
+
+TEST_CASE("ShadowCascadeCache - Schedule")
+{
+	LB_LOG("ShadowCascadeCache - Schedule");
+
+	const float3 sun = float3(0.0f, 1.0f, 0.0f);
+	float4x4 cascades[ShadowCascadeCache::NumCascades];
+	CreateCascades(sun, 0.0f, cascades);
+
+	ShadowCascadeCache cache;
+	cache.SetSettings({ .bEnabled = true, .FirstScheduledCascade = 1, .ScheduleInterval = 3 });
+	REQUIRE(!cache.IsScheduled(0));
+	REQUIRE(cache.IsScheduled(1));
+
+	// The first frame and invalidations draw everything, whatever the schedule says
+	REQUIRE(cache.Update(sun, cascades, {}) == AllCascades);
+
+	// Every cascade changes every frame, the scheduled ones take turns and keep their old matrix while they wait
+	const uint32 scheduledMask = AllCascades & ~1u;
+	uint32 drawnScheduled = 0;
+	for (uint32 frame = 1; frame <= 3; ++frame)
+	{
+		float4x4 camera[ShadowCascadeCache::NumCascades];
+		CreateCascades(sun, (float)frame, camera);
+
+		const uint32 drawn = cache.Update(sun, camera, {});
+		REQUIRE((drawn & 1u) == 1u);
+		REQUIRE(std::popcount(drawn & scheduledMask) <= (int)Math::DivideAndRoundUp(ShadowCascadeCache::NumCascades - 1, 3u));
+		REQUIRE((drawn & drawnScheduled) == 0);
+		drawnScheduled |= drawn & scheduledMask;
+
+		for (uint32 i = 0; i < ShadowCascadeCache::NumCascades; ++i)
+		{
+			if (drawn & (1u << i))
+				REQUIRE(cache.GetLightViewProj(i) == camera[i]);
+			else
+				REQUIRE(cache.GetLightViewProj(i) != camera[i]);
+		}
+	}
+
+	// After a full interval every cascade caught up
+	REQUIRE(drawnScheduled == scheduledMask);
+}
+
+#endif
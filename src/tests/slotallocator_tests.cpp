@@ -0,0 +1,75 @@
+#include "stdafx.h"
+#include "tests.h"
+#include "gfx/slotallocator.h"
+
+using namespace limbo;
+using namespace limbo::Gfx;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+TEST_CASE("SlotAllocator - Allocate And Free")
+{
+	LB_LOG("SlotAllocator - Allocate And Free");
+
+	SlotAllocator slots;
+	REQUIRE(slots.Allocate(0) == SlotAllocator::InvalidSlot);
+	REQUIRE(slots.GetSize() == 0);
+
+	const uint32 a = slots.Allocate(10);
+	const uint32 b = slots.Allocate(5);
+	const uint32 c = slots.Allocate(20);
+	REQUIRE(a == 0);
+	REQUIRE(b == 10);
+	REQUIRE(c == 15);
+	REQUIRE(slots.GetSize() == 35);
+	REQUIRE(slots.NumAllocated() == 35);
+
+	// A hole in the middle is reused by a range that fits, the rest of it stays free
+	slots.Free(a, 10);
+	REQUIRE(slots.NumFreeRanges() == 1);
+	REQUIRE(slots.Allocate(4) == 0);
+	REQUIRE(slots.Allocate(8) == 35);
+	REQUIRE(slots.GetSize() == 43);
+	REQUIRE(slots.Allocate(6) == 4);
+	REQUIRE(slots.NumFreeRanges() == 0);
+
+	// Neighbouring free ranges are merged
+	slots.Free(4, 6);
+	slots.Free(15, 20);
+	REQUIRE(slots.NumFreeRanges() == 2);
+	slots.Free(b, 5);
+	REQUIRE(slots.NumFreeRanges() == 1);
+	REQUIRE(slots.Allocate(31) == 4);
+	REQUIRE(slots.NumFreeRanges() == 0);
+	REQUIRE(slots.NumAllocated() == 43);
+}
+
+TEST_CASE("SlotAllocator - Shrinks At The End")
+{
+	LB_LOG("SlotAllocator - Shrinks At The End");
+
+	SlotAllocator slots;
+	const uint32 a = slots.Allocate(8);
+	const uint32 b = slots.Allocate(8);
+	const uint32 c = slots.Allocate(8);
+
+	slots.Free(c, 8);
+	REQUIRE(slots.GetSize() == 16);
+	REQUIRE(slots.NumFreeRanges() == 0);
+
+	// The free range before the end goes away with it
+	slots.Free(a, 8);
+	REQUIRE(slots.NumFreeRanges() == 1);
+	slots.Free(b, 8);
+	REQUIRE(slots.GetSize() == 0);
+	REQUIRE(slots.NumFreeRanges() == 0);
+	REQUIRE(slots.NumAllocated() == 0);
+
+	slots.Allocate(3);
+	slots.Reset();
+	REQUIRE(slots.GetSize() == 0);
+	REQUIRE(slots.Allocate(2) == 0);
+}
+
+#endif
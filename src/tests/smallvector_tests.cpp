@@ -0,0 +1,92 @@
+#include "stdafx.h"
+#include "tests.h"
+
+using namespace limbo;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+TEST_CASE("TSmallVector - Inline/Spill")
+{
+	LB_LOG("TSmallVector - Inline/Spill");
+
+	TSmallVector<uint32, 4> list;
+	for (uint32 i = 0; i < 4; ++i)
+		list.Add(i);
+	REQUIRE(list.IsInline());
+	REQUIRE(list.GetSize() == 4);
+
+	list.Add(4);
+	REQUIRE_FALSE(list.IsInline());
+	REQUIRE(list.GetSize() == 5);
+	for (uint32 i = 0; i < list.GetSize(); ++i)
+		REQUIRE(list[i] == i);
+
+	list.Clear();
+	REQUIRE(list.IsEmpty());
+	REQUIRE(list.GetCapacity() >= 5);
+}
+
+TEST_CASE("TSmallVector - Non-trivial types")
+{
+	LB_LOG("TSmallVector - Non-trivial types");
+
+	TSmallVector<std::string, 2> list;
+	for (uint32 i = 0; i < 8; ++i)
+		list.Add(std::to_string(i));
+
+	// Adding an element of the same list while it grows must not read freed memory
+	list.Add(list[0]);
+	REQUIRE(list.GetSize() == 9);
+	REQUIRE(list[8] == "0");
+
+	TSmallVector<std::string, 2> copy = list;
+	REQUIRE(copy.GetSize() == list.GetSize());
+	REQUIRE(copy[7] == "7");
+
+	TSmallVector<std::unique_ptr<uint32>, 2> owners;
+	owners.Emplace(new uint32(42));
+	owners.Emplace(new uint32(43));
+	owners.Emplace(new uint32(44));
+	REQUIRE(*owners[2] == 44);
+}
+
+TEST_CASE("TSmallVector - Move")
+{
+	LB_LOG("TSmallVector - Move");
+
+	LB_LOG("Inline");
+	{
+		TSmallVector<std::string, 4> list = { "a", "b" };
+		TSmallVector<std::string, 4> moved(std::move(list));
+		REQUIRE(list.IsEmpty());
+		REQUIRE(moved.GetSize() == 2);
+		REQUIRE(moved[1] == "b");
+	}
+
+	LB_LOG("Heap");
+	{
+		TSmallVector<std::string, 1> list = { "a", "b", "c" };
+		const std::string* data = list.GetData();
+
+		TSmallVector<std::string, 1> moved;
+		moved = std::move(list);
+		REQUIRE(list.IsEmpty());
+		REQUIRE(list.IsInline());
+		REQUIRE(moved.GetData() == data);
+		REQUIRE(moved[2] == "c");
+	}
+}
+
+TEST_CASE("TStaticArray - Assignment")
+{
+	LB_LOG("TStaticArray - Assignment");
+
+	TStaticArray<std::string, 2> small = { "a", "b" };
+	TStaticArray<std::string, 4> big;
+	big = small;
+	REQUIRE(big.GetSize() == 2);
+	REQUIRE(big.GetCapacity() == 4);
+	REQUIRE(big[1] == "b");
+}
+#endif
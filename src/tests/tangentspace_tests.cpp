@@ -0,0 +1,350 @@
+#include "stdafx.h"
+#include "tests.h"
+#include "gfx/tangentspace.h"
+#include "core/timer.h"
+
+#include <random>
+
+using namespace limbo;
+using namespace limbo::Gfx;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+namespace
+{
+	struct TestMesh
+	{
+		std::vector<MeshVertex> Vertices;
+		std::vector<uint32>		Indices;
+	};
+
+	// (columns + 1) x (rows + 1) vertices with the uvs from 0 to 1, the triangles face cross(dP/du, dP/dv)
+	template<typename TPosition>
+	TestMesh CreateGrid(uint32 columns, uint32 rows, TPosition&& position)
+	{
+		TestMesh mesh;
+		for (uint32 y = 0; y <= rows; ++y)
+		{
+			for (uint32 x = 0; x <= columns; ++x)
+			{
+				const float2 uv = float2((float)x / columns, (float)y / rows);
+				mesh.Vertices.push_back({ .Position = position(uv), .UV = uv });
+			}
+		}
+
+		for (uint32 y = 0; y < rows; ++y)
+		{
+			for (uint32 x = 0; x < columns; ++x)
+			{
+				const uint32 i = y * (columns + 1) + x;
+				mesh.Indices.insert(mesh.Indices.end(), { i, i + 1, i + columns + 1 });
+				mesh.Indices.insert(mesh.Indices.end(), { i + 1, i + columns + 2, i + columns + 1 });
+			}
+		}
+		return mesh;
+	}
+
+	// Unit sphere, u goes around the y axis. The seam and the poles have several vertices at the same position like in a real file.
+	float3 SpherePosition(float2 uv)
+	{
+		const float sinTheta = uv.y > 0.0f && uv.y < 1.0f ? sinf(uv.y * Math::PI) : 0.0f;
+		const float cosTheta = cosf(uv.y * Math::PI);
+		const float phi = uv.x < 1.0f ? uv.x * 2.0f * Math::PI : 0.0f;
+		return float3(sinTheta * cosf(phi), cosTheta, sinTheta * sinf(phi));
+	}
+
+	// A rough terrain, big enough to be split over several jobs
+	float3 TerrainPosition(float2 uv)
+	{
+		return float3(uv.x * 100.0f, sinf(uv.x * 40.0f) * cosf(uv.y * 30.0f) * 2.0f + sinf(uv.x * 300.0f) * 0.1f, -uv.y * 100.0f);
+	}
+
+	// Every face has its own 4 vertices, the uvs of a face go from 0 to 1
+	TestMesh CreateCube()
+	{
+		const float3 normals[] = { float3(1, 0, 0), float3(-1, 0, 0), float3(0, 1, 0), float3(0, -1, 0), float3(0, 0, 1), float3(0, 0, -1) };
+
+		TestMesh mesh;
+		for (const float3& normal : normals)
+		{
+			const float3 u = fabsf(normal.y) > 0.0f ? float3(1, 0, 0) : glm::cross(float3(0, 1, 0), normal);
+			const float3 v = glm::cross(normal, u);
+
+			const uint32 first = (uint32)mesh.Vertices.size();
+			for (const float2 uv : { float2(0, 0), float2(1, 0), float2(1, 1), float2(0, 1) })
+				mesh.Vertices.push_back({ .Position = normal + u * (uv.x * 2.0f - 1.0f) + v * (uv.y * 2.0f - 1.0f), .UV = uv });
+			mesh.Indices.insert(mesh.Indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+		}
+		return mesh;
+	}
+
+	float Angle(const float3& a, const float3& b)
+	{
+		return acosf(glm::clamp(glm::dot(glm::normalize(a), glm::normalize(b)), -1.0f, 1.0f));
+	}
+
+	// One triangle after the other on a single thread, without welding. The grids have no duplicated vertices so it does not change anything.
+	void ReferenceNormals(TestMesh& mesh)
+	{
+		std::vector<float3> normals(mesh.Vertices.size(), float3(0.0f));
+		for (size_t i = 0; i < mesh.Indices.size(); i += 3)
+		{
+			const uint32 i0 = mesh.Indices[i + 0];
+			const uint32 i1 = mesh.Indices[i + 1];
+			const uint32 i2 = mesh.Indices[i + 2];
+			const float3 p0 = mesh.Vertices[i0].Position;
+			const float3 p1 = mesh.Vertices[i1].Position;
+			const float3 p2 = mesh.Vertices[i2].Position;
+
+			const float3 normal = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+			normals[i0] += normal * Angle(p1 - p0, p2 - p0);
+			normals[i1] += normal * Angle(p2 - p1, p0 - p1);
+			normals[i2] += normal * Angle(p0 - p2, p1 - p2);
+		}
+
+		for (size_t i = 0; i < normals.size(); ++i)
+			mesh.Vertices[i].Normal = glm::normalize(normals[i]);
+	}
+
+	// Same as MikkTSpace for meshes without mirrored uvs
+	void ReferenceTangents(TestMesh& mesh)
+	{
+		std::vector<float3> tangents(mesh.Vertices.size(), float3(0.0f));
+		for (size_t i = 0; i < mesh.Indices.size(); i += 3)
+		{
+			const MeshVertex* corners[] = { &mesh.Vertices[mesh.Indices[i]], &mesh.Vertices[mesh.Indices[i + 1]], &mesh.Vertices[mesh.Indices[i + 2]] };
+			const float2 t21 = corners[1]->UV - corners[0]->UV;
+			const float2 t31 = corners[2]->UV - corners[0]->UV;
+			const float3 tangent = glm::normalize(t31.y * (corners[1]->Position - corners[0]->Position) - t21.y * (corners[2]->Position - corners[0]->Position));
+
+			for (uint32 corner = 0; corner < 3; ++corner)
+			{
+				const float3 n = corners[corner]->Normal;
+				const float3 previous = corners[(corner + 2) % 3]->Position - corners[corner]->Position;
+				const float3 next = corners[(corner + 1) % 3]->Position - corners[corner]->Position;
+				const float angle = Angle(previous - glm::dot(previous, n) * n, next - glm::dot(next, n) * n);
+				tangents[mesh.Indices[i + corner]] += glm::normalize(tangent - glm::dot(tangent, n) * n) * angle;
+			}
+		}
+
+		for (size_t i = 0; i < tangents.size(); ++i)
+			mesh.Vertices[i].Tangent = float4(glm::normalize(tangents[i]), 1.0f);
+	}
+
+	// Unit, finite and perpendicular to each other
+	bool IsValidTangentSpace(const MeshVertex& vertex)
+	{
+		const float3 tangent = float3(vertex.Tangent);
+		return fabsf(glm::length(vertex.Normal) - 1.0f) < 1e-4f
+			&& fabsf(glm::length(tangent) - 1.0f) < 1e-4f
+			&& fabsf(glm::dot(vertex.Normal, tangent)) < 1e-4f
+			&& fabsf(vertex.Tangent.w) == 1.0f;
+	}
+
+	void GenerateTangentSpace(TestMesh& mesh, const TangentSpace::NormalSettings& settings = TangentSpace::NormalSettings())
+	{
+		TangentSpace::GenerateNormals(mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices.data(), mesh.Vertices.size(), settings);
+		TangentSpace::GenerateTangents(mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices.data(), mesh.Vertices.size());
+	}
+}
+
+TEST_CASE("TangentSpace - Plane")
+{
+	LB_LOG("TangentSpace - Plane");
+
+	for (TangentSpace::NormalWeighting weighting : { TangentSpace::NormalWeighting::Area, TangentSpace::NormalWeighting::Angle })
+	{
+		TestMesh plane = CreateGrid(4, 4, [](float2 uv) { return float3(uv.x * 2.0f, uv.y * 2.0f, 0.0f); });
+		GenerateTangentSpace(plane, { .Weighting = weighting });
+		for (const MeshVertex& vertex : plane.Vertices)
+		{
+			REQUIRE(glm::distance(vertex.Normal, float3(0.0f, 0.0f, 1.0f)) < 1e-5f);
+			REQUIRE(glm::distance(vertex.Tangent, float4(1.0f, 0.0f, 0.0f, 1.0f)) < 1e-5f);
+		}
+	}
+
+	// Mirrored uvs flip the tangent and the sign, the bitangent still points along +v
+	TestMesh mirrored = CreateGrid(4, 4, [](float2 uv) { return float3(uv.x * 2.0f, uv.y * 2.0f, 0.0f); });
+	for (MeshVertex& vertex : mirrored.Vertices)
+		vertex.UV.x = 1.0f - vertex.UV.x;
+	GenerateTangentSpace(mirrored);
+	for (const MeshVertex& vertex : mirrored.Vertices)
+	{
+		REQUIRE(glm::distance(vertex.Tangent, float4(-1.0f, 0.0f, 0.0f, -1.0f)) < 1e-5f);
+		REQUIRE(glm::distance(glm::cross(vertex.Normal, float3(vertex.Tangent)) * vertex.Tangent.w, float3(0.0f, 1.0f, 0.0f)) < 1e-5f);
+	}
+}
+
+TEST_CASE("TangentSpace - Sphere")
+{
+	LB_LOG("TangentSpace - Sphere");
+
+	constexpr uint32 columns = 64;
+	constexpr uint32 rows = 32;
+	TestMesh sphere = CreateGrid(columns, rows, SpherePosition);
+	GenerateTangentSpace(sphere);
+
+	for (uint32 y = 0; y <= rows; ++y)
+	{
+		for (uint32 x = 0; x <= columns; ++x)
+		{
+			const MeshVertex& vertex = sphere.Vertices[y * (columns + 1) + x];
+			REQUIRE(IsValidTangentSpace(vertex));
+			REQUIRE(glm::dot(vertex.Normal, glm::normalize(vertex.Position)) > 0.999f);
+
+			// Both sides of the seam are welded
+			if (x == columns)
+				REQUIRE(vertex.Normal == sphere.Vertices[y * (columns + 1)].Normal);
+
+			// The tangents follow u around the y axis, the poles have no direction for it.
+			// Every triangle gives the direction of one of its edges, which is off by up to half a column next to the poles.
+			if (y == 0 || y == rows)
+				continue;
+			const float phi = vertex.UV.x * 2.0f * Math::PI;
+			REQUIRE(glm::dot(float3(vertex.Tangent), float3(-sinf(phi), 0.0f, cosf(phi))) > cosf(Math::PI / columns));
+			REQUIRE(vertex.Tangent.w == 1.0f);
+		}
+	}
+}
+
+TEST_CASE("TangentSpace - Cube")
+{
+	LB_LOG("TangentSpace - Cube");
+
+	// Not welded, every face keeps its own normal
+	TestMesh cube = CreateCube();
+	GenerateTangentSpace(cube, { .bWeldPositions = false });
+	for (uint32 i = 0; i < (uint32)cube.Vertices.size(); ++i)
+	{
+		const MeshVertex& vertex = cube.Vertices[i];
+		const MeshVertex& faceCorner = cube.Vertices[i / 4 * 4];
+		REQUIRE(IsValidTangentSpace(vertex));
+		REQUIRE(glm::distance(vertex.Normal, faceCorner.Normal) < 1e-5f);
+		REQUIRE(glm::distance(vertex.Normal, glm::normalize(glm::cross(cube.Vertices[i / 4 * 4 + 1].Position - faceCorner.Position, cube.Vertices[i / 4 * 4 + 3].Position - faceCorner.Position))) < 1e-5f);
+	}
+
+	// Welded, every face adds a right angle to each of its corners however it is triangulated, the corners point away from the center
+	cube = CreateCube();
+	GenerateTangentSpace(cube);
+	for (const MeshVertex& vertex : cube.Vertices)
+	{
+		REQUIRE(IsValidTangentSpace(vertex));
+		REQUIRE(glm::distance(vertex.Normal, glm::normalize(vertex.Position)) < 1e-5f);
+	}
+}
+
+TEST_CASE("TangentSpace - Degenerate Triangles")
+{
+	LB_LOG("TangentSpace - Degenerate Triangles");
+
+	TestMesh mesh;
+	mesh.Vertices = {
+		{ .Position = float3(0, 0, 0), .UV = float2(0, 0) },
+		{ .Position = float3(1, 0, 0), .UV = float2(1, 0) },
+		{ .Position = float3(0, 1, 0), .UV = float2(0, 1) },
+		// Same position as the first vertex
+		{ .Position = float3(0, 0, 0), .UV = float2(0, 0) },
+		// Same uv as the first vertex
+		{ .Position = float3(0, 0, 1), .UV = float2(0, 0) },
+		// No triangle uses it
+		{ .Position = float3(5, 5, 5), .UV = float2(0, 0) },
+	};
+	mesh.Indices = {
+		0, 1, 2,
+		// No area
+		0, 1, 3,
+		// Twice the same vertex
+		2, 2, 1,
+		// No area in uv space
+		0, 4, 3,
+	};
+	GenerateTangentSpace(mesh);
+
+	for (const MeshVertex& vertex : mesh.Vertices)
+		REQUIRE(IsValidTangentSpace(vertex));
+	REQUIRE(glm::distance(mesh.Vertices[0].Normal, float3(0.0f, 0.0f, 1.0f)) < 1e-5f);
+	REQUIRE(mesh.Vertices[3].Normal == mesh.Vertices[0].Normal);
+	REQUIRE(mesh.Vertices[5].Normal == float3(0.0f, 0.0f, 1.0f));
+	REQUIRE(glm::distance(mesh.Vertices[0].Tangent, float4(1.0f, 0.0f, 0.0f, 1.0f)) < 1e-5f);
+
+	// No triangles at all
+	TestMesh empty = { .Vertices = mesh.Vertices };
+	GenerateTangentSpace(empty);
+	for (const MeshVertex& vertex : empty.Vertices)
+		REQUIRE(IsValidTangentSpace(vertex));
+}
+
+TEST_CASE("TangentSpace - Matches Reference")
+{
+	LB_LOG("TangentSpace - Matches Reference");
+
+	// Enough triangles for several jobs
+	TestMesh terrain = CreateGrid(300, 300, TerrainPosition);
+	REQUIRE(terrain.Indices.size() / 3 > TangentSpace::MinTrianglesPerJob * 4);
+
+	TestMesh reference = terrain;
+	ReferenceNormals(reference);
+	ReferenceTangents(reference);
+
+	GenerateTangentSpace(terrain);
+	for (size_t i = 0; i < terrain.Vertices.size(); ++i)
+	{
+		REQUIRE(glm::distance(terrain.Vertices[i].Normal, reference.Vertices[i].Normal) < 1e-4f);
+		REQUIRE(glm::distance(terrain.Vertices[i].Tangent, reference.Vertices[i].Tangent) < 1e-4f);
+	}
+
+	// The same triangles in random order, every job now touches the whole mesh
+	TestMesh shuffled = CreateGrid(300, 300, TerrainPosition);
+	std::vector<uint32> triangles(shuffled.Indices.size() / 3);
+	for (uint32 i = 0; i < (uint32)triangles.size(); ++i)
+		triangles[i] = i;
+	std::shuffle(triangles.begin(), triangles.end(), std::mt19937(7));
+
+	std::vector<uint32> indices;
+	for (uint32 triangle : triangles)
+		indices.insert(indices.end(), shuffled.Indices.begin() + triangle * 3, shuffled.Indices.begin() + triangle * 3 + 3);
+	shuffled.Indices = indices;
+
+	GenerateTangentSpace(shuffled);
+	for (size_t i = 0; i < shuffled.Vertices.size(); ++i)
+	{
+		REQUIRE(glm::distance(shuffled.Vertices[i].Normal, reference.Vertices[i].Normal) < 1e-4f);
+		REQUIRE(glm::distance(shuffled.Vertices[i].Tangent, reference.Vertices[i].Tangent) < 1e-4f);
+	}
+}
+
+TEST_CASE("TangentSpace - Benchmark")
+{
+	LB_LOG("TangentSpace - Benchmark");
+
+	for (uint32 size : { 100u, 500u, 1500u })
+	{
+		const TestMesh source = CreateGrid(size, size, TerrainPosition);
+		const uint32 numTriangles = (uint32)source.Indices.size() / 3;
+
+		TestMesh mesh = source;
+		Core::Timer timer;
+		TangentSpace::GenerateNormals(mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices.data(), mesh.Vertices.size());
+		const float normalsTime = timer.ElapsedMilliseconds();
+
+		timer.Record();
+		TangentSpace::GenerateTangents(mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices.data(), mesh.Vertices.size());
+		const float tangentsTime = timer.ElapsedMilliseconds();
+
+		// The same math one triangle at a time on one thread, without the welding
+		TestMesh reference = source;
+		timer.Record();
+		ReferenceNormals(reference);
+		ReferenceTangents(reference);
+		const float referenceTime = timer.ElapsedMilliseconds();
+
+		for (size_t i = 0; i < mesh.Vertices.size(); i += 97)
+			REQUIRE(glm::distance(mesh.Vertices[i].Tangent, reference.Vertices[i].Tangent) < 1e-4f);
+
+		LB_LOG("%u triangles: normals %.2fms, tangents %.2fms (%.1fM triangles/s), one thread: %.2fms",
+			numTriangles, normalsTime, tangentsTime, numTriangles / ((normalsTime + tangentsTime) * 1000.0f), referenceTime);
+	}
+}
+
+#endif
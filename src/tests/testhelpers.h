@@ -0,0 +1,24 @@
+#pragma once
+
+#include "core/math.h"
+
+#include <random>
+#include <vector>
+
+namespace limbo::Tests
+{
+	// Boxes spread over a cube, about the layout of the props of a big level
+	std::vector<Math::AABB> CreateRandomBoxes(uint32 numBoxes, float worldSize, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> position(-worldSize, worldSize);
+		std::uniform_real_distribution<float> size(0.1f, 4.0f);
+
+		std::vector<Math::AABB> boxes(numBoxes);
+		for (Math::AABB& box : boxes)
+		{
+			box.Min = float3(position(rng), position(rng), position(rng));
+			box.Max = box.Min + float3(size(rng), size(rng), size(rng));
+		}
+		return boxes;
+	}
+}
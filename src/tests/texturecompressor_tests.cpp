@@ -0,0 +1,313 @@
+#include "stdafx.h"
+#include "tests.h"
+#include "gfx/texturecompressor.h"
+
+using namespace limbo;
+using namespace limbo::Gfx;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+namespace
+{
+	using TextureCompressor::Quality;
+
+	// Reference decoders, written from the format specification so they do not share code with the encoders
+	void DecodeBC1(const uint8* src, uint8* rgba)
+	{
+		uint16 c[2];
+		memcpy(c, src, 4);
+		uint32 indices;
+		memcpy(&indices, src + 4, 4);
+
+		int palette[4][4];
+		for (uint32 i = 0; i < 2; ++i)
+		{
+			const int r = (c[i] >> 11) & 31, g = (c[i] >> 5) & 63, b = c[i] & 31;
+			palette[i][0] = (r << 3) | (r >> 2);
+			palette[i][1] = (g << 2) | (g >> 4);
+			palette[i][2] = (b << 3) | (b >> 2);
+			palette[i][3] = 255;
+		}
+		for (uint32 ch = 0; ch < 4; ++ch)
+		{
+			if (c[0] > c[1])
+			{
+				palette[2][ch] = (2 * palette[0][ch] + palette[1][ch]) / 3;
+				palette[3][ch] = (palette[0][ch] + 2 * palette[1][ch]) / 3;
+			}
+			else
+			{
+				palette[2][ch] = (palette[0][ch] + palette[1][ch]) / 2;
+				palette[3][ch] = 0;
+			}
+		}
+
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			for (uint32 ch = 0; ch < 4; ++ch)
+				rgba[i * 4 + ch] = (uint8)palette[(indices >> (i * 2)) & 3][ch];
+		}
+	}
+
+	void DecodeBC4(const uint8* src, uint8* values, uint32 stride)
+	{
+		const int e0 = src[0], e1 = src[1];
+		uint64 indices = 0;
+		memcpy(&indices, src + 2, 6);
+
+		int palette[8] = { e0, e1 };
+		for (int i = 2; i < 8; ++i)
+		{
+			if (e0 > e1)
+				palette[i] = ((8 - i) * e0 + (i - 1) * e1 + 3) / 7;
+			else
+				palette[i] = i < 6 ? ((6 - i) * e0 + (i - 1) * e1 + 2) / 5 : (i == 6 ? 0 : 255);
+		}
+
+		for (uint32 i = 0; i < 16; ++i)
+			values[i * stride] = (uint8)palette[(indices >> (i * 3)) & 7];
+	}
+
+	void DecodeBC7Mode6(const uint8* src, uint8* rgba)
+	{
+		uint64 bits[2];
+		memcpy(bits, src, 16);
+		uint32 offset = 0;
+		auto read = [&](uint32 count)
+		{
+			uint32 value = 0;
+			for (uint32 i = 0; i < count; ++i, ++offset)
+				value |= uint32((bits[offset >> 6] >> (offset & 63)) & 1) << i;
+			return value;
+		};
+
+		REQUIRE(read(7) == (1 << 6));
+
+		int endpoints[2][4];
+		for (uint32 ch = 0; ch < 4; ++ch)
+		{
+			endpoints[0][ch] = read(7) << 1;
+			endpoints[1][ch] = read(7) << 1;
+		}
+		const uint32 p0 = read(1), p1 = read(1);
+		for (uint32 ch = 0; ch < 4; ++ch)
+		{
+			endpoints[0][ch] |= p0;
+			endpoints[1][ch] |= p1;
+		}
+
+		constexpr int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			const uint32 index = read(i == 0 ? 3 : 4);
+			for (uint32 ch = 0; ch < 4; ++ch)
+				rgba[i * 4 + ch] = (uint8)(((64 - weights[index]) * endpoints[0][ch] + weights[index] * endpoints[1][ch] + 32) >> 6);
+		}
+	}
+
+	// Mean squared error of the first numChannels channels
+	double BlockError(const uint8* a, const uint8* b, uint32 numChannels)
+	{
+		double error = 0.0;
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			for (uint32 ch = 0; ch < numChannels; ++ch)
+			{
+				const double d = (double)a[i * 4 + ch] - (double)b[i * 4 + ch];
+				error += d * d;
+			}
+		}
+		return error / (16.0 * numChannels);
+	}
+
+	void MakeGradientBlock(uint8* rgba, uint32 seed)
+	{
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			const float t = (float)i / 15.0f;
+			rgba[i * 4 + 0] = (uint8)(20 + t * 200);
+			rgba[i * 4 + 1] = (uint8)(220 - t * 150);
+			rgba[i * 4 + 2] = (uint8)(seed * 8 + i * 5);
+			rgba[i * 4 + 3] = (uint8)(255 - t * 100);
+		}
+	}
+}
+
+TEST_CASE("TextureCompressor - BC1")
+{
+	LB_LOG("TextureCompressor - BC1");
+
+	for (Quality quality : { Quality::Fast, Quality::High })
+	{
+		// A solid block only loses the 565 precision
+		uint8 solid[64];
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			solid[i * 4 + 0] = 200;
+			solid[i * 4 + 1] = 100;
+			solid[i * 4 + 2] = 50;
+			solid[i * 4 + 3] = 255;
+		}
+
+		uint8 encoded[8], decoded[64];
+		TextureCompressor::EncodeBC1Block(solid, encoded, quality);
+		DecodeBC1(encoded, decoded);
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			REQUIRE(abs(decoded[i * 4 + 0] - 200) <= 4);
+			REQUIRE(abs(decoded[i * 4 + 1] - 100) <= 2);
+			REQUIRE(abs(decoded[i * 4 + 2] - 50) <= 4);
+			// The three color mode would make some of the pixels transparent
+			REQUIRE(decoded[i * 4 + 3] == 255);
+		}
+
+		uint8 gradient[64];
+		// Sixteen steps squeezed in four colors, most of the error is inherent to the format
+		MakeGradientBlock(gradient, 1);
+		TextureCompressor::EncodeBC1Block(gradient, encoded, quality);
+		DecodeBC1(encoded, decoded);
+		REQUIRE(BlockError(gradient, decoded, 3) < 200.0);
+	}
+
+	// The high quality mode is never worse than the fast mode on these blocks
+	uint8 gradient[64], fast[8], high[8], decodedFast[64], decodedHigh[64];
+	for (uint32 seed = 0; seed < 16; ++seed)
+	{
+		MakeGradientBlock(gradient, seed);
+		TextureCompressor::EncodeBC1Block(gradient, fast, Quality::Fast);
+		TextureCompressor::EncodeBC1Block(gradient, high, Quality::High);
+		DecodeBC1(fast, decodedFast);
+		DecodeBC1(high, decodedHigh);
+		REQUIRE(BlockError(gradient, decodedHigh, 3) <= BlockError(gradient, decodedFast, 3) + 1e-3);
+	}
+}
+
+TEST_CASE("TextureCompressor - BC4 and BC5")
+{
+	LB_LOG("TextureCompressor - BC4 and BC5");
+
+	uint8 block[64];
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		block[i * 4 + 0] = (uint8)(i * 17);
+		block[i * 4 + 1] = (uint8)(255 - i * 3);
+		block[i * 4 + 2] = (uint8)(i % 2 ? 10 : 240);
+		block[i * 4 + 3] = 255;
+	}
+
+	// Eight interpolated values over the block range, every pixel is at most half a step away
+	uint8 encoded[16], decoded[64];
+	TextureCompressor::EncodeBC4Block(block, 0, encoded);
+	DecodeBC4(encoded, decoded, 4);
+	for (uint32 i = 0; i < 16; ++i)
+		REQUIRE(abs(decoded[i * 4] - block[i * 4]) <= 255 / 14 + 1);
+
+	// Two values are stored exactly as the endpoints
+	TextureCompressor::EncodeBC4Block(block, 2, encoded);
+	DecodeBC4(encoded, decoded, 4);
+	for (uint32 i = 0; i < 16; ++i)
+		REQUIRE(decoded[i * 4] == block[i * 4 + 2]);
+
+	// Roughness and metal are taken from g and b
+	uint32 channel0, channel1;
+	TextureCompressor::GetSourceChannels(TextureCompressor::TextureRole::RoughnessMetal, channel0, channel1);
+	REQUIRE(channel0 == 1);
+	REQUIRE(channel1 == 2);
+
+	TextureCompressor::EncodeBC5Block(block, channel0, channel1, encoded);
+	DecodeBC4(encoded, decoded + 0, 4);
+	DecodeBC4(encoded + 8, decoded + 1, 4);
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		REQUIRE(abs(decoded[i * 4 + 0] - block[i * 4 + 1]) <= 4);
+		REQUIRE(decoded[i * 4 + 1] == block[i * 4 + 2]);
+	}
+}
+
+TEST_CASE("TextureCompressor - BC7")
+{
+	LB_LOG("TextureCompressor - BC7");
+
+	for (Quality quality : { Quality::Fast, Quality::High })
+	{
+		// With mode 6 a solid color is stored exactly, the p-bit gives the lowest bit
+		uint8 solid[64];
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			solid[i * 4 + 0] = 201;
+			solid[i * 4 + 1] = 100;
+			solid[i * 4 + 2] = 51;
+			solid[i * 4 + 3] = 255;
+		}
+
+		uint8 encoded[16], decoded[64];
+		TextureCompressor::EncodeBC7Block(solid, encoded, quality);
+		DecodeBC7Mode6(encoded, decoded);
+		REQUIRE(BlockError(solid, decoded, 4) < 1.0);
+
+		uint8 gradient[64];
+		for (uint32 seed = 0; seed < 16; ++seed)
+		{
+			MakeGradientBlock(gradient, seed);
+			TextureCompressor::EncodeBC7Block(gradient, encoded, quality);
+			DecodeBC7Mode6(encoded, decoded);
+			REQUIRE(BlockError(gradient, decoded, 4) < (quality == Quality::High ? 2.0 : 16.0));
+		}
+	}
+}
+
+TEST_CASE("TextureCompressor - Mip chain")
+{
+	LB_LOG("TextureCompressor - Mip chain");
+
+	REQUIRE(TextureCompressor::CanCompress(64, 32));
+	REQUIRE_FALSE(TextureCompressor::CanCompress(66, 32));
+
+	REQUIRE(TextureCompressor::SelectFormat(TextureCompressor::TextureRole::Normal, false, Quality::High) == RHI::Format::BC5_UNORM);
+	REQUIRE(TextureCompressor::SelectFormat(TextureCompressor::TextureRole::Albedo, false, Quality::Fast) == RHI::Format::BC1_UNORM);
+	REQUIRE(TextureCompressor::SelectFormat(TextureCompressor::TextureRole::Albedo, true, Quality::Fast) == RHI::Format::BC3_UNORM);
+	REQUIRE(TextureCompressor::SelectFormat(TextureCompressor::TextureRole::Albedo, true, Quality::High) == RHI::Format::BC7_UNORM);
+
+	// Non square, so the smallest levels are below the block size in one dimension only
+	constexpr uint32 width = 32;
+	constexpr uint32 height = 8;
+	const uint16 mipLevels = RHI::CalculateMipCount(width, height);
+	REQUIRE(mipLevels == 6);
+
+	// Solid color RGBA8 chain, every level tightly packed
+	uint32 numTexels = 0;
+	for (uint16 mip = 0; mip < mipLevels; ++mip)
+		numTexels += Math::Max(1u, width >> mip) * Math::Max(1u, height >> mip);
+
+	std::vector<uint8> image(numTexels * 4);
+	for (uint32 i = 0; i < numTexels; ++i)
+	{
+		image[i * 4 + 0] = 30;
+		image[i * 4 + 1] = 160;
+		image[i * 4 + 2] = 90;
+		image[i * 4 + 3] = 255;
+	}
+	REQUIRE_FALSE(TextureCompressor::HasAlpha(image.data(), width, height));
+
+	// 8x2 + 4x1 + 2x1 + 1x1 + 1x1 + 1x1 blocks
+	const uint64 size = TextureCompressor::GetMipChainSize(RHI::Format::BC7_UNORM, width, height, mipLevels);
+	REQUIRE(size == (16 + 4 + 2 + 1 + 1 + 1) * 16);
+
+	std::vector<uint8> compressed(size + 16, 0xcd);
+	TextureCompressor::CompressMipChain(image.data(), width, height, mipLevels, RHI::Format::BC7_UNORM, TextureCompressor::TextureRole::Albedo, Quality::High, compressed.data());
+
+	// Every block of every level decodes to the source color
+	for (uint64 offset = 0; offset < size; offset += 16)
+	{
+		uint8 decoded[64];
+		DecodeBC7Mode6(compressed.data() + offset, decoded);
+		REQUIRE(BlockError(image.data(), decoded, 4) < 1.0);
+	}
+
+	// Nothing is written past the chain
+	for (uint64 i = size; i < compressed.size(); ++i)
+		REQUIRE(compressed[i] == 0xcd);
+}
+
+#endif
@@ -0,0 +1,174 @@
+#include "stdafx.h"
+#include "tests.h"
+#include "gfx/textureresidency.h"
+
+using namespace limbo;
+using namespace limbo::Gfx;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+namespace
+{
+	// 1024x1024 RGBA8, mip 4 is 64x64 so it is the tail
+	constexpr TextureResidency::TextureDesc TestTexture = {
+		.Width = 1024,
+		.Height = 1024,
+		.MipLevels = 11,
+		.Format = RHI::Format::RGBA8_UNORM,
+		.TailMip = 4
+	};
+
+	uint64 MipSize(uint16 mip)
+	{
+		return RHI::GetTextureMipByteSize(TestTexture.Format, TestTexture.Width, TestTexture.Height, 1, mip);
+	}
+
+	// Runs the frames the streamer would run, every request finishes right away
+	void StreamFrame(TextureResidency& residency, uint32 maxLoads, std::vector<TextureResidency::MipRequest>& loads, std::vector<TextureResidency::MipRequest>& evictions)
+	{
+		loads.clear();
+		evictions.clear();
+		residency.Update(maxLoads, loads, evictions);
+		for (const TextureResidency::MipRequest& request : loads)
+			residency.OnRequestFinished(request.Texture);
+		for (const TextureResidency::MipRequest& request : evictions)
+			residency.OnRequestFinished(request.Texture);
+	}
+}
+
+TEST_CASE("TextureResidency - Mips")
+{
+	LB_LOG("TextureResidency - Mips");
+
+	REQUIRE(GetStreamingTailMip(1024, 1024, 11, RHI::Format::RGBA8_UNORM) == 4);
+	REQUIRE(GetStreamingTailMip(2048, 512, 12, RHI::Format::RGBA8_UNORM) == 5);
+	REQUIRE(GetStreamingTailMip(64, 64, 7, RHI::Format::RGBA8_UNORM) == 0);
+	// The top of the resident chain of a block compressed texture has to be a multiple of 4
+	REQUIRE(GetStreamingTailMip(1024, 12, 11, RHI::Format::BC1_UNORM) == 0);
+	REQUIRE(GetStreamingTailMip(1024, 16, 11, RHI::Format::BC1_UNORM) == 2);
+
+	REQUIRE(GetStreamingMip(1024, 1024, 2048.0f) == 0);
+	REQUIRE(GetStreamingMip(1024, 1024, 1024.0f) == 0);
+	REQUIRE(GetStreamingMip(1024, 1024, 300.0f) == 1);
+	REQUIRE(GetStreamingMip(1024, 1024, 0.0f) == 10);
+
+	REQUIRE(GetResidentMipsSize(4, 4, 3, RHI::Format::RGBA8_UNORM, 0) == (16 + 4 + 1) * 4);
+	REQUIRE(GetResidentMipsSize(4, 4, 3, RHI::Format::RGBA8_UNORM, 1) == (4 + 1) * 4);
+}
+
+TEST_CASE("TextureResidency - Loads")
+{
+	LB_LOG("TextureResidency - Loads");
+
+	TextureResidency residency(Utils::ToMB(64));
+	const uint32 low = residency.AddTexture(TestTexture);
+	const uint32 high = residency.AddTexture(TestTexture);
+	REQUIRE(residency.GetResidentSize() == 2 * GetResidentMipsSize(1024, 1024, 11, TestTexture.Format, 4));
+
+	residency.BeginFrame();
+	residency.Request(low, 2, 1.0f);
+	residency.Request(high, 0, 10.0f);
+
+	// One load per frame, the most important texture goes first
+	std::vector<TextureResidency::MipRequest> loads;
+	std::vector<TextureResidency::MipRequest> evictions;
+	residency.Update(1, loads, evictions);
+	REQUIRE(loads.size() == 1);
+	REQUIRE(loads[0].Texture == high);
+	REQUIRE(loads[0].FirstMip == 3);
+	REQUIRE(evictions.empty());
+
+	// A texture only has one request in flight
+	REQUIRE(residency.IsBusy(high));
+	loads.clear();
+	residency.Update(8, loads, evictions);
+	REQUIRE(loads.size() == 1);
+	REQUIRE(loads[0].Texture == low);
+	residency.OnRequestFinished(high);
+	residency.OnRequestFinished(low);
+
+	// Mips are loaded one at a time until the wanted one is resident, and nothing more
+	for (uint32 frame = 0; frame < 8; ++frame)
+	{
+		residency.BeginFrame();
+		residency.Request(low, 2, 1.0f);
+		residency.Request(high, 0, 10.0f);
+		StreamFrame(residency, 8, loads, evictions);
+	}
+	REQUIRE(residency.GetFirstMip(low) == 2);
+	REQUIRE(residency.GetFirstMip(high) == 0);
+	REQUIRE(residency.GetResidentSize() == GetResidentMipsSize(1024, 1024, 11, TestTexture.Format, 2) + GetResidentMipsSize(1024, 1024, 11, TestTexture.Format, 0));
+
+	// A failed load gives its mip back and the texture stops streaming
+	residency.BeginFrame();
+	residency.Request(low, 0, 1.0f);
+	residency.Request(high, 0, 10.0f);
+	loads.clear();
+	residency.Update(8, loads, evictions);
+	REQUIRE(loads.size() == 1);
+	REQUIRE(loads[0].FirstMip == 1);
+	residency.OnLoadFailed(low);
+	REQUIRE(residency.GetFirstMip(low) == 2);
+	REQUIRE(!residency.IsBusy(low));
+
+	residency.BeginFrame();
+	residency.Request(low, 0, 1.0f);
+	loads.clear();
+	residency.Update(8, loads, evictions);
+	REQUIRE(loads.empty());
+}
+
+TEST_CASE("TextureResidency - Budget")
+{
+	LB_LOG("TextureResidency - Budget");
+
+	// Room for one full texture, the other tails and half of a mip 3
+	const uint64 tailSize = GetResidentMipsSize(1024, 1024, 11, TestTexture.Format, TestTexture.TailMip);
+	TextureResidency residency(GetResidentMipsSize(1024, 1024, 11, TestTexture.Format, 0) + 2 * tailSize + MipSize(3) / 2);
+	const uint32 a = residency.AddTexture(TestTexture);
+	const uint32 b = residency.AddTexture(TestTexture);
+	const uint32 c = residency.AddTexture(TestTexture);
+
+	std::vector<TextureResidency::MipRequest> loads;
+	std::vector<TextureResidency::MipRequest> evictions;
+	for (uint32 frame = 0; frame < 8; ++frame)
+	{
+		residency.BeginFrame();
+		residency.Request(a, 0, 1.0f);
+		StreamFrame(residency, 8, loads, evictions);
+	}
+	REQUIRE(residency.GetFirstMip(a) == 0);
+
+	// a is not visible anymore, it gives its mips back when b needs the space
+	residency.BeginFrame();
+	residency.Request(b, 3, 1.0f);
+	StreamFrame(residency, 8, loads, evictions);
+	REQUIRE(residency.GetFirstMip(b) == 3);
+	REQUIRE(evictions.size() == 1);
+	REQUIRE(evictions[0].Texture == a);
+	REQUIRE(evictions[0].FirstMip == TestTexture.TailMip);
+	REQUIRE(residency.GetFirstMip(a) == TestTexture.TailMip);
+
+	for (uint32 frame = 0; frame < 8; ++frame)
+	{
+		residency.BeginFrame();
+		residency.Request(b, 3, 1.0f);
+		residency.Request(c, 0, 5.0f);
+		StreamFrame(residency, 8, loads, evictions);
+		REQUIRE(residency.GetResidentSize() <= residency.GetBudget());
+	}
+
+	// The textures that are still visible are never evicted for each other, c stops where the budget does
+	REQUIRE(residency.GetFirstMip(b) == 3);
+	REQUIRE(residency.GetFirstMip(c) == 1);
+
+	// Lowering the budget gives memory back right away
+	residency.SetBudget(3 * tailSize);
+	residency.BeginFrame();
+	StreamFrame(residency, 8, loads, evictions);
+	REQUIRE(evictions.size() == 2);
+	REQUIRE(residency.GetResidentSize() == 3 * tailSize);
+}
+
+#endif
@@ -0,0 +1,182 @@
+#include "stdafx.h"
+#include "tests.h"
+#include "gfx/transformhierarchy.h"
+#include "core/timer.h"
+
+#include <glm/gtc/quaternion.hpp>
+#include <random>
+
+using namespace limbo;
+using namespace limbo::Gfx;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+namespace
+{
+	bool IsNear(const float4x4& a, const float4x4& b, float epsilon = 1e-4f)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			for (int r = 0; r < 4; ++r)
+			{
+				if (fabsf(a[c][r] - b[c][r]) > epsilon)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	quat RandomRotation(std::mt19937& rng)
+	{
+		std::normal_distribution<float> dist;
+		return glm::normalize(quat(dist(rng), dist(rng), dist(rng), dist(rng)));
+	}
+
+	// Each node gets a parent among the ones before it, a branching of 8 gives a few wide levels
+	void CreateRandomHierarchy(TransformHierarchy& hierarchy, uint32 numNodes, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> offset(-10.0f, 10.0f);
+		std::uniform_real_distribution<float> scale(0.9f, 1.1f);
+
+		hierarchy.Reserve(numNodes);
+		for (uint32 i = 0; i < numNodes; ++i)
+		{
+			const uint32 parent = i == 0 ? TransformHierarchy::InvalidNode : (i - 1) / 8;
+			hierarchy.AddNode(parent, float3(offset(rng), offset(rng), offset(rng)), RandomRotation(rng), float3(scale(rng)));
+		}
+	}
+
+	// Straight walk in node order, the parents are always computed first
+	std::vector<float4x4> ComputeReferenceWorldMatrices(const TransformHierarchy& hierarchy)
+	{
+		std::vector<float4x4> world(hierarchy.NumNodes());
+		for (uint32 i = 0; i < hierarchy.NumNodes(); ++i)
+		{
+			const float4x4 local = TransformHierarchy::ComposeMatrix(hierarchy.GetTranslation(i), hierarchy.GetRotation(i), hierarchy.GetScale(i));
+			const uint32 parent = hierarchy.GetParent(i);
+			world[i] = parent != TransformHierarchy::InvalidNode ? world[parent] * local : local;
+		}
+		return world;
+	}
+}
+
+TEST_CASE("TransformHierarchy - World Matrices")
+{
+	LB_LOG("TransformHierarchy - World Matrices");
+
+	// root -> a -> b, and c added to root after b so the levels are not in node order
+	TransformHierarchy hierarchy;
+	const quat rotation = glm::angleAxis(Math::PI_DIV_2, float3(0.0f, 1.0f, 0.0f));
+	const uint32 root = hierarchy.AddNode(TransformHierarchy::InvalidNode, float3(0.0f, 0.0f, 5.0f), quat(1.0f, 0.0f, 0.0f, 0.0f), float3(2.0f));
+	const uint32 a = hierarchy.AddNode(root, float3(1.0f, 0.0f, 0.0f), rotation, float3(1.0f));
+	const uint32 b = hierarchy.AddNode(a, float3(1.0f, 0.0f, 0.0f), quat(1.0f, 0.0f, 0.0f, 0.0f), float3(1.0f));
+	const uint32 c = hierarchy.AddNode(root, float3(0.0f, 1.0f, 0.0f), quat(1.0f, 0.0f, 0.0f, 0.0f), float3(1.0f));
+	hierarchy.Update();
+	REQUIRE(hierarchy.NumLevels() == 3);
+
+	// b is rotated by a, so its x offset turns into -z, everything is scaled by the root
+	const float3 bPosition = float3(hierarchy.GetWorldMatrix(b)[3]);
+	REQUIRE(glm::length(bPosition - float3(2.0f, 0.0f, 3.0f)) < 1e-4f);
+	const float3 cPosition = float3(hierarchy.GetWorldMatrix(c)[3]);
+	REQUIRE(glm::length(cPosition - float3(0.0f, 2.0f, 5.0f)) < 1e-4f);
+
+	// A node without a TRS can still be added from its matrix, mirrors included
+	const float4x4 matrix = TransformHierarchy::ComposeMatrix(float3(1.0f, 2.0f, 3.0f), rotation, float3(-1.0f, 2.0f, 0.5f));
+	float3 translation, scale;
+	quat decomposedRotation;
+	TransformHierarchy::DecomposeMatrix(matrix, translation, decomposedRotation, scale);
+	REQUIRE(IsNear(TransformHierarchy::ComposeMatrix(translation, decomposedRotation, scale), matrix));
+
+	const uint32 d = hierarchy.AddNode(c, matrix);
+	hierarchy.Update();
+	REQUIRE(IsNear(hierarchy.GetWorldMatrix(d), hierarchy.GetWorldMatrix(c) * matrix));
+
+	// The parent has to exist already
+	REQUIRE(hierarchy.AddNode(hierarchy.NumNodes() + 1, float3(0.0f), quat(1.0f, 0.0f, 0.0f, 0.0f), float3(1.0f)) == TransformHierarchy::InvalidNode);
+}
+
+TEST_CASE("TransformHierarchy - Dirty Propagation")
+{
+	LB_LOG("TransformHierarchy - Dirty Propagation");
+
+	std::mt19937 rng(5);
+	TransformHierarchy hierarchy;
+	CreateRandomHierarchy(hierarchy, 100, rng);
+
+	// Every node is new
+	hierarchy.Update();
+	REQUIRE(hierarchy.GetChangedNodes().size() == 100);
+
+	// Nothing changed, nothing is reported again
+	hierarchy.Update();
+	REQUIRE(hierarchy.GetChangedNodes().empty());
+	REQUIRE(!hierarchy.HasWorldChanged(0));
+
+	// Node 2 has children 17 to 24, and those have 137 and up which do not exist
+	hierarchy.SetTranslation(2, float3(100.0f, 0.0f, 0.0f));
+	hierarchy.SetTranslation(2, float3(50.0f, 0.0f, 0.0f));
+	hierarchy.Update();
+
+	const std::vector<uint32>& changed = hierarchy.GetChangedNodes();
+	REQUIRE(changed.size() == 9);
+	REQUIRE(changed[0] == 2);
+	for (uint32 i = 1; i < changed.size(); ++i)
+		REQUIRE(hierarchy.GetParent(changed[i]) == 2);
+	REQUIRE(!hierarchy.HasWorldChanged(1));
+	REQUIRE(!hierarchy.HasWorldChanged(25));
+
+	const std::vector<float4x4> reference = ComputeReferenceWorldMatrices(hierarchy);
+	for (uint32 i = 0; i < hierarchy.NumNodes(); ++i)
+		REQUIRE(IsNear(hierarchy.GetWorldMatrix(i), reference[i]));
+}
+
+TEST_CASE("TransformHierarchy - 100k Nodes")
+{
+	LB_LOG("TransformHierarchy - 100k Nodes");
+
+	constexpr uint32 numNodes = 100'000;
+	std::mt19937 rng(9);
+	TransformHierarchy hierarchy;
+	CreateRandomHierarchy(hierarchy, numNodes, rng);
+
+	// The first update has every node dirty
+	Core::Timer timer;
+	hierarchy.Update();
+	LB_LOG("Full update of %u nodes in %u levels: %.3fms", numNodes, hierarchy.NumLevels(), timer.ElapsedMilliseconds());
+	REQUIRE(hierarchy.GetChangedNodes().size() == numNodes);
+
+	const std::vector<float4x4> reference = ComputeReferenceWorldMatrices(hierarchy);
+	uint32 numMismatches = 0;
+	for (uint32 i = 0; i < numNodes; ++i)
+		numMismatches += IsNear(hierarchy.GetWorldMatrix(i), reference[i]) ? 0 : 1;
+	REQUIRE(numMismatches == 0);
+
+	// The reference walk, on a single thread, for comparison
+	timer.Record();
+	const std::vector<float4x4> serial = ComputeReferenceWorldMatrices(hierarchy);
+	LB_LOG("Serial walk of %u nodes: %.3fms", numNodes, timer.ElapsedMilliseconds());
+
+	// Moving 1% of the leaves only touches those
+	std::uniform_int_distribution<uint32> leaf(numNodes / 8, numNodes - 1);
+	for (uint32 i = 0; i < numNodes / 100; ++i)
+		hierarchy.SetTranslation(leaf(rng), float3(0.0f));
+	timer.Record();
+	hierarchy.Update();
+	LB_LOG("Update with 1%% of the leaves dirty: %.3fms, %zu changed", timer.ElapsedMilliseconds(), hierarchy.GetChangedNodes().size());
+	REQUIRE(hierarchy.GetChangedNodes().size() <= numNodes / 100);
+
+	// Moving the root moves everything
+	hierarchy.SetTranslation(0, float3(1.0f, 2.0f, 3.0f));
+	timer.Record();
+	hierarchy.Update();
+	LB_LOG("Update with the root dirty: %.3fms", timer.ElapsedMilliseconds());
+	REQUIRE(hierarchy.GetChangedNodes().size() == numNodes);
+
+	timer.Record();
+	hierarchy.Update();
+	LB_LOG("Update with nothing dirty: %.3fms", timer.ElapsedMilliseconds());
+	REQUIRE(hierarchy.GetChangedNodes().empty());
+}
+
+#endif
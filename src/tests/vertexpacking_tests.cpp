@@ -0,0 +1,160 @@
+#include "stdafx.h"
+#include "tests.h"
+#include "gfx/shaderinterop.h"
+
+#include <random>
+
+using namespace limbo;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+namespace
+{
+	// 0.15 degrees for the 11 bits octahedral normals, the tangent angle has 512 steps on top of that
+	const float MaxNormalCos = cosf(Math::Radians(0.15f));
+	const float MaxTangentCos = cosf(Math::Radians(0.5f));
+
+	float3 RandomDirection(std::mt19937& rng)
+	{
+		std::normal_distribution<float> dist;
+		float3 v;
+		do
+		{
+			v = float3(dist(rng), dist(rng), dist(rng));
+		} while (glm::dot(v, v) < 1e-6f);
+		return glm::normalize(v);
+	}
+
+	// A unit tangent perpendicular to the normal, the importer orthogonalizes them the same way
+	float4 RandomTangent(std::mt19937& rng, const float3& normal)
+	{
+		float3 t;
+		do
+		{
+			t = RandomDirection(rng);
+			t -= normal * glm::dot(normal, t);
+		} while (glm::dot(t, t) < 1e-4f);
+		return float4(glm::normalize(t), (rng() & 1) ? 1.0f : -1.0f);
+	}
+
+	MeshVertex RoundTrip(const MeshVertex& vertex, const float3& offset, const float3& scale)
+	{
+		return VertexPacking::UnpackMeshVertex(VertexPacking::PackMeshVertex(vertex, offset, scale), offset, scale);
+	}
+}
+
+TEST_CASE("VertexPacking - Positions")
+{
+	LB_LOG("VertexPacking - Positions");
+
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	const float3 offset(-12.0f, 3.0f, -0.5f);
+	const float3 scale(24.0f, 0.25f, 1000.0f);
+	const float3 maxError = scale * (0.5f / 65535.0f) + 1e-5f * glm::max(glm::abs(offset), glm::abs(offset + scale));
+
+	for (int i = 0; i < 10000; ++i)
+	{
+		MeshVertex vertex = {};
+		vertex.Position = offset + float3(unit(rng), unit(rng), unit(rng)) * scale;
+		vertex.Normal = float3(0.0f, 0.0f, 1.0f);
+
+		const float3 error = glm::abs(RoundTrip(vertex, offset, scale).Position - vertex.Position);
+		REQUIRE(error.x <= maxError.x);
+		REQUIRE(error.y <= maxError.y);
+		REQUIRE(error.z <= maxError.z);
+	}
+
+	// The corners of the bounds are exact
+	MeshVertex corner = {};
+	corner.Normal = float3(0.0f, 0.0f, 1.0f);
+	corner.Position = offset;
+	REQUIRE(RoundTrip(corner, offset, scale).Position == offset);
+	corner.Position = offset + scale;
+	const float3 cornerError = glm::abs(RoundTrip(corner, offset, scale).Position - corner.Position);
+	REQUIRE(cornerError.x <= maxError.x);
+	REQUIRE(cornerError.y <= maxError.y);
+	REQUIRE(cornerError.z <= maxError.z);
+
+	// The bits the BLAS reads as R16G16B16A16_UNORM
+	const PackedMeshVertex packed = VertexPacking::PackMeshVertex(corner, offset, scale);
+	REQUIRE(packed.PositionXY == 0xffffffffu);
+	REQUIRE(packed.PositionZ == 0xffffu);
+}
+
+TEST_CASE("VertexPacking - Normals and Tangents")
+{
+	LB_LOG("VertexPacking - Normals and Tangents");
+
+	std::mt19937 rng(11);
+	for (int i = 0; i < 10000; ++i)
+	{
+		MeshVertex vertex = {};
+		vertex.Normal = RandomDirection(rng);
+		vertex.Tangent = RandomTangent(rng, vertex.Normal);
+
+		const MeshVertex result = RoundTrip(vertex, float3(0.0f), float3(1.0f));
+		REQUIRE(glm::dot(result.Normal, vertex.Normal) >= MaxNormalCos);
+		REQUIRE(glm::dot(float3(result.Tangent), float3(vertex.Tangent)) >= MaxTangentCos);
+		REQUIRE(result.Tangent.w == vertex.Tangent.w);
+
+		// The decoded tangent frame stays orthonormal
+		REQUIRE(fabsf(glm::length(result.Normal) - 1.0f) < 1e-4f);
+		REQUIRE(fabsf(glm::length(float3(result.Tangent)) - 1.0f) < 1e-4f);
+		REQUIRE(fabsf(glm::dot(result.Normal, float3(result.Tangent))) < 1e-4f);
+	}
+
+	// The axes, the poles of the octahedron fold and the seams between its faces
+	const float3 directions[] = {
+		float3( 1.0f, 0.0f, 0.0f), float3(-1.0f, 0.0f, 0.0f),
+		float3( 0.0f, 1.0f, 0.0f), float3( 0.0f,-1.0f, 0.0f),
+		float3( 0.0f, 0.0f, 1.0f), float3( 0.0f, 0.0f,-1.0f),
+		glm::normalize(float3(1.0f, 1.0f, 0.0f)), glm::normalize(float3(-1.0f, 1.0f, -1.0f)),
+	};
+	for (const float3& normal : directions)
+	{
+		for (const float3& direction : directions)
+		{
+			const float3 t = direction - normal * glm::dot(normal, direction);
+			if (glm::dot(t, t) < 1e-4f)
+				continue;
+
+			MeshVertex vertex = {};
+			vertex.Normal = normal;
+			vertex.Tangent = float4(glm::normalize(t), -1.0f);
+
+			const MeshVertex result = RoundTrip(vertex, float3(0.0f), float3(1.0f));
+			REQUIRE(glm::dot(result.Normal, vertex.Normal) >= MaxNormalCos);
+			REQUIRE(glm::dot(float3(result.Tangent), float3(vertex.Tangent)) >= MaxTangentCos);
+			REQUIRE(result.Tangent.w == -1.0f);
+		}
+	}
+}
+
+TEST_CASE("VertexPacking - UVs")
+{
+	LB_LOG("VertexPacking - UVs");
+
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> dist(-8.0f, 8.0f);
+	for (int i = 0; i < 10000; ++i)
+	{
+		MeshVertex vertex = {};
+		vertex.Normal = float3(0.0f, 0.0f, 1.0f);
+		vertex.UV = float2(dist(rng), dist(rng));
+
+		// Halfs have 11 bits of mantissa
+		const float2 uv = RoundTrip(vertex, float3(0.0f), float3(1.0f)).UV;
+		REQUIRE(fabsf(uv.x - vertex.UV.x) <= fabsf(vertex.UV.x) / 2048.0f + 1e-7f);
+		REQUIRE(fabsf(uv.y - vertex.UV.y) <= fabsf(vertex.UV.y) / 2048.0f + 1e-7f);
+	}
+
+	MeshVertex vertex = {};
+	vertex.Normal = float3(0.0f, 0.0f, 1.0f);
+	vertex.UV = float2(0.0f, 1.0f);
+	REQUIRE(RoundTrip(vertex, float3(0.0f), float3(1.0f)).UV == vertex.UV);
+}
+
+#endif
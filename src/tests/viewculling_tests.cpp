@@ -0,0 +1,160 @@
+#include "stdafx.h"
+#include "tests.h"
+#include "gfx/viewculling.h"
+#include "core/timer.h"
+#include "testhelpers.h"
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <random>
+
+using namespace limbo;
+using namespace limbo::Gfx;
+
+#if ENABLE_LIMBO_TESTS
+#include <catch/catch.hpp>
+
+namespace
+{
+	// A camera and four orthographic boxes, about what the deferred renderer culls every frame
+	void CreateViews(std::mt19937& rng, float4x4 outViewProjections[5])
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		const float3 eye = float3(unit(rng), unit(rng), unit(rng)) * 50.0f;
+		outViewProjections[0] = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 300.0f) * glm::lookAt(eye, float3(0.0f), float3(0.0f, 1.0f, 0.0f));
+		for (uint32 i = 1; i < 5; ++i)
+		{
+			const float radius = 10.0f * i;
+			const float3 center = float3(unit(rng), unit(rng), unit(rng)) * 50.0f;
+			const float4x4 lightView = glm::lookAt(center + float3(0.3f, 1.0f, 0.2f) * radius, center, float3(0.0f, 1.0f, 0.0f));
+			outViewProjections[i] = glm::orthoZO(-radius, radius, -radius, radius, 0.0f, 2.0f * radius) * lightView;
+		}
+	}
+
+	std::vector<uint32> CullReference(const std::vector<Math::AABB>& boxes, const float4x4& viewProjection, bool bCullNearPlane)
+	{
+		float4 planes[6];
+		Math::ExtractFrustumPlanes(viewProjection, planes);
+		if (!bCullNearPlane)
+			planes[4] = float4(0.0f, 0.0f, 0.0f, 1.0f);
+
+		std::vector<uint32> result;
+		for (uint32 i = 0; i < (uint32)boxes.size(); ++i)
+		{
+			if (Math::AABBInFrustum(planes, boxes[i]))
+				result.push_back(i);
+		}
+		return result;
+	}
+}
+
+TEST_CASE("ViewCulling - Matches Reference")
+{
+	LB_LOG("ViewCulling - Matches Reference");
+
+	// Not a multiple of the block size, the last block is partly empty
+	std::mt19937 rng(21);
+	std::vector<Math::AABB> boxes = Tests::CreateRandomBoxes(5003, 100.0f, rng);
+
+	ViewCulling culling;
+	culling.SetInstances(boxes);
+	REQUIRE(culling.NumInstances() == 5003);
+
+	float4x4 viewProjections[5];
+	for (uint32 iteration = 0; iteration < 10; ++iteration)
+	{
+		CreateViews(rng, viewProjections);
+		for (uint32 view = 0; view < 5; ++view)
+			culling.SetView(view, viewProjections[view], view == 0);
+		culling.Cull();
+
+		for (uint32 view = 0; view < 5; ++view)
+		{
+			REQUIRE(culling.GetVisibleInstances(view) == CullReference(boxes, viewProjections[view], view == 0));
+
+			const CullingViewStats stats = culling.GetStats(view);
+			REQUIRE(stats.NumVisible + stats.NumCulled == 5003);
+		}
+	}
+
+	// Moving an instance in front of the camera makes it visible
+	float4 planes[6];
+	Math::ExtractFrustumPlanes(viewProjections[0], planes);
+	uint32 culled = 0;
+	while (Math::AABBInFrustum(planes, boxes[culled]))
+		++culled;
+
+	const float4 inFront = glm::inverse(viewProjections[0]) * float4(0.0f, 0.0f, 0.5f, 1.0f);
+	const float3 center = float3(inFront) / inFront.w;
+	boxes[culled] = { center - 0.5f, center + 0.5f };
+	culling.UpdateInstance(culled, boxes[culled]);
+	culling.Cull();
+	REQUIRE(culling.GetVisibleInstances(0) == CullReference(boxes, viewProjections[0], true));
+	REQUIRE(std::find(culling.GetVisibleInstances(0).begin(), culling.GetVisibleInstances(0).end(), culled) != culling.GetVisibleInstances(0).end());
+
+	// A disabled view sees nothing
+	culling.DisableView(1);
+	culling.Cull();
+	REQUIRE(culling.GetVisibleInstances(1).empty());
+	REQUIRE(culling.GetStats(1).NumCulled == 0);
+
+	// Growing keeps the boxes that were there, the new instances get theirs with UpdateInstance()
+	const Math::AABB farAway = { float3(1000.0f), float3(1001.0f) };
+	culling.Resize(5010);
+	for (uint32 i = 5003; i < 5010; ++i)
+	{
+		boxes.push_back(i == 5009 ? boxes[culled] : farAway);
+		culling.UpdateInstance(i, boxes[i]);
+	}
+	culling.Cull();
+	REQUIRE(culling.NumInstances() == 5010);
+	REQUIRE(culling.GetVisibleInstances(0) == CullReference(boxes, viewProjections[0], true));
+	REQUIRE(culling.GetVisibleInstances(0).back() == 5009);
+
+	ViewCulling empty;
+	empty.SetInstances({});
+	empty.SetView(0, viewProjections[0]);
+	empty.Cull();
+	REQUIRE(empty.GetVisibleInstances(0).empty());
+}
+
+TEST_CASE("ViewCulling - Benchmark")
+{
+	LB_LOG("ViewCulling - Benchmark");
+
+	std::mt19937 rng(23);
+	float4x4 viewProjections[5];
+	CreateViews(rng, viewProjections);
+
+	for (uint32 numInstances : { 100u, 10'000u, 100'000u })
+	{
+		const std::vector<Math::AABB> boxes = Tests::CreateRandomBoxes(numInstances, 200.0f, rng);
+
+		ViewCulling culling;
+		culling.SetInstances(boxes);
+		for (uint32 view = 0; view < 5; ++view)
+			culling.SetView(view, viewProjections[view], view == 0);
+
+		constexpr uint32 numIterations = 100;
+		Core::Timer timer;
+		for (uint32 i = 0; i < numIterations; ++i)
+			culling.Cull();
+		const float cullTime = timer.ElapsedMilliseconds() / numIterations;
+
+		// The same tests one box at a time on one thread
+		timer.Record();
+		size_t numReferenceVisible = 0;
+		for (uint32 view = 0; view < 5; ++view)
+			numReferenceVisible += CullReference(boxes, viewProjections[view], view == 0).size();
+		const float referenceTime = timer.ElapsedMilliseconds();
+
+		size_t numVisible = 0;
+		for (uint32 view = 0; view < 5; ++view)
+			numVisible += culling.GetVisibleInstances(view).size();
+		REQUIRE(numVisible == numReferenceVisible);
+
+		LB_LOG("%u instances x 5 views: %.3fms, one box at a time: %.3fms, %zu visible", numInstances, cullTime, referenceTime, numVisible);
+	}
+}
+
+#endif
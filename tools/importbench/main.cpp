@@ -0,0 +1,372 @@
+#include "stdafx.h"
+
+#include "gfx/sceneimport.h"
+#include "core/jobsystem.h"
+#include "core/timer.h"
+
+#include <cgltf/cgltf.h>
+#include <algorithm>
+#include <cfloat>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+
+// Runs the CPU side of the scene import on its own, nothing is uploaded and no device is created.
+//
+//   limbo_importbench [--runs=3] [--output=result.json] [--no-textures] [--fast-texture-compression] [models...]
+//
+// Without models every .gltf and .glb in assets/models is imported. Every stage runs on the job system like
+// it does in the import, one stage after the other so each one can be timed, and the best run is kept.
+
+using namespace limbo;
+using namespace limbo::Gfx;
+
+namespace
+{
+	struct BenchOptions
+	{
+		std::vector<std::string>		Models;
+		std::string						OutputPath;
+		uint32							NumRuns = 3;
+		bool							bTextures = true;
+		TextureCompressor::Quality		Quality = TextureCompressor::Quality::High;
+	};
+
+	struct StageResult
+	{
+		std::string Name;
+		double		Milliseconds = DBL_MAX;
+		// What went through the stage, for the throughput
+		uint64		NumTriangles = 0;
+		uint64		NumBytes = 0;
+	};
+
+	struct ModelResult
+	{
+		std::string					Path;
+		bool						bLoaded = false;
+		uint64						NumPrimitives = 0;
+		uint64						NumVertices = 0;
+		uint64						NumTriangles = 0;
+		uint64						NumImages = 0;
+		uint64						NumDecodedImages = 0;
+		std::vector<StageResult>	Stages;
+	};
+
+	// One image the run decodes and cooks
+	struct BenchImage
+	{
+		const cgltf_image*		Image = nullptr;
+		SceneImport::ImageUsage	Usage;
+		std::string				SourcePath;
+		uint64					EncodedBytes = 0;
+
+		uint8*					Pixels = nullptr;
+		int						Width = 0;
+		int						Height = 0;
+		int						Channels = 0;
+	};
+
+	bool ParseArgument(const char* arg, const char* name, std::string& value)
+	{
+		const size_t length = strlen(name);
+		if (strncmp(arg, name, length) != 0 || arg[length] != '=')
+			return false;
+		value = arg + length + 1;
+		return true;
+	}
+
+	bool ParseOptions(int argc, char** argv, BenchOptions& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string value;
+			if (ParseArgument(argv[i], "--runs", value))
+				options.NumRuns = Math::Max(atoi(value.c_str()), 1);
+			else if (ParseArgument(argv[i], "--output", value))
+				options.OutputPath = value;
+			else if (strcmp(argv[i], "--no-textures") == 0)
+				options.bTextures = false;
+			else if (strcmp(argv[i], LIMBO_CMD_FAST_TEXTURE_COMPRESSION) == 0)
+				options.Quality = TextureCompressor::Quality::Fast;
+			else if (strncmp(argv[i], "--", 2) == 0)
+				return false;
+			else
+				options.Models.emplace_back(argv[i]);
+		}
+		return true;
+	}
+
+	// The models are either in their own folder or straight in assets/models
+	void FindModels(const char* folder, std::vector<std::string>& outModels)
+	{
+		auto isModel = [](const std::filesystem::path& path)
+		{
+			return path.extension() == ".gltf" || path.extension() == ".glb";
+		};
+
+		std::error_code error;
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(folder, error))
+		{
+			if (entry.is_directory())
+			{
+				for (const std::filesystem::directory_entry& file : std::filesystem::directory_iterator(entry.path(), error))
+				{
+					if (file.is_regular_file() && isModel(file.path()))
+						outModels.emplace_back(file.path().generic_string());
+				}
+			}
+			else if (entry.is_regular_file() && isModel(entry.path()))
+			{
+				outModels.emplace_back(entry.path().generic_string());
+			}
+		}
+		std::sort(outModels.begin(), outModels.end());
+	}
+
+	uint64 GetFileSize(const std::string& path)
+	{
+		std::error_code error;
+		const uint64 size = std::filesystem::file_size(path, error);
+		return error ? 0 : size;
+	}
+
+	// Runs jobCount jobs and waits for them, returns the wall time
+	double TimeJobs(uint32 jobCount, const std::function<void(uint32)>& job)
+	{
+		Core::Timer timer;
+		Core::JobContext context;
+		Core::JobSystem::ExecuteMany(context, jobCount, 1, Core::TOnJobSystemExecuteMany::CreateLambda([&job](Core::JobDispatchArgs args)
+		{
+			job(args.jobIndex);
+		}));
+		Core::JobSystem::Wait(context);
+		return Core::Timestamp::ToMilliseconds((int64)timer.ElapsedTicks());
+	}
+
+	// Keeps the fastest run of every stage
+	void AddStage(ModelResult& result, uint32 stageIndex, const char* name, double milliseconds, uint64 numTriangles, uint64 numBytes)
+	{
+		if (stageIndex >= result.Stages.size())
+			result.Stages.push_back({ .Name = name });
+
+		StageResult& stage = result.Stages[stageIndex];
+		stage.Milliseconds = Math::Min(stage.Milliseconds, milliseconds);
+		stage.NumTriangles = numTriangles;
+		stage.NumBytes = numBytes;
+	}
+
+	bool RunModel(const std::string& path, const BenchOptions& options, ModelResult& result)
+	{
+		uint32 stageIndex = 0;
+
+		// Parse, the json and every buffer it points to
+		Core::Timer timer;
+		cgltf_options gltfOptions = {};
+		cgltf_data* data = nullptr;
+		if (cgltf_parse_file(&gltfOptions, path.c_str(), &data) != cgltf_result_success)
+			return false;
+		if (cgltf_load_buffers(&gltfOptions, data, path.c_str()) != cgltf_result_success)
+		{
+			cgltf_free(data);
+			return false;
+		}
+		const double parseTime = Core::Timestamp::ToMilliseconds((int64)timer.ElapsedTicks());
+
+		uint64 parsedBytes = GetFileSize(path);
+		for (size_t i = 0; i < data->buffers_count; ++i)
+			parsedBytes += data->buffers[i].uri ? data->buffers[i].size : 0;
+		AddStage(result, stageIndex++, "Parse", parseTime, 0, parsedBytes);
+
+		// Every primitive of every mesh, the import only has the ones the nodes point to but that is almost always all of them
+		std::vector<SceneImport::PrimitiveData> primitives;
+		for (size_t meshIndex = 0; meshIndex < data->meshes_count; ++meshIndex)
+		{
+			const cgltf_mesh& mesh = data->meshes[meshIndex];
+			for (size_t i = 0; i < mesh.primitives_count; ++i)
+			{
+				if (mesh.primitives[i].indices)
+					primitives.emplace_back().Primitive = &mesh.primitives[i];
+			}
+		}
+		const uint32 numPrimitives = (uint32)primitives.size();
+
+		const double decodeTime = TimeJobs(numPrimitives, [&primitives](uint32 i) { SceneImport::DecodePrimitive(primitives[i]); });
+
+		uint64 numTriangles = 0, numVertices = 0, numDecodedBytes = 0, numGeneratedTriangles = 0;
+		for (const SceneImport::PrimitiveData& primitive : primitives)
+		{
+			numTriangles += primitive.IndicesStream.size() / 3;
+			numVertices += primitive.VerticesStream.size();
+			numDecodedBytes += primitive.VerticesStream.size() * sizeof(MeshVertex) + primitive.IndicesStream.size() * sizeof(uint32);
+			if (primitive.bMissingNormals || primitive.bMissingTangents)
+				numGeneratedTriangles += primitive.IndicesStream.size() / 3;
+		}
+		result.NumPrimitives = numPrimitives;
+		result.NumVertices = numVertices;
+		result.NumTriangles = numTriangles;
+		AddStage(result, stageIndex++, "Accessor decode", decodeTime, numTriangles, numDecodedBytes);
+
+		const double attributesTime = TimeJobs(numPrimitives, [&primitives](uint32 i) { SceneImport::GenerateMissingAttributes(primitives[i]); });
+		AddStage(result, stageIndex++, "Normals and tangents", attributesTime, numGeneratedTriangles, 0);
+
+		const double optimizeTime = TimeJobs(numPrimitives, [&primitives](uint32 i) { SceneImport::OptimizePrimitiveData(primitives[i]); });
+		AddStage(result, stageIndex++, "Optimize", optimizeTime, numTriangles, numDecodedBytes);
+
+		const double meshletsTime = TimeJobs(numPrimitives, [&primitives](uint32 i)
+		{
+			SceneImport::PrimitiveData& primitive = primitives[i];
+			SceneImport::CreateMeshlets(primitive, primitive.IndicesStream.data(), primitive.IndicesStream.size());
+		});
+		AddStage(result, stageIndex++, "Meshlets", meshletsTime, numTriangles, 0);
+
+		const double lodsTime = TimeJobs(numPrimitives, [&primitives](uint32 i) { SceneImport::CreateMeshLODs(primitives[i]); });
+		AddStage(result, stageIndex++, "LODs", lodsTime, numTriangles, 0);
+
+		if (options.bTextures)
+		{
+			SceneImport::ImageUsageMap usages;
+			SceneImport::GatherImageUsages(data, usages);
+
+			// DDS images are uploaded as they are, there is nothing to decode
+			std::vector<BenchImage> images;
+			const std::string folder = std::filesystem::path(path).parent_path().generic_string() + "/";
+			for (size_t i = 0; i < data->images_count; ++i)
+			{
+				const cgltf_image* image = &data->images[i];
+				if (image->uri && std::string_view(image->uri).find(".dds") != std::string_view::npos)
+					continue;
+
+				BenchImage& benchImage = images.emplace_back();
+				benchImage.Image = image;
+				benchImage.Usage = SceneImport::GetImageUsage(usages, image);
+				if (image->uri)
+				{
+					benchImage.SourcePath = folder + image->uri;
+					benchImage.EncodedBytes = GetFileSize(benchImage.SourcePath);
+				}
+				else if (image->buffer_view)
+				{
+					benchImage.EncodedBytes = image->buffer_view->size;
+				}
+			}
+			result.NumImages = data->images_count;
+
+			const double imageDecodeTime = TimeJobs((uint32)images.size(), [&images](uint32 i)
+			{
+				BenchImage& image = images[i];
+				image.Pixels = SceneImport::DecodeImage(image.Image, image.SourcePath.c_str(), image.Width, image.Height, image.Channels);
+			});
+
+			uint64 encodedBytes = 0, decodedBytes = 0;
+			result.NumDecodedImages = 0;
+			for (const BenchImage& image : images)
+			{
+				encodedBytes += image.EncodedBytes;
+				if (image.Pixels)
+				{
+					decodedBytes += (uint64)image.Width * image.Height * 4;
+					result.NumDecodedImages++;
+				}
+			}
+			AddStage(result, stageIndex++, "Texture decode", imageDecodeTime, 0, encodedBytes);
+
+			const double imageCookTime = TimeJobs((uint32)images.size(), [&images, &options](uint32 i)
+			{
+				BenchImage& image = images[i];
+				if (!image.Pixels)
+					return;
+
+				SceneImport::CookedImage cooked;
+				free(SceneImport::CookImage(image.Pixels, (uint32)image.Width, (uint32)image.Height, image.Usage, options.Quality, 0, cooked));
+			});
+			AddStage(result, stageIndex++, "Texture cook", imageCookTime, 0, decodedBytes);
+
+			for (BenchImage& image : images)
+				free(image.Pixels);
+		}
+
+		cgltf_free(data);
+		return true;
+	}
+
+	std::string ToJson(const BenchOptions& options, const std::vector<ModelResult>& results)
+	{
+		std::string json = "{\n";
+		json += std::format("  \"threads\": {},\n  \"runs\": {},\n", Core::JobSystem::ThreadCount(), options.NumRuns);
+		json += std::format("  \"textureQuality\": \"{}\",\n", options.Quality == TextureCompressor::Quality::Fast ? "fast" : "high");
+		json += "  \"models\": [";
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			const ModelResult& result = results[i];
+			json += std::format("{}\n    {{\n      \"path\": \"{}\",\n      \"loaded\": {},\n", i > 0 ? "," : "", result.Path, result.bLoaded);
+			json += std::format("      \"primitives\": {},\n      \"vertices\": {},\n      \"triangles\": {},\n      \"images\": {},\n      \"decodedImages\": {},\n",
+								result.NumPrimitives, result.NumVertices, result.NumTriangles, result.NumImages, result.NumDecodedImages);
+
+			double totalTime = 0.0;
+			for (const StageResult& stage : result.Stages)
+				totalTime += stage.Milliseconds;
+			json += std::format("      \"totalMs\": {:.3f},\n", totalTime);
+
+			json += "      \"stages\": [";
+			for (size_t s = 0; s < result.Stages.size(); ++s)
+			{
+				const StageResult& stage = result.Stages[s];
+				const double seconds = Math::Max(stage.Milliseconds * 1e-3, 1e-9);
+				json += std::format("{}\n        {{ \"name\": \"{}\", \"ms\": {:.3f}, \"trianglesPerSecond\": {:.0f}, \"mbPerSecond\": {:.2f} }}",
+									s > 0 ? "," : "", stage.Name, stage.Milliseconds, stage.NumTriangles / seconds, stage.NumBytes / (1024.0 * 1024.0) / seconds);
+			}
+			json += result.Stages.empty() ? "]\n    }" : "\n      ]\n    }";
+		}
+		json += results.empty() ? "]\n" : "\n  ]\n";
+		json += "}\n";
+		return json;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		fprintf(stderr, "usage: limbo_importbench [--runs=N] [--output=file.json] [--no-textures] [%s] [models...]\n", LIMBO_CMD_FAST_TEXTURE_COMPRESSION);
+		return 1;
+	}
+
+	if (options.Models.empty())
+		FindModels("assets/models", options.Models);
+	if (options.Models.empty())
+	{
+		fprintf(stderr, "No models found, run it from the root of the repository or pass the models\n");
+		return 1;
+	}
+
+	Core::Timestamp::Calibrate();
+	Core::JobSystem::Initialize();
+
+	std::vector<ModelResult> results(options.Models.size());
+	for (size_t i = 0; i < options.Models.size(); ++i)
+	{
+		ModelResult& result = results[i];
+		result.Path = options.Models[i];
+		result.bLoaded = true;
+		for (uint32 run = 0; run < options.NumRuns && result.bLoaded; ++run)
+			result.bLoaded = RunModel(result.Path, options, result);
+
+		if (result.bLoaded)
+			LB_LOG("%s - %llu triangles", result.Path.c_str(), (unsigned long long)result.NumTriangles);
+		else
+			LB_WARN("Failed to load %s", result.Path.c_str());
+	}
+
+	const std::string json = ToJson(options, results);
+	if (options.OutputPath.empty())
+	{
+		fputs(json.c_str(), stdout);
+		return 0;
+	}
+
+	std::ofstream file(options.OutputPath, std::ios::binary);
+	file.write(json.data(), json.size());
+	return file.good() ? 0 : 1;
+}